@@ -0,0 +1,187 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define pr_fmt(fmt) "BOOTPROF: " fmt
+
+#include <skiboot.h>
+#include <cpu.h>
+#include <lock.h>
+#include <timebase.h>
+#include <device.h>
+#include <opal-internal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <boot-profile.h>
+#include <boot-profile-types.h>
+
+/*
+ * A full boot of a large system runs a few hundred jobs, anything past
+ * this is counted but not recorded.
+ */
+#define BOOT_PROFILE_MAX_ENTRIES	512
+
+struct boot_profile_record {
+	const char	*name;
+	uint64_t	start_tb;
+	uint64_t	end_tb;
+	uint64_t	lock_wait_tb;
+	uint32_t	pir;
+	uint8_t		type;
+};
+
+static struct boot_profile_record records[BOOT_PROFILE_MAX_ENTRIES];
+static unsigned int nr_records, nr_dropped;
+static uint64_t flash_bytes;
+static int cur_phase = -1;
+static bool boot_profile_done;
+static struct lock boot_profile_lock = LOCK_UNLOCKED;
+
+static int boot_profile_start(uint8_t type, const char *name)
+{
+	struct cpu_thread *cpu = this_cpu();
+	struct boot_profile_record *r;
+	int slot = -1;
+
+	if (boot_profile_done)
+		return -1;
+
+	lock(&boot_profile_lock);
+	if (boot_profile_done)
+		goto out;
+	if (nr_records == BOOT_PROFILE_MAX_ENTRIES) {
+		nr_dropped++;
+		goto out;
+	}
+	slot = nr_records++;
+out:
+	unlock(&boot_profile_lock);
+	if (slot < 0)
+		return -1;
+
+	r = &records[slot];
+	r->name = name;
+	r->type = type;
+	r->pir = cpu->pir;
+	/* Turned into the time spent waiting by boot_profile_end() */
+	r->lock_wait_tb = cpu->lock_wait_tb;
+	r->start_tb = mftb();
+
+	return slot;
+}
+
+static void boot_profile_end(int slot)
+{
+	struct boot_profile_record *r;
+
+	if (slot < 0)
+		return;
+
+	r = &records[slot];
+	r->lock_wait_tb = this_cpu()->lock_wait_tb - r->lock_wait_tb;
+	/* The export only trusts lock_wait_tb once end_tb is set */
+	lwsync();
+	r->end_tb = mftb();
+}
+
+void boot_phase(const char *name)
+{
+	boot_profile_end(cur_phase);
+	cur_phase = -1;
+	if (name)
+		cur_phase = boot_profile_start(BOOT_PROFILE_PHASE, name);
+}
+
+int boot_profile_job_start(const char *name)
+{
+	return boot_profile_start(BOOT_PROFILE_JOB, name);
+}
+
+void boot_profile_job_end(int slot)
+{
+	boot_profile_end(slot);
+}
+
+void boot_profile_flash_read(uint64_t bytes)
+{
+	if (boot_profile_done)
+		return;
+
+	lock(&boot_profile_lock);
+	flash_bytes += bytes;
+	unlock(&boot_profile_lock);
+}
+
+void boot_profile_add_dt(void)
+{
+	struct boot_profile_entry *entries;
+	struct boot_profile_hdr *hdr;
+	struct cpu_thread *cpu;
+	uint64_t lock_wait_tb = 0;
+	unsigned int i, count;
+	size_t size;
+
+	if (boot_profile_done)
+		return;
+
+	boot_phase(NULL);
+
+	lock(&boot_profile_lock);
+	boot_profile_done = true;
+	count = nr_records;
+	unlock(&boot_profile_lock);
+
+	for_each_cpu(cpu)
+		lock_wait_tb += cpu->lock_wait_tb;
+
+	size = sizeof(*hdr) + count * sizeof(*entries);
+	hdr = zalloc(size);
+	if (!hdr) {
+		prerror("Failed to allocate %zu bytes for the profile\n", size);
+		return;
+	}
+
+	hdr->magic = cpu_to_be32(BOOT_PROFILE_MAGIC);
+	hdr->version = cpu_to_be32(BOOT_PROFILE_VERSION);
+	hdr->tb_hz = cpu_to_be64(tb_hz);
+	hdr->nr_entries = cpu_to_be32(count);
+	hdr->nr_dropped = cpu_to_be32(nr_dropped);
+	hdr->flash_bytes = cpu_to_be64(flash_bytes);
+	hdr->lock_wait_tb = cpu_to_be64(lock_wait_tb);
+
+	entries = (void *)(hdr + 1);
+	for (i = 0; i < count; i++) {
+		struct boot_profile_record *r = &records[i];
+		struct boot_profile_entry *e = &entries[i];
+		uint64_t end_tb = r->end_tb;
+
+		lwsync();
+		e->start_tb = cpu_to_be64(r->start_tb);
+		e->end_tb = cpu_to_be64(end_tb);
+		/* Still running, it's only a baseline so far */
+		if (end_tb)
+			e->lock_wait_tb = cpu_to_be64(r->lock_wait_tb);
+		e->pir = cpu_to_be32(r->pir);
+		e->type = r->type;
+		/* Zero filled, so always NUL terminated */
+		strncpy(e->name, r->name, BOOT_PROFILE_NAME_LEN - 1);
+	}
+
+	dt_add_property(opal_node, "boot-profile", hdr, size);
+	free(hdr);
+
+	prlog(PR_INFO, "%u entries (%u dropped), %llu bytes read from flash\n",
+	      count, nr_dropped, (unsigned long long)flash_bytes);
+}
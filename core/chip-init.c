@@ -0,0 +1,221 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the per chip initialisation of a set of units, see chip-init.h.
+ * Most of the time goes in XSCOMs to one chip at a time, so with the
+ * work for each chip done by a CPU of that chip the boot doesn't get
+ * slower with the number of sockets. The boot CPU only schedules: it
+ * starts whatever has its dependencies met, polls the jobs and runs
+ * the finish hooks.
+ */
+
+#define pr_fmt(fmt) "CHIPINIT: " fmt
+
+#include <skiboot.h>
+#include <chip.h>
+#include <cpu.h>
+#include <timebase.h>
+#include <chip-init.h>
+
+/* How long the boot CPU waits between looks at the running jobs */
+#define CHIP_INIT_POLL_US	10
+
+enum chip_init_work_state {
+	CHIP_INIT_WAITING,
+	CHIP_INIT_RUNNING,
+	CHIP_INIT_DONE,
+};
+
+struct chip_init_work {
+	const struct chip_init_unit	*unit;
+	struct proc_chip		*chip;
+	struct cpu_job			*job;
+	enum chip_init_work_state	state;
+	/* Time spent in init_chip(), as seen by the CPU that ran it */
+	unsigned long			tb;
+};
+
+struct chip_init_state {
+	const struct chip_init_unit * const *units;
+	unsigned int			nr_units;
+	unsigned int			nr_chips;
+	/* nr_units * nr_chips, unit major */
+	struct chip_init_work		*work;
+	/* Per unit, chips not done yet and whether finish() has run */
+	unsigned int			*left;
+	bool				*finished;
+};
+
+static void chip_init_job(void *data)
+{
+	struct chip_init_work *w = data;
+	unsigned long start = mftb();
+
+	w->unit->init_chip(w->chip);
+	w->tb = mftb() - start;
+}
+
+static int chip_init_unit_index(struct chip_init_state *s,
+				const struct chip_init_unit *unit)
+{
+	unsigned int i;
+
+	for (i = 0; i < s->nr_units; i++)
+		if (s->units[i] == unit)
+			return i;
+	return -1;
+}
+
+static bool chip_init_ready(struct chip_init_state *s, unsigned int u,
+			    unsigned int c)
+{
+	const struct chip_init_unit *dep;
+	unsigned int i;
+	int d;
+
+	for (i = 0; i < CHIP_INIT_MAX_DEPS && s->units[u]->deps[i]; i++) {
+		dep = s->units[u]->deps[i];
+		d = chip_init_unit_index(s, dep);
+		if (d < 0)
+			continue;
+		if (dep->finish ? !s->finished[d] :
+		    s->work[d * s->nr_chips + c].state != CHIP_INIT_DONE)
+			return false;
+	}
+	return true;
+}
+
+static void chip_init_start(struct chip_init_work *w)
+{
+	w->state = CHIP_INIT_RUNNING;
+	if (!w->unit->init_chip)
+		return;
+
+	/* No other CPU on that chip, any one will do, or even us */
+	w->job = cpu_queue_job_on_chip(w->chip->id, w->unit->name,
+				       chip_init_job, w);
+	if (!w->job)
+		w->job = cpu_queue_job(NULL, w->unit->name, chip_init_job, w);
+	if (!w->job)
+		chip_init_job(w);
+}
+
+/* Returns true if anything moved */
+static bool chip_init_step(struct chip_init_state *s, unsigned int *running)
+{
+	struct chip_init_work *w;
+	bool progress = false;
+	unsigned int u, c;
+
+	*running = 0;
+	for (u = 0; u < s->nr_units; u++) {
+		for (c = 0; c < s->nr_chips; c++) {
+			w = &s->work[u * s->nr_chips + c];
+			if (w->state != CHIP_INIT_RUNNING)
+				continue;
+			if (w->job) {
+				if (!cpu_poll_job(w->job))
+					continue;
+				cpu_wait_job(w->job, true);
+				w->job = NULL;
+			}
+			w->state = CHIP_INIT_DONE;
+			s->left[u]--;
+			progress = true;
+		}
+		if (!s->left[u] && !s->finished[u]) {
+			if (s->units[u]->finish)
+				s->units[u]->finish();
+			s->finished[u] = true;
+			progress = true;
+		}
+	}
+
+	for (u = 0; u < s->nr_units; u++) {
+		for (c = 0; c < s->nr_chips; c++) {
+			w = &s->work[u * s->nr_chips + c];
+			if (w->state == CHIP_INIT_WAITING &&
+			    chip_init_ready(s, u, c)) {
+				chip_init_start(w);
+				progress = true;
+			}
+			if (w->state == CHIP_INIT_RUNNING)
+				(*running)++;
+		}
+	}
+
+	return progress;
+}
+
+void chip_init_run(const struct chip_init_unit * const *units,
+		   unsigned int nr_units)
+{
+	struct chip_init_state s = { .units = units, .nr_units = nr_units };
+	unsigned long start = mftb(), serial = 0;
+	unsigned int u, c, running;
+	struct proc_chip *chip;
+	bool done;
+
+	for_each_chip(chip)
+		s.nr_chips++;
+	if (!nr_units || !s.nr_chips)
+		return;
+
+	s.work = zalloc(nr_units * s.nr_chips * sizeof(*s.work));
+	s.left = zalloc(nr_units * sizeof(*s.left));
+	s.finished = zalloc(nr_units * sizeof(*s.finished));
+	assert(s.work && s.left && s.finished);
+
+	for (u = 0; u < nr_units; u++) {
+		c = 0;
+		for_each_chip(chip) {
+			s.work[u * s.nr_chips + c].unit = units[u];
+			s.work[u * s.nr_chips + c].chip = chip;
+			c++;
+		}
+		s.left[u] = s.nr_chips;
+	}
+
+	for (;;) {
+		if (chip_init_step(&s, &running))
+			continue;
+
+		done = true;
+		for (u = 0; u < nr_units; u++)
+			done &= s.finished[u];
+		if (done)
+			break;
+
+		/* Nothing running and nothing can start, that's a loop */
+		if (!running) {
+			prlog(PR_EMERG, "Circular dependencies between units\n");
+			assert(false);
+		}
+
+		time_wait_us(CHIP_INIT_POLL_US);
+	}
+
+	for (u = 0; u < nr_units * s.nr_chips; u++)
+		serial += s.work[u].tb;
+	prlog(PR_INFO, "%u units on %u chips in %lums (%lums of work)\n",
+	      nr_units, s.nr_chips, tb_to_msecs(mftb() - start),
+	      tb_to_msecs(serial));
+
+	free(s.work);
+	free(s.left);
+	free(s.finished);
+}
@@ -97,6 +97,7 @@ static void init_chip(struct dt_node *dn)
 		chip->occ_functional = false;
 
 	list_head_init(&chip->i2cms);
+	init_lock(&chip->hmi_lock);
 
 	/* Update the location code for this chip. */
 	if (dt_has_node_property(dn, "ibm,loc-code", NULL))
@@ -53,6 +53,10 @@ static int vprlog(int log_level, const char *fmt, va_list ap)
 
 	console_write(flush_to_drivers, buffer, count);
 
+	/* Don't leave emergency output sitting in a driver's buffer */
+	if (log_level <= PR_EMERG && flush_to_drivers)
+		flush_console_sync();
+
 	return count;
 }
 
@@ -182,6 +182,23 @@ bool flush_console(void)
 	return ret;
 }
 
+/*
+ * Like flush_console() but also waits for the driver to get out what it
+ * buffered, for emergency output after which we may never poll again.
+ */
+void flush_console_sync(void)
+{
+	bool need_unlock = lock_recursive(&con_lock);
+
+	__flush_console(true);
+
+	if (need_unlock)
+		unlock(&con_lock);
+
+	if (con_driver && con_driver->flush)
+		con_driver->flush();
+}
+
 static void inmem_write(char c)
 {
 	uint32_t opos;
@@ -284,7 +301,11 @@ void console_complete_flush(void)
 	 * Using term 0 here is a dumb hack that works because the UART
 	 * only has term 0 and the FSP doesn't have an explicit flush method.
 	 */
-	int64_t ret = opal_con_driver->flush(0);
+	int64_t ret;
+
+	flush_console_sync();
+
+	ret = opal_con_driver->flush(0);
 
 	if (ret == OPAL_UNSUPPORTED || ret == OPAL_PARAMETER)
 		return;
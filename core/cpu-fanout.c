@@ -0,0 +1,162 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Running the same job on every CPU, for things that have to be done
+ * by each thread itself (timebase sync...). Rather than queueing and
+ * waiting for them one at a time, all the cores go at once, their
+ * threads ordered primary first.
+ */
+
+#include <skiboot.h>
+#include <cpu.h>
+#include <timebase.h>
+
+/* How long the caller waits between looks at the jobs */
+#define CPU_FANOUT_POLL_US	10
+
+enum cpu_fanout_state {
+	CPU_FANOUT_UNUSED,
+	CPU_FANOUT_WAITING,
+	CPU_FANOUT_RUNNING,
+	CPU_FANOUT_DONE,
+	/* Secondary whose primary failed */
+	CPU_FANOUT_SKIPPED,
+};
+
+struct cpu_fanout_slot {
+	struct cpu_thread	*cpu;
+	struct cpu_job		*job;
+	bool			(*func)(void *data);
+	void			*data;
+	enum cpu_fanout_state	state;
+	bool			ok;
+};
+
+static void cpu_fanout_job(void *data)
+{
+	struct cpu_fanout_slot *s = data;
+
+	s->ok = s->func(s->data);
+}
+
+static void cpu_fanout_queue(struct cpu_fanout_slot *s, const char *name)
+{
+	s->state = CPU_FANOUT_RUNNING;
+	s->job = cpu_queue_job(s->cpu, name, cpu_fanout_job, s);
+	if (!s->job) {
+		s->ok = false;
+		s->state = CPU_FANOUT_DONE;
+	}
+}
+
+/* Returns true if anything moved, counts what's still to finish */
+static bool cpu_fanout_step(struct cpu_fanout_slot *slots, const char *name,
+			    unsigned int *pending)
+{
+	struct cpu_fanout_slot *s, *p, *mine = NULL;
+	bool progress = false;
+	unsigned int pir;
+
+	*pending = 0;
+	for (pir = 0; pir <= cpu_max_pir; pir++) {
+		s = &slots[pir];
+
+		if (s->state == CPU_FANOUT_RUNNING && cpu_poll_job(s->job)) {
+			cpu_wait_job(s->job, true);
+			s->job = NULL;
+			s->state = CPU_FANOUT_DONE;
+			progress = true;
+		}
+
+		if (s->state == CPU_FANOUT_WAITING) {
+			/* Primaries, or secondaries of a primary not in the
+			 * run, go straight away
+			 */
+			p = &slots[s->cpu->primary->pir];
+			if (p == s || p->state == CPU_FANOUT_UNUSED) {
+				/* Ours runs inline, so once the others go */
+				if (s->cpu == this_cpu())
+					mine = s;
+				else
+					cpu_fanout_queue(s, name);
+				progress = true;
+			} else if (p->state == CPU_FANOUT_DONE) {
+				if (!p->ok)
+					s->state = CPU_FANOUT_SKIPPED;
+				else if (s->cpu == this_cpu())
+					mine = s;
+				else
+					cpu_fanout_queue(s, name);
+				progress = true;
+			}
+		}
+
+		if (s->state == CPU_FANOUT_WAITING ||
+		    s->state == CPU_FANOUT_RUNNING)
+			(*pending)++;
+	}
+
+	if (mine)
+		cpu_fanout_queue(mine, name);
+
+	return progress;
+}
+
+unsigned int cpu_run_per_core(const char *name,
+			      bool (*func)(void *data), void *data,
+			      struct cpu_thread *skip, bool primaries_only,
+			      void (*done)(struct cpu_thread *cpu,
+					   bool ok, void *data))
+{
+	struct cpu_fanout_slot *slots, *s;
+	unsigned int pir, pending, failed = 0;
+	struct cpu_thread *cpu;
+
+	slots = zalloc((cpu_max_pir + 1) * sizeof(*slots));
+	assert(slots);
+
+	for_each_available_cpu(cpu) {
+		if (cpu == skip || (primaries_only && cpu->is_secondary))
+			continue;
+		s = &slots[cpu->pir];
+		s->cpu = cpu;
+		s->func = func;
+		s->data = data;
+		s->state = CPU_FANOUT_WAITING;
+	}
+
+	for (;;) {
+		if (cpu_fanout_step(slots, name, &pending))
+			continue;
+		if (!pending)
+			break;
+		time_wait_us(CPU_FANOUT_POLL_US);
+	}
+
+	for (pir = 0; pir <= cpu_max_pir; pir++) {
+		s = &slots[pir];
+		if (s->state != CPU_FANOUT_DONE)
+			continue;
+		if (!s->ok)
+			failed++;
+		if (done)
+			done(s->cpu, s->ok, data);
+	}
+
+	free(slots);
+	return failed;
+}
@@ -32,6 +32,7 @@
 #include <ccan/str/str.h>
 #include <ccan/container_of/container_of.h>
 #include <xscom.h>
+#include <boot-profile.h>
 
 /* The cpu_threads array is static and indexed by PIR in
  * order to speed up lookup from asm entry points
@@ -204,7 +205,10 @@ struct cpu_job *__cpu_queue_job(struct cpu_thread *cpu,
 
 	/* Can't be scheduled, run it now */
 	if (cpu == NULL) {
+		int slot = boot_profile_job_start(name);
+
 		func(data);
+		boot_profile_job_end(slot);
 		job->complete = true;
 		return job;
 	}
@@ -228,6 +232,26 @@ struct cpu_job *__cpu_queue_job(struct cpu_thread *cpu,
 	return job;
 }
 
+struct cpu_job *cpu_queue_job_on_chip(uint32_t chip_id,
+				      const char *name,
+				      void (*func)(void *data), void *data)
+{
+	struct cpu_thread *cpu, *best = NULL, *me = this_cpu();
+
+	/* Racy like cpu_find_job_target(), it's only a hint */
+	for_each_available_cpu(cpu) {
+		if (cpu == me || cpu->chip_id != chip_id ||
+		    cpu->job_has_no_return)
+			continue;
+		if (!best || cpu->job_count < best->job_count)
+			best = cpu;
+	}
+	if (!best)
+		return NULL;
+
+	return cpu_queue_job(best, name, func, data);
+}
+
 bool cpu_poll_job(struct cpu_job *job)
 {
 	lwsync();
@@ -268,6 +292,7 @@ void cpu_process_jobs(void)
 	struct cpu_job *job = NULL;
 	void (*func)(void *);
 	void *data;
+	int slot;
 
 	sync();
 	if (!cpu_check_jobs(cpu))
@@ -286,9 +311,14 @@ void cpu_process_jobs(void)
 		no_return = job->no_return;
 		unlock(&cpu->job_lock);
 		prlog(PR_TRACE, "running job %s on %x\n", job->name, cpu->pir);
-		if (no_return)
+		if (no_return) {
 			free(job);
-		func(data);
+			func(data);
+		} else {
+			slot = boot_profile_job_start(job->name);
+			func(data);
+			boot_profile_job_end(slot);
+		}
 		if (!list_empty(&cpu->locks_held)) {
 			prlog(PR_ERR, "OPAL job %s returning with locks held\n",
 			      job->name);
@@ -835,6 +865,7 @@ static void init_cpu_thread(struct cpu_thread *t,
 
 	memset(t + guard_skip, 0, sizeof(struct cpu_thread) - guard_skip);
 	init_lock(&t->dctl_lock);
+	init_lock(&t->hmi_lock);
 	init_lock(&t->job_lock);
 	list_head_init(&t->job_queue);
 	list_head_init(&t->locks_held);
@@ -299,65 +299,111 @@ static int p8_sreset_thread(struct cpu_thread *cpu)
  * using scom registers.
  */
 
-static int p9_core_set_special_wakeup(struct cpu_thread *cpu)
+static int p9_core_request_special_wakeup(struct cpu_thread *cpu)
 {
 	uint32_t chip_id = pir_to_chip_id(cpu->pir);
 	uint32_t core_id = pir_to_core_id(cpu->pir);
 	uint32_t swake_addr;
-	uint32_t sshhyp_addr;
-	uint64_t val;
-	int i;
 
 	swake_addr = XSCOM_ADDR_P9_EC_SLAVE(core_id, EC_PPM_SPECIAL_WKUP_HYP);
-	sshhyp_addr = XSCOM_ADDR_P9_EC_SLAVE(core_id, P9_EC_PPM_SSHHYP);
 
 	if (xscom_write(chip_id, swake_addr, P9_SPWKUP_SET)) {
 		prlog(PR_ERR, "Could not set special wakeup on %u:%u:"
 				" Unable to write PPM_SPECIAL_WKUP_HYP.\n",
 				chip_id, core_id);
-		goto out_fail;
+		return OPAL_HARDWARE;
 	}
 
-	for (i = 0; i < P9_SPWKUP_TIMEOUT / P9_SPWKUP_POLL_INTERVAL; i++) {
-		if (xscom_read(chip_id, sshhyp_addr, &val)) {
-			prlog(PR_ERR, "Could not set special wakeup on %u:%u:"
-					" Unable to read PPM_SSHHYP.\n",
-					chip_id, core_id);
-			goto out_fail;
-		}
-		if (val & P9_SPECIAL_WKUP_DONE) {
-			/*
-			 * CORE_GATED will be unset on a successful special
-			 * wakeup of the core which indicates that the core is
-			 * out of stop state. If CORE_GATED is still set then
-			 * raise error.
-			 */
-			if (dctl_core_is_gated(cpu)) {
-				prlog(PR_ERR, "Failed special wakeup on %u:%u"
-						" as CORE_GATED is set\n",
-						chip_id, core_id);
-				goto out_fail;
-			} else {
-				return 0;
-			}
-		}
-		time_wait_us(P9_SPWKUP_POLL_INTERVAL);
-	}
+	return 0;
+}
+
+/*
+ * Returns OPAL_BUSY until the wakeup is done.
+ *
+ * As per the special wakeup protocol we should not de-assert
+ * the special wakeup on the core until WAKEUP_DONE is set.
+ * So even on error do not de-assert.
+ */
+static int p9_core_poll_special_wakeup(struct cpu_thread *cpu)
+{
+	uint32_t chip_id = pir_to_chip_id(cpu->pir);
+	uint32_t core_id = pir_to_core_id(cpu->pir);
+	uint32_t sshhyp_addr;
+	uint64_t val;
+
+	sshhyp_addr = XSCOM_ADDR_P9_EC_SLAVE(core_id, P9_EC_PPM_SSHHYP);
 
-	prlog(PR_ERR, "Could not set special wakeup on %u:%u:"
-			" timeout waiting for SPECIAL_WKUP_DONE.\n",
-			chip_id, core_id);
+	if (xscom_read(chip_id, sshhyp_addr, &val)) {
+		prlog(PR_ERR, "Could not set special wakeup on %u:%u:"
+				" Unable to read PPM_SSHHYP.\n",
+				chip_id, core_id);
+		return OPAL_HARDWARE;
+	}
+	if (!(val & P9_SPECIAL_WKUP_DONE))
+		return OPAL_BUSY;
 
-out_fail:
 	/*
-	 * As per the special wakeup protocol we should not de-assert
-	 * the special wakeup on the core until WAKEUP_DONE is set.
-	 * So even on error do not de-assert.
+	 * CORE_GATED will be unset on a successful special
+	 * wakeup of the core which indicates that the core is
+	 * out of stop state. If CORE_GATED is still set then
+	 * raise error.
 	 */
-	return OPAL_HARDWARE;
+	if (dctl_core_is_gated(cpu)) {
+		prlog(PR_ERR, "Failed special wakeup on %u:%u"
+				" as CORE_GATED is set\n",
+				chip_id, core_id);
+		return OPAL_HARDWARE;
+	}
+
+	return 0;
+}
+
+/*
+ * Wakes up the cores whose rc is OPAL_BUSY: request them all, then
+ * poll them all, so the cores wake up side by side rather than each
+ * one taking its turn.
+ */
+static void p9_cores_set_special_wakeup(struct cpu_thread **cores, int *rcs,
+					unsigned int nr)
+{
+	unsigned int i, pending = 0;
+	int j;
+
+	for (i = 0; i < nr; i++) {
+		if (rcs[i] != OPAL_BUSY)
+			continue;
+		rcs[i] = p9_core_request_special_wakeup(cores[i]);
+		if (!rcs[i]) {
+			rcs[i] = OPAL_BUSY;
+			pending++;
+		}
+	}
+
+	for (j = 0; pending && j < P9_SPWKUP_TIMEOUT / P9_SPWKUP_POLL_INTERVAL;
+	     j++) {
+		for (i = 0; i < nr; i++) {
+			if (rcs[i] != OPAL_BUSY)
+				continue;
+			rcs[i] = p9_core_poll_special_wakeup(cores[i]);
+			if (rcs[i] != OPAL_BUSY)
+				pending--;
+		}
+		if (pending)
+			time_wait_us(P9_SPWKUP_POLL_INTERVAL);
+	}
+
+	for (i = 0; pending && i < nr; i++) {
+		if (rcs[i] != OPAL_BUSY)
+			continue;
+		prlog(PR_ERR, "Could not set special wakeup on %u:%u:"
+				" timeout waiting for SPECIAL_WKUP_DONE.\n",
+				pir_to_chip_id(cores[i]->pir),
+				pir_to_core_id(cores[i]->pir));
+		rcs[i] = OPAL_HARDWARE;
+	}
 }
 
-static int p9_core_clear_special_wakeup(struct cpu_thread *cpu)
+static int p9_core_release_special_wakeup(struct cpu_thread *cpu)
 {
 	uint32_t chip_id = pir_to_chip_id(cpu->pir);
 	uint32_t core_id = pir_to_core_id(cpu->pir);
@@ -365,26 +411,44 @@ static int p9_core_clear_special_wakeup(struct cpu_thread *cpu)
 
 	swake_addr = XSCOM_ADDR_P9_EC_SLAVE(core_id, EC_PPM_SPECIAL_WKUP_HYP);
 
+	if (xscom_write(chip_id, swake_addr, 0)) {
+		prlog(PR_ERR, "Could not clear special wakeup on %u:%u:"
+				" Unable to write PPM_SPECIAL_WKUP_HYP.\n",
+				chip_id, core_id);
+		return OPAL_HARDWARE;
+	}
+
+	return 0;
+}
+
+/* Releases the cores whose rc is OPAL_BUSY */
+static void p9_cores_clear_special_wakeup(struct cpu_thread **cores, int *rcs,
+					  unsigned int nr)
+{
+	bool released = false;
+	unsigned int i;
+
 	/*
 	 * De-assert special wakeup after a small delay.
 	 * The delay may help avoid problems setting and clearing special
 	 * wakeup back-to-back. This should be confirmed.
 	 */
 	time_wait_us(1);
-	if (xscom_write(chip_id, swake_addr, 0)) {
-		prlog(PR_ERR, "Could not clear special wakeup on %u:%u:"
-				" Unable to write PPM_SPECIAL_WKUP_HYP.\n",
-				chip_id, core_id);
-		return OPAL_HARDWARE;
+	for (i = 0; i < nr; i++) {
+		if (rcs[i] != OPAL_BUSY)
+			continue;
+		rcs[i] = p9_core_release_special_wakeup(cores[i]);
+		if (!rcs[i])
+			released = true;
 	}
 
 	/*
 	 * Don't wait for de-assert to complete as other components
 	 * could have requested for special wkeup. Wait for 10ms to
-	 * avoid back-to-back asserts
+	 * avoid back-to-back asserts, once for the whole lot.
 	 */
-	time_wait_us(10000);
-	return 0;
+	if (released)
+		time_wait_us(10000);
 }
 
 static int p9_thread_quiesced(struct cpu_thread *cpu)
@@ -548,49 +612,127 @@ static int p9_sreset_thread(struct cpu_thread *cpu)
 
 /**************** generic direct controls ****************/
 
-int dctl_set_special_wakeup(struct cpu_thread *t)
+/*
+ * The batches take the locks of all the cores, in the order given, and
+ * hold them until the hardware is done with every one of them. Only the
+ * cores going from or to no wakeup at all are touched, and marked with
+ * an OPAL_BUSY rc until they are.
+ */
+static int __dctl_set_special_wakeup(struct cpu_thread **cores, int *rcs,
+				     unsigned int nr)
 {
-	struct cpu_thread *c = t->primary;
+	struct cpu_thread *c;
 	int rc = OPAL_SUCCESS;
+	unsigned int i;
 
-	if (proc_gen != proc_gen_p9 && proc_gen != proc_gen_p8)
-		return OPAL_UNSUPPORTED;
+	for (i = 0; i < nr; i++) {
+		c = cores[i];
+		lock(&c->dctl_lock);
+		rcs[i] = c->special_wakeup_count ? OPAL_SUCCESS : OPAL_BUSY;
+	}
 
-	lock(&c->dctl_lock);
-	if (c->special_wakeup_count == 0) {
-		if (proc_gen == proc_gen_p9)
-			rc = p9_core_set_special_wakeup(c);
-		else /* (proc_gen == proc_gen_p8) */
-			rc = p8_core_set_special_wakeup(c);
+	if (proc_gen == proc_gen_p9)
+		p9_cores_set_special_wakeup(cores, rcs, nr);
+	else /* (proc_gen == proc_gen_p8) */
+		for (i = 0; i < nr; i++)
+			if (rcs[i] == OPAL_BUSY)
+				rcs[i] = p8_core_set_special_wakeup(cores[i]);
+
+	for (i = 0; i < nr; i++) {
+		c = cores[i];
+		if (!rcs[i])
+			c->special_wakeup_count++;
+		else
+			rc = rcs[i];
+		unlock(&c->dctl_lock);
+	}
+
+	return rc;
+}
+
+static int __dctl_clear_special_wakeup(struct cpu_thread **cores, int *rcs,
+				       unsigned int nr)
+{
+	struct cpu_thread *c;
+	int rc = OPAL_SUCCESS;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		c = cores[i];
+		lock(&c->dctl_lock);
+		rcs[i] = c->special_wakeup_count == 1 ? OPAL_BUSY : OPAL_SUCCESS;
+	}
+
+	if (proc_gen == proc_gen_p9)
+		p9_cores_clear_special_wakeup(cores, rcs, nr);
+	else /* (proc_gen == proc_gen_p8) */
+		for (i = 0; i < nr; i++)
+			if (rcs[i] == OPAL_BUSY)
+				rcs[i] = p8_core_clear_special_wakeup(cores[i]);
+
+	for (i = 0; i < nr; i++) {
+		c = cores[i];
+		if (rcs[i])
+			rc = rcs[i];
+		else if (c->special_wakeup_count)
+			c->special_wakeup_count--;
+		unlock(&c->dctl_lock);
 	}
-	if (!rc)
-		c->special_wakeup_count++;
-	unlock(&c->dctl_lock);
 
 	return rc;
 }
 
+int dctl_set_special_wakeup(struct cpu_thread *t)
+{
+	struct cpu_thread *c = t->primary;
+	int rc;
+
+	if (proc_gen != proc_gen_p9 && proc_gen != proc_gen_p8)
+		return OPAL_UNSUPPORTED;
+
+	return __dctl_set_special_wakeup(&c, &rc, 1);
+}
+
 int dctl_clear_special_wakeup(struct cpu_thread *t)
 {
 	struct cpu_thread *c = t->primary;
-	int rc = OPAL_SUCCESS;
+	int rc;
 
 	if (proc_gen != proc_gen_p9 && proc_gen != proc_gen_p8)
 		return OPAL_UNSUPPORTED;
 
-	lock(&c->dctl_lock);
-	if (!c->special_wakeup_count)
-		goto out;
-	if (c->special_wakeup_count == 1) {
-		if (proc_gen == proc_gen_p9)
-			rc = p9_core_clear_special_wakeup(c);
-		else /* (proc_gen == proc_gen_p8) */
-			rc = p8_core_clear_special_wakeup(c);
-	}
-	if (!rc)
-		c->special_wakeup_count--;
-out:
-	unlock(&c->dctl_lock);
+	return __dctl_clear_special_wakeup(&c, &rc, 1);
+}
+
+int dctl_set_special_wakeup_cores(struct cpu_thread **cores, unsigned int nr)
+{
+	int *rcs, rc;
+
+	if (proc_gen != proc_gen_p9 && proc_gen != proc_gen_p8)
+		return OPAL_UNSUPPORTED;
+
+	rcs = zalloc(nr * sizeof(*rcs));
+	if (!rcs)
+		return OPAL_NO_MEM;
+	rc = __dctl_set_special_wakeup(cores, rcs, nr);
+	free(rcs);
+
+	return rc;
+}
+
+int dctl_clear_special_wakeup_cores(struct cpu_thread **cores,
+				    unsigned int nr)
+{
+	int *rcs, rc;
+
+	if (proc_gen != proc_gen_p9 && proc_gen != proc_gen_p8)
+		return OPAL_UNSUPPORTED;
+
+	rcs = zalloc(nr * sizeof(*rcs));
+	if (!rcs)
+		return OPAL_NO_MEM;
+	rc = __dctl_clear_special_wakeup(cores, rcs, nr);
+	free(rcs);
 
 	return rc;
 }
@@ -696,9 +838,29 @@ static int dctl_sreset(struct cpu_thread *t)
 
 /**************** fast reboot API ****************/
 
+/* Returns all the operational cores, to be freed */
+static struct cpu_thread **ungarded_cores(unsigned int *nr)
+{
+	struct cpu_thread **cores, *cpu;
+	unsigned int i = 0;
+
+	*nr = 0;
+	for_each_ungarded_primary(cpu)
+		(*nr)++;
+	cores = zalloc(*nr * sizeof(*cores));
+	if (!cores)
+		return NULL;
+	for_each_ungarded_primary(cpu)
+		cores[i++] = cpu;
+
+	return cores;
+}
+
 int sreset_all_prepare(void)
 {
-	struct cpu_thread *cpu;
+	struct cpu_thread **cores, *cpu;
+	unsigned int nr;
+	int rc;
 
 	prlog(PR_DEBUG, "RESET: Resetting from cpu: 0x%x (core 0x%x)\n",
 	      this_cpu()->pir, pir_to_core_id(this_cpu()->pir));
@@ -713,10 +875,13 @@ int sreset_all_prepare(void)
 	}
 
 	/* Assert special wakup on all cores. Only on operational cores. */
-	for_each_ungarded_primary(cpu) {
-		if (dctl_set_special_wakeup(cpu) != OPAL_SUCCESS)
-			return OPAL_HARDWARE;
-	}
+	cores = ungarded_cores(&nr);
+	if (!cores)
+		return OPAL_HARDWARE;
+	rc = dctl_set_special_wakeup_cores(cores, nr);
+	free(cores);
+	if (rc != OPAL_SUCCESS)
+		return OPAL_HARDWARE;
 
 	prlog(PR_DEBUG, "RESET: Stopping the world...\n");
 
@@ -734,13 +899,17 @@ int sreset_all_prepare(void)
 
 void sreset_all_finish(void)
 {
-	struct cpu_thread *cpu;
+	struct cpu_thread **cores;
+	unsigned int nr;
 
 	if (chip_quirk(QUIRK_MAMBO_CALLOUTS))
 		return;
 
-	for_each_ungarded_primary(cpu)
-		dctl_clear_special_wakeup(cpu);
+	cores = ungarded_cores(&nr);
+	if (!cores)
+		return;
+	dctl_clear_special_wakeup_cores(cores, nr);
+	free(cores);
 }
 
 int sreset_all_others(void)
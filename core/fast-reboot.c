@@ -363,8 +363,13 @@ void __noreturn fast_reboot_entry(void)
 		 * mambo really should reserve memory regions for this, if
 		 * fast reboot is to work reliably.
 		 */
-		memset(KERNEL_LOAD_BASE, 0, KERNEL_LOAD_SIZE);
-		memset(INITRAMFS_LOAD_BASE, 0, INITRAMFS_LOAD_SIZE);
+		mem_clear_queue((uint64_t)KERNEL_LOAD_BASE,
+				(uint64_t)KERNEL_LOAD_BASE + KERNEL_LOAD_SIZE,
+				this_cpu()->chip_id);
+		mem_clear_queue((uint64_t)INITRAMFS_LOAD_BASE,
+				(uint64_t)INITRAMFS_LOAD_BASE +
+				INITRAMFS_LOAD_SIZE, this_cpu()->chip_id);
+		mem_clear_wait();
 	}
 
 	/* Start preloading kernel and ramdisk */
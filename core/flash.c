@@ -28,6 +28,7 @@
 #include <libstb/secureboot.h>
 #include <libstb/trustedboot.h>
 #include <elf.h>
+#include <boot-profile.h>
 
 struct flash {
 	struct list_node	list;
@@ -94,6 +95,18 @@ static int flash_nvram_info(uint32_t *total_size)
 	return rc;
 }
 
+/* Reads done on behalf of the boot, accounted in the boot profile */
+static int flash_boot_read(struct flash *flash, uint64_t pos, void *buf,
+			   uint64_t len)
+{
+	int rc;
+
+	rc = blocklevel_read(flash->bl, pos, buf, len);
+	if (!rc)
+		boot_profile_flash_read(len);
+	return rc;
+}
+
 static int flash_nvram_start_read(void *dst, uint32_t src, uint32_t len)
 {
 	int rc;
@@ -118,7 +131,7 @@ static int flash_nvram_start_read(void *dst, uint32_t src, uint32_t len)
 		goto out;
 	}
 
-	rc = blocklevel_read(nvram_flash->bl, nvram_offset + src, dst, len);
+	rc = flash_boot_read(nvram_flash, nvram_offset + src, dst, len);
 
 out:
 	unlock(&flash_lock);
@@ -594,6 +607,19 @@ static size_t sizeof_elf_from_hdr(void *buf)
 	return sz;
 }
 
+struct flash_load_resource_item {
+	enum resource_id id;
+	uint32_t subid;
+	int result;
+	void *buf;
+	size_t *len;
+	/* Left for flash_load_resource_finish() */
+	struct trustedboot_measurement measurement;
+	void *content;
+	int content_size;
+	struct list_node link;
+};
+
 /*
  * load a resource from FLASH
  * buf and len shouldn't account for ECC even if partition is ECCed.
@@ -605,9 +631,12 @@ static size_t sizeof_elf_from_hdr(void *buf)
  *
  * Additionally, the logic to work out how much to read from flash is insane.
  */
-static int flash_load_resource(enum resource_id id, uint32_t subid,
-			       void *buf, size_t *len)
+static int flash_load_resource(struct flash_load_resource_item *r)
 {
+	enum resource_id id = r->id;
+	uint32_t subid = r->subid;
+	void *buf = r->buf;
+	size_t *len = r->len;
 	int i;
 	int rc = OPAL_RESOURCE;
 	struct ffs_handle *ffs;
@@ -689,7 +718,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 		goto out_free_ffs;
 	}
 
-	rc = blocklevel_read(flash->bl, ffs_part_start, bufp,
+	rc = flash_boot_read(flash, ffs_part_start, bufp,
 			SECURE_BOOT_HEADERS_SIZE);
 	if (rc) {
 		prerror("FLASH: failed to read the first 0x%x from "
@@ -722,7 +751,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 
 		ffs_part_start += SECURE_BOOT_HEADERS_SIZE;
 
-		rc = blocklevel_read(flash->bl, ffs_part_start, bufp,
+		rc = flash_boot_read(flash, ffs_part_start, bufp,
 					  content_size);
 		if (rc) {
 			prerror("FLASH: failed to read content size %d"
@@ -775,7 +804,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 			}
 			prlog(PR_DEBUG, "FLASH: computed %s size %u\n",
 			      name, content_size);
-			rc = blocklevel_read(flash->bl, ffs_part_start,
+			rc = flash_boot_read(flash, ffs_part_start,
 						  buf, content_size);
 			if (rc) {
 				prerror("FLASH: failed to read content size %d"
@@ -806,7 +835,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 		 * Afterwards, we memmove() things back into place for
 		 * the caller.
 		 */
-		rc = blocklevel_read(flash->bl, ffs_part_start,
+		rc = flash_boot_read(flash, ffs_part_start,
 					  buf, ffs_part_size);
 
 		bufp += offset;
@@ -815,15 +844,18 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 done_reading:
 	/*
 	 * Verify and measure the retrieved PNOR partition as part of the
-	 * secure boot and trusted boot requirements
+	 * secure boot and trusted boot requirements. The measurement is
+	 * hashed on another CPU while we verify, it gets finished, and a
+	 * subpartition moved into place, by flash_load_resource_finish()
+	 * once the next resource has been read.
 	 */
+	trustedboot_measure_start(&r->measurement, id, buf, *len);
 	secureboot_verify(id, buf, *len);
-	trustedboot_measure(id, buf, *len);
 
 	/* Find subpartition */
 	if (subid != RESOURCE_SUBID_NONE) {
-		memmove(buf, bufp, content_size);
-		*len = content_size;
+		r->content = bufp;
+		r->content_size = content_size;
 	}
 
 	status = true;
@@ -836,15 +868,6 @@ out_unlock:
 }
 
 
-struct flash_load_resource_item {
-	enum resource_id id;
-	uint32_t subid;
-	int result;
-	void *buf;
-	size_t *len;
-	struct list_node link;
-};
-
 static LIST_HEAD(flash_load_resource_queue);
 static LIST_HEAD(flash_loaded_resources);
 static struct lock flash_load_resource_lock = LOCK_UNLOCKED;
@@ -880,32 +903,52 @@ int flash_resource_loaded(enum resource_id id, uint32_t subid)
 	return rc;
 }
 
+static void flash_load_resource_finish(struct flash_load_resource_item *r)
+{
+	/* In the order they were loaded, like the PCR extends always were */
+	trustedboot_measure_finish(&r->measurement);
+
+	if (r->content) {
+		memmove(r->buf, r->content, r->content_size);
+		*r->len = r->content_size;
+	}
+}
+
 static void flash_load_resources(void *data __unused)
 {
-	struct flash_load_resource_item *r;
-	int result;
+	struct flash_load_resource_item *r, *i, *prev = NULL;
+	int result = OPAL_EMPTY, prev_result = OPAL_EMPTY;
 
+	/*
+	 * A loaded resource stays at the top of the queue while the next
+	 * one is read, so its measurement can be hashed in the meantime.
+	 */
 	lock(&flash_load_resource_lock);
 	do {
-		if (list_empty(&flash_load_resource_queue)) {
-			break;
+		r = NULL;
+		list_for_each(&flash_load_resource_queue, i, link) {
+			if (i->result == OPAL_EMPTY) {
+				r = i;
+				r->result = OPAL_BUSY;
+				break;
+			}
 		}
-		r = list_top(&flash_load_resource_queue,
-			     struct flash_load_resource_item, link);
-		if (r->result != OPAL_EMPTY)
-			prerror("flash_load_resources() list_top unexpected "
-				" result %d\n", r->result);
-		r->result = OPAL_BUSY;
 		unlock(&flash_load_resource_lock);
 
-		result = flash_load_resource(r->id, r->subid, r->buf, r->len);
+		if (r)
+			result = flash_load_resource(r);
+		if (prev)
+			flash_load_resource_finish(prev);
 
 		lock(&flash_load_resource_lock);
-		r = list_pop(&flash_load_resource_queue,
-			     struct flash_load_resource_item, link);
-		r->result = result;
-		list_add_tail(&flash_loaded_resources, &r->link);
-	} while(true);
+		if (prev) {
+			prev->result = prev_result;
+			list_del(&prev->link);
+			list_add_tail(&flash_loaded_resources, &prev->link);
+		}
+		prev = r;
+		prev_result = result;
+	} while (prev || !list_empty(&flash_load_resource_queue));
 	unlock(&flash_load_resource_lock);
 }
 
@@ -934,6 +977,8 @@ int flash_start_preload_resource(enum resource_id id, uint32_t subid,
 	r->buf = buf;
 	r->len = len;
 	r->result = OPAL_EMPTY;
+	r->measurement.started = false;
+	r->content = NULL;
 
 	prlog(PR_DEBUG, "FLASH: Queueing preload of %x/%x\n",
 	      r->id, r->subid);
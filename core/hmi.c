@@ -282,7 +282,6 @@ static const struct nx_xstop_bit_info nx_pbi_xstop_bits[] = {
 	{ 12, NX_CHECKSTOP_PBI_ISN_UE },
 };
 
-static struct lock hmi_lock = LOCK_UNLOCKED;
 static uint32_t malf_alert_scom;
 static uint32_t nx_status_reg;
 static uint32_t nx_dma_engine_fir;
@@ -809,6 +808,8 @@ static void find_npu_checkstop_reason(int flat_chip_id,
 
 static void decode_malfunction(struct OpalHMIEvent *hmi_evt, uint64_t *out_flags)
 {
+	struct proc_chip *chip = get_chip(this_cpu()->chip_id);
+	struct proc_chip *xchip;
 	int i;
 	uint64_t malf_alert, flags;
 
@@ -823,19 +824,35 @@ static void decode_malfunction(struct OpalHMIEvent *hmi_evt, uint64_t *out_flags
 		return;
 	}
 
-	xscom_read(this_cpu()->chip_id, malf_alert_scom, &malf_alert);
+	/*
+	 * Claim the alerts under the lock of the chip whose register we
+	 * read, then decode each one under the lock of the chip that
+	 * raised it, never holding both. HMIs on other chips go on in
+	 * parallel.
+	 */
+	lock(&chip->hmi_lock);
+	xscom_read(chip->id, malf_alert_scom, &malf_alert);
+	for (i = 0; i < 64; i++) {
+		if (malf_alert & PPC_BIT(i))
+			xscom_write(chip->id, malf_alert_scom, ~PPC_BIT(i));
+	}
+	unlock(&chip->hmi_lock);
 
 	if (!malf_alert)
 		return;
 
 	for (i = 0; i < 64; i++) {
-		if (malf_alert & PPC_BIT(i)) {
-			xscom_write(this_cpu()->chip_id, malf_alert_scom,
-								~PPC_BIT(i));
-			find_capp_checkstop_reason(i, hmi_evt, &flags);
-			find_nx_checkstop_reason(i, hmi_evt, &flags);
-			find_npu_checkstop_reason(i, hmi_evt, &flags);
-		}
+		if (!(malf_alert & PPC_BIT(i)))
+			continue;
+
+		xchip = get_chip(i);
+		if (xchip)
+			lock(&xchip->hmi_lock);
+		find_capp_checkstop_reason(i, hmi_evt, &flags);
+		find_nx_checkstop_reason(i, hmi_evt, &flags);
+		find_npu_checkstop_reason(i, hmi_evt, &flags);
+		if (xchip)
+			unlock(&xchip->hmi_lock);
 	}
 
 	find_core_checkstop_reason(hmi_evt, &flags);
@@ -974,9 +991,10 @@ static int handle_all_core_tfac_error(uint64_t tfmr, uint64_t *out_flags)
 	hmi_rendez_vous(1);
 
 	/* We use a lock here as some of the TFMR bits are shared and I
-	 * prefer avoiding doing the cleanup simultaneously.
+	 * prefer avoiding doing the cleanup simultaneously. They are only
+	 * shared within the core, other cores go on in parallel.
 	 */
-	lock(&hmi_lock);
+	lock(&t0->hmi_lock);
 
 	/* First handle corrupt TFMR otherwise we can't trust anything.
 	 * We'll use a lock here so that the threads don't try to do it at
@@ -985,13 +1003,11 @@ static int handle_all_core_tfac_error(uint64_t tfmr, uint64_t *out_flags)
 	if (tfmr & SPR_TFMR_TFMR_CORRUPT) {
 		/* Check if it's still in error state */
 		if (mfspr(SPR_TFMR) & SPR_TFMR_TFMR_CORRUPT)
-			if (!recover_corrupt_tfmr()) {
-				unlock(&hmi_lock);
+			if (!recover_corrupt_tfmr())
 				recover = 0;
-			}
 
 		if (!recover) {
-			unlock(&hmi_lock);
+			unlock(&t0->hmi_lock);
 			goto error_out;
 		}
 
@@ -1003,7 +1019,7 @@ static int handle_all_core_tfac_error(uint64_t tfmr, uint64_t *out_flags)
 			tfmr &= ~SPR_TFMR_THREAD_ERRORS;
 		}
 		if (!recover) {
-			unlock(&hmi_lock);
+			unlock(&t0->hmi_lock);
 			goto error_out;
 		}
 	}
@@ -1018,7 +1034,7 @@ static int handle_all_core_tfac_error(uint64_t tfmr, uint64_t *out_flags)
 	tfmr_cleanup_core_errors(tfmr);
 
 	/* Unlock before next rendez-vous */
-	unlock(&hmi_lock);
+	unlock(&t0->hmi_lock);
 
 	/* Second rendez vous, ensure the above cleanups are all done before
 	 * we proceed further
@@ -1059,14 +1075,16 @@ static uint64_t read_tfmr_t0(void)
 	uint64_t tfmr_t0;
 	uint32_t chip_id = this_cpu()->chip_id;
 	uint32_t core_id = pir_to_core_id(this_cpu()->pir);
+	struct lock *l = &this_cpu()->primary->hmi_lock;
 
-	lock(&hmi_lock);
+	/* SPRC/SPRD are per core */
+	lock(l);
 
 	xscom_write(chip_id, XSCOM_ADDR_P9_EC(core_id, P9_SCOM_SPRC),
 			SETFIELD(P9_SCOMC_SPR_SELECT, 0, P9_SCOMC_TFMR_T0));
 	xscom_read(chip_id, XSCOM_ADDR_P9_EC(core_id, P9_SCOM_SPRD),
 				&tfmr_t0);
-	unlock(&hmi_lock);
+	unlock(l);
 	return tfmr_t0;
 }
 
@@ -1194,8 +1212,10 @@ static int handle_hmi_exception(uint64_t hmer, struct OpalHMIEvent *hmi_evt,
 		handled = 0;
 	}
 
-	lock(&hmi_lock);
 	/*
+	 * Nothing below needs serialising against other threads: HMER is
+	 * per thread and the malfunction decode takes the chip locks.
+	 *
 	 * Not all HMIs would move TB into invalid state. Set the TB state
 	 * looking at TFMR register. TFMR will tell us correct state of
 	 * TB register.
@@ -1286,7 +1306,6 @@ static int handle_hmi_exception(uint64_t hmer, struct OpalHMIEvent *hmi_evt,
 	 * we want to clear.
 	 */
 	mtspr(SPR_HMER, ~handled);
-	unlock(&hmi_lock);
 	return recover;
 }
 
@@ -20,6 +20,7 @@
 #include <device.h>
 #include <opal-msg.h>
 #include <timebase.h>
+#include <processor.h>
 
 static LIST_HEAD(i2c_bus_list);
 
@@ -138,6 +139,7 @@ opal_call(OPAL_I2C_REQUEST, opal_i2c_request, 3);
 #define MAX_NACK_RETRIES		 2
 #define REQ_COMPLETE_POLLING		 5  /* Check if req is complete
 					       in 5ms interval */
+#define REQ_COMPLETE_WAKEUP_US		10  /* Notice completion within */
 
 struct i2c_sync_userdata {
 	int rc;
@@ -148,9 +150,30 @@ static void i2c_sync_request_complete(int rc, struct i2c_request *req)
 {
 	struct i2c_sync_userdata *ud = req->user_data;
 	ud->rc = rc;
+	lwsync();
 	ud->done = true;
 }
 
+/*
+ * Wait until the bus wants the request run again, or less if it gets
+ * completed by someone else in the meantime, usually the interrupt.
+ */
+static void i2c_sync_wait(struct i2c_sync_userdata *ud, uint64_t duration)
+{
+	uint64_t end = mftb() + duration;
+	uint64_t now, slice = usecs_to_tb(REQ_COMPLETE_WAKEUP_US);
+
+	for (;;) {
+		sync();
+		if (ud->done)
+			return;
+		now = mftb();
+		if (tb_compare(now, end) != TB_ABEFOREB)
+			return;
+		time_wait(end - now < slice ? end - now : slice);
+	}
+}
+
 /**
  * i2c_request_send - send request to i2c bus synchronously
  * @bus_id: i2c bus id
@@ -170,10 +193,10 @@ int i2c_request_send(int bus_id, int dev_addr, int read_write,
 		     uint32_t offset, uint32_t offset_bytes, void* buf,
 		     size_t buflen, int timeout)
 {
-	int rc, waited, retries;
+	int rc, retries;
 	struct i2c_request *req;
 	struct i2c_bus *bus;
-	uint64_t time_to_wait = 0;
+	uint64_t time_to_wait = 0, start = mftb();
 	struct i2c_sync_userdata ud;
 
 	bus = i2c_find_bus_by_id(bus_id);
@@ -206,20 +229,18 @@ int i2c_request_send(int bus_id, int dev_addr, int read_write,
 	req->rw_buf     = (void*) buf;
 	req->rw_len     = buflen;
 	req->completion = i2c_sync_request_complete;
-	ud.done = false;
 	req->user_data = &ud;
 
 	for (retries = 0; retries <= MAX_NACK_RETRIES; retries++) {
-		waited = 0;
+		ud.done = false;
 		i2c_set_req_timeout(req, timeout);
 		i2c_queue_req(req);
 
 		do {
 			time_to_wait = i2c_run_req(req);
 			if (!time_to_wait)
-				time_to_wait = REQ_COMPLETE_POLLING;
-			time_wait(time_to_wait);
-			waited += time_to_wait;
+				time_to_wait = msecs_to_tb(REQ_COMPLETE_POLLING);
+			i2c_sync_wait(&ud, time_to_wait);
 		} while (!ud.done);
 
 		rc = ud.rc;
@@ -234,7 +255,8 @@ int i2c_request_send(int bus_id, int dev_addr, int read_write,
 	prlog(PR_DEBUG, "I2C: %s req op=%x offset=%x buf=%016llx buflen=%d "
 	      "delay=%lu/%d rc=%d\n",
 	      (rc) ? "!!!!" : "----", req->op, req->offset,
-	      *(uint64_t*) buf, req->rw_len, tb_to_msecs(waited), timeout, rc);
+	      *(uint64_t*) buf, req->rw_len, tb_to_msecs(mftb() - start),
+	      timeout, rc);
 
 	i2c_free_req(req);
 	if (rc)
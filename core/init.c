@@ -52,6 +52,8 @@
 #include <imc.h>
 #include <dts.h>
 #include <sbe-p9.h>
+#include <boot-profile.h>
+#include <chip-init.h>
 
 enum proc_gen proc_gen;
 unsigned int pcie_max_link_speed;
@@ -313,6 +315,22 @@ extern uint64_t boot_offset;
 
 static size_t initramfs_size;
 
+/*
+ * Measured together once both are loaded, so the two get hashed at the
+ * same time on different CPUs.
+ */
+static struct trustedboot_resource os_measurements[2];
+static unsigned int nr_os_measurements;
+
+static void os_measurement_add(enum resource_id id, void *buf, size_t len)
+{
+	assert(nr_os_measurements < ARRAY_SIZE(os_measurements));
+	os_measurements[nr_os_measurements].id = id;
+	os_measurements[nr_os_measurements].buf = buf;
+	os_measurements[nr_os_measurements].len = len;
+	nr_os_measurements++;
+}
+
 bool start_preload_kernel(void)
 {
 	int loaded;
@@ -425,9 +443,8 @@ static bool load_kernel(void)
 		secureboot_verify(RESOURCE_ID_KERNEL,
 				  stb_container,
 				  SECURE_BOOT_HEADERS_SIZE + kernel_size);
-		trustedboot_measure(RESOURCE_ID_KERNEL,
-				    stb_container,
-				    SECURE_BOOT_HEADERS_SIZE + kernel_size);
+		os_measurement_add(RESOURCE_ID_KERNEL, stb_container,
+				   SECURE_BOOT_HEADERS_SIZE + kernel_size);
 	}
 
 	return true;
@@ -466,9 +483,8 @@ static void load_initramfs(void)
 		secureboot_verify(RESOURCE_ID_INITRAMFS,
 				  stb_container,
 				  SECURE_BOOT_HEADERS_SIZE + initramfs_size);
-		trustedboot_measure(RESOURCE_ID_INITRAMFS,
-				    stb_container,
-				    SECURE_BOOT_HEADERS_SIZE + initramfs_size);
+		os_measurement_add(RESOURCE_ID_INITRAMFS, stb_container,
+				   SECURE_BOOT_HEADERS_SIZE + initramfs_size);
 	}
 }
 
@@ -493,6 +509,8 @@ void __noreturn load_and_boot_kernel(bool is_reboot)
 		platform.exit();
 
 	/* Load kernel LID */
+	boot_phase("kernel-load");
+	nr_os_measurements = 0;
 	if (!load_kernel()) {
 		op_display(OP_FATAL, OP_MOD_INIT, 1);
 		abort();
@@ -500,6 +518,9 @@ void __noreturn load_and_boot_kernel(bool is_reboot)
 
 	load_initramfs();
 
+	trustedboot_measure_multi(os_measurements, nr_os_measurements);
+
+	boot_phase("os-prep");
 	trustedboot_exit_boot_services();
 
 	ipmi_set_fw_progress_sensor(IPMI_FW_OS_BOOT);
@@ -543,6 +564,9 @@ void __noreturn load_and_boot_kernel(bool is_reboot)
 
 	op_display(OP_LOG, OP_MOD_INIT, 0x000B);
 
+	/* Ends the last phase, so everything up to here is in the profile */
+	boot_profile_add_dt();
+
 	/* Create the device tree blob to boot OS. */
 	fdt = create_dtb(dt_root, false);
 	if (!fdt) {
@@ -562,6 +586,7 @@ void __noreturn load_and_boot_kernel(bool is_reboot)
 	cpu_give_self_os();
 
 	mem_dump_free();
+	opal_dump_pollers();
 
 	/* Take processours out of nap */
 	cpu_set_sreset_enable(false);
@@ -811,6 +836,12 @@ static void pci_nvram_init(void)
 	}
 }
 
+/* Independent of each other, run for all chips at once */
+static const struct chip_init_unit *boot_chip_units[] = {
+	&slw_chip_unit,
+	&vas_chip_unit,
+};
+
 /* Called from head.S, thus no prototype. */
 void main_cpu_entry(const void *fdt);
 
@@ -891,6 +922,9 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	/* Init the physical map table so we can start mapping things */
 	phys_map_init();
 
+	/* Locks work, we can start timing the boot */
+	boot_phase("device-tree");
+
 	/*
 	 * If we are coming in with a flat device-tree, we expand it
 	 * now. Else look for HDAT and create a device-tree from them
@@ -927,6 +961,7 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	 * We also initialize the FSI master at that point in case we need
 	 * to access chips via that path early on.
 	 */
+	boot_phase("chips");
 	init_chips();
 
 	xscom_init();
@@ -957,6 +992,7 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	 * This should be done before mem_region_init, so the stack
 	 * region length can be set according to the maximum PIR.
 	 */
+	boot_phase("memory");
 	init_cpu_max_pir();
 
 	/*
@@ -985,12 +1021,14 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	 *
 	 * Note: Timebases still not synchronized.
 	 */
+	boot_phase("platform-probe");
 	probe_platform();
 
 	/* Allocate our split trace buffers now. Depends add_opal_node() */
 	init_trace_buffers();
 
 	/* On P7/P8, get the ICPs and make sure they are in a sane state */
+	boot_phase("interrupts");
 	init_interrupts();
 	if (proc_gen == proc_gen_p7 || proc_gen == proc_gen_p8)
 		cpu_set_ipi_enable(true);
@@ -1011,6 +1049,7 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	lpc_init_interrupts();
 
 	/* Call in secondary CPUs */
+	boot_phase("cpu-bringup");
 	cpu_bringup();
 
 	/* We can now overwrite the 0x100 vector as we are no longer being
@@ -1028,6 +1067,7 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	 * that the timestamps in early boot might be a little off compared
 	 * to wall clock time.
 	 */
+	boot_phase("chiptod");
 	chiptod_init();
 
 	/*
@@ -1037,6 +1077,7 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	p9_sbe_init();
 
 	/* Initialize i2c */
+	boot_phase("platform-init");
 	p8_i2c_init();
 
 	/* Register routine to dispatch and read sensors */
@@ -1058,12 +1099,14 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 		platform.init();
 
 	/* Read in NVRAM and set it up */
+	boot_phase("nvram");
 	nvram_init();
 
 	/* Set the console level */
 	console_log_level();
 
 	/* Secure/Trusted Boot init. We look for /ibm,secureboot in DT */
+	boot_phase("secureboot");
 	secureboot_init();
 	trustedboot_init();
 
@@ -1073,27 +1116,32 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	/* Install the OPAL Console handlers */
 	init_opal_console();
 
-	/* Init SLW related stuff, including fastsleep */
-	slw_init();
+	/*
+	 * Per chip units, each chip initialised from its own CPUs: SLW
+	 * (including fastsleep) and the Virtual Accelerator Switchboard
+	 */
+	boot_phase("chip-init");
+	chip_init_run(boot_chip_units, ARRAY_SIZE(boot_chip_units));
 
 	op_display(OP_LOG, OP_MOD_INIT, 0x0002);
 
 	pci_nvram_init();
+	opal_call_lat_init();
 
+	boot_phase("flash-preload");
 	preload_io_vpd();
 	preload_capp_ucode();
 	start_preload_kernel();
 
-	/* Virtual Accelerator Switchboard */
-	vas_init();
-
 	/* NX init */
+	boot_phase("accelerators");
 	nx_init();
 
 	/* Init In-Memory Collection related stuff (load the IMC dtb into memory) */
 	imc_init();
 
 	/* Probe IO hubs */
+	boot_phase("phb-probe");
 	probe_p7ioc();
 
 	/* Probe PHB3 on P8 */
@@ -1109,6 +1157,7 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	probe_npu2_opencapi();
 
 	/* Initialize PCI */
+	boot_phase("pci-slots");
 	pci_init_slots();
 
 	/* Add OPAL timer related properties */
@@ -1127,6 +1176,7 @@ void __noreturn __nomcount main_cpu_entry(const void *fdt)
 	 */
 
 	/* Create the LPC bus interrupt-map on P9 */
+	boot_phase("finalize");
 	lpc_finalize_interrupts();
 
 	/* Add the list of interrupts going to OPAL */
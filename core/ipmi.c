@@ -24,10 +24,47 @@
 #include <lock.h>
 #include <cpu.h>
 #include <timebase.h>
+#include <lat-hist.h>
+#include <opal-internal.h>
 
 struct ipmi_backend *ipmi_backend = NULL;
+
+/*
+ * Synchronous messages. Each caller of ipmi_queue_msg_sync() has a
+ * completion on its stack which ipmi_cmd_done() signals straight from
+ * the backend's response path, so several can be outstanding at once.
+ */
+struct ipmi_sync_wait {
+	struct list_node	link;
+	struct ipmi_msg		*msg;
+	unsigned long		start;
+	unsigned long		done_tb;
+	volatile bool		done;
+};
+
+/*
+ * The waiter spins for about twice the usual response time, checking
+ * every IPMI_SYNC_POLL_US, then sleeps for increasingly long periods up
+ * to IPMI_SYNC_WAIT_MAX_US.
+ */
+#define IPMI_SYNC_POLL_US	10
+#define IPMI_SYNC_SPIN_MIN_US	20
+#define IPMI_SYNC_SPIN_MAX_US	500
+#define IPMI_SYNC_WAIT_MAX_US	5000
+
+/* Exported as ipmi_sync_latency, see lat-hist.h for the layout */
+struct ipmi_sync_stats {
+	/* Queueing to the response */
+	struct lat_hist		response;
+	/* The response to the caller running again */
+	struct lat_hist		wakeup;
+};
+
 static struct lock sync_lock = LOCK_UNLOCKED;
-static struct ipmi_msg *sync_msg = NULL;
+static LIST_HEAD(sync_waiters);
+static struct ipmi_sync_stats sync_stats;
+/* Moving average of the response time, in TB ticks */
+static unsigned long sync_avg_tb;
 
 void ipmi_free_msg(struct ipmi_msg *msg)
 {
@@ -132,8 +169,29 @@ int ipmi_dequeue_msg(struct ipmi_msg *msg)
 	return msg->backend->dequeue_msg(msg);
 }
 
+static struct ipmi_sync_wait *ipmi_sync_find(struct ipmi_msg *msg)
+{
+	struct ipmi_sync_wait *w, *found = NULL;
+
+	lock(&sync_lock);
+	list_for_each(&sync_waiters, w, link) {
+		if (w->msg == msg) {
+			list_del(&w->link);
+			w->msg = NULL;
+			found = w;
+			break;
+		}
+	}
+	unlock(&sync_lock);
+
+	return found;
+}
+
 void ipmi_cmd_done(uint8_t cmd, uint8_t netfn, uint8_t cc, struct ipmi_msg *msg)
 {
+	/* Before the completion functions free the message */
+	struct ipmi_sync_wait *sync = ipmi_sync_find(msg);
+
 	msg->cc = cc;
 	if (msg->cmd != cmd) {
 		prerror("IPMI: Incorrect cmd 0x%02x in response\n", cmd);
@@ -158,12 +216,75 @@ void ipmi_cmd_done(uint8_t cmd, uint8_t netfn, uint8_t cc, struct ipmi_msg *msg)
 	   completion functions. */
 
 	/* If this is a synchronous message flag that we are done */
-	if (msg == sync_msg)
-		sync_msg = NULL;
+	if (sync) {
+		sync->done_tb = mftb();
+		lwsync();
+		sync->done = true;
+	}
+}
+
+static unsigned long ipmi_sync_spin_tb(void)
+{
+	unsigned long spin = 2 * sync_avg_tb;
+
+	if (spin < usecs_to_tb(IPMI_SYNC_SPIN_MIN_US))
+		return usecs_to_tb(IPMI_SYNC_SPIN_MIN_US);
+	if (spin > usecs_to_tb(IPMI_SYNC_SPIN_MAX_US))
+		return usecs_to_tb(IPMI_SYNC_SPIN_MAX_US);
+	return spin;
+}
+
+/* Same rules as time_wait(), to make sure the backend makes progress */
+static void ipmi_sync_run_pollers(void)
+{
+	if (this_cpu() == boot_cpu && list_empty(&this_cpu()->locks_held))
+		opal_run_pollers();
+}
+
+static void ipmi_sync_wait(struct ipmi_sync_wait *w)
+{
+	unsigned long now, next, spin_end, wait;
+
+	spin_end = w->start + ipmi_sync_spin_tb();
+	wait = usecs_to_tb(IPMI_SYNC_POLL_US);
+
+	for (;;) {
+		ipmi_sync_run_pollers();
+		if (w->done)
+			break;
+
+		now = mftb();
+		if (tb_compare(now, spin_end) == TB_ABEFOREB) {
+			/* The response usually comes quickly, spin for it */
+			next = now + usecs_to_tb(IPMI_SYNC_POLL_US);
+			while (!w->done &&
+			       tb_compare(mftb(), next) == TB_ABEFOREB)
+				cpu_relax();
+		} else {
+			/* A slow one, don't burn the CPU waiting for it */
+			time_wait_nopoll(wait);
+			if (wait < usecs_to_tb(IPMI_SYNC_WAIT_MAX_US) / 2)
+				wait *= 2;
+			else
+				wait = usecs_to_tb(IPMI_SYNC_WAIT_MAX_US);
+		}
+	}
+	sync();
+
+	lock(&sync_lock);
+	lat_hist_add(&sync_stats.response, w->done_tb - w->start);
+	lat_hist_add(&sync_stats.wakeup, mftb() - w->done_tb);
+	/* Weighted 1/8 so that a single slow command doesn't stick */
+	sync_avg_tb = sync_avg_tb - sync_avg_tb / 8 +
+		(w->done_tb - w->start) / 8;
+	unlock(&sync_lock);
 }
 
 void ipmi_queue_msg_sync(struct ipmi_msg *msg)
 {
+	struct ipmi_sync_wait w = { .msg = msg };
+	int rc;
+
 	if (!ipmi_present())
 		return;
 
@@ -172,14 +293,29 @@ void ipmi_queue_msg_sync(struct ipmi_msg *msg)
 		return;
 	}
 
+	/*
+	 * Not held while queueing, the backend may complete the message
+	 * (eg. dropping it from a full queue) before returning.
+	 */
 	lock(&sync_lock);
-	while (sync_msg);
-	sync_msg = msg;
-	ipmi_queue_msg(msg);
+	w.start = mftb();
+	list_add_tail(&sync_waiters, &w.link);
 	unlock(&sync_lock);
 
-	while (sync_msg == msg)
-		time_wait_ms(100);
+	rc = ipmi_queue_msg(msg);
+	if (rc) {
+		prerror("%s: Failed to queue message: %d\n", __func__, rc);
+		lock(&sync_lock);
+		if (w.msg) {
+			list_del(&w.link);
+			unlock(&sync_lock);
+			return;
+		}
+		/* Completed anyway, wait for it to let go of w */
+		unlock(&sync_lock);
+	}
+
+	ipmi_sync_wait(&w);
 }
 
 static void ipmi_read_event_complete(struct ipmi_msg *msg)
@@ -246,6 +382,8 @@ void ipmi_register_backend(struct ipmi_backend *backend)
 	assert(backend->dequeue_msg);
 	ipmi_backend = backend;
 	ipmi_backend->opal_event_ipmi_recv = opal_dynamic_event_alloc();
+
+	opal_add_export("ipmi_sync_latency", &sync_stats, sizeof(sync_stats));
 }
 
 bool ipmi_present(void)
@@ -207,6 +207,7 @@ void lock_caller(struct lock *l, const char *owner)
 {
 	bool timeout_warn = false;
 	unsigned long start = 0;
+	uint64_t wait_start;
 
 	if (bust_locks)
 		return;
@@ -216,6 +217,7 @@ void lock_caller(struct lock *l, const char *owner)
 	if (try_lock(l))
 		return;
 	add_lock_request(l);
+	wait_start = mftb();
 
 #ifdef DEBUG_LOCKS
 	/*
@@ -240,6 +242,7 @@ void lock_caller(struct lock *l, const char *owner)
 	}
 
 	remove_lock_request();
+	this_cpu()->lock_wait_tb += mftb() - wait_start;
 }
 
 void unlock(struct lock *l)
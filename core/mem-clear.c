@@ -0,0 +1,140 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Zeroing of large memory ranges, typically all the OS memory on a
+ * fast reboot. Ranges are cut into chunks, each one cleared by a job
+ * running on a CPU of the chip that owns that memory so that all the
+ * memory controllers are kept busy at once.
+ */
+
+#define pr_fmt(fmt) "MEMCLR: " fmt
+
+#include <skiboot.h>
+#include <cpu.h>
+#include <mem_region.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ccan/list/list.h>
+
+/* About the amount a single thread clears in a few tens of ms */
+#ifndef MEM_CLEAR_CHUNK_SIZE
+#define MEM_CLEAR_CHUNK_SIZE	(1ull << 30)
+#endif
+
+#define MEM_CLEAR_LINE		128
+
+struct mem_clear_chunk {
+	struct list_node	link;
+	uint64_t		start;
+	uint64_t		end;
+	struct cpu_job		*job;
+};
+
+/* Only ever used by the CPU doing the clearing, so no locking */
+static LIST_HEAD(mem_clear_chunks);
+
+/*
+ * dcbz establishes the lines in the cache as zeroes without reading
+ * them from memory first, which about halves the memory traffic.
+ */
+void mem_zero(void *addr, size_t len)
+{
+#if defined(__powerpc64__) && !defined(__TEST__)
+	char *p = addr, *end = p + len;
+	char *first = (char *)ALIGN_UP((unsigned long)p, MEM_CLEAR_LINE);
+	char *last = (char *)ALIGN_DOWN((unsigned long)end, MEM_CLEAR_LINE);
+
+	if (first >= last) {
+		memset(addr, 0, len);
+		return;
+	}
+
+	memset(p, 0, first - p);
+	for (p = first; p < last; p += MEM_CLEAR_LINE)
+		asm volatile("dcbz 0,%0" : : "r"(p) : "memory");
+	memset(last, 0, end - last);
+#else
+	memset(addr, 0, len);
+#endif
+}
+
+static void mem_clear_job(void *data)
+{
+	struct mem_clear_chunk *c = data;
+
+	mem_zero((void *)c->start, c->end - c->start);
+}
+
+void mem_clear_queue(uint64_t start, uint64_t end, uint32_t chip_id)
+{
+	struct mem_clear_chunk *c;
+	uint64_t next;
+
+	while (start < end) {
+		/* Chunks are aligned so that a range split in two (around
+		 * a reservation) doesn't end up with tiny chunks.
+		 */
+		next = ALIGN_DOWN(start, MEM_CLEAR_CHUNK_SIZE) +
+			MEM_CLEAR_CHUNK_SIZE;
+		if (next > end)
+			next = end;
+
+		c = zalloc(sizeof(*c));
+		if (!c) {
+			/* Not fatal, just slower */
+			mem_zero((void *)start, next - start);
+			start = next;
+			continue;
+		}
+		c->start = start;
+		c->end = next;
+		list_add_tail(&mem_clear_chunks, &c->link);
+
+		c->job = cpu_queue_job_on_chip(chip_id, "mem_clear",
+					       mem_clear_job, c);
+		if (!c->job)
+			c->job = cpu_queue_job(NULL, "mem_clear",
+					       mem_clear_job, c);
+		/* Couldn't even allocate the job, do it here */
+		if (!c->job)
+			mem_clear_job(c);
+
+		start = next;
+	}
+}
+
+void mem_clear_wait(void)
+{
+	struct mem_clear_chunk *c;
+	uint64_t bytes = 0;
+	unsigned int count = 0;
+
+	/* Runs the jobs here if we are the only CPU around */
+	cpu_process_local_jobs();
+
+	while ((c = list_pop(&mem_clear_chunks, struct mem_clear_chunk,
+			     link))) {
+		cpu_wait_job(c->job, true);
+		bytes += c->end - c->start;
+		count++;
+		free(c);
+	}
+
+	if (count)
+		prlog(PR_DEBUG, "Cleared %llu MB in %u chunks\n",
+		      (unsigned long long)(bytes >> 20), count);
+}
@@ -1166,7 +1166,7 @@ void mem_region_release_unused(void)
 	unlock(&mem_region_lock);
 }
 
-static void mem_clear_range(uint64_t s, uint64_t e)
+static void mem_clear_range(uint64_t s, uint64_t e, uint32_t chip_id)
 {
 	uint64_t res_start, res_end;
 
@@ -1185,8 +1185,8 @@ static void mem_clear_range(uint64_t s, uint64_t e)
 	if (e <= s)
 		return;
 	if (s < res_start && e > res_end) {
-		mem_clear_range(s, res_start);
-		mem_clear_range(res_end, e);
+		mem_clear_range(s, res_start, chip_id);
+		mem_clear_range(res_end, e, chip_id);
 		return;
 	}
 
@@ -1201,19 +1201,20 @@ static void mem_clear_range(uint64_t s, uint64_t e)
 	if (e <= s)
 		return;
 	if (s < res_start && e > res_end) {
-		mem_clear_range(s, res_start);
-		mem_clear_range(res_end, e);
+		mem_clear_range(s, res_start, chip_id);
+		mem_clear_range(res_end, e, chip_id);
 		return;
 	}
 
 	prlog(PR_NOTICE, "Clearing region %llx-%llx\n",
 	      (long long)s, (long long)e);
-	memset((void *)s, 0, e - s);
+	mem_clear_queue(s, e, chip_id);
 }
 
 void mem_region_clear_unused(void)
 {
 	struct mem_region *r;
+	uint32_t chip_id;
 
 	lock(&mem_region_lock);
 	assert(mem_regions_finalised);
@@ -1226,9 +1227,17 @@ void mem_region_clear_unused(void)
 
 		assert(r != &skiboot_heap);
 
-		mem_clear_range(r->start, r->start + r->len);
+		/* Cleared from the chip owning the memory where known */
+		chip_id = 0xffffffff;
+		if (r->node)
+			chip_id = dt_prop_get_u32_def(r->node, "ibm,chip-id",
+						      0xffffffff);
+
+		mem_clear_range(r->start, r->start + r->len, chip_id);
 	}
 	unlock(&mem_region_lock);
+
+	mem_clear_wait();
 }
 
 static void mem_region_add_dt_reserved_node(struct dt_node *parent,
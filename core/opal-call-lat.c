@@ -0,0 +1,98 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Latency histograms of the OPAL calls, per CPU and per token. Each CPU
+ * only ever writes its own cacheline aligned block, so recording a call
+ * is two timebase reads and a few stores to lines no other CPU touches.
+ *
+ * It costs about 36k per CPU, so it's only enabled with the NVRAM
+ * setting opal-call-latency=true. The histograms are exported to the OS
+ * as /sys/firmware/opal/exports/opal_call_latency, which
+ * external/opal-call-lat/dump_opal_call_lat decodes.
+ */
+
+#include <skiboot.h>
+#include <cpu.h>
+#include <opal.h>
+#include <nvram.h>
+#include <lat-hist.h>
+#include <mem_region-malloc.h>
+#include <opal-call-lat-types.h>
+
+#define OPAL_CALL_LAT_ALIGN	128
+
+static struct opal_call_lat_hdr *opal_call_lat;
+
+void opal_call_lat_record(struct cpu_thread *cpu, uint64_t token)
+{
+	if (token > OPAL_LAST)
+		return;
+
+	lat_hist_add(&cpu->opal_call_lat[token], mftb() - cpu->opal_call_tb);
+}
+
+void opal_call_lat_init(void)
+{
+	struct opal_call_lat_cpu *blk;
+	struct cpu_thread *cpu;
+	size_t hdr_size, cpu_size, size;
+	unsigned int nr_cpus = 0;
+
+	BUILD_ASSERT(sizeof(struct lat_hist) ==
+		     sizeof(struct opal_call_lat_hist));
+	BUILD_ASSERT(LAT_HIST_BUCKETS == OPAL_CALL_LAT_BUCKETS);
+
+	if (!nvram_query_eq("opal-call-latency", "true"))
+		return;
+
+	for_each_cpu(cpu)
+		nr_cpus++;
+
+	hdr_size = ALIGN_UP(sizeof(struct opal_call_lat_hdr),
+			    OPAL_CALL_LAT_ALIGN);
+	cpu_size = ALIGN_UP(sizeof(struct opal_call_lat_cpu) +
+			    (OPAL_LAST + 1) * sizeof(struct lat_hist),
+			    OPAL_CALL_LAT_ALIGN);
+	size = hdr_size + nr_cpus * cpu_size;
+
+	opal_call_lat = local_alloc(this_cpu()->chip_id, size, 0x1000);
+	if (!opal_call_lat) {
+		prerror("OPAL: Failed to allocate call latency histograms\n");
+		return;
+	}
+	memset(opal_call_lat, 0, size);
+
+	opal_call_lat->magic = cpu_to_be32(OPAL_CALL_LAT_MAGIC);
+	opal_call_lat->version = cpu_to_be32(OPAL_CALL_LAT_VERSION);
+	opal_call_lat->hdr_size = cpu_to_be32(hdr_size);
+	opal_call_lat->cpu_size = cpu_to_be32(cpu_size);
+	opal_call_lat->nr_cpus = cpu_to_be32(nr_cpus);
+	opal_call_lat->nr_tokens = cpu_to_be32(OPAL_LAST + 1);
+	opal_call_lat->nr_buckets = cpu_to_be32(LAT_HIST_BUCKETS);
+	opal_call_lat->tb_hz = cpu_to_be64(tb_hz);
+
+	blk = (void *)opal_call_lat + hdr_size;
+	for_each_cpu(cpu) {
+		blk->pir = cpu_to_be32(cpu->pir);
+		cpu->opal_call_lat = (struct lat_hist *)blk->hist;
+		blk = (void *)blk + cpu_size;
+	}
+
+	prlog(PR_INFO, "OPAL: Call latency histograms for %u CPUs, %zu bytes\n",
+	      nr_cpus, size);
+	opal_add_export("opal_call_latency", opal_call_lat, size);
+}
@@ -166,6 +166,10 @@ int64_t opal_entry_check(struct stack_frame *eframe)
 		}
 	}
 
+	/* Re-entries aren't timed, they'd overwrite the outer call's entry */
+	if (cpu->opal_call_lat && cpu->in_opal_call == 1)
+		cpu->opal_call_tb = mftb();
+
 	return OPAL_SUCCESS;
 }
 
@@ -176,6 +180,9 @@ int64_t opal_exit_check(int64_t retval, struct stack_frame *eframe)
 	struct cpu_thread *cpu = this_cpu();
 	uint64_t token = eframe->gpr[0];
 
+	if (cpu->opal_call_lat && cpu->in_opal_call == 1)
+		opal_call_lat_record(cpu, token);
+
 	if (!cpu->in_opal_call) {
 		disable_fast_reboot("Un-accounted firmware entry");
 		printf("CPU UN-ACCOUNTED FIRMWARE ENTRY! PIR=%04lx cpu @%p -> pir=%04x token=%llu retval=%lld\n",
@@ -355,6 +362,19 @@ static void add_opal_firmware_exports_node(struct dt_node *node)
 #endif
 }
 
+void opal_add_export(const char *name, void *base, uint64_t size)
+{
+	struct dt_node *exports;
+
+	exports = opal_node ? dt_find_by_path(opal_node, "firmware/exports") :
+		NULL;
+	if (!exports) {
+		prerror("OPAL: No exports node for %s\n", name);
+		return;
+	}
+	dt_add_property_u64s(exports, name, (uint64_t)base, size);
+}
+
 static void add_opal_firmware_node(void)
 {
 	struct dt_node *firmware = dt_new(opal_node, "firmware");
@@ -492,16 +512,36 @@ static uint64_t opal_test_func(uint64_t arg)
 }
 opal_call(OPAL_TEST, opal_test_func, 1);
 
+/*
+ * Pollers with neither an interest mask nor an interval are called on
+ * every opal_run_pollers(). The others only when one of the events they
+ * are interested in was kicked, or when their interval is up.
+ */
 struct opal_poll_entry {
 	struct list_node	link;
 	void			(*poller)(void *data);
 	void			*data;
+	const char		*name;
+	uint64_t		events;
+	unsigned long		interval;
+	unsigned long		next;
+	/* Updated locklessly, only indicative with several CPUs polling */
+	uint64_t		runs;
+	uint64_t		skips;
+	unsigned long		total_tb;
+	unsigned long		max_tb;
 };
 
+/* A poller taking longer than this gets reported, each time it's slower */
+#define OPAL_POLLER_SLOW_US	100
+
 static struct list_head opal_pollers = LIST_HEAD_INIT(opal_pollers);
 static struct lock opal_poll_lock = LOCK_UNLOCKED;
+static uint64_t opal_poll_kicked;
 
-void opal_add_poller(void (*poller)(void *data), void *data)
+static void __opal_add_poller(void (*poller)(void *data), void *data,
+			      const char *name, uint64_t events,
+			      unsigned long interval)
 {
 	struct opal_poll_entry *ent;
 
@@ -509,11 +549,105 @@ void opal_add_poller(void (*poller)(void *data), void *data)
 	assert(ent);
 	ent->poller = poller;
 	ent->data = data;
+	ent->name = name;
+	ent->events = events;
+	ent->interval = interval;
 	lock(&opal_poll_lock);
 	list_add_tail(&opal_pollers, &ent->link);
 	unlock(&opal_poll_lock);
 }
 
+void opal_add_poller(void (*poller)(void *data), void *data)
+{
+	__opal_add_poller(poller, data, NULL, 0, 0);
+}
+
+void opal_add_poller_timed(void (*poller)(void *data), void *data,
+			   const char *name, uint64_t events,
+			   unsigned long interval_ms)
+{
+	__opal_add_poller(poller, data, name, events,
+			  msecs_to_tb(interval_ms));
+}
+
+void opal_kick_pollers(uint64_t events)
+{
+	/* Drivers kick on hot paths, most of the time it's already done */
+	if ((opal_poll_kicked & events) == events)
+		return;
+
+	lock(&opal_poll_lock);
+	opal_poll_kicked |= events;
+	unlock(&opal_poll_lock);
+}
+
+static bool opal_poller_due(struct opal_poll_entry *ent, uint64_t kicked,
+			    unsigned long now)
+{
+	if (ent->events & kicked)
+		return true;
+	if (ent->interval)
+		return tb_compare(now, ent->next) != TB_ABEFOREB;
+
+	/* Only interested in events */
+	return !ent->events;
+}
+
+static void opal_run_poller(struct opal_poll_entry *ent, uint64_t kicked)
+{
+	unsigned long start, tb;
+
+	start = mftb();
+	if (!opal_poller_due(ent, kicked, start)) {
+		ent->skips++;
+		return;
+	}
+	ent->next = start + ent->interval;
+
+	ent->poller(ent->data);
+
+	tb = mftb() - start;
+	ent->runs++;
+	ent->total_tb += tb;
+	if (tb > ent->max_tb) {
+		ent->max_tb = tb;
+		if (tb_to_usecs(tb) > OPAL_POLLER_SLOW_US)
+			prlog(PR_INFO, "OPAL: Poller %s (%p) took %luus\n",
+			      ent->name ? ent->name : "?", ent->poller,
+			      tb_to_usecs(tb));
+	}
+}
+
+bool opal_poller_stats(const char *name, struct opal_poller_stats *stats)
+{
+	struct opal_poll_entry *ent;
+
+	list_for_each(&opal_pollers, ent, link) {
+		if (!ent->name || strcmp(ent->name, name))
+			continue;
+		stats->runs = ent->runs;
+		stats->skips = ent->skips;
+		stats->total_tb = ent->total_tb;
+		stats->max_tb = ent->max_tb;
+		return true;
+	}
+	return false;
+}
+
+void opal_dump_pollers(void)
+{
+	struct opal_poll_entry *ent;
+
+	prlog(PR_DEBUG, "OPAL: Pollers:\n");
+	list_for_each(&opal_pollers, ent, link)
+		prlog(PR_DEBUG, "  %-16s runs %llu skips %llu"
+		      " total %luus max %luus\n",
+		      ent->name ? ent->name : "?",
+		      (unsigned long long)ent->runs,
+		      (unsigned long long)ent->skips,
+		      tb_to_usecs(ent->total_tb), tb_to_usecs(ent->max_tb));
+}
+
 void opal_del_poller(void (*poller)(void *data))
 {
 	struct opal_poll_entry *ent;
@@ -550,6 +684,7 @@ void opal_run_pollers(void)
 	static int poller_recursion = 0;
 	struct opal_poll_entry *poll_ent;
 	bool was_in_poller;
+	uint64_t kicked;
 
 	/* Don't re-enter on this CPU, unless it was an OPAL re-entry */
 	if (this_cpu()->in_opal_call == 1 && this_cpu()->in_poller) {
@@ -602,9 +737,18 @@ void opal_run_pollers(void)
 	/* We run the timers first */
 	check_timers(false);
 
+	/* Take the events kicked so far, later ones are for the next run */
+	kicked = opal_poll_kicked;
+	if (kicked) {
+		lock(&opal_poll_lock);
+		kicked = opal_poll_kicked;
+		opal_poll_kicked = 0;
+		unlock(&opal_poll_lock);
+	}
+
 	/* The pollers are run lokelessly, see comment in opal_del_poller */
 	list_for_each(&opal_pollers, poll_ent, link)
-		poll_ent->poller(poll_ent->data);
+		opal_run_poller(poll_ent, kicked);
 
 	/* Disable poller flag */
 	this_cpu()->in_poller = was_in_poller;
@@ -207,7 +207,7 @@ void pci_init_iov_cap(struct phb *phb, struct pci_device *pd)
 	if (!pci_has_cap(pd, PCI_CFG_CAP_ID_EXP, false))
 		return;
 
-	pos = pci_find_ecap(phb, pd->bdfn, PCIECAP_ID_SRIOV, NULL);
+	pos = pci_dev_find_ecap(phb, pd, PCIECAP_ID_SRIOV, NULL);
 	if (pos <= 0)
 		return;
 
@@ -74,6 +74,93 @@ opal_call(OPAL_PCI_CONFIG_WRITE_BYTE, opal_pci_config_write_byte, 4);
 opal_call(OPAL_PCI_CONFIG_WRITE_HALF_WORD, opal_pci_config_write_half_word, 4);
 opal_call(OPAL_PCI_CONFIG_WRITE_WORD, opal_pci_config_write_word, 4);
 
+int64_t pci_cfg_access_one(struct phb *phb, struct opal_pci_cfg_access *acc)
+{
+	uint32_t bdfn = be16_to_cpu(acc->bdfn);
+	uint32_t offset = be16_to_cpu(acc->offset);
+	uint32_t val = be32_to_cpu(acc->value);
+	uint16_t val16;
+	uint8_t val8;
+	int64_t rc;
+
+	if (acc->op == OPAL_PCI_CFG_ACCESS_WRITE) {
+		switch (acc->size) {
+		case 1:
+			return phb->ops->cfg_write8(phb, bdfn, offset, val);
+		case 2:
+			return phb->ops->cfg_write16(phb, bdfn, offset, val);
+		case 4:
+			return phb->ops->cfg_write32(phb, bdfn, offset, val);
+		}
+		return OPAL_PARAMETER;
+	}
+
+	if (acc->op != OPAL_PCI_CFG_ACCESS_READ)
+		return OPAL_PARAMETER;
+
+	switch (acc->size) {
+	case 1:
+		rc = phb->ops->cfg_read8(phb, bdfn, offset, &val8);
+		val = val8;
+		break;
+	case 2:
+		rc = phb->ops->cfg_read16(phb, bdfn, offset, &val16);
+		val = val16;
+		break;
+	case 4:
+		rc = phb->ops->cfg_read32(phb, bdfn, offset, &val);
+		break;
+	default:
+		return OPAL_PARAMETER;
+	}
+	if (rc == OPAL_SUCCESS)
+		acc->value = cpu_to_be32(val);
+
+	return rc;
+}
+
+/*
+ * Run a batch of config space accesses under a single PHB lock and a
+ * single OPAL entry. Every descriptor gets its own return code, a
+ * failed access doesn't stop the ones after it. PHBs which can check
+ * their state once for the whole batch do it through their own
+ * cfg_access_vector op.
+ */
+static int64_t opal_pci_config_access_vector(uint64_t phb_id,
+					     struct opal_pci_cfg_access *accs,
+					     uint64_t count)
+{
+	struct phb *phb = pci_get_phb(phb_id);
+	bool failed = false;
+	uint64_t i;
+	int64_t rc;
+
+	if (!phb)
+		return OPAL_PARAMETER;
+	if (!count || count > OPAL_PCI_CFG_ACCESS_MAX)
+		return OPAL_PARAMETER;
+	if (!opal_addr_valid(accs) || !opal_addr_valid(&accs[count - 1] + 1))
+		return OPAL_PARAMETER;
+
+	phb_lock(phb);
+	if (phb->ops->cfg_access_vector) {
+		phb->ops->cfg_access_vector(phb, accs, count);
+	} else {
+		for (i = 0; i < count; i++) {
+			rc = pci_cfg_access_one(phb, &accs[i]);
+			accs[i].rc = cpu_to_be32(rc);
+		}
+	}
+	phb_unlock(phb);
+
+	for (i = 0; i < count; i++)
+		if (accs[i].rc)
+			failed = true;
+
+	return failed ? OPAL_PARTIAL : OPAL_SUCCESS;
+}
+opal_call(OPAL_PCI_CONFIG_ACCESS_VECTOR, opal_pci_config_access_vector, 3);
+
 static struct lock opal_eeh_evt_lock = LOCK_UNLOCKED;
 static uint64_t opal_eeh_evt = 0;
 
@@ -544,6 +631,7 @@ static int64_t opal_pci_reset(uint64_t id, uint8_t reset_scope,
 		if (assert_state != OPAL_ASSERT_RESET)
 			break;
 
+		pci_uncache_caps(phb, slot->pd);
 		rc = slot->ops.creset(slot);
 		if (rc < 0)
 			prlog(PR_ERR, "SLOT-%016llx: Error %lld on complete reset\n",
@@ -559,6 +647,7 @@ static int64_t opal_pci_reset(uint64_t id, uint8_t reset_scope,
 		if (assert_state != OPAL_ASSERT_RESET)
 			break;
 
+		pci_uncache_caps(phb, slot->pd);
 		rc = slot->ops.freset(slot);
 		if (rc < 0)
 			prlog(PR_ERR, "SLOT-%016llx: Error %lld on fundamental reset\n",
@@ -574,6 +663,7 @@ static int64_t opal_pci_reset(uint64_t id, uint8_t reset_scope,
 		if (assert_state != OPAL_ASSERT_RESET)
 			break;
 
+		pci_uncache_caps(phb, slot->pd);
 		rc = slot->ops.hreset(slot);
 		if (rc < 0)
 			prlog(PR_ERR, "SLOT-%016llx: Error %lld on hot reset\n",
@@ -86,6 +86,168 @@ static int64_t __pci_find_cap(struct phb *phb, uint16_t bdfn,
 	return OPAL_UNSUPPORTED;
 }
 
+static int64_t __pci_find_ecap(struct phb *phb, uint16_t bdfn, uint16_t want,
+			       uint8_t *version)
+{
+	int64_t rc;
+	uint32_t cap;
+	uint16_t off, prev = 0;
+
+	for (off = 0x100; off && off < 0x1000; off = (cap >> 20) & 0xffc ) {
+		if (off == prev) {
+			PCIERR(phb, bdfn, "pci_find_ecap hit a loop !\n");
+			break;
+		}
+		prev = off;
+		rc = pci_cfg_read32(phb, bdfn, off, &cap);
+		if (rc)
+			return rc;
+		if ((cap & 0xffff) == want) {
+			if (version)
+				*version = (cap >> 16) & 0xf;
+			return off;
+		}
+	}
+	return OPAL_UNSUPPORTED;
+}
+
+static bool pci_cache_std_caps(struct phb *phb, struct pci_device *pd)
+{
+	struct pci_cap_cache *cc = &pd->cap_cache;
+	uint16_t stat, cap;
+	uint8_t pos, next;
+
+	cc->nr_caps = 0;
+	if (pci_cfg_read16(phb, pd->bdfn, PCI_CFG_STAT, &stat))
+		return false;
+	if (!(stat & PCI_CFG_STAT_CAP))
+		return true;
+	if (pci_cfg_read8(phb, pd->bdfn, PCI_CFG_CAP, &pos))
+		return false;
+	pos &= 0xfc;
+	while (pos) {
+		if (cc->nr_caps == PCI_CACHED_CAPS)
+			return false;
+		if (pci_cfg_read16(phb, pd->bdfn, pos, &cap))
+			return false;
+		cc->caps[cc->nr_caps].id = cap & 0xff;
+		cc->caps[cc->nr_caps].pos = pos;
+		cc->nr_caps++;
+		next = (cap >> 8) & 0xfc;
+		if (next == pos) {
+			PCIERR(phb, pd->bdfn, "pci_find_cap hit a loop !\n");
+			break;
+		}
+		pos = next;
+	}
+	return true;
+}
+
+static bool pci_cache_ext_caps(struct phb *phb, struct pci_device *pd)
+{
+	struct pci_cap_cache *cc = &pd->cap_cache;
+	uint32_t cap;
+	uint16_t off, prev = 0;
+
+	cc->nr_ecaps = 0;
+	for (off = 0x100; off && off < 0x1000; off = (cap >> 20) & 0xffc) {
+		if (off == prev) {
+			PCIERR(phb, pd->bdfn, "pci_find_ecap hit a loop !\n");
+			break;
+		}
+		prev = off;
+		if (cc->nr_ecaps == PCI_CACHED_ECAPS)
+			return false;
+		if (pci_cfg_read32(phb, pd->bdfn, off, &cap))
+			return false;
+		cc->ecaps[cc->nr_ecaps].id = cap & 0xffff;
+		cc->ecaps[cc->nr_ecaps].pos = off;
+		cc->ecaps[cc->nr_ecaps].version = (cap >> 16) & 0xf;
+		cc->nr_ecaps++;
+	}
+	return true;
+}
+
+/*
+ * Records the capability chains of a device. Only PCIe devices have
+ * extended capabilities, reading there on the others isn't reliable.
+ */
+static void pci_cache_caps(struct phb *phb, struct pci_device *pd)
+{
+	struct pci_cap_cache *cc = &pd->cap_cache;
+	unsigned int i;
+
+	cc->stale = false;
+	cc->ecaps_valid = false;
+	cc->caps_valid = pci_cache_std_caps(phb, pd);
+	if (!cc->caps_valid)
+		return;
+
+	for (i = 0; i < cc->nr_caps; i++)
+		if (cc->caps[i].id == PCI_CFG_CAP_ID_EXP)
+			break;
+	if (i < cc->nr_caps)
+		cc->ecaps_valid = pci_cache_ext_caps(phb, pd);
+}
+
+static int __pci_uncache_caps(struct phb *phb __unused,
+			      struct pci_device *pd, void *data __unused)
+{
+	pd->cap_cache.stale = true;
+	return 0;
+}
+
+/*
+ * The capabilities of a device and of everything below it are recorded
+ * again the next time they're looked up, after a reset for example.
+ */
+void pci_uncache_caps(struct phb *phb, struct pci_device *pd)
+{
+	if (pd)
+		__pci_uncache_caps(phb, pd, NULL);
+	pci_walk_dev(phb, pd, __pci_uncache_caps, NULL);
+}
+
+/* pci_dev_find_cap - Like pci_find_cap(), from the recorded chain */
+int64_t pci_dev_find_cap(struct phb *phb, struct pci_device *pd,
+			 uint8_t want)
+{
+	struct pci_cap_cache *cc = &pd->cap_cache;
+	unsigned int i;
+
+	if (cc->stale)
+		pci_cache_caps(phb, pd);
+	if (!cc->caps_valid)
+		return __pci_find_cap(phb, pd->bdfn, want, true);
+
+	for (i = 0; i < cc->nr_caps; i++)
+		if (cc->caps[i].id == want)
+			return cc->caps[i].pos;
+	return OPAL_UNSUPPORTED;
+}
+
+/* pci_dev_find_ecap - Like pci_find_ecap(), from the recorded chain */
+int64_t pci_dev_find_ecap(struct phb *phb, struct pci_device *pd,
+			  uint16_t want, uint8_t *version)
+{
+	struct pci_cap_cache *cc = &pd->cap_cache;
+	unsigned int i;
+
+	if (cc->stale)
+		pci_cache_caps(phb, pd);
+	if (!cc->ecaps_valid)
+		return __pci_find_ecap(phb, pd->bdfn, want, version);
+
+	for (i = 0; i < cc->nr_ecaps; i++) {
+		if (cc->ecaps[i].id == want) {
+			if (version)
+				*version = cc->ecaps[i].version;
+			return cc->ecaps[i].pos;
+		}
+	}
+	return OPAL_UNSUPPORTED;
+}
+
 /* pci_find_cap - Find a PCI capability in a device config space
  *
  * This will return a config space offset (positive) or a negative
@@ -95,6 +257,10 @@ static int64_t __pci_find_cap(struct phb *phb, uint16_t bdfn,
  */
 int64_t pci_find_cap(struct phb *phb, uint16_t bdfn, uint8_t want)
 {
+	struct pci_device *pd = pci_find_dev(phb, bdfn);
+
+	if (pd)
+		return pci_dev_find_cap(phb, pd, want);
 	return __pci_find_cap(phb, bdfn, want, true);
 }
 
@@ -110,26 +276,11 @@ int64_t pci_find_cap(struct phb *phb, uint16_t bdfn, uint8_t want)
 int64_t pci_find_ecap(struct phb *phb, uint16_t bdfn, uint16_t want,
 		      uint8_t *version)
 {
-	int64_t rc;
-	uint32_t cap;
-	uint16_t off, prev = 0;
+	struct pci_device *pd = pci_find_dev(phb, bdfn);
 
-	for (off = 0x100; off && off < 0x1000; off = (cap >> 20) & 0xffc ) {
-		if (off == prev) {
-			PCIERR(phb, bdfn, "pci_find_ecap hit a loop !\n");
-			break;
-		}
-		prev = off;
-		rc = pci_cfg_read32(phb, bdfn, off, &cap);
-		if (rc)
-			return rc;
-		if ((cap & 0xffff) == want) {
-			if (version)
-				*version = (cap >> 16) & 0xf;
-			return off;
-		}
-	}
-	return OPAL_UNSUPPORTED;
+	if (pd)
+		return pci_dev_find_ecap(phb, pd, want, version);
+	return __pci_find_ecap(phb, bdfn, want, version);
 }
 
 static void pci_init_pcie_cap(struct phb *phb, struct pci_device *pd)
@@ -152,9 +303,9 @@ static void pci_init_pcie_cap(struct phb *phb, struct pci_device *pd)
 			ecap = __pci_find_cap(phb, pd->bdfn,
 					      PCI_CFG_CAP_ID_EXP, false);
 		else
-			ecap = pci_find_cap(phb, pd->bdfn, PCI_CFG_CAP_ID_EXP);
+			ecap = pci_dev_find_cap(phb, pd, PCI_CFG_CAP_ID_EXP);
 	} else {
-		ecap = pci_find_cap(phb, pd->bdfn, PCI_CFG_CAP_ID_EXP);
+		ecap = pci_dev_find_cap(phb, pd, PCI_CFG_CAP_ID_EXP);
 	}
 
 	if (ecap <= 0) {
@@ -196,7 +347,7 @@ static void pci_init_aer_cap(struct phb *phb, struct pci_device *pd)
 	if (!pci_has_cap(pd, PCI_CFG_CAP_ID_EXP, false))
 		return;
 
-	pos = pci_find_ecap(phb, pd->bdfn, PCIECAP_ID_AER, NULL);
+	pos = pci_dev_find_ecap(phb, pd, PCIECAP_ID_AER, NULL);
 	if (pos > 0)
 		pci_set_cap(pd, PCIECAP_ID_AER, pos, NULL, NULL, true);
 }
@@ -205,7 +356,7 @@ static void pci_init_pm_cap(struct phb *phb, struct pci_device *pd)
 {
 	int64_t pos;
 
-	pos = pci_find_cap(phb, pd->bdfn, PCI_CFG_CAP_ID_PM);
+	pos = pci_dev_find_cap(phb, pd, PCI_CFG_CAP_ID_PM);
 	if (pos > 0)
 		pci_set_cap(pd, PCI_CFG_CAP_ID_PM, pos, NULL, NULL, false);
 }
@@ -290,6 +441,7 @@ static struct pci_device *pci_scan_one(struct phb *phb, struct pci_device *paren
 	pd->scan_map = 0xffffffff; /* Default */
 	pd->primary_bus = (bdfn >> 8);
 
+	pci_cache_caps(phb, pd);
 	pci_init_capabilities(phb, pd);
 
 	/* If it's a bridge, sanitize the bus numbers to avoid forwarding
@@ -1958,11 +2110,6 @@ struct pci_cfg_reg_filter *pci_find_cfg_reg_filter(struct pci_device *pd,
 	return NULL;
 }
 
-static bool pci_device_has_cfg_reg_filters(struct phb *phb, uint16_t bdfn)
-{
-       return bitmap_tst_bit(*phb->filter_map, bdfn);
-}
-
 int64_t pci_handle_cfg_filters(struct phb *phb, uint32_t bdfn,
 			       uint32_t offset, uint32_t len,
 			       uint32_t *data, bool write)
@@ -0,0 +1,182 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/* Don't include these: PPC-specific */
+#define __CPU_H
+#define __TIME_H
+
+#define lwsync()
+#define zalloc(bytes) calloc((bytes), 1)
+
+#define CPUS 4
+
+struct cpu_thread {
+	uint32_t pir;
+	uint64_t lock_wait_tb;
+};
+
+static struct cpu_thread fake_cpus[CPUS];
+static struct cpu_thread *cur_cpu = &fake_cpus[0];
+
+static inline struct cpu_thread *this_cpu(void)
+{
+	return cur_cpu;
+}
+
+#define for_each_cpu(cpu)	\
+	for (cpu = &fake_cpus[0]; cpu < &fake_cpus[CPUS]; cpu++)
+
+static unsigned long tb_hz = 512000000;
+static uint64_t stamp;
+
+static inline uint64_t mftb(void)
+{
+	return stamp;
+}
+
+#include "../boot-profile.c"
+
+struct dt_node *opal_node = (void *)0x1234;
+static void *blob;
+static size_t blob_size;
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+struct dt_property *dt_add_property(struct dt_node *node, const char *name,
+				    const void *val, size_t size)
+{
+	assert(node == opal_node);
+	assert(!strcmp(name, "boot-profile"));
+	assert(!blob);
+	blob = malloc(size);
+	memcpy(blob, val, size);
+	blob_size = size;
+	return NULL;
+}
+
+void _prlog(int log_level __unused, const char *fmt __unused, ...)
+{
+}
+
+static void check_entry(struct boot_profile_entry *e, uint8_t type,
+			const char *name, uint32_t pir, uint64_t start,
+			uint64_t end, uint64_t lock_wait)
+{
+	assert(e->type == type);
+	assert(!strcmp(e->name, name));
+	assert(be32_to_cpu(e->pir) == pir);
+	assert(be64_to_cpu(e->start_tb) == start);
+	assert(be64_to_cpu(e->end_tb) == end);
+	assert(be64_to_cpu(e->lock_wait_tb) == lock_wait);
+}
+
+int main(void)
+{
+	struct boot_profile_entry *e;
+	struct boot_profile_hdr *hdr;
+	int job, unfinished;
+	unsigned int i;
+
+	for (i = 0; i < CPUS; i++)
+		fake_cpus[i].pir = i * 8;
+
+	/* Two phases on the boot CPU, with a job run on another one */
+	stamp = 100;
+	boot_phase("one");
+	stamp = 150;
+	fake_cpus[0].lock_wait_tb += 7;
+	cur_cpu = &fake_cpus[2];
+	fake_cpus[2].lock_wait_tb = 1000;
+	job = boot_profile_job_start("a job");
+	assert(job >= 0);
+	stamp = 170;
+	fake_cpus[2].lock_wait_tb += 3;
+	boot_profile_job_end(job);
+	unfinished = boot_profile_job_start("slow job");
+	assert(unfinished >= 0);
+	cur_cpu = &fake_cpus[0];
+
+	boot_profile_flash_read(0x1000);
+	boot_profile_flash_read(0x234);
+
+	stamp = 200;
+	boot_phase("a very long name that gets truncated");
+	stamp = 300;
+	fake_cpus[0].lock_wait_tb += 5;
+	boot_profile_add_dt();
+
+	assert(blob);
+	hdr = blob;
+	assert(blob_size == sizeof(*hdr) + 4 * sizeof(*e));
+	assert(be32_to_cpu(hdr->magic) == BOOT_PROFILE_MAGIC);
+	assert(be32_to_cpu(hdr->version) == BOOT_PROFILE_VERSION);
+	assert(be64_to_cpu(hdr->tb_hz) == tb_hz);
+	assert(be32_to_cpu(hdr->nr_entries) == 4);
+	assert(be32_to_cpu(hdr->nr_dropped) == 0);
+	assert(be64_to_cpu(hdr->flash_bytes) == 0x1234);
+	assert(be64_to_cpu(hdr->lock_wait_tb) == 7 + 5 + 1003);
+
+	e = (void *)(hdr + 1);
+	check_entry(&e[0], BOOT_PROFILE_PHASE, "one", 0, 100, 200, 7);
+	check_entry(&e[1], BOOT_PROFILE_JOB, "a job", 16, 150, 170, 3);
+	/* Unfinished entries have no end nor lock wait */
+	check_entry(&e[2], BOOT_PROFILE_JOB, "slow job", 16, 170, 0, 0);
+	check_entry(&e[3], BOOT_PROFILE_PHASE, "a very long name that g",
+		    0, 200, 300, 5);
+
+	/* Nothing is recorded after the export, nor exported twice */
+	assert(boot_profile_job_start("late") == -1);
+	boot_phase("late");
+	boot_profile_flash_read(1);
+	boot_profile_add_dt();
+	assert(nr_records == 4);
+	assert(flash_bytes == 0x1234);
+
+	/* Entries past the end are counted as dropped */
+	boot_profile_done = false;
+	for (i = nr_records; i < BOOT_PROFILE_MAX_ENTRIES; i++)
+		assert(boot_profile_job_start("filler") >= 0);
+	assert(boot_profile_job_start("dropped") == -1);
+	assert(boot_profile_job_start("dropped") == -1);
+	assert(nr_dropped == 2);
+	free(blob);
+	blob = NULL;
+	boot_profile_add_dt();
+	hdr = blob;
+	assert(be32_to_cpu(hdr->nr_entries) == BOOT_PROFILE_MAX_ENTRIES);
+	assert(be32_to_cpu(hdr->nr_dropped) == 2);
+	free(blob);
+
+	return 0;
+}
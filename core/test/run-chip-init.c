@@ -0,0 +1,306 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The chip_init_run() scheduler against simulated CPUs: jobs run when
+ * queued but take simulated time, finishing in whatever order their
+ * CPUs get to them. Checks every unit starts after its dependencies
+ * and that the chips really are initialised side by side.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+#include <skiboot.h>
+
+struct cpu_thread;
+
+struct cpu_job {
+	void (*func)(void *data);
+	void *data;
+	unsigned long end;
+};
+
+struct cpu_job *cpu_queue_job_on_chip(uint32_t chip_id, const char *name,
+				      void (*func)(void *data), void *data);
+struct cpu_job *cpu_queue_job(struct cpu_thread *cpu, const char *name,
+			      void (*func)(void *data), void *data);
+bool cpu_poll_job(struct cpu_job *job);
+void cpu_wait_job(struct cpu_job *job, bool free_it);
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+#undef prlog
+#define prlog(l, ...) mock_printf(__VA_ARGS__)
+#undef pr_fmt
+
+#include "../chip-init.c"
+
+unsigned long tb_hz = 512000000;
+
+#define NR_CHIPS	8
+#define CPUS_PER_CHIP	2
+/* No CPU on that one, its work goes to any CPU */
+#define NO_CPU_CHIP	5
+
+static struct proc_chip chips[NR_CHIPS];
+static unsigned int sim_chips;
+static unsigned long cpu_free[NR_CHIPS][CPUS_PER_CHIP];
+static unsigned int nr_on_chip, nr_any, nr_polls;
+static bool fail_jobs;
+
+struct proc_chip *next_chip(struct proc_chip *chip)
+{
+	unsigned int i = chip ? chip - chips + 1 : 0;
+
+	return i < sim_chips ? &chips[i] : NULL;
+}
+
+void time_wait_us(unsigned long us)
+{
+	stamp += usecs_to_tb(us);
+}
+
+/* The job runs on that CPU as soon as it is free, taking its time */
+static struct cpu_job *run_on(unsigned long *cpu,
+			      void (*func)(void *data), void *data)
+{
+	struct cpu_job *job = calloc(1, sizeof(*job));
+	unsigned long now = stamp;
+
+	job->func = func;
+	job->data = data;
+	if (tb_compare(*cpu, stamp) == TB_AAFTERB)
+		stamp = *cpu;
+	func(data);
+	job->end = *cpu = stamp;
+	stamp = now;
+	return job;
+}
+
+static unsigned long *least_busy(unsigned int first, unsigned int last)
+{
+	unsigned long *best = NULL;
+	unsigned int c, t;
+
+	for (c = first; c <= last; c++) {
+		if (c == NO_CPU_CHIP)
+			continue;
+		for (t = 0; t < CPUS_PER_CHIP; t++)
+			if (!best || cpu_free[c][t] < *best)
+				best = &cpu_free[c][t];
+	}
+	return best;
+}
+
+struct cpu_job *cpu_queue_job_on_chip(uint32_t chip_id,
+				      const char *name __unused,
+				      void (*func)(void *data), void *data)
+{
+	if (fail_jobs || chip_id == NO_CPU_CHIP || sim_chips == 1)
+		return NULL;
+	nr_on_chip++;
+	return run_on(least_busy(chip_id, chip_id), func, data);
+}
+
+struct cpu_job *cpu_queue_job(struct cpu_thread *cpu,
+			      const char *name __unused,
+			      void (*func)(void *data), void *data)
+{
+	assert(!cpu);
+	if (fail_jobs || sim_chips == 1)
+		return NULL;
+	nr_any++;
+	return run_on(least_busy(0, sim_chips - 1), func, data);
+}
+
+bool cpu_poll_job(struct cpu_job *job)
+{
+	nr_polls++;
+	return tb_compare(stamp, job->end) != TB_ABEFOREB;
+}
+
+void cpu_wait_job(struct cpu_job *job, bool free_it)
+{
+	assert(cpu_poll_job(job));
+	if (free_it)
+		free(job);
+}
+
+/*
+ * A:50us, B:100us after A, C:150us with a finish hook, D:25us after B
+ * and C, E finish only after D, F after A and a unit run earlier. The
+ * chips take one to three times as long as each other.
+ */
+enum { A, B, C, D, E, F, NR_UNITS };
+
+static const unsigned long unit_us[NR_UNITS] = { 50, 100, 150, 25, 0, 10 };
+
+static struct {
+	unsigned long start, end;
+	unsigned int runs;
+} rec[NR_UNITS][NR_CHIPS];
+
+static unsigned long finish_tb[NR_UNITS];
+static unsigned long serial_tb;
+
+static void unit_run(unsigned int u, struct proc_chip *chip)
+{
+	unsigned int c = chip - chips;
+	unsigned long tb = usecs_to_tb(unit_us[u]) * (1 + c % 3);
+
+	assert(chip->id == c);
+	assert(!rec[u][c].runs++);
+	rec[u][c].start = stamp;
+	stamp += tb;
+	rec[u][c].end = stamp;
+	serial_tb += tb;
+}
+
+static void unit_finish(unsigned int u)
+{
+	unsigned int c;
+
+	assert(!finish_tb[u]);
+	for (c = 0; c < sim_chips; c++)
+		assert(!rec[u][c].runs ||
+		       tb_compare(rec[u][c].end, stamp) != TB_AAFTERB);
+	finish_tb[u] = stamp;
+}
+
+static void a_chip(struct proc_chip *chip) { unit_run(A, chip); }
+static void b_chip(struct proc_chip *chip) { unit_run(B, chip); }
+static void c_chip(struct proc_chip *chip) { unit_run(C, chip); }
+static void d_chip(struct proc_chip *chip) { unit_run(D, chip); }
+static void f_chip(struct proc_chip *chip) { unit_run(F, chip); }
+static void c_finish(void) { unit_finish(C); }
+static void e_finish(void) { unit_finish(E); }
+
+static const struct chip_init_unit earlier = { .name = "earlier" };
+
+static const struct chip_init_unit units[NR_UNITS] = {
+	[A] = { .name = "a", .init_chip = a_chip },
+	[B] = { .name = "b", .init_chip = b_chip, .deps = { &units[A] } },
+	[C] = { .name = "c", .init_chip = c_chip, .finish = c_finish },
+	[D] = { .name = "d", .init_chip = d_chip,
+		.deps = { &units[B], &units[C] } },
+	[E] = { .name = "e", .finish = e_finish, .deps = { &units[D] } },
+	[F] = { .name = "f", .init_chip = f_chip,
+		.deps = { &earlier, &units[A] } },
+};
+
+/* Listed backwards, the order mustn't matter */
+static const struct chip_init_unit *unit_list[NR_UNITS] = {
+	&units[F], &units[E], &units[D], &units[C], &units[B], &units[A],
+};
+
+static void after(unsigned int u, unsigned int dep)
+{
+	unsigned int c;
+
+	for (c = 0; c < sim_chips; c++) {
+		if (u == E)
+			continue;
+		if (units[dep].finish)
+			assert(tb_compare(rec[u][c].start, finish_tb[dep]) !=
+			       TB_ABEFOREB);
+		else
+			assert(tb_compare(rec[u][c].start, rec[dep][c].end) !=
+			       TB_ABEFOREB);
+	}
+}
+
+/* Returns the elapsed time */
+static unsigned long run(unsigned int chip_count)
+{
+	unsigned long start;
+	unsigned int u, c;
+
+	sim_chips = chip_count;
+	memset(rec, 0, sizeof(rec));
+	memset(finish_tb, 0, sizeof(finish_tb));
+	serial_tb = 0;
+	stamp += usecs_to_tb(1000);
+	for (c = 0; c < NR_CHIPS; c++)
+		for (u = 0; u < CPUS_PER_CHIP; u++)
+			cpu_free[c][u] = stamp;
+
+	start = stamp;
+	chip_init_run(unit_list, NR_UNITS);
+
+	for (u = 0; u < NR_UNITS; u++) {
+		assert(finish_tb[u] || !units[u].finish);
+		for (c = 0; c < sim_chips; c++)
+			assert(rec[u][c].runs == (units[u].init_chip ? 1 : 0));
+	}
+	after(B, A);
+	after(D, B);
+	after(D, C);
+	after(F, A);
+	for (c = 0; c < sim_chips; c++)
+		assert(tb_compare(finish_tb[E], rec[D][c].end) != TB_ABEFOREB);
+
+	return stamp - start;
+}
+
+int main(void)
+{
+	unsigned long elapsed;
+	unsigned int c;
+
+	for (c = 0; c < NR_CHIPS; c++)
+		chips[c].id = c;
+
+	/* All at once, the chip without CPUs borrowing other ones */
+	elapsed = run(NR_CHIPS);
+	printf("%u chips: %lu us, %lu us of work, %.1fx\n", NR_CHIPS,
+	       tb_to_usecs(elapsed), tb_to_usecs(serial_tb),
+	       (double)serial_tb / elapsed);
+	assert(nr_on_chip == (NR_CHIPS - 1) * (NR_UNITS - 1));
+	assert(nr_any == NR_UNITS - 1);
+	/* A little more than the slowest chip, plus the barrier on C */
+	assert(elapsed * (NR_CHIPS - 2) <= serial_tb);
+	assert(elapsed <= usecs_to_tb((50 + 100 + 150 + 25) * 3));
+
+	/* The boot CPU waits rather than spinning on the jobs */
+	assert(nr_polls < 50 * NR_UNITS * NR_CHIPS);
+
+	/* Alone, everything runs inline, still in order */
+	nr_on_chip = nr_any = 0;
+	elapsed = run(1);
+	assert(!nr_on_chip && !nr_any);
+	assert(elapsed == serial_tb);
+
+	/* No job could be queued at all */
+	fail_jobs = true;
+	elapsed = run(NR_CHIPS);
+	assert(elapsed == serial_tb);
+
+	return 0;
+}
@@ -62,6 +62,10 @@ ssize_t console_write(bool flush_to_drivers, const void *buf, size_t count)
 	return count;
 }
 
+void flush_console_sync(void)
+{
+}
+
 int main(void)
 {
 	unsigned long value = 0xffffffffffffffff;
@@ -47,6 +47,10 @@ ssize_t console_write(bool flush_to_drivers, const void *buf, size_t count)
 	return count;
 }
 
+void flush_console_sync(void)
+{
+}
+
 int main(void)
 {
 	debug_descriptor.console_log_levels = 0x75;
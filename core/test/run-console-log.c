@@ -47,6 +47,13 @@ ssize_t console_write(bool flush_to_drivers, const void *buf, size_t count)
 	return count;
 }
 
+bool synced;
+
+void flush_console_sync(void)
+{
+	synced = true;
+}
+
 int main(void)
 {
 	debug_descriptor.console_log_levels = 0x75;
@@ -54,6 +61,7 @@ int main(void)
 	prlog(PR_EMERG, "Hello World");
 	assert(strcmp(console_buffer, "[    0.000000042,0] Hello World") == 0);
 	assert(flushed_to_drivers==true);
+	assert(synced);
 
 	memset(console_buffer, 0, sizeof(console_buffer));
 
@@ -66,9 +74,11 @@ int main(void)
 	assert(strcmp(console_buffer, "[    0.000000042,7] Hello World") == 0);
 	assert(flushed_to_drivers==false);
 
+	synced = false;
 	printf("Hello World");
 	assert(strcmp(console_buffer, "[    0.000000042,5] Hello World") == 0);
 	assert(flushed_to_drivers==true);
+	assert(!synced);
 
 	return 0;
 }
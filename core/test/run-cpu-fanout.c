@@ -0,0 +1,292 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * cpu_run_per_core() against simulated CPUs: jobs run when queued but
+ * take simulated time on their CPU. Checks the secondaries wait for
+ * their primary, failures are collected and that the cores really do
+ * run side by side.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+#include <skiboot.h>
+
+struct cpu_thread {
+	uint32_t		pir;
+	bool			is_secondary;
+	bool			available;
+	struct cpu_thread	*primary;
+	/* Simulation: when it's free again */
+	unsigned long		free_tb;
+};
+
+struct cpu_job {
+	unsigned long end;
+};
+
+static unsigned int cpu_max_pir;
+struct cpu_thread *first_available_cpu(void);
+struct cpu_thread *next_available_cpu(struct cpu_thread *cpu);
+struct cpu_job *cpu_queue_job(struct cpu_thread *cpu, const char *name,
+			      void (*func)(void *data), void *data);
+bool cpu_poll_job(struct cpu_job *job);
+void cpu_wait_job(struct cpu_job *job, bool free_it);
+static struct cpu_thread *this_cpu(void);
+
+#define for_each_available_cpu(cpu)	\
+	for (cpu = first_available_cpu(); cpu; cpu = next_available_cpu(cpu))
+
+unsigned int cpu_run_per_core(const char *name,
+			      bool (*func)(void *data), void *data,
+			      struct cpu_thread *skip, bool primaries_only,
+			      void (*done)(struct cpu_thread *cpu,
+					   bool ok, void *data));
+
+#include "../cpu-fanout.c"
+
+unsigned long tb_hz = 512000000;
+
+#define NR_CORES	8
+#define NR_THREADS	4
+#define NR_CPUS		(NR_CORES * NR_THREADS)
+/* How long the job takes on a primary and on a secondary */
+#define PRIMARY_US	200
+#define SECONDARY_US	5
+
+static struct cpu_thread cpus[NR_CPUS];
+static struct cpu_thread *boot_cpu, *running_on;
+static unsigned int nr_polls, nr_queued;
+
+static struct {
+	unsigned long start, end;
+	unsigned int runs, dones, seq;
+	bool ok;
+} rec[NR_CPUS];
+
+static unsigned long serial_tb;
+static int fail_pir = -1, unqueueable_pir = -1;
+static int last_done;
+
+struct cpu_thread *first_available_cpu(void)
+{
+	return next_available_cpu(NULL);
+}
+
+struct cpu_thread *next_available_cpu(struct cpu_thread *cpu)
+{
+	unsigned int i = cpu ? cpu - cpus + 1 : 0;
+
+	for (; i < NR_CPUS; i++)
+		if (cpus[i].available)
+			return &cpus[i];
+	return NULL;
+}
+
+static struct cpu_thread *this_cpu(void)
+{
+	return running_on;
+}
+
+void time_wait_us(unsigned long us)
+{
+	stamp += usecs_to_tb(us);
+}
+
+/* The job runs on that CPU as soon as it is free, taking its time */
+struct cpu_job *cpu_queue_job(struct cpu_thread *cpu,
+			      const char *name __unused,
+			      void (*func)(void *data), void *data)
+{
+	struct cpu_job *job;
+	unsigned long now = stamp;
+
+	assert(cpu);
+	if (cpu->pir == unqueueable_pir)
+		return NULL;
+
+	job = calloc(1, sizeof(*job));
+	nr_queued++;
+	if (tb_compare(cpu->free_tb, stamp) == TB_AAFTERB)
+		stamp = cpu->free_tb;
+	running_on = cpu;
+	func(data);
+	running_on = boot_cpu;
+	job->end = cpu->free_tb = stamp;
+
+	/* Ours runs inline, the caller's clock goes with it */
+	if (cpu != boot_cpu)
+		stamp = now;
+	return job;
+}
+
+bool cpu_poll_job(struct cpu_job *job)
+{
+	nr_polls++;
+	return tb_compare(stamp, job->end) != TB_ABEFOREB;
+}
+
+void cpu_wait_job(struct cpu_job *job, bool free_it)
+{
+	assert(cpu_poll_job(job));
+	if (free_it)
+		free(job);
+}
+
+static bool sync_job(void *data)
+{
+	struct cpu_thread *me = this_cpu();
+	unsigned long tb;
+
+	assert(data == &rec);
+	assert(!rec[me->pir].runs++);
+	rec[me->pir].seq = nr_queued;
+	tb = usecs_to_tb(me->is_secondary ? SECONDARY_US : PRIMARY_US);
+	rec[me->pir].start = stamp;
+	stamp += tb;
+	rec[me->pir].end = stamp;
+	serial_tb += tb;
+
+	return me->pir != fail_pir;
+}
+
+static void sync_done(struct cpu_thread *cpu, bool ok, void *data)
+{
+	assert(data == &rec);
+	assert((int)cpu->pir > last_done);
+	last_done = cpu->pir;
+	rec[cpu->pir].dones++;
+	rec[cpu->pir].ok = ok;
+}
+
+/* Returns the elapsed time */
+static unsigned long run(struct cpu_thread *skip, bool primaries_only,
+			 unsigned int expect_failed)
+{
+	unsigned long start;
+	unsigned int i;
+	struct cpu_thread *p;
+
+	memset(rec, 0, sizeof(rec));
+	serial_tb = 0;
+	last_done = -1;
+	stamp += usecs_to_tb(1000);
+	for (i = 0; i < NR_CPUS; i++)
+		cpus[i].free_tb = stamp;
+
+	start = stamp;
+	assert(cpu_run_per_core("sync", sync_job, &rec, skip, primaries_only,
+				sync_done) == expect_failed);
+
+	for (i = 0; i < NR_CPUS; i++) {
+		p = cpus[i].primary;
+		if (&cpus[i] == skip || !cpus[i].available ||
+		    (primaries_only && cpus[i].is_secondary) ||
+		    (p != &cpus[i] && p != skip && rec[p->pir].runs &&
+		     !rec[p->pir].ok) ||
+		    (int)p->pir == unqueueable_pir) {
+			/* A failed primary is not gone past */
+			if ((int)i != unqueueable_pir)
+				assert(!rec[i].runs && !rec[i].dones);
+			continue;
+		}
+		assert(rec[i].dones == 1);
+		if ((int)i == unqueueable_pir) {
+			assert(!rec[i].runs && !rec[i].ok);
+			continue;
+		}
+		assert(rec[i].runs == 1);
+		assert(rec[i].ok == ((int)i != fail_pir));
+
+		/* Secondaries only once the primary is synced */
+		if (p != &cpus[i] && p != skip)
+			assert(tb_compare(rec[i].start, rec[p->pir].end) !=
+			       TB_ABEFOREB);
+	}
+
+	return stamp - start;
+}
+
+int main(void)
+{
+	unsigned long elapsed;
+	unsigned int i;
+
+	cpu_max_pir = NR_CPUS - 1;
+	for (i = 0; i < NR_CPUS; i++) {
+		cpus[i].pir = i;
+		cpus[i].available = true;
+		cpus[i].is_secondary = i % NR_THREADS;
+		cpus[i].primary = &cpus[i - i % NR_THREADS];
+	}
+	boot_cpu = running_on = &cpus[0];
+
+	/* Everybody but the boot CPU, like the chiptod slaves */
+	elapsed = run(boot_cpu, false, 0);
+	printf("%u CPUs: %lu us, %lu us of work, %.1fx\n", NR_CPUS - 1,
+	       tb_to_usecs(elapsed), tb_to_usecs(serial_tb),
+	       (double)serial_tb / elapsed);
+	/* About one primary and its secondaries, not all of them */
+	assert(elapsed <= usecs_to_tb(PRIMARY_US + 4 * SECONDARY_US +
+				      (NR_THREADS + 1) * CPU_FANOUT_POLL_US));
+	assert(elapsed * (NR_CORES - 2) <= serial_tb);
+	/* The caller waits rather than spinning on the jobs */
+	assert(nr_polls < 10 * NR_CPUS);
+
+	/* Including us, we run ours last rather than hold the others up */
+	elapsed = run(NULL, false, 0);
+	for (i = 1; i < NR_CORES; i++)
+		assert(rec[0].seq > rec[i * NR_THREADS].seq);
+	assert(elapsed * (NR_CORES - 2) <= serial_tb);
+
+	/* Primaries only */
+	nr_queued = 0;
+	run(NULL, true, 0);
+	assert(nr_queued == NR_CORES);
+
+	/* A primary fails, its threads are left alone */
+	fail_pir = 2 * NR_THREADS;
+	run(boot_cpu, false, 1);
+
+	/* A secondary fails, that's just the one */
+	fail_pir = 3 * NR_THREADS + 1;
+	run(boot_cpu, false, 1);
+	fail_pir = -1;
+
+	/* Couldn't queue on a secondary, it's a failure */
+	unqueueable_pir = 5 * NR_THREADS + 2;
+	run(boot_cpu, false, 1);
+	unqueueable_pir = -1;
+
+	/* Unavailable CPUs aren't touched */
+	cpus[6 * NR_THREADS + 3].available = false;
+	run(boot_cpu, false, 0);
+
+	return 0;
+}
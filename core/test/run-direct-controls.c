@@ -0,0 +1,354 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Special wakeup of POWER9 cores against simulated PPM registers: each
+ * core takes its own time to wake up once asked. Counts the XSCOMs and
+ * the simulated time the batches take next to one core at a time.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+static unsigned long sim_tb;
+#define mftb()	(sim_tb)
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+#include <skiboot.h>
+#include <lock.h>
+
+struct cpu_thread {
+	uint32_t		pir;
+	uint32_t		chip_id;
+	bool			is_secondary;
+	struct cpu_thread	*primary;
+	struct lock		dctl_lock;
+	bool			dctl_stopped;
+	uint32_t		special_wakeup_count;
+};
+
+#define NR_CHIPS	2
+#define CORES_PER_CHIP	12
+#define NR_CORES	(NR_CHIPS * CORES_PER_CHIP)
+#define THREADS		4
+#define NR_CPUS		(NR_CORES * THREADS)
+
+static struct cpu_thread cpus[NR_CPUS];
+
+static inline struct cpu_thread *this_cpu(void)
+{
+	return &cpus[0];
+}
+
+static struct cpu_thread *next_primary(struct cpu_thread *cpu)
+{
+	cpu = cpu ? cpu + THREADS : &cpus[0];
+	return cpu < &cpus[NR_CPUS] ? cpu : NULL;
+}
+
+static struct cpu_thread *next_cpu(struct cpu_thread *cpu)
+{
+	cpu = cpu ? cpu + 1 : &cpus[0];
+	return cpu < &cpus[NR_CPUS] ? cpu : NULL;
+}
+
+#define for_each_ungarded_primary(cpu)	\
+	for (cpu = next_primary(NULL); cpu; cpu = next_primary(cpu))
+#define for_each_ungarded_cpu(cpu)	\
+	for (cpu = next_cpu(NULL); cpu; cpu = next_cpu(cpu))
+
+static struct cpu_thread *find_cpu_by_server(u32 server_no)
+{
+	return server_no < NR_CPUS ? &cpus[server_no] : NULL;
+}
+
+int dctl_set_special_wakeup(struct cpu_thread *t);
+int dctl_clear_special_wakeup(struct cpu_thread *t);
+int dctl_set_special_wakeup_cores(struct cpu_thread **cores, unsigned int nr);
+int dctl_clear_special_wakeup_cores(struct cpu_thread **cores,
+				    unsigned int nr);
+int dctl_core_is_gated(struct cpu_thread *t);
+
+#define mfspr(spr)	(0UL)
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+static unsigned int nr_errors;
+
+#undef prlog
+#define prlog(l, ...) do {			\
+	if ((l) <= PR_ERR)			\
+		nr_errors++;			\
+	mock_printf(__VA_ARGS__);		\
+} while (0)
+#undef prerror
+#define prerror(...) prlog(PR_ERR, __VA_ARGS__)
+
+#include "../direct-controls.c"
+
+enum proc_gen proc_gen = proc_gen_p9;
+enum proc_chip_quirks proc_chip_quirks;
+unsigned long tb_hz = 512000000;
+
+static struct core_sim {
+	/* When the wakeup asked for is done, 0 if not asked */
+	unsigned long	done_tb;
+	bool		never;
+	unsigned int	asserts, releases;
+} cores[NR_CORES];
+
+static unsigned int nr_reads, nr_writes;
+
+/* Every core takes a different time to come out of stop */
+static unsigned long wakeup_us(unsigned int core)
+{
+	return 200 + 150 * (core % 7);
+}
+
+uint32_t pir_to_core_id(uint32_t pir)
+{
+	return (pir / THREADS) % CORES_PER_CHIP;
+}
+
+uint32_t pir_to_thread_id(uint32_t pir)
+{
+	return pir % THREADS;
+}
+
+uint32_t pir_to_chip_id(uint32_t pir)
+{
+	return pir / (THREADS * CORES_PER_CHIP);
+}
+
+static struct core_sim *core_at(uint32_t chip_id, uint64_t addr,
+				uint64_t reg)
+{
+	unsigned int core;
+
+	for (core = 0; core < CORES_PER_CHIP; core++)
+		if (addr == XSCOM_ADDR_P9_EC_SLAVE(core, reg))
+			return &cores[chip_id * CORES_PER_CHIP + core];
+	return NULL;
+}
+
+int _xscom_write(uint32_t partid, uint64_t pcb_addr, uint64_t val,
+		 bool take_lock __unused)
+{
+	struct core_sim *c = core_at(partid, pcb_addr,
+				     EC_PPM_SPECIAL_WKUP_HYP);
+
+	assert(c);
+	nr_writes++;
+	if (val == P9_SPWKUP_SET) {
+		c->asserts++;
+		c->done_tb = sim_tb + usecs_to_tb(wakeup_us(c - cores));
+	} else {
+		assert(!val);
+		c->releases++;
+		c->done_tb = 0;
+	}
+	return 0;
+}
+
+int _xscom_read(uint32_t partid, uint64_t pcb_addr, uint64_t *val,
+		bool take_lock __unused)
+{
+	struct core_sim *c = core_at(partid, pcb_addr, P9_EC_PPM_SSHHYP);
+
+	assert(c);
+	nr_reads++;
+	if (c->done_tb && !c->never &&
+	    tb_compare(sim_tb, c->done_tb) != TB_ABEFOREB)
+		*val = P9_SPECIAL_WKUP_DONE;
+	else
+		*val = P9_CORE_GATED;
+	return 0;
+}
+
+void time_wait_us(unsigned long us)
+{
+	sim_tb += usecs_to_tb(us);
+}
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+/* Paths not taken here */
+static unsigned int nr_stub_calls;
+
+unsigned long callthru_tcl(const char *str __unused, int len __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+void __opal_register(uint64_t token __unused, void *func __unused,
+		     unsigned num_args __unused)
+{
+	nr_stub_calls++;
+}
+
+static void reset_counts(void)
+{
+	unsigned int i;
+
+	nr_reads = nr_writes = 0;
+	for (i = 0; i < NR_CORES; i++)
+		cores[i].asserts = cores[i].releases = 0;
+}
+
+static void check_locks(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_CPUS; i++)
+		assert(!cpus[i].dctl_lock.lock_val);
+}
+
+int main(void)
+{
+	struct cpu_thread *batch[NR_CORES];
+	unsigned long start, serial_set, serial_clear, slowest = 0;
+	unsigned int i;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		cpus[i].pir = i;
+		cpus[i].chip_id = pir_to_chip_id(i);
+		cpus[i].is_secondary = i % THREADS;
+		cpus[i].primary = &cpus[i - i % THREADS];
+	}
+	for (i = 0; i < NR_CORES; i++) {
+		batch[i] = &cpus[i * THREADS];
+		if (wakeup_us(i) > slowest)
+			slowest = wakeup_us(i);
+	}
+
+	/* One core at a time, as it used to be done */
+	start = sim_tb;
+	for (i = 0; i < NR_CORES; i++)
+		assert(dctl_set_special_wakeup(batch[i] + 1) == OPAL_SUCCESS);
+	serial_set = sim_tb - start;
+	start = sim_tb;
+	for (i = 0; i < NR_CORES; i++)
+		assert(dctl_clear_special_wakeup(batch[i] + 2) == OPAL_SUCCESS);
+	serial_clear = sim_tb - start;
+	assert(serial_clear >= NR_CORES * usecs_to_tb(10000));
+	check_locks();
+
+	/* All at once: one write each, then polling them together */
+	reset_counts();
+	start = sim_tb;
+	assert(dctl_set_special_wakeup_cores(batch, NR_CORES) ==
+	       OPAL_SUCCESS);
+	printf("set %u cores: %lu us at once, %lu us one at a time,"
+	       " %u writes, %u reads\n", NR_CORES, tb_to_usecs(sim_tb - start),
+	       tb_to_usecs(serial_set), nr_writes, nr_reads);
+	assert(nr_writes == NR_CORES);
+	assert(sim_tb - start <= usecs_to_tb(slowest + P9_SPWKUP_POLL_INTERVAL));
+	for (i = 0; i < NR_CORES; i++) {
+		assert(cores[i].asserts == 1);
+		assert(cpus[i * THREADS].special_wakeup_count == 1);
+	}
+	check_locks();
+
+	/* Already awake, that's only counted */
+	reset_counts();
+	assert(dctl_set_special_wakeup(&cpus[3]) == OPAL_SUCCESS);
+	assert(cpus[0].special_wakeup_count == 2);
+	assert(!nr_writes && !nr_reads);
+	assert(dctl_clear_special_wakeup(&cpus[0]) == OPAL_SUCCESS);
+	assert(cpus[0].special_wakeup_count == 1);
+	assert(!nr_writes && !nr_reads);
+
+	/* One write each and the back to back delay once */
+	start = sim_tb;
+	assert(dctl_clear_special_wakeup_cores(batch, NR_CORES) ==
+	       OPAL_SUCCESS);
+	printf("clear %u cores: %lu us at once, %lu us one at a time\n",
+	       NR_CORES, tb_to_usecs(sim_tb - start),
+	       tb_to_usecs(serial_clear));
+	assert(nr_writes == NR_CORES && !nr_reads);
+	assert(sim_tb - start == usecs_to_tb(10000 + 1));
+	for (i = 0; i < NR_CORES; i++) {
+		assert(cores[i].releases == 1 && !cores[i].done_tb);
+		assert(!cpus[i * THREADS].special_wakeup_count);
+	}
+	check_locks();
+
+	/* Nothing to release, no delay */
+	reset_counts();
+	start = sim_tb;
+	assert(dctl_clear_special_wakeup_cores(batch, NR_CORES) ==
+	       OPAL_SUCCESS);
+	assert(!nr_writes && sim_tb - start == usecs_to_tb(1));
+
+	/* A core that never wakes up fails alone, after the timeout */
+	reset_counts();
+	cores[5].never = true;
+	start = sim_tb;
+	assert(dctl_set_special_wakeup_cores(batch, NR_CORES) ==
+	       OPAL_HARDWARE);
+	assert(sim_tb - start >= usecs_to_tb(P9_SPWKUP_TIMEOUT));
+	for (i = 0; i < NR_CORES; i++)
+		assert(cpus[i * THREADS].special_wakeup_count == (i != 5));
+	/* Still asserted, as per the protocol */
+	assert(!cores[5].releases && nr_errors == 1);
+	check_locks();
+
+	/* And isn't released with the others */
+	reset_counts();
+	assert(dctl_clear_special_wakeup_cores(batch, NR_CORES) ==
+	       OPAL_SUCCESS);
+	assert(nr_writes == NR_CORES - 1 && !cores[5].releases);
+	cores[5].never = false;
+	cores[5].done_tb = 0;
+
+	/* The fast reboot path goes through the batches */
+	reset_counts();
+	nr_errors = 0;
+	start = sim_tb;
+	sreset_all_finish();
+	assert(!nr_writes);
+	for (i = 0; i < NR_CORES; i++)
+		cpus[i * THREADS].special_wakeup_count = 1;
+	sreset_all_finish();
+	assert(nr_writes == NR_CORES);
+	assert(sim_tb - start == usecs_to_tb(2 + 10000));
+
+	assert(!nr_errors);
+	assert(!nr_stub_calls);
+
+	return 0;
+}
@@ -0,0 +1,448 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Timebase errors hitting every core at once, with a thread standing
+ * in for each hardware thread. Checks the rendez-vous between the
+ * threads of a core, that the core wide cleanup is serialised within
+ * the core only, and reports how many cores did it at the same time.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#include <skiboot.h>
+#include <lock.h>
+#include <ccan/list/list.h>
+
+enum cpu_thread_state {
+	cpu_state_active,
+	cpu_state_unavailable,
+};
+
+struct cpu_thread {
+	uint32_t		pir;
+	uint32_t		chip_id;
+	bool			is_secondary;
+	struct cpu_thread	*primary;
+	enum cpu_thread_state	state;
+	uint32_t		core_hmi_state;
+	uint32_t		*core_hmi_state_ptr;
+	struct lock		hmi_lock;
+	bool			tb_invalid;
+	bool			tb_resynced;
+	uint64_t		hmer;
+};
+
+#define NR_CHIPS	2
+#define CORES_PER_CHIP	4
+#define NR_CORES	(NR_CHIPS * CORES_PER_CHIP)
+#define THREADS		4
+#define NR_CPUS		(NR_CORES * THREADS)
+
+static struct cpu_thread cpus[NR_CPUS];
+static __thread struct cpu_thread *cur_cpu;
+static unsigned int cpu_thread_count = THREADS;
+
+static inline struct cpu_thread *this_cpu(void)
+{
+	return cur_cpu;
+}
+
+static inline uint32_t cpu_get_thread_index(struct cpu_thread *cpu)
+{
+	return cpu->pir - cpu->primary->pir;
+}
+
+static inline uint32_t cpu_get_thread0(struct cpu_thread *cpu)
+{
+	return cpu->primary->pir;
+}
+
+static inline bool cpu_is_thread0(struct cpu_thread *cpu)
+{
+	return cpu->primary == cpu;
+}
+
+static struct cpu_thread *find_cpu_by_pir(uint32_t pir)
+{
+	assert(pir < NR_CPUS);
+	return &cpus[pir];
+}
+
+static struct cpu_thread *first_cpu(void)
+{
+	return &cpus[0];
+}
+
+static struct cpu_thread *next_cpu(struct cpu_thread *cpu)
+{
+	return cpu + 1 < &cpus[NR_CPUS] ? cpu + 1 : NULL;
+}
+
+#define for_each_cpu(cpu)	\
+	for (cpu = first_cpu(); cpu; cpu = next_cpu(cpu))
+
+static void cpu_relax(void)
+{
+	sched_yield();
+}
+
+#define cmpxchg32(mem, old, new) __sync_val_compare_and_swap(mem, old, new)
+
+static uint64_t mock_mfspr(unsigned int spr);
+static void mock_mtspr(unsigned int spr, uint64_t val);
+#define mfspr(spr)		mock_mfspr(spr)
+#define mtspr(spr, val)		mock_mtspr(spr, val)
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+static unsigned int nr_errors;
+
+#undef prlog
+#define prlog(l, ...) do {			\
+	if ((l) <= PR_ERR)			\
+		__sync_fetch_and_add(&nr_errors, 1);	\
+	mock_printf(__VA_ARGS__);		\
+} while (0)
+#undef prerror
+#define prerror(...) prlog(PR_ERR, __VA_ARGS__)
+#undef pr_fmt
+
+#include "../hmi.c"
+
+enum proc_gen proc_gen = proc_gen_p9;
+
+/* How long the cleanup of a core takes, it's mostly XSCOMs */
+#define CLEANUP_US	2000
+
+static struct core_sim {
+	uint64_t	tfmr;
+	unsigned int	in_cleanup;
+	unsigned int	cleaned;
+	unsigned int	cleared;
+	unsigned int	resynced;
+	unsigned int	sprc_select;
+} cores[NR_CORES];
+
+static unsigned int cores_in_cleanup, max_cores_in_cleanup;
+static unsigned int nr_events;
+
+static struct core_sim *my_core(void)
+{
+	return &cores[this_cpu()->pir / THREADS];
+}
+
+static uint64_t mock_mfspr(unsigned int spr)
+{
+	switch (spr) {
+	case SPR_TFMR:
+		return my_core()->tfmr;
+	case SPR_HMER:
+		return this_cpu()->hmer;
+	}
+	assert(false);
+	return 0;
+}
+
+static void mock_mtspr(unsigned int spr, uint64_t val)
+{
+	assert(spr == SPR_HMER);
+	/* Writing HMER ands it */
+	this_cpu()->hmer &= val;
+}
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	while (__sync_lock_test_and_set(&l->lock_val, 1))
+		sched_yield();
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	__sync_lock_release(&l->lock_val);
+}
+
+bool lock_held_by_me(struct lock *l)
+{
+	return l->lock_val;
+}
+
+static struct proc_chip chips[NR_CHIPS];
+
+struct proc_chip *get_chip(uint32_t chip_id)
+{
+	return chip_id < NR_CHIPS ? &chips[chip_id] : NULL;
+}
+
+uint32_t pir_to_core_id(uint32_t pir)
+{
+	return pir / THREADS;
+}
+
+uint32_t pir_to_chip_id(uint32_t pir)
+{
+	return pir / (THREADS * CORES_PER_CHIP);
+}
+
+/* SPRC/SPRD select then read another thread's SPR, per core */
+int _xscom_write(uint32_t partid __unused, uint64_t pcb_addr,
+		 uint64_t val __unused, bool take_lock __unused)
+{
+	assert(pcb_addr == XSCOM_ADDR_P9_EC(pir_to_core_id(this_cpu()->pir),
+					    P9_SCOM_SPRC));
+	assert(this_cpu()->primary->hmi_lock.lock_val);
+	my_core()->sprc_select++;
+	return 0;
+}
+
+int _xscom_read(uint32_t partid __unused, uint64_t pcb_addr, uint64_t *val,
+		bool take_lock __unused)
+{
+	assert(pcb_addr == XSCOM_ADDR_P9_EC(pir_to_core_id(this_cpu()->pir),
+					    P9_SCOM_SPRD));
+	assert(this_cpu()->primary->hmi_lock.lock_val);
+	*val = my_core()->tfmr;
+	return 0;
+}
+
+void _xscom_lock(void)
+{
+}
+
+void _xscom_unlock(void)
+{
+}
+
+bool tfmr_recover_local_errors(uint64_t tfmr __unused)
+{
+	return true;
+}
+
+/* Paths not taken here */
+static unsigned int nr_stub_calls;
+
+bool recover_corrupt_tfmr(void)
+{
+	nr_stub_calls++;
+	return false;
+}
+
+/* Every thread of the core, one at a time, with other cores at once */
+void tfmr_cleanup_core_errors(uint64_t tfmr)
+{
+	struct core_sim *core = my_core();
+	unsigned int n;
+
+	assert(tfmr & SPR_TFMR_CORE_ERRORS);
+	assert(this_cpu()->primary->hmi_lock.lock_val);
+	assert(!core->in_cleanup++);
+	assert(!core->cleared);
+
+	n = __sync_add_and_fetch(&cores_in_cleanup, 1);
+	while (n > max_cores_in_cleanup)
+		__sync_val_compare_and_swap(&max_cores_in_cleanup,
+					    max_cores_in_cleanup, n);
+	usleep(CLEANUP_US);
+	__sync_sub_and_fetch(&cores_in_cleanup, 1);
+
+	core->cleaned++;
+	core->in_cleanup--;
+}
+
+/* After the second rendez-vous, everybody has cleaned up */
+int tfmr_clear_core_errors(uint64_t tfmr __unused)
+{
+	struct core_sim *core = my_core();
+
+	assert(core->cleaned == THREADS);
+	assert(!core->resynced);
+	__sync_fetch_and_add(&core->cleared, 1);
+	return 1;
+}
+
+/* After the third one, on thread 0 only, everybody has cleared */
+int chiptod_recover_tb_errors(bool *out_resynced)
+{
+	struct core_sim *core = my_core();
+
+	assert(cpu_is_thread0(this_cpu()));
+	assert(core->cleared == THREADS);
+	core->tfmr = SPR_TFMR_TB_VALID;
+	core->resynced++;
+	*out_resynced = true;
+	return 1;
+}
+
+int chiptod_recover_tod_errors(void)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+int _opal_queue_msg(enum opal_msg_type msg_type __unused, void *data __unused,
+		    void (*consumed)(void *data) __unused, size_t num_params,
+		    const u64 *params __unused)
+{
+	assert(num_params == 5);
+	__sync_fetch_and_add(&nr_events, 1);
+	return 0;
+}
+
+/* Only used by the malfunction alert decode, not reached here */
+#define STUB(ret, fn, ...)	ret fn(__VA_ARGS__) { nr_stub_calls++; return 0; }
+#define STUB_VOID(fn, ...)	void fn(__VA_ARGS__) { nr_stub_calls++; }
+
+STUB(struct phb *, pci_get_phb, uint64_t phb_id __unused)
+STUB(int64_t, capp_get_info, int chip_id __unused, struct phb *phb __unused,
+     struct capp_info *info __unused)
+STUB(bool, dt_node_is_compatible, const struct dt_node *node __unused,
+     const char *compat __unused)
+STUB(u32, dt_get_chip_id, const struct dt_node *node __unused)
+STUB_VOID(disable_fast_reboot, const char *reason __unused)
+STUB_VOID(npu_set_fence_state, struct npu *p __unused, bool fence __unused)
+STUB(bool, nvram_query_eq, const char *key __unused, const char *value __unused)
+
+int last_phb_id;
+
+static pthread_barrier_t round_barrier;
+static unsigned int nr_rounds;
+
+static void *hmi_thread(void *data)
+{
+	struct cpu_thread *cpu = data;
+	uint64_t flags;
+	unsigned int i;
+
+	cur_cpu = cpu;
+	for (i = 0; i < nr_rounds; i++) {
+		/* Everybody takes the HMI at about the same time */
+		pthread_barrier_wait(&round_barrier);
+
+		flags = 0;
+		cpu->hmer = SPR_HMER_TFAC_ERROR;
+		assert(opal_handle_hmi2((__be64 *)&flags) == OPAL_SUCCESS);
+		flags = be64_to_cpu(flags);
+
+		/* Thread 0 resynced before anybody left the last one */
+		assert(my_core()->resynced == 1);
+		assert(flags & OPAL_HMI_FLAGS_TB_RESYNC);
+		assert(flags & OPAL_HMI_FLAGS_NEW_EVENT);
+		assert(!cpu->hmer);
+		assert(!cpu->tb_invalid);
+
+		pthread_barrier_wait(&round_barrier);
+		/* The main thread sets the next round up */
+		pthread_barrier_wait(&round_barrier);
+	}
+	return NULL;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void setup_round(unsigned int round)
+{
+	unsigned int i;
+
+	memset(cores, 0, sizeof(cores));
+	for (i = 0; i < NR_CORES; i++) {
+		cores[i].tfmr = SPR_TFMR_TB_VALID | SPR_TFMR_TB_MISSING_SYNC;
+		/* Secondaries look at thread 0 for that one */
+		if ((i + round) & 1)
+			cores[i].tfmr |= SPR_TFMR_HDEC_PARITY_ERROR;
+	}
+	for (i = 0; i < NR_CPUS; i++)
+		cpus[i].tb_resynced = false;
+}
+
+int main(void)
+{
+	pthread_t threads[NR_CPUS];
+	unsigned int i, j;
+	double start, elapsed, serial;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		cpus[i].pir = i;
+		cpus[i].chip_id = pir_to_chip_id(i);
+		cpus[i].primary = &cpus[i - i % THREADS];
+		cpus[i].is_secondary = i % THREADS;
+		cpus[i].core_hmi_state_ptr = &cpus[i].primary->core_hmi_state;
+	}
+
+	nr_rounds = 10;
+	pthread_barrier_init(&round_barrier, NULL, NR_CPUS + 1);
+	for (i = 0; i < NR_CPUS; i++)
+		assert(!pthread_create(&threads[i], NULL, hmi_thread, &cpus[i]));
+
+	start = now();
+	for (i = 0; i < nr_rounds; i++) {
+		setup_round(i);
+		pthread_barrier_wait(&round_barrier);
+		/* Everybody is back from the HMI */
+		pthread_barrier_wait(&round_barrier);
+
+		for (j = 0; j < NR_CORES; j++) {
+			assert(cores[j].cleaned == THREADS);
+			assert(cores[j].cleared == THREADS);
+			assert(cores[j].resynced == 1);
+			/* One look at thread 0 per secondary */
+			assert(cores[j].sprc_select ==
+			       (((j + i) & 1) ? THREADS - 1 : 0));
+		}
+		for (j = 0; j < NR_CORES; j++)
+			assert(!cpus[j * THREADS].hmi_lock.lock_val);
+		pthread_barrier_wait(&round_barrier);
+	}
+	elapsed = now() - start;
+
+	for (i = 0; i < NR_CPUS; i++)
+		pthread_join(threads[i], NULL);
+
+	assert(nr_events == nr_rounds * NR_CPUS);
+	assert(!nr_errors);
+	assert(!nr_stub_calls);
+
+	/* With a single lock every cleanup would be one after the other */
+	serial = nr_rounds * NR_CPUS * CLEANUP_US / 1e6;
+	printf("%u cores x %u threads: %.1f ms per HMI, %.1f ms serialised,"
+	       " up to %u cores cleaning up at once\n", NR_CORES, THREADS,
+	       elapsed * 1e3 / nr_rounds, serial * 1e3 / nr_rounds,
+	       max_cores_in_cleanup);
+	/* Not the wall clock, that's at the mercy of the host's load */
+	assert(max_cores_in_cleanup > 1);
+
+	return 0;
+}
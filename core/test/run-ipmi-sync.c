@@ -0,0 +1,322 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ipmi_queue_msg_sync() against a mock backend answering after a set
+ * delay, either from an interrupt on another CPU or from the pollers.
+ * Time is simulated, the waiter has to notice the response within a
+ * bounded delay whatever the response time.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#include <ccan/list/list.h>
+
+struct cpu_thread {
+	struct list_head	locks_held;
+};
+
+static struct cpu_thread cpus[2];
+static struct cpu_thread *boot_cpu = &cpus[0];
+static struct cpu_thread *cur_cpu;
+
+static inline struct cpu_thread *this_cpu(void)
+{
+	return cur_cpu;
+}
+
+static void cpu_relax(void);
+
+static inline void sync(void)
+{
+}
+
+static inline void lwsync(void)
+{
+}
+
+#include "../ipmi.c"
+#include "../../ccan/list/list.c"
+
+unsigned long tb_hz = 512000000;
+
+/* How long a cpu_relax() takes */
+#define RELAX_TB	50
+
+static struct {
+	struct ipmi_msg msg;
+	uint8_t data[4];
+	unsigned long due;
+	bool queued;
+	/* The response comes from an interrupt rather than the pollers */
+	bool irq;
+	/* Fail queue_msg(), or complete the message from it */
+	int queue_rc;
+	bool complete_now;
+} bmc;
+
+static unsigned int nr_complete, nr_pollers;
+
+static void respond(void)
+{
+	if (!bmc.queued || tb_compare(stamp, bmc.due) == TB_ABEFOREB)
+		return;
+	bmc.queued = false;
+	ipmi_cmd_done(bmc.msg.cmd, bmc.msg.netfn + (1 << 2), IPMI_CC_NO_ERROR,
+		      &bmc.msg);
+}
+
+/* Time passes on the waiting CPU, another one may take the interrupt */
+static void advance(unsigned long tb)
+{
+	unsigned long end = stamp + tb;
+
+	if (bmc.irq && bmc.queued &&
+	    tb_compare(bmc.due, end) != TB_AAFTERB) {
+		if (tb_compare(bmc.due, stamp) == TB_AAFTERB)
+			stamp = bmc.due;
+		respond();
+	}
+	stamp = end;
+}
+
+static void cpu_relax(void)
+{
+	advance(RELAX_TB);
+}
+
+void time_wait_nopoll(unsigned long duration)
+{
+	advance(duration);
+}
+
+void opal_run_pollers(void)
+{
+	assert(this_cpu() == boot_cpu);
+	nr_pollers++;
+	respond();
+}
+
+static struct ipmi_msg *mock_alloc(size_t req_size __unused,
+				   size_t resp_size __unused)
+{
+	bmc.msg.data = bmc.data;
+	return &bmc.msg;
+}
+
+static void mock_free(struct ipmi_msg *msg)
+{
+	assert(msg == &bmc.msg);
+}
+
+static int mock_queue(struct ipmi_msg *msg)
+{
+	assert(msg == &bmc.msg);
+	assert(!bmc.queued);
+	if (bmc.queue_rc)
+		return bmc.queue_rc;
+	bmc.queued = true;
+	if (bmc.complete_now) {
+		bmc.due = stamp;
+		respond();
+	}
+	return 0;
+}
+
+static int mock_dequeue(struct ipmi_msg *msg __unused)
+{
+	assert(0);
+	return 0;
+}
+
+static struct ipmi_backend mock_backend = {
+	.alloc_msg = mock_alloc,
+	.free_msg = mock_free,
+	.queue_msg = mock_queue,
+	.dequeue_msg = mock_dequeue,
+};
+
+static const char *export_name;
+static uint64_t export_size;
+
+void opal_add_export(const char *name, void *base, uint64_t size)
+{
+	assert(base == &sync_stats);
+	export_name = name;
+	export_size = size;
+}
+
+__be64 opal_dynamic_event_alloc(void)
+{
+	return 0;
+}
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+void _prlog(int log_level __unused, const char *fmt __unused, ...)
+{
+}
+
+void ipmi_parse_sel(struct ipmi_msg *msg __unused)
+{
+}
+
+void ipmi_wdt_stop(void)
+{
+}
+
+int ipmi_set_boot_count(void)
+{
+	return 0;
+}
+
+static void complete(struct ipmi_msg *msg)
+{
+	assert(msg == &bmc.msg);
+	nr_complete++;
+}
+
+/* Sends a message answered after us, returns how late the caller woke */
+static unsigned long send(unsigned long us, bool irq)
+{
+	struct ipmi_msg *msg;
+	unsigned long start = stamp;
+
+	msg = ipmi_mkmsg(IPMI_DEFAULT_INTERFACE, IPMI_GET_MESSAGE_FLAGS,
+			 complete, NULL, NULL, 0, 1);
+	assert(msg == &bmc.msg);
+	bmc.due = stamp + usecs_to_tb(us);
+	bmc.irq = irq;
+	ipmi_queue_msg_sync(msg);
+
+	assert(!bmc.queued);
+	assert(list_empty(&sync_waiters));
+	assert(!sync_lock.lock_val);
+	assert(stamp - start >= usecs_to_tb(us));
+	return stamp - bmc.due;
+}
+
+static void check_delays(bool irq)
+{
+	static const unsigned long delays[] = {
+		0, 1, 5, 10, 19, 20, 21, 50, 100, 499, 500, 501, 1000, 2000,
+		4999, 5000, 5001, 10000, 20000, 100000, 250000,
+	};
+	unsigned long late, bound, us;
+	unsigned int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(delays); i++) {
+		for (j = 0; j < 8; j++) {
+			/* Random phase against the polling periods */
+			us = delays[i];
+			stamp += random() % usecs_to_tb(10);
+			sync_avg_tb = random() % usecs_to_tb(400);
+
+			late = send(us, irq);
+
+			/*
+			 * Never later than about the response time itself,
+			 * or the longest sleep. From an interrupt the spin
+			 * notices straight away.
+			 */
+			if (us < IPMI_SYNC_SPIN_MIN_US)
+				bound = irq ? RELAX_TB :
+					usecs_to_tb(IPMI_SYNC_POLL_US) +
+					RELAX_TB;
+			else
+				bound = usecs_to_tb(MIN(us, IPMI_SYNC_WAIT_MAX_US) +
+						    IPMI_SYNC_POLL_US) +
+					RELAX_TB;
+			assert(late <= bound);
+		}
+	}
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	srandom(1);
+	list_head_init(&cpus[0].locks_held);
+	list_head_init(&cpus[1].locks_held);
+	stamp = 1000;
+
+	ipmi_register_backend(&mock_backend);
+	assert(!strcmp(export_name, "ipmi_sync_latency"));
+	assert(export_size == sizeof(struct ipmi_sync_stats));
+
+	/* Response from an interrupt on another CPU */
+	cur_cpu = &cpus[1];
+	nr_pollers = 0;
+	check_delays(true);
+	assert(nr_pollers == 0);
+
+	/* The boot CPU waiting while the backend is polled */
+	cur_cpu = boot_cpu;
+	check_delays(false);
+	assert(nr_pollers > 0);
+
+	/* Quick responses make the waiter spin for them */
+	sync_avg_tb = 0;
+	for (i = 0; i < 64; i++)
+		assert(send(50, true) <= RELAX_TB || i < 16);
+	assert(ipmi_sync_spin_tb() > usecs_to_tb(90));
+	assert(ipmi_sync_spin_tb() <= usecs_to_tb(100));
+	for (i = 0; i < 64; i++)
+		send(20000, true);
+	assert(ipmi_sync_spin_tb() == usecs_to_tb(IPMI_SYNC_SPIN_MAX_US));
+
+	assert(nr_complete == sync_stats.response.count);
+	assert(sync_stats.wakeup.count == sync_stats.response.count);
+	assert(sync_stats.response.bucket[lat_hist_bucket(20000)] >= 64);
+	assert(sync_stats.response.max_us >= 250000);
+
+	/* Completed before ipmi_queue_msg() even returned */
+	bmc.complete_now = true;
+	i = nr_complete;
+	send(0, false);
+	assert(nr_complete == i + 1);
+	bmc.complete_now = false;
+
+	/* Couldn't be queued, nothing to wait for */
+	bmc.queue_rc = OPAL_HARDWARE;
+	ipmi_queue_msg_sync(&bmc.msg);
+	assert(list_empty(&sync_waiters));
+	assert(nr_complete == i + 1);
+
+	return 0;
+}
@@ -0,0 +1,255 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+/* Changed between runs, the code only ever uses it in expressions */
+static uint64_t chunk_size;
+#define MEM_CLEAR_CHUNK_SIZE chunk_size
+
+struct cpu_thread;
+
+struct cpu_job {
+	void (*func)(void *data);
+	void *data;
+	uint32_t chip_id;
+	bool complete;
+};
+
+struct cpu_job *cpu_queue_job_on_chip(uint32_t chip_id, const char *name,
+				      void (*func)(void *data), void *data);
+struct cpu_job *cpu_queue_job(struct cpu_thread *cpu, const char *name,
+			      void (*func)(void *data), void *data);
+void cpu_wait_job(struct cpu_job *job, bool free_it);
+void cpu_process_local_jobs(void);
+
+#include "../mem-clear.c"
+#include "../../ccan/list/list.c"
+
+#define MEM_SIZE	(1 << 19)
+#define NR_CHIPS	2
+#define NO_CHIP		0xffffffff
+#define MAX_JOBS	(MEM_SIZE / 64 + 64)
+
+static unsigned char *mem;
+static unsigned char counts[MEM_SIZE];
+static struct cpu_job *jobs[MAX_JOBS];
+static unsigned int nr_jobs, nr_run, nr_inline, nr_any;
+static bool fail_jobs;
+
+void _prlog(int log_level __unused, const char *fmt __unused, ...)
+{
+}
+
+static struct cpu_job *queue(uint32_t chip_id, void (*func)(void *data),
+			     void *data)
+{
+	struct cpu_job *job;
+
+	if (fail_jobs)
+		return NULL;
+
+	assert(nr_jobs < MAX_JOBS);
+	job = calloc(1, sizeof(*job));
+	job->func = func;
+	job->data = data;
+	job->chip_id = chip_id;
+	jobs[nr_jobs++] = job;
+	return job;
+}
+
+struct cpu_job *cpu_queue_job_on_chip(uint32_t chip_id,
+				      const char *name __unused,
+				      void (*func)(void *data), void *data)
+{
+	/* Only chips 0 and 1 have CPUs */
+	if (chip_id >= NR_CHIPS)
+		return NULL;
+	return queue(chip_id, func, data);
+}
+
+struct cpu_job *cpu_queue_job(struct cpu_thread *cpu,
+			      const char *name __unused,
+			      void (*func)(void *data), void *data)
+{
+	assert(!cpu);
+	nr_any++;
+	return queue(NO_CHIP, func, data);
+}
+
+static void run_job(struct cpu_job *job)
+{
+	struct mem_clear_chunk *c = job->data;
+	uint64_t i;
+
+	if (job->complete)
+		return;
+
+	for (i = c->start; i < c->end; i++)
+		counts[i - (uint64_t)mem]++;
+	job->func(job->data);
+	job->complete = true;
+}
+
+/* Other CPUs finish their jobs in any order, here the reverse one */
+void cpu_wait_job(struct cpu_job *job, bool free_it)
+{
+	unsigned int i;
+
+	if (!job) {
+		nr_inline++;
+		return;
+	}
+
+	for (i = nr_jobs; i > nr_run; i--)
+		run_job(jobs[i - 1]);
+	nr_run = nr_jobs;
+	assert(job->complete);
+	if (free_it)
+		free(job);
+}
+
+void cpu_process_local_jobs(void)
+{
+}
+
+struct range {
+	uint64_t start, end;
+	uint32_t chip_id;
+};
+
+static void check(const struct range *r, unsigned int count)
+{
+	unsigned int i, chunks;
+	uint64_t j, len;
+
+	memset(mem, 0xa5, MEM_SIZE);
+	memset(counts, 0, MEM_SIZE);
+	nr_jobs = nr_run = nr_inline = nr_any = 0;
+
+	for (i = 0; i < count; i++)
+		mem_clear_queue((uint64_t)mem + r[i].start,
+				(uint64_t)mem + r[i].end, r[i].chip_id);
+
+	/* Every job runs on the chip it was asked for, if it can */
+	chunks = 0;
+	for (i = 0; i < nr_jobs; i++) {
+		struct mem_clear_chunk *c = jobs[i]->data;
+
+		assert(c->end - c->start <= chunk_size);
+		assert(c->end > c->start);
+		for (j = 0; j < count; j++) {
+			if (c->start < (uint64_t)mem + r[j].start ||
+			    c->end > (uint64_t)mem + r[j].end)
+				continue;
+			if (r[j].chip_id < NR_CHIPS)
+				assert(jobs[i]->chip_id == r[j].chip_id);
+			else
+				assert(jobs[i]->chip_id == NO_CHIP);
+			chunks++;
+		}
+	}
+	assert(chunks == nr_jobs);
+
+	mem_clear_wait();
+	assert(list_empty(&mem_clear_chunks));
+
+	/* Inside the ranges exactly once, nothing outside */
+	for (i = 0, j = 0; j < MEM_SIZE; j++) {
+		while (i < count && j >= r[i].end)
+			i++;
+		if (i < count && j >= r[i].start) {
+			assert(mem[j] == 0);
+			assert(fail_jobs || counts[j] == 1);
+		} else {
+			assert(mem[j] == 0xa5);
+			assert(counts[j] == 0);
+		}
+	}
+
+	/* Chunks are as big as they can be */
+	for (i = 0, len = 0; i < count; i++)
+		len += r[i].end - r[i].start;
+	if (!fail_jobs)
+		assert(nr_jobs >= len / chunk_size);
+	for (i = 0; i < nr_jobs; i++)
+		jobs[i] = NULL;
+}
+
+int main(void)
+{
+	/* Sorted, like the regions list, with holes for reservations */
+	static const struct range fixed[] = {
+		{ 0x0, 0x1000, 0 },
+		{ 0x1080, 0x20001, 0 },
+		{ 0x20001, 0x3ffff, 1 },
+		{ 0x40000, 0x40001, 1 },
+		{ 0x41003, 0x58000, 7 },
+		{ 0x60000, MEM_SIZE - 3, 1 },
+	};
+	static struct range r[64];
+	unsigned int i, n, run;
+	uint64_t pos;
+
+	mem = aligned_alloc(1 << 16, MEM_SIZE);
+	assert(mem);
+	srandom(1);
+
+	for (chunk_size = 64; chunk_size <= 4 * MEM_SIZE; chunk_size <<= 1)
+		check(fixed, ARRAY_SIZE(fixed));
+
+	/* Random ranges with random chunking */
+	for (run = 0; run < 50; run++) {
+		chunk_size = 1ull << (6 + random() % 16);
+		pos = 0;
+		for (n = 0; n < ARRAY_SIZE(r); n++) {
+			pos += random() % 0x2000;
+			if (pos >= MEM_SIZE)
+				break;
+			r[n].start = pos;
+			pos += 1 + random() % 0x8000;
+			if (pos > MEM_SIZE)
+				pos = MEM_SIZE;
+			r[n].end = pos;
+			r[n].chip_id = random() % (NR_CHIPS + 1);
+		}
+		check(r, n);
+	}
+
+	/* Without jobs the clearing is done inline */
+	fail_jobs = true;
+	chunk_size = 4096;
+	check(fixed, ARRAY_SIZE(fixed));
+	assert(nr_jobs == 0);
+	for (i = 0, n = 0; i < ARRAY_SIZE(fixed); i++)
+		n += ALIGN_UP(fixed[i].end, chunk_size) / chunk_size -
+			fixed[i].start / chunk_size;
+	assert(nr_inline == n);
+
+	free(mem);
+	return 0;
+}
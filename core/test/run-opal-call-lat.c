@@ -0,0 +1,260 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The histogram math, the layout of the exported OPAL call latencies as
+ * the decoder sees it, and how long recording a call takes.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <skiboot.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#include <ccan/list/list.h>
+
+struct cpu_thread {
+	uint32_t		pir;
+	uint32_t		chip_id;
+	uint64_t		opal_call_tb;
+	struct lat_hist		*opal_call_lat;
+};
+
+#define NR_CPUS	6
+static struct cpu_thread cpus[NR_CPUS];
+
+static inline struct cpu_thread *this_cpu(void)
+{
+	return &cpus[0];
+}
+
+#define for_each_cpu(c)	for (c = cpus; c < cpus + NR_CPUS; c++)
+
+#include "../opal-call-lat.c"
+
+unsigned long tb_hz = 512000000;
+
+static size_t alloc_size;
+
+void *__local_alloc(unsigned int chip __unused, size_t size, size_t align,
+		    const char *location __unused)
+{
+	void *p;
+
+	alloc_size = size;
+	assert(posix_memalign(&p, align, size) == 0);
+	return p;
+}
+
+static bool enabled;
+
+bool nvram_query_eq(const char *key, const char *value)
+{
+	assert(!strcmp(key, "opal-call-latency"));
+	assert(!strcmp(value, "true"));
+	return enabled;
+}
+
+static void *export_base;
+static uint64_t export_size;
+
+void opal_add_export(const char *name, void *base, uint64_t size)
+{
+	assert(!strcmp(name, "opal_call_latency"));
+	export_base = base;
+	export_size = size;
+}
+
+void _prlog(int log_level __unused, const char *fmt __unused, ...)
+{
+}
+
+static void check_buckets(void)
+{
+	struct lat_hist h;
+	unsigned int i;
+
+	assert(lat_hist_bucket(0) == 0);
+	assert(lat_hist_bucket(1) == 0);
+	for (i = 1; i < LAT_HIST_BUCKETS - 1; i++) {
+		assert(lat_hist_bucket(1ul << i) == i);
+		assert(lat_hist_bucket((1ul << (i + 1)) - 1) == i);
+	}
+	assert(lat_hist_bucket(1ul << (LAT_HIST_BUCKETS - 1)) ==
+	       LAT_HIST_BUCKETS - 1);
+	assert(lat_hist_bucket(~0ul) == LAT_HIST_BUCKETS - 1);
+
+	memset(&h, 0, sizeof(h));
+	lat_hist_add(&h, usecs_to_tb(3));
+	lat_hist_add(&h, usecs_to_tb(100));
+	lat_hist_add(&h, usecs_to_tb(1));
+	lat_hist_add(&h, 0);
+	assert(h.count == 4);
+	assert(h.total_us == 104);
+	assert(h.max_us == 100);
+	assert(h.bucket[0] == 2);
+	assert(h.bucket[1] == 1);
+	assert(h.bucket[6] == 1);
+}
+
+/* What an OPAL call does, with the call taking us microseconds */
+static void call(struct cpu_thread *cpu, uint64_t token, unsigned long us)
+{
+	cpu->opal_call_tb = mftb();
+	stamp += usecs_to_tb(us);
+	opal_call_lat_record(cpu, token);
+}
+
+/* Counters are in the firmware's endianness, the host's here */
+#define fw64(x)	((uint64_t)(x))
+
+/* Reads the export the way the decoder does */
+static const struct opal_call_lat_hist *hist(unsigned int cpu_idx,
+					     unsigned int token)
+{
+	const struct opal_call_lat_hdr *hdr = export_base;
+	const struct opal_call_lat_cpu *blk;
+
+	blk = export_base + be32_to_cpu(hdr->hdr_size) +
+		cpu_idx * be32_to_cpu(hdr->cpu_size);
+	assert(be32_to_cpu(blk->pir) == cpus[cpu_idx].pir);
+	return &blk->hist[token];
+}
+
+static void check_export(void)
+{
+	const struct opal_call_lat_hdr *hdr;
+	const struct opal_call_lat_hist *h;
+	unsigned int i;
+	void *blk;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		cpus[i].pir = 0x20 + i * 4;
+		cpus[i].opal_call_lat = NULL;
+	}
+
+	/* Nothing unless asked for */
+	enabled = false;
+	opal_call_lat_init();
+	assert(!export_base);
+	for (i = 0; i < NR_CPUS; i++)
+		assert(!cpus[i].opal_call_lat);
+
+	enabled = true;
+	opal_call_lat_init();
+	assert(export_base && export_size == alloc_size);
+
+	hdr = export_base;
+	assert(be32_to_cpu(hdr->magic) == OPAL_CALL_LAT_MAGIC);
+	assert(be32_to_cpu(hdr->version) == OPAL_CALL_LAT_VERSION);
+	assert(be32_to_cpu(hdr->nr_cpus) == NR_CPUS);
+	assert(be32_to_cpu(hdr->nr_tokens) == OPAL_LAST + 1);
+	assert(be32_to_cpu(hdr->nr_buckets) == OPAL_CALL_LAT_BUCKETS);
+	assert(be64_to_cpu(hdr->tb_hz) == tb_hz);
+	assert(export_size == be32_to_cpu(hdr->hdr_size) +
+	       NR_CPUS * be32_to_cpu(hdr->cpu_size));
+
+	/* Each CPU writes its own cachelines and nobody else's */
+	assert(be32_to_cpu(hdr->cpu_size) % OPAL_CALL_LAT_ALIGN == 0);
+	for (i = 0; i < NR_CPUS; i++) {
+		blk = export_base + be32_to_cpu(hdr->hdr_size) +
+			i * be32_to_cpu(hdr->cpu_size);
+		assert((unsigned long)blk % OPAL_CALL_LAT_ALIGN == 0);
+		assert((void *)cpus[i].opal_call_lat > blk);
+		assert((void *)&cpus[i].opal_call_lat[OPAL_LAST + 1] <=
+		       blk + be32_to_cpu(hdr->cpu_size));
+	}
+
+	call(&cpus[0], OPAL_POLL_EVENTS, 3);
+	call(&cpus[0], OPAL_POLL_EVENTS, 5);
+	call(&cpus[0], OPAL_LAST, 1000);
+	call(&cpus[NR_CPUS - 1], OPAL_POLL_EVENTS, 20);
+	/* Not a token, not recorded anywhere */
+	call(&cpus[1], OPAL_LAST + 1, 7);
+
+	h = hist(0, OPAL_POLL_EVENTS);
+	assert(fw64(h->count) == 2);
+	assert(fw64(h->total_us) == 8);
+	assert(fw64(h->max_us) == 5);
+	assert(fw64(h->bucket[1]) == 1);
+	assert(fw64(h->bucket[2]) == 1);
+
+	h = hist(0, OPAL_LAST);
+	assert(fw64(h->count) == 1);
+	assert(fw64(h->bucket[lat_hist_bucket(1000)]) == 1);
+
+	h = hist(NR_CPUS - 1, OPAL_POLL_EVENTS);
+	assert(fw64(h->count) == 1);
+	assert(fw64(h->max_us) == 20);
+
+	for (i = 1; i < NR_CPUS - 1; i++)
+		assert(fw64(hist(i, OPAL_POLL_EVENTS)->count) == 0);
+	assert(fw64(hist(2, OPAL_LAST)->count) == 0);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define BENCH_CALLS	1000000
+
+/*
+ * Everything recording adds to a call, with the latencies spread over
+ * the buckets. Firmware also pays for the two mftb, a few tens of cycles.
+ */
+static void bench(void)
+{
+	struct cpu_thread *cpu = &cpus[2];
+	unsigned int i;
+	double start, ns;
+
+	start = now_ns();
+	for (i = 0; i < BENCH_CALLS; i++) {
+		cpu->opal_call_tb = mftb();
+		stamp += (i * 2654435761u) & 0xfffff;
+		opal_call_lat_record(cpu, i % (OPAL_LAST + 1));
+	}
+	ns = (now_ns() - start) / BENCH_CALLS;
+	printf("%.1fns per recorded call\n", ns);
+
+	/* Generous, valgrind and gcov builds run this too */
+	assert(ns < 2000);
+}
+
+int main(void)
+{
+	stamp = 1000;
+
+	check_buckets();
+	check_export();
+	bench();
+
+	return 0;
+}
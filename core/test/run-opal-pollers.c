@@ -0,0 +1,348 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * opal_run_pollers() with mock pollers: plain ones run every time, timed
+ * ones only when their interval is up or an event they're interested in
+ * was kicked. Checks the run and skip counters and the time accounting.
+ */
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <skiboot.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#include <ccan/list/list.h>
+
+/* The firmware's format strings don't match the host's uint64_t */
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+#undef prlog
+#define prlog(l, ...)	mock_printf(__VA_ARGS__)
+#define printf(...)	mock_printf(__VA_ARGS__)
+
+#define zalloc(bytes)	calloc((bytes), 1)
+
+static inline int ilog2(unsigned long val)
+{
+	return 63 - __builtin_clzl(val);
+}
+
+struct cpu_thread {
+	uint32_t		pir;
+	uint32_t		in_opal_call;
+	uint32_t		quiesce_opal_call;
+	struct list_head	locks_held;
+	bool			in_poller;
+	uint64_t		current_token;
+	uint64_t		opal_call_tb;
+	struct lat_hist		*opal_call_lat;
+};
+
+static struct cpu_thread the_cpu;
+unsigned int cpu_max_pir;
+
+static inline struct cpu_thread *this_cpu(void)
+{
+	return &the_cpu;
+}
+
+static inline struct cpu_thread *find_cpu_by_server(u32 server_no __unused)
+{
+	return NULL;
+}
+
+#define for_each_cpu(c)	for (c = &the_cpu; c; c = NULL)
+
+#define mfspr(spr)	0
+#define smt_lowest()
+#define smt_medium()
+
+static inline uint32_t cmpxchg32(uint32_t *mem, uint32_t old, uint32_t new)
+{
+	uint32_t prev = *mem;
+
+	if (prev == old)
+		*mem = new;
+	return prev;
+}
+
+#include "../opal.c"
+#include "../../ccan/list/list.c"
+
+unsigned long tb_hz = 512000000;
+unsigned long top_of_ram = 0x0fffffffffffffffUL;
+
+/* From head.S and the linker script */
+uint64_t opal_branch_table[OPAL_LAST + 1];
+struct opal_table_entry __opal_table_start[1], __opal_table_end[1];
+char __sym_map_start[1], __sym_map_end[1];
+uint32_t opal_entry, attn_trigger, hir_trigger;
+
+const char version[] = "test";
+struct dt_node *dt_root;
+enum proc_gen proc_gen;
+bool bust_locks;
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+static unsigned int nr_timer_checks;
+
+void check_timers(bool from_interrupt __unused)
+{
+	nr_timer_checks++;
+}
+
+void backtrace(void) {}
+void opal_call_lat_record(struct cpu_thread *cpu __unused,
+			  uint64_t token __unused) {}
+void dump_locks_list(void) {}
+void drop_my_locks(bool warn __unused) {}
+void disable_fast_reboot(const char *reason __unused) {}
+void occ_send_dummy_interrupt(void) {}
+void add_associativity_ref_point(void) {}
+void memcons_add_properties(void) {}
+void fsp_trigger_reset(uint32_t plid __unused) {}
+
+uint32_t log_simple_error(struct opal_err_info *e_info __unused,
+			  const char *fmt __unused, ...)
+{
+	return 0;
+}
+
+struct dt_node *dt_new(struct dt_node *parent __unused,
+		       const char *name __unused)
+{
+	return NULL;
+}
+
+struct dt_node *dt_new_check(struct dt_node *parent __unused,
+			     const char *name __unused)
+{
+	return NULL;
+}
+
+struct dt_node *dt_find_by_path(struct dt_node *root __unused,
+				const char *path __unused)
+{
+	return NULL;
+}
+
+struct dt_property *__dt_add_property_cells(struct dt_node *node __unused,
+					    const char *name __unused,
+					    int count __unused, ...)
+{
+	return NULL;
+}
+
+struct dt_property *__dt_add_property_u64s(struct dt_node *node __unused,
+					   const char *name __unused,
+					   int count __unused, ...)
+{
+	return NULL;
+}
+
+struct dt_property *__dt_add_property_strings(struct dt_node *node __unused,
+					      const char *name __unused,
+					      int count __unused, ...)
+{
+	return NULL;
+}
+
+struct dt_property *dt_add_property_string(struct dt_node *node __unused,
+					   const char *name __unused,
+					   const char *value __unused)
+{
+	return NULL;
+}
+
+struct dt_property *dt_add_property(struct dt_node *node __unused,
+				    const char *name __unused,
+				    const void *val __unused,
+				    size_t size __unused)
+{
+	return NULL;
+}
+
+#define EVT_A	PPC_BIT(60)
+#define EVT_B	PPC_BIT(61)
+
+struct mock_poller {
+	unsigned int calls;
+	/* How long a call takes */
+	unsigned long tb;
+	/* Events kicked by each call */
+	uint64_t kick;
+};
+
+static struct mock_poller plain, timed, evt, both;
+
+static void mock_poll(void *data)
+{
+	struct mock_poller *p = data;
+
+	p->calls++;
+	stamp += p->tb;
+	if (p->kick)
+		opal_kick_pollers(p->kick);
+}
+
+static struct opal_poll_entry *find_entry(struct mock_poller *p)
+{
+	struct opal_poll_entry *ent;
+
+	list_for_each(&opal_pollers, ent, link)
+		if (ent->data == p)
+			return ent;
+	assert(0);
+	return NULL;
+}
+
+static void run(unsigned int n, unsigned long step)
+{
+	while (n--) {
+		opal_run_pollers();
+		stamp += step;
+	}
+}
+
+static void reset_calls(void)
+{
+	plain.calls = timed.calls = evt.calls = both.calls = 0;
+}
+
+int main(void)
+{
+	struct opal_poller_stats stats;
+	struct opal_poll_entry *ent;
+	unsigned int i;
+
+	list_head_init(&the_cpu.locks_held);
+	stamp = 1000;
+
+	opal_add_poller(mock_poll, &plain);
+	opal_add_poller_timed(mock_poll, &timed, "timed", 0, 10);
+	opal_add_poller_timed(mock_poll, &evt, "evt", EVT_A, 0);
+	opal_add_poller_timed(mock_poll, &both, "both", EVT_A | EVT_B, 100);
+
+	/* Timed ones run straight away the first time */
+	run(1, 0);
+	assert(plain.calls == 1 && timed.calls == 1);
+	assert(evt.calls == 0 && both.calls == 1);
+	assert(nr_timer_checks == 1);
+
+	/* 1ms steps for 1s, the plain one runs every time */
+	reset_calls();
+	run(1000, msecs_to_tb(1));
+	assert(plain.calls == 1000);
+	assert(timed.calls == 99);
+	assert(both.calls == 9);
+	assert(evt.calls == 0);
+
+	ent = find_entry(&timed);
+	assert(ent->runs == 100);
+	assert(ent->skips == 901);
+	assert(find_entry(&plain)->skips == 0);
+	assert(find_entry(&evt)->skips == 1001);
+
+	/* An event runs the pollers interested in it once, whatever the time */
+	reset_calls();
+	opal_kick_pollers(EVT_A);
+	run(1, 0);
+	assert(evt.calls == 1 && both.calls == 1);
+	run(1, 0);
+	assert(evt.calls == 1 && both.calls == 1);
+
+	opal_kick_pollers(EVT_B);
+	run(1, 0);
+	assert(evt.calls == 1 && both.calls == 2);
+
+	/* Kicked from a poller, it's for the next run */
+	plain.kick = EVT_A;
+	run(1, 0);
+	assert(evt.calls == 1);
+	plain.kick = 0;
+	run(1, 0);
+	assert(evt.calls == 2 && both.calls == 3);
+	run(1, 0);
+	assert(evt.calls == 2 && both.calls == 3);
+	assert(!opal_poll_kicked);
+
+	/* Being kicked restarts the interval */
+	reset_calls();
+	run(100, msecs_to_tb(1));
+	assert(both.calls == 0);
+	run(1, msecs_to_tb(1));
+	assert(both.calls == 1);
+
+	/* Time spent in each poller is accounted to it */
+	timed.tb = usecs_to_tb(50);
+	plain.tb = usecs_to_tb(5);
+	ent = find_entry(&timed);
+	i = ent->runs;
+	ent->total_tb = 0;
+	find_entry(&plain)->total_tb = 0;
+	run(100, msecs_to_tb(1));
+	assert(ent->runs == i + 10);
+	assert(ent->total_tb == 10 * usecs_to_tb(50));
+	assert(ent->max_tb == usecs_to_tb(50));
+	assert(find_entry(&plain)->total_tb == 100 * usecs_to_tb(5));
+
+	/* A slow one shows up in its maximum */
+	timed.tb = usecs_to_tb(2000);
+	run(20, msecs_to_tb(1));
+	assert(tb_to_usecs(ent->max_tb) == 2000);
+
+	/* Which is what anyone asking for the named ones gets */
+	assert(opal_poller_stats("timed", &stats));
+	assert(stats.runs == ent->runs && stats.skips == ent->skips);
+	assert(stats.total_tb == ent->total_tb);
+	assert(tb_to_usecs(stats.max_tb) == 2000);
+	assert(opal_poller_stats("evt", &stats));
+	assert(stats.runs == find_entry(&evt)->runs);
+	assert(!opal_poller_stats("nope", &stats));
+	opal_dump_pollers();
+
+	/* Recursion is refused */
+	reset_calls();
+	the_cpu.in_opal_call = 1;
+	the_cpu.in_poller = true;
+	opal_run_pollers();
+	assert(plain.calls == 0);
+
+	return 0;
+}
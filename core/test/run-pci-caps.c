@@ -0,0 +1,283 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Capability lookups from the chains recorded at probe time must give
+ * the same answers as walking config space, without any config access.
+ */
+
+#define __TEST__
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <skiboot.h>
+
+static inline unsigned long mftb(void)
+{
+	return 42;
+}
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+/* The firmware's format strings don't match the host's uint64_t */
+#undef prlog
+#define prlog(l, ...)	mock_printf(__VA_ARGS__)
+
+#define zalloc(bytes)	calloc((bytes), 1)
+#define smt_lowest()
+#define smt_medium()
+
+static inline int ilog2(unsigned long val)
+{
+	return 63 - __builtin_clzl(val);
+}
+
+#include "../pci.c"
+#include "../../ccan/list/list.c"
+
+unsigned long tb_hz = 512000000;
+
+#define CAP_ID_MSI	0x05
+#define CAP_ID_MSIX	0x11
+
+#define CFG_SPACE_SIZE	0x1000
+#define NR_DEVS		8
+static uint8_t cfg[NR_DEVS][CFG_SPACE_SIZE];
+static unsigned int nr_reads;
+
+static struct phb phb;
+static struct pci_device devs[NR_DEVS];
+
+#define MOCK_READ(size, type)						\
+static int64_t mock_read##size(struct phb *p __unused, uint32_t bdfn,	\
+			       uint32_t offset, type *data)		\
+{									\
+	nr_reads++;							\
+	*data = (type)~0;						\
+	if (bdfn >= NR_DEVS || offset + sizeof(type) > CFG_SPACE_SIZE)	\
+		return OPAL_HARDWARE;					\
+	memcpy(data, &cfg[bdfn][offset], sizeof(type));			\
+	return OPAL_SUCCESS;						\
+}
+
+MOCK_READ(8, uint8_t)
+MOCK_READ(16, uint16_t)
+MOCK_READ(32, uint32_t)
+
+static const struct phb_ops mock_ops = {
+	.cfg_read8	= mock_read8,
+	.cfg_read16	= mock_read16,
+	.cfg_read32	= mock_read32,
+};
+
+/* Referenced by the rest of pci.c, never reached from here */
+struct platform platform;
+
+static unsigned int nr_stub_calls;
+
+#define STUB(proto)		proto { nr_stub_calls++; return 0; }
+#define STUB_VOID(proto)	proto { nr_stub_calls++; }
+
+STUB(struct cpu_job *__cpu_queue_job(struct cpu_thread *cpu __unused,
+				     const char *name __unused,
+				     void (*func)(void *data) __unused,
+				     void *data __unused,
+				     bool no_return __unused))
+STUB_VOID(void cpu_wait_job(struct cpu_job *job __unused, bool free_it __unused))
+STUB_VOID(void cpu_process_local_jobs(void))
+STUB(struct dt_node *dt_new(struct dt_node *parent __unused,
+			    const char *name __unused))
+STUB(struct dt_property *dt_add_property(struct dt_node *node __unused,
+					 const char *name __unused,
+					 const void *val __unused,
+					 size_t size __unused))
+STUB(struct dt_property *dt_add_property_string(struct dt_node *node __unused,
+						const char *name __unused,
+						const char *value __unused))
+STUB(struct dt_property *__dt_add_property_cells(struct dt_node *node __unused,
+						 const char *name __unused,
+						 int count __unused, ...))
+STUB_VOID(void dt_free(struct dt_node *node __unused))
+STUB(u32 dt_prop_get_u32(const struct dt_node *node __unused,
+			 const char *prop __unused))
+STUB(u32 dt_prop_get_u32_def(const struct dt_node *node __unused,
+			     const char *prop __unused, u32 def __unused))
+STUB(const void *dt_prop_get_def(const struct dt_node *node __unused,
+				 const char *prop __unused,
+				 void *def __unused))
+STUB(bool fsp_present(void))
+STUB_VOID(void pci_handle_quirk(struct phb *p __unused,
+			   struct pci_device *pd __unused))
+STUB_VOID(void pci_init_iov_cap(struct phb *p __unused,
+			   struct pci_device *pd __unused))
+STUB_VOID(void pci_slot_add_dt_properties(struct pci_slot *slot __unused,
+				     struct dt_node *np __unused))
+STUB_VOID(void time_wait(unsigned long duration __unused))
+STUB_VOID(void time_wait_ms(unsigned long ms __unused))
+STUB_VOID(void check_timers(bool from_interrupt __unused))
+
+static void set_cap(unsigned int dev, uint8_t pos, uint8_t id, uint8_t next)
+{
+	cfg[dev][pos] = id;
+	cfg[dev][pos + 1] = next;
+}
+
+static void set_ecap(unsigned int dev, uint16_t pos, uint16_t id,
+		     uint8_t version, uint16_t next)
+{
+	uint32_t val = id | (version << 16) | ((uint32_t)next << 20);
+
+	memcpy(&cfg[dev][pos], &val, sizeof(val));
+}
+
+static void set_caps_ptr(unsigned int dev, uint8_t pos)
+{
+	uint16_t stat = pos ? PCI_CFG_STAT_CAP : 0;
+
+	memcpy(&cfg[dev][PCI_CFG_STAT], &stat, sizeof(stat));
+	cfg[dev][PCI_CFG_CAP] = pos;
+}
+
+/* Everything the lookups can be asked, against walking config space */
+static void check_dev(unsigned int dev, bool cached, bool ecached)
+{
+	struct pci_device *pd = &devs[dev];
+	uint8_t ver, hw_ver;
+	unsigned int id, reads;
+	int64_t rc;
+
+	for (id = 0; id < 0x100; id++) {
+		reads = nr_reads;
+		rc = pci_dev_find_cap(&phb, pd, id);
+		assert(cached == (nr_reads == reads));
+		assert(rc == __pci_find_cap(&phb, dev, id, true));
+
+		reads = nr_reads;
+		assert(pci_find_cap(&phb, dev, id) == rc);
+		assert(cached == (nr_reads == reads));
+	}
+
+	for (id = 0; id < 0x40; id++) {
+		ver = hw_ver = 0xff;
+		reads = nr_reads;
+		rc = pci_dev_find_ecap(&phb, pd, id, &ver);
+		assert(ecached == (nr_reads == reads));
+		assert(rc == __pci_find_ecap(&phb, dev, id, &hw_ver));
+		assert(ver == hw_ver);
+
+		reads = nr_reads;
+		assert(pci_find_ecap(&phb, dev, id, NULL) == rc);
+		assert(ecached == (nr_reads == reads));
+	}
+}
+
+static void add_dev(unsigned int dev)
+{
+	struct pci_device *pd = &devs[dev];
+
+	pd->bdfn = dev;
+	pd->phb = &phb;
+	list_head_init(&pd->children);
+	list_add_tail(&phb.devices, &pd->link);
+	pci_cache_caps(&phb, pd);
+}
+
+int main(void)
+{
+	unsigned int i, reads;
+
+	phb.ops = &mock_ops;
+	list_head_init(&phb.devices);
+
+	/* PCIe function with PM, MSI and PCIe caps, AER, SR-IOV and ARI */
+	set_caps_ptr(0, 0x40);
+	set_cap(0, 0x40, PCI_CFG_CAP_ID_PM, 0x50);
+	set_cap(0, 0x50, CAP_ID_MSI, 0x60);
+	set_cap(0, 0x60, PCI_CFG_CAP_ID_EXP, 0);
+	set_ecap(0, 0x100, PCIECAP_ID_AER, 2, 0x140);
+	set_ecap(0, 0x140, PCIECAP_ID_SRIOV, 1, 0x180);
+	set_ecap(0, 0x180, 0x0e, 1, 0);
+
+	/* Conventional PCI, whatever is at 0x100 isn't a capability */
+	set_caps_ptr(1, 0x40);
+	set_cap(1, 0x40, PCI_CFG_CAP_ID_PM, 0);
+	set_ecap(1, 0x100, PCIECAP_ID_AER, 1, 0x100);
+
+	/* No capabilities at all */
+	set_caps_ptr(2, 0);
+
+	/* More capabilities than recorded */
+	set_caps_ptr(3, 0x40);
+	for (i = 0; i < PCI_CACHED_CAPS + 2; i++)
+		set_cap(3, 0x40 + i * 8, 0x20 + i, i == PCI_CACHED_CAPS + 1 ?
+			0 : 0x48 + i * 8);
+	set_cap(3, 0x40 + 4 * 8, PCI_CFG_CAP_ID_EXP, 0x48 + 4 * 8);
+	set_ecap(3, 0x100, PCIECAP_ID_AER, 1, 0);
+
+	/* Extended capability pointing at itself */
+	set_caps_ptr(4, 0x40);
+	set_cap(4, 0x40, PCI_CFG_CAP_ID_EXP, 0);
+	set_ecap(4, 0x100, PCIECAP_ID_AER, 1, 0x200);
+	set_ecap(4, 0x200, PCIECAP_ID_SRIOV, 1, 0x200);
+
+	for (i = 0; i < 5; i++)
+		add_dev(i);
+
+	/* Recording takes one read per capability, plus the pointers */
+	reads = nr_reads;
+	pci_uncache_caps(&phb, &devs[0]);
+	assert(nr_reads == reads);
+	assert(pci_dev_find_cap(&phb, &devs[0], CAP_ID_MSI) == 0x50);
+	assert(nr_reads == reads + 2 + 3 + 3);
+
+	check_dev(0, true, true);
+	check_dev(2, true, false);
+	check_dev(4, true, true);
+	assert(!devs[3].cap_cache.caps_valid);
+	check_dev(3, false, false);
+
+	/* Only the extended capabilities are looked up in config space */
+	assert(devs[1].cap_cache.caps_valid && !devs[1].cap_cache.ecaps_valid);
+	reads = nr_reads;
+	assert(pci_dev_find_cap(&phb, &devs[1], PCI_CFG_CAP_ID_PM) == 0x40);
+	assert(nr_reads == reads);
+	assert(pci_dev_find_ecap(&phb, &devs[1], PCIECAP_ID_AER, NULL) ==
+	       0x100);
+	assert(nr_reads > reads);
+
+	/* Not probed, so walked in config space */
+	set_caps_ptr(5, 0x40);
+	set_cap(5, 0x40, CAP_ID_MSI, 0);
+	reads = nr_reads;
+	assert(pci_find_cap(&phb, 5, CAP_ID_MSI) == 0x40);
+	assert(nr_reads > reads);
+
+	/* After a reset the chains are read again, they may have changed */
+	set_cap(0, 0x50, CAP_ID_MSIX, 0x60);
+	assert(pci_find_cap(&phb, 0, CAP_ID_MSIX) == OPAL_UNSUPPORTED);
+	pci_uncache_caps(&phb, NULL);
+	for (i = 0; i < 5; i++)
+		assert(devs[i].cap_cache.stale);
+	assert(pci_find_cap(&phb, 0, CAP_ID_MSIX) == 0x50);
+	assert(pci_find_cap(&phb, 0, CAP_ID_MSI) == OPAL_UNSUPPORTED);
+	check_dev(0, true, true);
+
+	assert(nr_stub_calls == 0);
+	return 0;
+}
@@ -0,0 +1,390 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Check that OPAL_PCI_CONFIG_ACCESS_VECTOR gives the same results as
+ * the single access calls, under one PHB lock.
+ */
+
+#define __TEST__
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <skiboot.h>
+
+static inline unsigned long mftb(void)
+{
+	return 42;
+}
+
+/* The firmware's format strings don't match the host's uint64_t */
+#undef prlog
+#define prlog(l, f, ...)	do { } while (0)
+
+#include "../pci-opal.c"
+
+/* Host stack addresses have to pass opal_addr_valid() */
+unsigned long top_of_ram = 0x0fffffffffffffffUL;
+unsigned long tb_hz = 512000000;
+
+/* Config space of a single bus, 256 devfns of 4k each */
+#define CFG_SPACE_SIZE	0x1000
+static uint8_t cfg[256][CFG_SPACE_SIZE];
+
+static struct phb phb;
+static unsigned int nr_locks, nr_unlocks;
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(l == &phb.lock);
+	assert(nr_locks == nr_unlocks);
+	nr_locks++;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l == &phb.lock);
+	nr_unlocks++;
+	assert(nr_locks == nr_unlocks);
+}
+
+struct phb *pci_get_phb(uint64_t phb_id)
+{
+	return phb_id == 0 ? &phb : NULL;
+}
+
+static int64_t mock_check(uint32_t bdfn, uint32_t offset, uint32_t size)
+{
+	/* Only bus 0 exists */
+	if (bdfn > 0xff)
+		return OPAL_HARDWARE;
+	if (offset & (size - 1))
+		return OPAL_PARAMETER;
+	if (offset + size > CFG_SPACE_SIZE)
+		return OPAL_PARAMETER;
+	return OPAL_SUCCESS;
+}
+
+#define MOCK_CFG(size, type)						\
+static int64_t mock_read##size(struct phb *p __unused, uint32_t bdfn,	\
+			       uint32_t offset, type *data)		\
+{									\
+	int64_t rc = mock_check(bdfn, offset, sizeof(type));		\
+									\
+	*data = (type)~0;						\
+	if (rc)								\
+		return rc;						\
+	memcpy(data, &cfg[bdfn][offset], sizeof(type));			\
+	return OPAL_SUCCESS;						\
+}									\
+static int64_t mock_write##size(struct phb *p __unused, uint32_t bdfn, \
+				uint32_t offset, type data)		\
+{									\
+	int64_t rc = mock_check(bdfn, offset, sizeof(type));		\
+									\
+	if (rc)								\
+		return rc;						\
+	memcpy(&cfg[bdfn][offset], &data, sizeof(type));		\
+	return OPAL_SUCCESS;						\
+}
+
+MOCK_CFG(8, uint8_t)
+MOCK_CFG(16, uint16_t)
+MOCK_CFG(32, uint32_t)
+
+static const struct phb_ops mock_ops = {
+	.cfg_read8	= mock_read8,
+	.cfg_read16	= mock_read16,
+	.cfg_read32	= mock_read32,
+	.cfg_write8	= mock_write8,
+	.cfg_write16	= mock_write16,
+	.cfg_write32	= mock_write32,
+};
+
+/*
+ * A PHB with its own vectored op, checking the device's state once per
+ * run of accesses to it like phb4 does, then accessing directly.
+ */
+static unsigned int nr_vector_calls, nr_run_checks;
+
+static void mock_access_vector(struct phb *p, struct opal_pci_cfg_access *accs,
+			       uint64_t count)
+{
+	uint64_t i;
+
+	nr_vector_calls++;
+	for (i = 0; i < count; i++) {
+		if (!i || accs[i].bdfn != accs[i - 1].bdfn)
+			nr_run_checks++;
+		accs[i].rc = cpu_to_be32(pci_cfg_access_one(p, &accs[i]));
+	}
+}
+
+static const struct phb_ops mock_vector_ops = {
+	.cfg_read8		= mock_read8,
+	.cfg_read16		= mock_read16,
+	.cfg_read32		= mock_read32,
+	.cfg_write8		= mock_write8,
+	.cfg_write16		= mock_write16,
+	.cfg_write32		= mock_write32,
+	.cfg_access_vector	= mock_access_vector,
+};
+
+/* Referenced by the rest of pci-opal.c, never reached from here */
+static unsigned int nr_stub_calls;
+
+int _opal_queue_msg(enum opal_msg_type msg_type __unused, void *data __unused,
+		    void (*consumed)(void *data) __unused,
+		    size_t num_params __unused, const u64 *params __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+void init_timer(struct timer *t __unused, timer_func_t expiry __unused,
+		void *data __unused)
+{
+	nr_stub_calls++;
+}
+
+uint64_t schedule_timer(struct timer *t __unused, uint64_t how_long __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+void opal_update_pending_evt(uint64_t evt_mask __unused,
+			     uint64_t evt_values __unused)
+{
+	nr_stub_calls++;
+}
+
+void pci_add_device_nodes(struct phb *p __unused,
+			  struct list_head *list __unused,
+			  struct dt_node *parent_node __unused,
+			  struct pci_lsi_state *lstate __unused,
+			  uint8_t swizzle __unused)
+{
+	nr_stub_calls++;
+}
+
+void pci_remove_bus(struct phb *p __unused, struct list_head *list __unused)
+{
+	nr_stub_calls++;
+}
+
+uint8_t pci_scan_bus(struct phb *p __unused, uint8_t bus __unused,
+		     uint8_t max_bus __unused, struct list_head *list __unused,
+		     struct pci_device *parent __unused,
+		     bool scan_downstream __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+struct pci_slot *pci_slot_find(uint64_t id __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+void pci_uncache_caps(struct phb *p __unused, struct pci_device *pd __unused)
+{
+	nr_stub_calls++;
+}
+
+static void init_cfg(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < 256; i++)
+		for (j = 0; j < CFG_SPACE_SIZE; j++)
+			cfg[i][j] = i ^ (j * 7);
+}
+
+static void set_acc(struct opal_pci_cfg_access *acc, uint16_t bdfn,
+		    uint16_t offset, uint8_t size, uint8_t op, uint32_t value)
+{
+	memset(acc, 0, sizeof(*acc));
+	acc->bdfn = cpu_to_be16(bdfn);
+	acc->offset = cpu_to_be16(offset);
+	acc->size = size;
+	acc->op = op;
+	acc->value = cpu_to_be32(value);
+	acc->rc = cpu_to_be32(0xdeadbeef);
+}
+
+/* Do the same access through the single access calls */
+static int64_t single(struct opal_pci_cfg_access *acc, uint32_t *value)
+{
+	uint16_t bdfn = be16_to_cpu(acc->bdfn);
+	uint16_t offset = be16_to_cpu(acc->offset);
+	uint32_t val = be32_to_cpu(acc->value);
+	uint8_t v8;
+	uint16_t v16;
+	int64_t rc;
+
+	*value = val;
+	if (acc->op == OPAL_PCI_CFG_ACCESS_WRITE) {
+		switch (acc->size) {
+		case 1:
+			return opal_pci_config_write_byte(0, bdfn, offset, val);
+		case 2:
+			return opal_pci_config_write_half_word(0, bdfn, offset,
+							       val);
+		case 4:
+			return opal_pci_config_write_word(0, bdfn, offset, val);
+		}
+		return OPAL_PARAMETER;
+	}
+
+	switch (acc->size) {
+	case 1:
+		rc = opal_pci_config_read_byte(0, bdfn, offset, &v8);
+		if (!rc)
+			*value = v8;
+		return rc;
+	case 2:
+		rc = opal_pci_config_read_half_word(0, bdfn, offset, &v16);
+		if (!rc)
+			*value = v16;
+		return rc;
+	case 4:
+		return opal_pci_config_read_word(0, bdfn, offset, value);
+	}
+	return OPAL_PARAMETER;
+}
+
+#define NR_ACCS	64
+
+int main(void)
+{
+	static struct opal_pci_cfg_access accs[NR_ACCS], ref[NR_ACCS];
+	static const uint8_t sizes[] = { 1, 2, 4, 3 };
+	static uint32_t values[NR_ACCS];
+	static int64_t rcs[NR_ACCS];
+	bool any_failed = false;
+	unsigned int i;
+	int64_t rc;
+
+	phb.ops = &mock_ops;
+	srandom(1);
+
+	/*
+	 * A mix of reads and writes, including some bad sizes, unaligned
+	 * offsets and absent devices. Run it once through the single
+	 * access calls and once vectored, starting from the same config
+	 * space, and compare.
+	 */
+	for (i = 0; i < NR_ACCS; i++) {
+		uint8_t size = sizes[random() % 4];
+		uint16_t bdfn = random() % 8;
+		uint16_t offset = random() % 0x100;
+
+		if (i % 13 == 0)
+			bdfn = 0x100;
+		if (i % 7)
+			offset &= ~(size - 1);
+		set_acc(&ref[i], bdfn, offset, size, random() % 2,
+			random());
+	}
+	memcpy(accs, ref, sizeof(accs));
+
+	init_cfg();
+	for (i = 0; i < NR_ACCS; i++) {
+		rcs[i] = single(&ref[i], &values[i]);
+		if (rcs[i])
+			any_failed = true;
+	}
+	assert(any_failed);
+
+	init_cfg();
+	nr_locks = nr_unlocks = 0;
+	rc = opal_pci_config_access_vector(0, accs, NR_ACCS);
+	assert(rc == OPAL_PARTIAL);
+	/* The whole batch ran under a single lock */
+	assert(nr_locks == 1);
+
+	for (i = 0; i < NR_ACCS; i++) {
+		assert((int32_t)be32_to_cpu(accs[i].rc) == rcs[i]);
+		if (rcs[i] == OPAL_SUCCESS)
+			assert(be32_to_cpu(accs[i].value) == values[i]);
+	}
+
+	/* All good accesses return OPAL_SUCCESS */
+	init_cfg();
+	for (i = 0; i < 4; i++)
+		set_acc(&accs[i], 1, 0x40, 4, OPAL_PCI_CFG_ACCESS_READ, 0);
+	set_acc(&accs[1], 1, 0x40, 4, OPAL_PCI_CFG_ACCESS_WRITE, 0x12345678);
+	set_acc(&accs[3], 1, 0x42, 2, OPAL_PCI_CFG_ACCESS_READ, 0);
+	rc = opal_pci_config_access_vector(0, accs, 4);
+	assert(rc == OPAL_SUCCESS);
+	for (i = 0; i < 4; i++)
+		assert(be32_to_cpu(accs[i].rc) == OPAL_SUCCESS);
+	/* Accesses are done in order */
+	assert(be32_to_cpu(accs[0].value) != 0x12345678);
+	assert(be32_to_cpu(accs[2].value) == 0x12345678);
+	assert(be32_to_cpu(accs[3].value) == 0x1234);
+
+	/* A bad op is caught per access */
+	set_acc(&accs[0], 1, 0x40, 4, 2, 0);
+	rc = opal_pci_config_access_vector(0, accs, 1);
+	assert(rc == OPAL_PARTIAL);
+	assert((int32_t)be32_to_cpu(accs[0].rc) == OPAL_PARAMETER);
+
+	/* Bad parameters for the whole call don't touch anything */
+	nr_locks = nr_unlocks = 0;
+	assert(opal_pci_config_access_vector(1, accs, 1) == OPAL_PARAMETER);
+	assert(opal_pci_config_access_vector(0, accs, 0) == OPAL_PARAMETER);
+	assert(opal_pci_config_access_vector(0, accs,
+				OPAL_PCI_CFG_ACCESS_MAX + 1) == OPAL_PARAMETER);
+	assert(opal_pci_config_access_vector(0,
+			(void *)(top_of_ram - sizeof(accs[0])), 2)
+	       == OPAL_PARAMETER);
+	assert(nr_locks == 0);
+
+	/*
+	 * A PHB with a cfg_access_vector op gets the whole batch in one
+	 * call, and the results still match the single accesses. Group
+	 * the accesses by device the way a save/restore would.
+	 */
+	phb.ops = &mock_vector_ops;
+	for (i = 0; i < NR_ACCS; i++)
+		ref[i].bdfn = cpu_to_be16(i / 16);
+	memcpy(accs, ref, sizeof(accs));
+
+	init_cfg();
+	for (i = 0; i < NR_ACCS; i++)
+		rcs[i] = single(&ref[i], &values[i]);
+
+	init_cfg();
+	nr_locks = nr_unlocks = 0;
+	rc = opal_pci_config_access_vector(0, accs, NR_ACCS);
+	assert(rc == OPAL_PARTIAL);
+	assert(nr_locks == 1);
+	assert(nr_vector_calls == 1);
+	assert(nr_run_checks == NR_ACCS / 16);
+	for (i = 0; i < NR_ACCS; i++) {
+		assert((int32_t)be32_to_cpu(accs[i].rc) == rcs[i]);
+		if (rcs[i] == OPAL_SUCCESS)
+			assert(be32_to_cpu(accs[i].value) == values[i]);
+	}
+
+	assert(nr_stub_calls == 0);
+
+	return 0;
+}
@@ -61,3 +61,18 @@ STUB(dt_next);
 STUB(dt_has_node_property);
 STUB(dt_get_address);
 STUB(add_chip_dev_associativity);
+STUB(mem_clear_queue);
+STUB(mem_clear_wait);
+STUB(_xscom_read);
+STUB(memcpy_from_ci);
+STUB(next_chip);
+STUB(dt_find_by_path);
+STUB(dt_find_by_name);
+STUB(dt_find_by_phandle);
+STUB(dt_node_is_compatible);
+STUB(dt_prop_get_u32);
+STUB(dt_check_del_prop);
+STUB(__dt_add_property_cells);
+STUB(secureboot_is_compatible);
+STUB(__cvc_sha512_v1);
+STUB(__cvc_verify_v1);
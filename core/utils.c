@@ -21,6 +21,7 @@
 #include <processor.h>
 #include <cpu.h>
 #include <stack.h>
+#include <console.h>
 
 void __noreturn assert_fail(const char *msg)
 {
@@ -45,6 +46,7 @@ void __noreturn _abort(const char *msg)
 
 	prlog(PR_EMERG, "Aborting!\n");
 	backtrace();
+	flush_console_sync();
 
 	if (platform.terminate)
 		platform.terminate(msg);
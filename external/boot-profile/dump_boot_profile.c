@@ -0,0 +1,149 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Decodes the ibm,opal/boot-profile property left by skiboot */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "../../ccan/endian/endian.h"
+#include "../../ccan/short_types/short_types.h"
+#include <boot-profile-types.h>
+
+static u64 tb_hz;
+static u64 first_tb;
+
+static double tb_to_ms(u64 tb)
+{
+	return (double)tb * 1000 / tb_hz;
+}
+
+static void dump_entry(const struct boot_profile_entry *e)
+{
+	u64 start = be64_to_cpu(e->start_tb);
+	u64 end = be64_to_cpu(e->end_tb);
+	char name[BOOT_PROFILE_NAME_LEN + 1];
+
+	memcpy(name, e->name, BOOT_PROFILE_NAME_LEN);
+	name[BOOT_PROFILE_NAME_LEN] = '\0';
+
+	/*
+	 * Anything timed before chiptod_init() ran on an unsynchronised
+	 * timebase and can't be placed against the rest.
+	 */
+	if (start < first_tb)
+		printf("%12s ", "?");
+	else
+		printf("%12.3f ", tb_to_ms(start - first_tb));
+
+	if (!end)
+		printf("%12s ", "unfinished");
+	else if (end < start)
+		printf("%12s ", "?");
+	else
+		printf("%12.3f ", tb_to_ms(end - start));
+
+	printf("%10.3f  ", tb_to_ms(be64_to_cpu(e->lock_wait_tb)));
+	if (e->type == BOOT_PROFILE_JOB)
+		printf("[%04x] ", be32_to_cpu(e->pir));
+	printf("%s\n", name);
+}
+
+static void dump_entries(const struct boot_profile_entry *e,
+			 unsigned int count, u8 type, const char *what)
+{
+	unsigned int i;
+
+	printf("\n%s:\n", what);
+	printf("%12s %12s %10s  %s\n", "start (ms)", "time (ms)",
+	       "lock (ms)", "name");
+	for (i = 0; i < count; i++)
+		if (e[i].type == type)
+			dump_entry(&e[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *in = "/proc/device-tree/ibm,opal/boot-profile";
+	const struct boot_profile_entry *entries;
+	const struct boot_profile_hdr *hdr;
+	unsigned int count;
+	size_t size = 0, alloc = 0;
+	char *buf = NULL;
+	ssize_t r;
+	int fd;
+
+	if (argc > 2)
+		errx(1, "Usage: dump_boot_profile [file]");
+
+	if (argv[1])
+		in = argv[1];
+	fd = open(in, O_RDONLY);
+	if (fd < 0)
+		err(1, "Opening %s", in);
+
+	do {
+		if (size == alloc) {
+			alloc += 0x10000;
+			buf = realloc(buf, alloc);
+			if (!buf)
+				err(1, "Reading %s", in);
+		}
+		r = read(fd, buf + size, alloc - size);
+		if (r < 0)
+			err(1, "Reading %s", in);
+		size += r;
+	} while (r);
+	close(fd);
+
+	hdr = (void *)buf;
+	if (size < sizeof(*hdr) ||
+	    be32_to_cpu(hdr->magic) != BOOT_PROFILE_MAGIC)
+		errx(1, "%s isn't a boot profile", in);
+	if (be32_to_cpu(hdr->version) != BOOT_PROFILE_VERSION)
+		errx(1, "Unknown boot profile version %u",
+		     be32_to_cpu(hdr->version));
+
+	count = be32_to_cpu(hdr->nr_entries);
+	if (size < sizeof(*hdr) + (size_t)count * sizeof(*entries))
+		errx(1, "%s is truncated", in);
+	entries = (void *)(hdr + 1);
+
+	tb_hz = be64_to_cpu(hdr->tb_hz);
+	if (!tb_hz)
+		errx(1, "Bad timebase frequency");
+
+	/* Times are relative to the first entry, the start of the boot */
+	first_tb = count ? be64_to_cpu(entries[0].start_tb) : 0;
+
+	printf("Timebase: %"PRIu64" Hz\n", tb_hz);
+	printf("Entries: %u (%u dropped)\n", count,
+	       be32_to_cpu(hdr->nr_dropped));
+	printf("Flash read: %"PRIu64" bytes\n", be64_to_cpu(hdr->flash_bytes));
+	printf("Lock wait: %.3f ms\n", tb_to_ms(be64_to_cpu(hdr->lock_wait_tb)));
+
+	dump_entries(entries, count, BOOT_PROFILE_PHASE, "Phases");
+	dump_entries(entries, count, BOOT_PROFILE_JOB, "Jobs");
+
+	free(buf);
+	return 0;
+}
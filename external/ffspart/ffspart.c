@@ -27,11 +27,13 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <libflash/libflash.h>
 #include <libflash/libffs.h>
 #include <libflash/blocklevel.h>
 #include <common/arch_flash.h>
+#include <mbedtls/sha512.h>
 
 /*
  * Flags:
@@ -57,6 +59,32 @@
 /* Full version number (possibly includes gitid). */
 extern const char version[];
 
+/* Partition data still to be copied into the image */
+struct part_job {
+	char name[FFS_PART_NAME_MAX + 1];
+	char *filename;
+	uint32_t base;
+	uint32_t size;
+	unsigned char digest[64];
+	int rc;
+};
+
+/*
+ * With --jobs (or --manifest) partition data isn't written as the
+ * layout is parsed, it is queued here and copied straight into a
+ * mapping of the image by a set of worker threads.
+ */
+struct part_jobs {
+	struct part_job *jobs;
+	unsigned int count;
+	unsigned int alloc;
+
+	pthread_mutex_t lock;
+	unsigned int next;
+	uint8_t *image;
+	bool digest;
+};
+
 static int read_u32(const char *input, uint32_t *val)
 {
 	char *endptr;
@@ -121,7 +149,39 @@ static struct ffs_hdr *parse_toc(const char *line, uint32_t block_size,
 	return hdr;
 }
 
-static int parse_entry(struct blocklevel_device *bl,
+static int queue_part_job(struct part_jobs *pj, const char *name,
+		const char *filename, uint32_t base, uint32_t size)
+{
+	struct part_job *job;
+
+	if (pj->count == pj->alloc) {
+		unsigned int alloc = pj->alloc ? pj->alloc * 2 : 16;
+
+		job = realloc(pj->jobs, alloc * sizeof(*job));
+		if (!job) {
+			fprintf(stderr, "Out of memory!\n");
+			return -1;
+		}
+		pj->jobs = job;
+		pj->alloc = alloc;
+	}
+
+	job = &pj->jobs[pj->count];
+	memset(job, 0, sizeof(*job));
+	snprintf(job->name, sizeof(job->name), "%s", name);
+	job->filename = strdup(filename);
+	if (!job->filename) {
+		fprintf(stderr, "Out of memory!\n");
+		return -1;
+	}
+	job->base = base;
+	job->size = size;
+	pj->count++;
+
+	return 0;
+}
+
+static int parse_entry(struct blocklevel_device *bl, struct part_jobs *pj,
 		struct ffs_hdr **tocs, const char *line)
 {
 	char name[FFS_PART_NAME_MAX + 2] = { 0 };
@@ -276,6 +336,11 @@ static int parse_entry(struct blocklevel_device *bl,
 			return -1;
 		}
 
+		if (pj) {
+			close(data_fd);
+			return queue_part_job(pj, name, filename, pbase, pactual);
+		}
+
 		data_ptr = mmap(NULL, pactual, PROT_READ, MAP_SHARED, data_fd, 0);
 		if (!data_ptr) {
 			fprintf(stderr, "Couldn't mmap file '%s' for '%s' partition "
@@ -295,6 +360,144 @@ static int parse_entry(struct blocklevel_device *bl,
 	return 0;
 }
 
+static int run_part_job(struct part_jobs *pj, struct part_job *job)
+{
+	uint8_t *data_ptr;
+	int data_fd;
+
+	if (job->size) {
+		data_fd = open(job->filename, O_RDONLY);
+		if (data_fd == -1) {
+			fprintf(stderr, "Couldn't open file '%s' for '%s' partition "
+					"(%m)\n", job->filename, job->name);
+			return -1;
+		}
+
+		data_ptr = mmap(NULL, job->size, PROT_READ, MAP_SHARED, data_fd, 0);
+		if (data_ptr == MAP_FAILED) {
+			fprintf(stderr, "Couldn't mmap file '%s' for '%s' partition "
+				"(%m)\n", job->filename, job->name);
+			close(data_fd);
+			return -1;
+		}
+
+		memcpy(pj->image + job->base, data_ptr, job->size);
+		munmap(data_ptr, job->size);
+		close(data_fd);
+	}
+
+	/* Digest what actually landed in the image */
+	if (pj->digest)
+		mbedtls_sha512(pj->image + job->base, job->size, job->digest, 0);
+
+	return 0;
+}
+
+static void *part_job_worker(void *arg)
+{
+	struct part_jobs *pj = arg;
+	struct part_job *job;
+
+	for (;;) {
+		pthread_mutex_lock(&pj->lock);
+		job = pj->next < pj->count ? &pj->jobs[pj->next++] : NULL;
+		pthread_mutex_unlock(&pj->lock);
+		if (!job)
+			break;
+
+		job->rc = run_part_job(pj, job);
+	}
+
+	return NULL;
+}
+
+static int run_part_jobs(struct part_jobs *pj, const char *pnor,
+		uint32_t image_size, unsigned int nr_threads)
+{
+	pthread_t *threads;
+	unsigned int i, started;
+	int fd, rc = 0;
+
+	fd = open(pnor, O_RDWR);
+	if (fd == -1) {
+		fprintf(stderr, "Couldn't open '%s' pnor file (%m)\n", pnor);
+		return -1;
+	}
+
+	pj->image = mmap(NULL, image_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (pj->image == MAP_FAILED) {
+		fprintf(stderr, "Couldn't mmap '%s' pnor file (%m)\n", pnor);
+		close(fd);
+		return -1;
+	}
+
+	if (nr_threads > pj->count)
+		nr_threads = pj->count;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads && nr_threads) {
+		fprintf(stderr, "Out of memory!\n");
+		rc = -1;
+		goto out;
+	}
+
+	pthread_mutex_init(&pj->lock, NULL);
+	pj->next = 0;
+	for (started = 0; started < nr_threads; started++)
+		if (pthread_create(&threads[started], NULL, part_job_worker, pj))
+			break;
+	/* Whatever didn't start, do it ourselves */
+	if (started < nr_threads)
+		part_job_worker(pj);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&pj->lock);
+	free(threads);
+
+	for (i = 0; i < pj->count; i++) {
+		if (pj->jobs[i].rc) {
+			fprintf(stderr, "Couldn't write file '%s' for '%s' partition to PNOR\n",
+					pj->jobs[i].filename, pj->jobs[i].name);
+			rc = -1;
+		}
+	}
+
+	if (msync(pj->image, image_size, MS_SYNC)) {
+		fprintf(stderr, "Couldn't sync '%s' pnor file (%m)\n", pnor);
+		rc = -1;
+	}
+out:
+	munmap(pj->image, image_size);
+	close(fd);
+	return rc;
+}
+
+static int write_manifest(struct part_jobs *pj, const char *manifest)
+{
+	unsigned int i, j;
+	FILE *f;
+
+	f = fopen(manifest, "w");
+	if (!f) {
+		fprintf(stderr, "Couldn't open manifest file %s: %m\n", manifest);
+		return -1;
+	}
+
+	/* Same format as sha512sum(1), partition names for file names */
+	for (i = 0; i < pj->count; i++) {
+		for (j = 0; j < sizeof(pj->jobs[i].digest); j++)
+			fprintf(f, "%02x", pj->jobs[i].digest[j]);
+		fprintf(f, "  %s\n", pj->jobs[i].name);
+	}
+
+	if (fclose(f)) {
+		fprintf(stderr, "Couldn't write manifest file %s: %m\n", manifest);
+		return -1;
+	}
+	return 0;
+}
+
 static void print_version(void)
 {
 	printf("Open-Power FFS format tool %s\n", version);
@@ -313,13 +516,22 @@ static void print_help(const char *pname)
 	printf("\t\tFile containing the required partition data\n\n");
 	printf("\t-p, --pnor=file\n");
 	printf("\t\tOutput file to write data\n\n");
+	printf("\t-j, --jobs=num\n");
+	printf("\t\tCopy partition data into the output file using num\n");
+	printf("\t\tthreads. The output is identical to the default\n");
+	printf("\t\tserial mode\n\n");
+	printf("\t-m, --manifest=file\n");
+	printf("\t\tWrite the SHA-512 of each partition's data to file,\n");
+	printf("\t\tin the format used by sha512sum\n\n");
 }
 
 int main(int argc, char *argv[])
 {
-	char *pnor = NULL, *input = NULL, line[MAX_LINE];
+	char *pnor = NULL, *input = NULL, *manifest = NULL, line[MAX_LINE];
 	bool toc_created = false, bad_input = false;
 	uint32_t block_size = 0, block_count = 0;
+	struct part_jobs jobs = { 0 }, *pj = NULL;
+	unsigned int nr_jobs = 0;
 	struct ffs_hdr *tocs[MAX_TOCS] = { 0 };
 	struct blocklevel_device *bl = NULL;
 	const char *pname = argv[0];
@@ -332,12 +544,14 @@ int main(int argc, char *argv[])
 			{"block_size",	required_argument,	NULL,	's'},
 			{"debug",	no_argument,	NULL,	'g'},
 			{"input",	required_argument,	NULL,	'i'},
+			{"jobs",	required_argument,	NULL,	'j'},
+			{"manifest",	required_argument,	NULL,	'm'},
 			{"pnor",	required_argument,	NULL,	'p'},
 			{NULL,	0,	0, 0}
 		};
 		int c, oidx = 0;
 
-		c = getopt_long(argc, argv, "+:c:gi:p:s:", long_opts, &oidx);
+		c = getopt_long(argc, argv, "+:c:gi:j:m:p:s:", long_opts, &oidx);
 		if (c == EOF)
 			break;
 		switch(c) {
@@ -353,6 +567,20 @@ int main(int argc, char *argv[])
 			if (!input)
 				fprintf(stderr, "Out of memory!\n");
 			break;
+		case 'j':
+			nr_jobs = strtoul(optarg, NULL, 0);
+			if (!nr_jobs) {
+				fprintf(stderr, "Invalid number of jobs '%s'\n",
+						optarg);
+				bad_input = true;
+			}
+			break;
+		case 'm':
+			free(manifest);
+			manifest = strdup(optarg);
+			if (!manifest)
+				fprintf(stderr, "Out of memory!\n");
+			break;
 		case 'p':
 			free(pnor);
 			pnor = strdup(optarg);
@@ -410,6 +638,11 @@ int main(int argc, char *argv[])
 		return 4;
 	}
 
+	if (nr_jobs || manifest) {
+		pj = &jobs;
+		pj->digest = manifest != NULL;
+	}
+
 	line_number = 0;
 	while (fgets(line, MAX_LINE, in_file) != NULL) {
 		line_number++;
@@ -459,7 +692,7 @@ int main(int argc, char *argv[])
 				}
 				toc_created = true;
 			}
-			rc = parse_entry(bl, tocs, line);
+			rc = parse_entry(bl, pj, tocs, line);
 			if (rc) {
 				rc = 6;
 				goto parse_out;
@@ -467,6 +700,17 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (pj) {
+		rc = run_part_jobs(pj, pnor, block_size * block_count,
+				nr_jobs ? nr_jobs : 1);
+		if (!rc && manifest)
+			rc = write_manifest(pj, manifest);
+		if (rc) {
+			rc = 8;
+			goto parse_out;
+		}
+	}
+
 	for(i = 0; i < MAX_TOCS; i++) {
 		if (tocs[i]) {
 			rc = ffs_hdr_finalise(bl, tocs[i]);
@@ -486,6 +730,10 @@ parse_out:
 	fclose(in_file);
 	for(i = 0; i < MAX_TOCS; i++)
 		ffs_hdr_free(tocs[i]);
+	for(i = 0; i < jobs.count; i++)
+		free(jobs.jobs[i].filename);
+	free(jobs.jobs);
+	free(manifest);
 	free(input);
 	free(pnor);
 	return rc;
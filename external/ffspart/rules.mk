@@ -7,6 +7,10 @@ LIBFLASH_FILES := libflash.c libffs.c ecc.c blocklevel.c file.c
 LIBFLASH_OBJS := $(addprefix libflash-, $(LIBFLASH_FILES:.c=.o))
 LIBFLASH_SRC := $(addprefix libflash/,$(LIBFLASH_FILES))
 OBJS	+= $(LIBFLASH_OBJS)
+MBEDTLS_FILES := sha512.c
+MBEDTLS_OBJS := $(addprefix mbedtls-, $(MBEDTLS_FILES:.c=.o))
+MBEDTLS_SRC := $(addprefix mbedtls/,$(MBEDTLS_FILES))
+OBJS	+= $(MBEDTLS_OBJS)
 OBJS	+= common-arch_flash.o
 
 CC	= $(CROSS_COMPILE)gcc
@@ -28,6 +32,14 @@ $(LIBFLASH_SRC): | links
 $(LIBFLASH_OBJS): libflash-%.o : libflash/%.c
 	$(Q_CC)$(CC) $(CFLAGS) -c $< -o $@
 
+mbedtls:
+	$(Q_LN)ln -sf ../../libstb/mbedtls ./mbedtls
+
+$(MBEDTLS_SRC): | mbedtls
+
+$(MBEDTLS_OBJS): mbedtls-%.o : mbedtls/%.c | mbedtls
+	$(Q_CC)$(CC) $(CFLAGS) -c $< -o $@
+
 $(EXE): $(OBJS)
-	$(Q_CC)$(CC) $(CFLAGS) $^ -lrt -o $@
+	$(Q_CC)$(CC) $(CFLAGS) $^ -lrt -lpthread -o $@
 
@@ -0,0 +1 @@
+const char version[] = "f61183c-dirty-f7ee5f7";
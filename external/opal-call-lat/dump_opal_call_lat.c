@@ -0,0 +1,199 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Decodes the opal_call_latency export left by skiboot */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "../../ccan/endian/endian.h"
+#include "../../ccan/short_types/short_types.h"
+#include <opal-call-lat-types.h>
+
+struct hist {
+	u64 count;
+	u64 total_us;
+	u64 max_us;
+	u64 bucket[OPAL_CALL_LAT_BUCKETS];
+};
+
+static void add_hist(struct hist *h, const struct opal_call_lat_hist *in)
+{
+	unsigned int i;
+	u64 max = be64_to_cpu(in->max_us);
+
+	h->count += be64_to_cpu(in->count);
+	h->total_us += be64_to_cpu(in->total_us);
+	if (max > h->max_us)
+		h->max_us = max;
+	for (i = 0; i < OPAL_CALL_LAT_BUCKETS; i++)
+		h->bucket[i] += be64_to_cpu(in->bucket[i]);
+}
+
+/* Upper bound of the bucket holding the given fraction of the calls */
+static void print_pct(const struct hist *h, unsigned int pct)
+{
+	u64 seen = 0, want = (h->count * pct + 99) / 100;
+	unsigned int i;
+
+	for (i = 0; i < OPAL_CALL_LAT_BUCKETS - 1; i++) {
+		seen += h->bucket[i];
+		if (seen >= want)
+			break;
+	}
+	if (i == OPAL_CALL_LAT_BUCKETS - 1)
+		printf(" %9s", "max");
+	else
+		printf(" %9"PRIu64, (u64)2 << i);
+}
+
+static void print_hist(const char *what, unsigned int token,
+		       const struct hist *h, bool buckets)
+{
+	unsigned int i;
+
+	printf("%-6s %5u %10"PRIu64" %9.1f %9"PRIu64, what, token, h->count,
+	       (double)h->total_us / h->count, h->max_us);
+	print_pct(h, 50);
+	print_pct(h, 99);
+	printf("\n");
+
+	if (!buckets)
+		return;
+	for (i = 0; i < OPAL_CALL_LAT_BUCKETS; i++) {
+		if (!h->bucket[i])
+			continue;
+		if (i == OPAL_CALL_LAT_BUCKETS - 1)
+			printf("%24s>= %-8u %10"PRIu64"\n", "", 1u << i,
+			       h->bucket[i]);
+		else
+			printf("%24s< %-9u %10"PRIu64"\n", "", 2u << i,
+			       h->bucket[i]);
+	}
+}
+
+static void usage(void)
+{
+	errx(1, "Usage: dump_opal_call_lat [-c] [-b] [file]\n"
+	     "  -c  per CPU as well as for all of them\n"
+	     "  -b  print the buckets");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *in = "/sys/firmware/opal/exports/opal_call_latency";
+	const struct opal_call_lat_hdr *hdr;
+	const struct opal_call_lat_cpu *blk;
+	unsigned int nr_cpus, nr_tokens, hdr_size, cpu_size, c, t;
+	bool per_cpu = false, buckets = false;
+	size_t size = 0, alloc = 0;
+	struct hist *total, h;
+	char *buf = NULL, pir[8];
+	ssize_t r;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "cb")) != -1) {
+		switch (opt) {
+		case 'c':
+			per_cpu = true;
+			break;
+		case 'b':
+			buckets = true;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc - optind > 1)
+		usage();
+	if (optind < argc)
+		in = argv[optind];
+
+	fd = open(in, O_RDONLY);
+	if (fd < 0)
+		err(1, "Opening %s", in);
+
+	do {
+		if (size == alloc) {
+			alloc += 0x100000;
+			buf = realloc(buf, alloc);
+			if (!buf)
+				err(1, "Reading %s", in);
+		}
+		r = read(fd, buf + size, alloc - size);
+		if (r < 0)
+			err(1, "Reading %s", in);
+		size += r;
+	} while (r);
+	close(fd);
+
+	hdr = (void *)buf;
+	if (size < sizeof(*hdr) ||
+	    be32_to_cpu(hdr->magic) != OPAL_CALL_LAT_MAGIC)
+		errx(1, "%s isn't an OPAL call latency export", in);
+	if (be32_to_cpu(hdr->version) != OPAL_CALL_LAT_VERSION)
+		errx(1, "Unknown OPAL call latency version %u",
+		     be32_to_cpu(hdr->version));
+	if (be32_to_cpu(hdr->nr_buckets) != OPAL_CALL_LAT_BUCKETS)
+		errx(1, "Unexpected number of buckets %u",
+		     be32_to_cpu(hdr->nr_buckets));
+
+	nr_cpus = be32_to_cpu(hdr->nr_cpus);
+	nr_tokens = be32_to_cpu(hdr->nr_tokens);
+	hdr_size = be32_to_cpu(hdr->hdr_size);
+	cpu_size = be32_to_cpu(hdr->cpu_size);
+	if (cpu_size < sizeof(*blk) + nr_tokens * sizeof(blk->hist[0]) ||
+	    size < hdr_size + (size_t)nr_cpus * cpu_size)
+		errx(1, "%s is truncated", in);
+
+	total = calloc(nr_tokens, sizeof(*total));
+	if (!total)
+		err(1, "Allocating");
+
+	printf("Timebase: %"PRIu64" Hz, %u CPUs\n",
+	       be64_to_cpu(hdr->tb_hz), nr_cpus);
+	printf("%-6s %5s %10s %9s %9s %9s %9s\n", "cpu", "token", "calls",
+	       "avg (us)", "max (us)", "p50 <", "p99 <");
+
+	for (c = 0; c < nr_cpus; c++) {
+		blk = (void *)buf + hdr_size + (size_t)c * cpu_size;
+		snprintf(pir, sizeof(pir), "%04x", be32_to_cpu(blk->pir));
+		for (t = 0; t < nr_tokens; t++) {
+			if (!blk->hist[t].count)
+				continue;
+			add_hist(&total[t], &blk->hist[t]);
+			if (!per_cpu)
+				continue;
+			memset(&h, 0, sizeof(h));
+			add_hist(&h, &blk->hist[t]);
+			print_hist(pir, t, &h, buckets);
+		}
+	}
+
+	for (t = 0; t < nr_tokens; t++)
+		if (total[t].count)
+			print_hist("all", t, &total[t], buckets);
+
+	free(total);
+	free(buf);
+	return 0;
+}
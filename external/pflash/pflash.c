@@ -38,6 +38,7 @@
 #include <libflash/blocklevel.h>
 #include <common/arch_flash.h>
 #include "progress.h"
+#include "pipeline.h"
 
 #define __aligned(x)			__attribute__((aligned(x)))
 
@@ -59,7 +60,6 @@ static bool dummy_run;
 static bool bmc_flash;
 
 #define FILE_BUF_SIZE	0x10000
-static uint8_t file_buf[FILE_BUF_SIZE] __aligned(0x1000);
 
 static bool check_confirm(void)
 {
@@ -401,16 +401,75 @@ static int set_ecc(struct flash_details *flash, uint32_t start, uint32_t size)
 	return 0;
 }
 
+struct program_ctx {
+	struct blocklevel_device *bl;
+	int fd;
+	uint32_t actual_size;
+	bool smart;
+};
+
+static int program_read_chunk(void *priv, uint64_t pos, uint8_t *buf,
+		uint32_t *len)
+{
+	struct program_ctx *ctx = priv;
+	ssize_t rc;
+
+	(void)pos;
+	rc = read(ctx->fd, buf, *len);
+	if (rc < 0) {
+		perror("Error reading file");
+		return 1;
+	}
+	*len = rc;
+	return 0;
+}
+
+static int program_write_error(int rc, uint64_t pos)
+{
+	if (rc == FLASH_ERR_VERIFY_FAILURE)
+		fprintf(stderr, "Verification failed for"
+			" chunk at 0x%08" PRIx64 "\n", pos);
+	else
+		fprintf(stderr, "Flash write error %d for"
+			" chunk at 0x%08" PRIx64 "\n", rc, pos);
+	return rc;
+}
+
+static int program_write_chunk(void *priv, uint64_t pos, uint8_t *buf,
+		uint32_t *len)
+{
+	struct program_ctx *ctx = priv;
+	int rc;
+
+	/*
+	 * blocklevel_smart_write() compares each erase block with the
+	 * image and only erases and writes the ones that differ.
+	 */
+	if (ctx->smart)
+		rc = blocklevel_smart_write(ctx->bl, pos, buf, *len);
+	else
+		rc = blocklevel_write(ctx->bl, pos, buf, *len);
+	if (rc)
+		return program_write_error(rc, pos);
+
+	ctx->actual_size += *len;
+	progress_tick(ctx->actual_size >> 8);
+	return 0;
+}
+
 static int program_file(struct blocklevel_device *bl,
 		const char *file, uint32_t start, uint32_t size,
-		struct ffs_handle *ffsh, int ffs_index)
+		struct ffs_handle *ffsh, int ffs_index, bool smart)
 {
+	struct program_ctx ctx = {
+		.bl = bl,
+		.smart = smart,
+	};
 	bool confirm;
-	int fd, rc = 0;
-	uint32_t actual_size = 0;
+	int rc = 0;
 
-	fd = open(file, O_RDONLY);
-	if (fd == -1) {
+	ctx.fd = open(file, O_RDONLY);
+	if (ctx.fd == -1) {
 		perror("Failed to open file");
 		return 1;
 	}
@@ -430,72 +489,51 @@ static int program_file(struct blocklevel_device *bl,
 
 	printf("Programming & Verifying...\n");
 	progress_init(size >> 8);
-	while(size) {
-		ssize_t len;
-
-		len = read(fd, file_buf, FILE_BUF_SIZE);
-		if (len < 0) {
-			perror("Error reading file");
-			rc = 1;
-			goto out;
-		}
-		if (len == 0)
-			break;
-		if (len > size)
-			len = size;
-		size -= len;
-		actual_size += len;
-		rc = blocklevel_write(bl, start, file_buf, len);
-		if (rc) {
-			if (rc == FLASH_ERR_VERIFY_FAILURE)
-				fprintf(stderr, "Verification failed for"
-					" chunk at 0x%08x\n", start);
-			else
-				fprintf(stderr, "Flash write error %d for"
-					" chunk at 0x%08x\n", rc, start);
-			goto out;
-		}
-		start += len;
-		progress_tick(actual_size >> 8);
-	}
+	rc = pipeline_run(start, size, FILE_BUF_SIZE, program_read_chunk,
+			program_write_chunk, &ctx);
 	progress_end();
+	if (rc)
+		goto out;
 
 	/* If this is a flash partition, adjust its size */
 	if (ffsh && ffs_index >= 0) {
 		printf("Updating actual size in partition header...\n");
-		ffs_update_act_size(ffsh, ffs_index, actual_size);
+		ffs_update_act_size(ffsh, ffs_index, ctx.actual_size);
 	}
 out:
-	close(fd);
+	close(ctx.fd);
 	return rc;
 }
 
-static int do_read_file(struct blocklevel_device *bl, const char *file,
-		uint32_t start, uint32_t size)
+struct read_ctx {
+	struct blocklevel_device *bl;
+	int fd;
+	uint32_t done;
+};
+
+static int read_flash_chunk(void *priv, uint64_t pos, uint8_t *buf,
+		uint32_t *len)
 {
-	int fd, rc = 0;
-	uint32_t done = 0;
+	struct read_ctx *ctx = priv;
+	int rc;
 
-	fd = open(file, O_WRONLY | O_TRUNC | O_CREAT, 00666);
-	if (fd == -1) {
-		perror("Failed to open file");
-		return 1;
-	}
-	printf("Reading to \"%s\" from 0x%08x..0x%08x !\n",
-	       file, start, start + size);
+	rc = blocklevel_read(ctx->bl, pos, buf, *len);
+	if (rc)
+		fprintf(stderr, "Flash read error %d for"
+			" chunk at 0x%08" PRIx64 "\n", rc, pos);
+	return rc;
+}
 
-	progress_init(size >> 8);
-	while(size) {
-		ssize_t len;
+static int read_write_chunk(void *priv, uint64_t pos, uint8_t *buf,
+		uint32_t *len)
+{
+	struct read_ctx *ctx = priv;
+	uint32_t left = *len;
+	ssize_t rc;
 
-		len = size > FILE_BUF_SIZE ? FILE_BUF_SIZE : size;
-		rc = blocklevel_read(bl, start, file_buf, len);
-		if (rc) {
-			fprintf(stderr, "Flash read error %d for"
-				" chunk at 0x%08x\n", rc, start);
-			break;
-		}
-		rc = write(fd, file_buf, len);
+	(void)pos;
+	while (left) {
+		rc = write(ctx->fd, buf, left);
 		/*
 		 * zero isn't strictly an error.
 		 * Treat it as such so we can be sure we'lre always
@@ -503,16 +541,36 @@ static int do_read_file(struct blocklevel_device *bl, const char *file,
 		 */
 		if (rc <= 0) {
 			perror("Error writing file");
-			break;
+			return 1;
 		}
-		start += rc;
-		size -= rc;
-		done += rc;
-		progress_tick(done >> 8);
+		buf += rc;
+		left -= rc;
+		ctx->done += rc;
+		progress_tick(ctx->done >> 8);
+	}
+	return 0;
+}
+
+static int do_read_file(struct blocklevel_device *bl, const char *file,
+		uint32_t start, uint32_t size)
+{
+	struct read_ctx ctx = { .bl = bl };
+	int rc;
+
+	ctx.fd = open(file, O_WRONLY | O_TRUNC | O_CREAT, 00666);
+	if (ctx.fd == -1) {
+		perror("Failed to open file");
+		return 1;
 	}
+	printf("Reading to \"%s\" from 0x%08x..0x%08x !\n",
+	       file, start, start + size);
+
+	progress_init(size >> 8);
+	rc = pipeline_run(start, size, FILE_BUF_SIZE, read_flash_chunk,
+			read_write_chunk, &ctx);
 	progress_end();
-	close(fd);
-	return size ? rc : 0;
+	close(ctx.fd);
+	return rc;
 }
 
 static int enable_4B_addresses(struct blocklevel_device *bl)
@@ -677,6 +735,10 @@ static void print_help(const char *pname)
 	printf("\t\tthe specified size (whatever is smaller). If used in\n");
 	printf("\t\tconjunction with any erase command, the erase will\n");
 	printf("\t\ttake place first.\n\n");
+	printf("\t--smart\n");
+	printf("\t\tWhen programming, compare each erase block with the\n");
+	printf("\t\tfile first and only erase and write the blocks that\n");
+	printf("\t\tdiffer. Implies --erase for the programmed range.\n\n");
 	printf("\t-t, --tune\n");
 	printf("\t\tJust tune the flash controller & access size\n");
 	printf("\t\tMust be used in conjuction with --direct\n");
@@ -706,7 +768,7 @@ int main(int argc, char *argv[])
 	bool program = false, erase_all = false, info = false, do_read = false;
 	bool enable_4B = false, disable_4B = false;
 	bool show_help = false, show_version = false;
-	bool no_action = false, tune = false;
+	bool no_action = false, tune = false, smart = false;
 	char *write_file = NULL, *read_file = NULL, *part_name = NULL;
 	bool ffs_toc_seen = false, direct = false, print_detail = false;
 	int flash_side = 0;
@@ -737,6 +799,7 @@ int main(int argc, char *argv[])
 			{"side",	required_argument,	NULL,	'S'},
 			{"toc",		required_argument,	NULL,	'T'},
 			{"clear",   no_argument,        NULL,   'c'},
+			{"smart",	no_argument,		NULL,	'M'},
 			{NULL,	    0,                  NULL,    0 }
 		};
 		int c, oidx = 0;
@@ -839,6 +902,9 @@ int main(int argc, char *argv[])
 		case 'c':
 			do_clear = true;
 			break;
+		case 'M':
+			smart = true;
+			break;
 		case 'm':
 			print_detail = true;
 			if (optarg) {
@@ -949,6 +1015,16 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+	if (smart && !program) {
+		fprintf(stderr, "--smart only makes sense with --program\n");
+		rc = 1;
+		goto out;
+	}
+
+	/* Smart programming erases whatever it has to rewrite */
+	if (smart)
+		erase = true;
+
 	if (do_clear && !part_name) {
 		fprintf(stderr, "--clear only supported on a partition name\n");
 		rc = 1;
@@ -1145,12 +1221,15 @@ int main(int argc, char *argv[])
 		rc = do_read_file(flash.bl, read_file, address, read_size);
 	if (!rc && erase_all)
 		rc = erase_chip(&flash);
+	else if (!rc && erase && smart)
+		/* Smart programming erases the blocks it has to rewrite */
+		printf("Smart programming, only erasing blocks that differ\n");
 	else if (!rc && erase)
 		rc = erase_range(&flash, address, write_size,
 				program, ffsh, ffs_index);
 	if (!rc && program)
 		rc = program_file(flash.bl, write_file, address, write_size,
-				ffsh, ffs_index);
+				ffsh, ffs_index, smart);
 	if (!rc && do_clear)
 		rc = set_ecc(&flash, address, write_size);
 
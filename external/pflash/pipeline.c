@@ -0,0 +1,187 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "pipeline.h"
+
+/* Enough to keep both sides busy, more just costs memory */
+#define PIPELINE_DEPTH	4
+
+struct pipeline_slot {
+	uint8_t *buf;
+	uint64_t pos;
+	uint32_t len;
+};
+
+struct pipeline {
+	struct pipeline_slot slots[PIPELINE_DEPTH];
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/*
+	 * Free running counters, head is the next slot the producer
+	 * fills and tail the next slot the consumer drains.
+	 */
+	unsigned int head;
+	unsigned int tail;
+	bool eof;
+	int producer_rc;
+	int consumer_rc;
+
+	uint64_t pos;
+	uint64_t size;
+	uint32_t chunk_size;
+	pipeline_fn producer;
+	pipeline_fn consumer;
+	void *priv;
+};
+
+static void *producer_thread(void *arg)
+{
+	struct pipeline *p = arg;
+	uint64_t pos = p->pos, left = p->size;
+	int rc = 0;
+
+	while (left) {
+		struct pipeline_slot *slot;
+		uint32_t len = left > p->chunk_size ? p->chunk_size : left;
+
+		pthread_mutex_lock(&p->lock);
+		while (p->head - p->tail == PIPELINE_DEPTH && !p->consumer_rc)
+			pthread_cond_wait(&p->cond, &p->lock);
+		if (p->consumer_rc) {
+			pthread_mutex_unlock(&p->lock);
+			break;
+		}
+		slot = &p->slots[p->head % PIPELINE_DEPTH];
+		pthread_mutex_unlock(&p->lock);
+
+		rc = p->producer(p->priv, pos, slot->buf, &len);
+		if (rc || !len)
+			break;
+		if (len > left)
+			len = left;
+
+		slot->pos = pos;
+		slot->len = len;
+		pos += len;
+		left -= len;
+
+		pthread_mutex_lock(&p->lock);
+		p->head++;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+	}
+
+	pthread_mutex_lock(&p->lock);
+	p->producer_rc = rc;
+	p->eof = true;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct pipeline *p = arg;
+	int rc = 0;
+
+	for (;;) {
+		struct pipeline_slot *slot;
+
+		pthread_mutex_lock(&p->lock);
+		while (p->head == p->tail && !p->eof)
+			pthread_cond_wait(&p->cond, &p->lock);
+		if (p->head == p->tail) {
+			pthread_mutex_unlock(&p->lock);
+			break;
+		}
+		slot = &p->slots[p->tail % PIPELINE_DEPTH];
+		pthread_mutex_unlock(&p->lock);
+
+		rc = p->consumer(p->priv, slot->pos, slot->buf, &slot->len);
+
+		pthread_mutex_lock(&p->lock);
+		if (rc)
+			p->consumer_rc = rc;
+		else
+			p->tail++;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+
+		if (rc)
+			break;
+	}
+
+	return NULL;
+}
+
+int pipeline_run(uint64_t pos, uint64_t size, uint32_t chunk_size,
+		pipeline_fn producer, pipeline_fn consumer, void *priv)
+{
+	struct pipeline p = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+		.pos = pos,
+		.size = size,
+		.chunk_size = chunk_size,
+		.producer = producer,
+		.consumer = consumer,
+		.priv = priv,
+	};
+	pthread_t prod, cons;
+	int i, rc = 0;
+
+	for (i = 0; i < PIPELINE_DEPTH; i++) {
+		if (posix_memalign((void **)&p.slots[i].buf, 0x1000, chunk_size)) {
+			fprintf(stderr, "Couldn't allocate pipeline buffers\n");
+			rc = 1;
+			goto out;
+		}
+	}
+
+	if (pthread_create(&prod, NULL, producer_thread, &p)) {
+		fprintf(stderr, "Couldn't start pipeline reader\n");
+		rc = 1;
+		goto out;
+	}
+	if (pthread_create(&cons, NULL, consumer_thread, &p)) {
+		fprintf(stderr, "Couldn't start pipeline writer\n");
+		/* Make the producer give up and wait for it */
+		pthread_mutex_lock(&p.lock);
+		p.consumer_rc = 1;
+		pthread_cond_broadcast(&p.cond);
+		pthread_mutex_unlock(&p.lock);
+		pthread_join(prod, NULL);
+		rc = 1;
+		goto out;
+	}
+
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+
+	rc = p.consumer_rc ? p.consumer_rc : p.producer_rc;
+out:
+	for (i = 0; i < PIPELINE_DEPTH; i++)
+		free(p.slots[i].buf);
+	return rc;
+}
@@ -0,0 +1,42 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+#include <stdint.h>
+
+/*
+ * A pipeline moves a range of data from a producer to a consumer
+ * through a small ring of buffers. Each side runs in its own thread so
+ * that file I/O and flash I/O overlap rather than alternate.
+ *
+ * The producer is called with the position of the next chunk and, in
+ * *len, the most it may place in buf. It sets *len to what it actually
+ * produced, zero meaning there is no more data. The consumer is handed
+ * every chunk, in order, with *len set to its length.
+ *
+ * A non-zero return from either callback stops the pipeline and is
+ * what pipeline_run() returns. Chunks produced before a producer error
+ * are still consumed.
+ */
+typedef int (*pipeline_fn)(void *priv, uint64_t pos, uint8_t *buf,
+		uint32_t *len);
+
+int pipeline_run(uint64_t pos, uint64_t size, uint32_t chunk_size,
+		pipeline_fn producer, pipeline_fn consumer, void *priv);
+
+#endif /* __PIPELINE_H */
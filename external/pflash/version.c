@@ -0,0 +1 @@
+const char version[] = "f61183c-dirty-1367bf1";
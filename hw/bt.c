@@ -28,6 +28,7 @@
 #include <timebase.h>
 #include <chip.h>
 #include <interrupts.h>
+#include <platform.h>
 
 /* BT registers */
 #define BT_CTRL			0
@@ -64,6 +65,13 @@
 /* Maximum number of outstanding messages to allow in the queue. */
 #define BT_MAX_QUEUE_LEN	10
 
+/*
+ * Maximum number of requests sent to the BMC and waiting for a response,
+ * whatever the BMC says it can take. Keeps some of the queue for the
+ * messages that haven't been sent yet.
+ */
+#define BT_MAX_INFLIGHT		(BT_MAX_QUEUE_LEN / 2)
+
 /* How long (in seconds) before a message is timed out. */
 #define BT_MSG_TIMEOUT		3
 
@@ -91,11 +99,21 @@
 #define BT_Q_INF(msg, fmt, args...) \
 	_BT_Q_LOG(PR_INFO, msg, fmt, ##args)
 
+/* Messages waiting to be sent go out in this order, see bt_msg_prio() */
+enum bt_prio {
+	BT_PRIO_HIGH,		/* Watchdog and power control */
+	BT_PRIO_NORMAL,
+	BT_PRIO_LOW,		/* SEL and eSEL */
+	BT_NR_PRIOS,
+};
+
 struct bt_msg {
 	struct list_node link;
 	unsigned long tb;
 	uint8_t seq;
 	uint8_t send_count;
+	uint8_t prio;
+	bool inflight;
 	struct ipmi_msg ipmi_msg;
 };
 
@@ -110,9 +128,17 @@ struct bt_caps {
 struct bt {
 	uint32_t base_addr;
 	struct lock lock;
-	struct list_head msgq;
+	/* Waiting to be sent, one queue per priority */
+	struct list_head msgq[BT_NR_PRIOS];
+	/* Sent and waiting for a response, matched by sequence number */
+	struct list_head inflight;
+	int nr_inflight;
+	/* Last message written, still in the FIFO until the next one */
+	struct bt_msg *last_sent;
 	struct timer poller;
 	bool irq_ok;
+	/* A request is waiting for the BMC to take the last one */
+	bool fifo_wait;
 	int queue_len;
 	struct bt_caps caps;
 };
@@ -212,11 +238,38 @@ static inline bool bt_idle(void)
 	return !(bt_ctrl & BT_CTRL_B_BUSY) && !(bt_ctrl & BT_CTRL_H2B_ATN);
 }
 
-/* Must be called with bt.lock held */
-static void bt_msg_del(struct bt_msg *bt_msg)
+/*
+ * Messages waiting to be sent time out if the BMC doesn't make any
+ * progress, so restart their wait whenever it does.
+ */
+static void bt_restart_pending(void)
+{
+	struct bt_msg *bt_msg;
+	int prio;
+
+	for (prio = 0; prio < BT_NR_PRIOS; prio++) {
+		bt_msg = list_top(&bt.msgq[prio], struct bt_msg, link);
+		if (bt_msg)
+			bt_msg->tb = 0;
+	}
+}
+
+/* Takes a message off whichever queue it is on. Must hold bt.lock */
+static void bt_msg_unlink(struct bt_msg *bt_msg)
 {
 	list_del(&bt_msg->link);
 	bt.queue_len--;
+	if (bt_msg->inflight) {
+		bt_msg->inflight = false;
+		bt.nr_inflight--;
+	}
+	if (bt.last_sent == bt_msg)
+		bt.last_sent = NULL;
+}
+
+/* Times out a message that's on no queue. Must be called with bt.lock held */
+static void bt_msg_fail(struct bt_msg *bt_msg)
+{
 	unlock(&bt.lock);
 	ipmi_cmd_done(bt_msg->ipmi_msg.cmd,
 		      IPMI_NETFN_RETURN_CODE(bt_msg->ipmi_msg.netfn),
@@ -224,6 +277,13 @@ static void bt_msg_del(struct bt_msg *bt_msg)
 	lock(&bt.lock);
 }
 
+/* Must be called with bt.lock held */
+static void bt_msg_del(struct bt_msg *bt_msg)
+{
+	bt_msg_unlink(bt_msg);
+	bt_msg_fail(bt_msg);
+}
+
 static void bt_init_interface(void)
 {
 	/* Clear interrupt condition & enable irq */
@@ -294,6 +354,9 @@ static void bt_flush_msg(void)
 	/* Can't hurt to clear the write pointer again, just to be sure */
 	bt_outb(BT_CTRL_CLR_WR_PTR, BT_CTRL);
 	bt_set_h_busy(false);
+
+	/* Whatever we last wrote is gone, it gets resent if it times out */
+	bt.last_sent = NULL;
 }
 
 static void bt_get_resp(void)
@@ -327,8 +390,8 @@ static void bt_get_resp(void)
 	/* Byte 5 - Completion Code */
 	cc = bt_inb(BT_HOST2BMC);
 
-	/* Find the corresponding message */
-	list_for_each(&bt.msgq, tmp_bt_msg, link) {
+	/* Find the corresponding message, responses can come in any order */
+	list_for_each(&bt.inflight, tmp_bt_msg, link) {
 		if (tmp_bt_msg->seq == seq) {
 			bt_msg = tmp_bt_msg;
 			break;
@@ -364,8 +427,8 @@ static void bt_get_resp(void)
 
 	BT_Q_INF(bt_msg, "IPMI MSG done");
 
-	list_del(&bt_msg->link);
-	bt.queue_len--;
+	bt_msg_unlink(bt_msg);
+	bt_restart_pending();
 	unlock(&bt.lock);
 
 	/* Call IPMI layer to finish processing the message. */
@@ -375,25 +438,75 @@ static void bt_get_resp(void)
 	return;
 }
 
-static void bt_expire_old_msg(uint64_t tb)
+static bool bt_msg_expired(struct bt_msg *bt_msg, uint64_t tb)
+{
+	return bt_msg->tb > 0 &&
+		tb_compare(tb, bt_msg->tb + secs_to_tb(bt.caps.msg_timeout))
+			== TB_AAFTERB;
+}
+
+/* The next message to be sent, highest priority first */
+static struct bt_msg *bt_next_msg(void)
 {
 	struct bt_msg *bt_msg;
+	int prio;
 
-	bt_msg = list_top(&bt.msgq, struct bt_msg, link);
+	for (prio = 0; prio < BT_NR_PRIOS; prio++) {
+		bt_msg = list_top(&bt.msgq[prio], struct bt_msg, link);
+		if (bt_msg)
+			return bt_msg;
+	}
+	return NULL;
+}
+
+static struct bt_msg *bt_find_expired(uint64_t tb)
+{
+	struct bt_msg *bt_msg;
 
-	if (bt_msg && bt_msg->tb > 0 && !chip_quirk(QUIRK_SIMICS) &&
-	    (tb_compare(tb, bt_msg->tb +
-			secs_to_tb(bt.caps.msg_timeout)) == TB_AAFTERB)) {
-		if (bt_msg->send_count <= bt.caps.max_retries) {
-			/* A message timeout is usually due to the BMC
-			 * clearing the H2B_ATN flag without actually
-			 * doing anything. The data will still be in the
-			 * FIFO so just reset the flag.*/
-			BT_Q_ERR(bt_msg, "Retry sending message");
-			bt_msg->send_count++;
+	list_for_each(&bt.inflight, bt_msg, link)
+		if (bt_msg_expired(bt_msg, tb))
+			return bt_msg;
 
+	/*
+	 * The next message in line starts its timeout before being sent
+	 * so that we notice a BMC that never becomes idle.
+	 */
+	bt_msg = bt_next_msg();
+	if (bt_msg && bt_msg_expired(bt_msg, tb))
+		return bt_msg;
+
+	return NULL;
+}
+
+static void bt_expire_old_msg(uint64_t tb)
+{
+	struct bt_msg *bt_msg;
+
+	if (chip_quirk(QUIRK_SIMICS))
+		return;
+
+	/* bt_msg_del() drops the lock, so look again after each one */
+	while ((bt_msg = bt_find_expired(tb))) {
+		if (bt_msg->inflight &&
+		    bt_msg->send_count <= bt.caps.max_retries) {
 			bt_msg->tb = tb;
-			bt_outb(BT_CTRL_H2B_ATN, BT_CTRL);
+			if (bt_msg == bt.last_sent) {
+				/* A message timeout is usually due to the BMC
+				 * clearing the H2B_ATN flag without actually
+				 * doing anything. The data will still be in the
+				 * FIFO so just reset the flag.*/
+				BT_Q_ERR(bt_msg, "Retry sending message");
+				bt_msg->send_count++;
+				bt_outb(BT_CTRL_H2B_ATN, BT_CTRL);
+			} else {
+				/* Overwritten by a later message, so it has
+				 * to go through the FIFO again. */
+				BT_Q_ERR(bt_msg, "Resending message");
+				list_del(&bt_msg->link);
+				bt_msg->inflight = false;
+				bt.nr_inflight--;
+				list_add(&bt.msgq[bt_msg->prio], &bt_msg->link);
+			}
 		} else {
 			BT_Q_ERR(bt_msg, "Timeout sending message");
 			bt_msg_del(bt_msg);
@@ -415,11 +528,19 @@ static void print_debug_queue_info(void)
 	struct bt_msg *msg;
 	static bool printed;
 
-	if (!list_empty(&bt.msgq)) {
+	int prio;
+
+	if (bt.queue_len) {
 		printed = false;
 		prlog(PR_DEBUG, "-------- BT Msg Queue --------\n");
-		list_for_each(&bt.msgq, msg, link) {
-			BT_Q_DBG(msg, "[ sent %d ]", msg->send_count);
+		list_for_each(&bt.inflight, msg, link) {
+			BT_Q_DBG(msg, "[ in flight, sent %d ]", msg->send_count);
+		}
+		for (prio = 0; prio < BT_NR_PRIOS; prio++) {
+			list_for_each(&bt.msgq[prio], msg, link) {
+				BT_Q_DBG(msg, "[ prio %d, sent %d ]", prio,
+					 msg->send_count);
+			}
 		}
 		prlog(PR_DEBUG, "-----------------------------\n");
 	} else if (!printed) {
@@ -429,32 +550,66 @@ static void print_debug_queue_info(void)
 #endif
 }
 
+static int bt_max_inflight(void)
+{
+	/* The BMC default is a single request at a time */
+	if (bt.caps.num_requests <= 1)
+		return 1;
+	return MIN(bt.caps.num_requests, BT_MAX_INFLIGHT);
+}
+
 static void bt_send_and_unlock(void)
 {
-	if (lpc_ok() && !list_empty(&bt.msgq)) {
-		struct bt_msg *bt_msg;
+	struct bt_msg *bt_msg;
 
-		bt_msg = list_top(&bt.msgq, struct bt_msg, link);
-		assert(bt_msg);
+	if (!lpc_ok())
+		goto out;
 
-		/*
-		 * Start the message timeout once it gets to the top
-		 * of the queue. This will ensure we timeout messages
-		 * in the case of a broken bt interface as occurs when
-		 * the BMC is not responding to any IPMI messages.
-		 */
-		if (bt_msg->tb == 0)
-			bt_msg->tb = mftb();
+	bt_msg = bt_next_msg();
+	if (!bt_msg)
+		goto out;
 
-		/*
-		 * Only send it if we haven't already.
-		 * Timeouts and retries happen in bt_expire_old_msg()
-		 * called from bt_poll()
-		 */
-		if (bt_idle() && bt_msg->send_count == 0)
-			bt_send_msg(bt_msg);
+	/*
+	 * Start the message timeout once it gets to the top
+	 * of the queue. This will ensure we timeout messages
+	 * in the case of a broken bt interface as occurs when
+	 * the BMC is not responding to any IPMI messages.
+	 */
+	if (bt_msg->tb == 0)
+		bt_msg->tb = mftb();
+
+	/*
+	 * The FIFO only holds one request, but once the BMC has taken
+	 * it we can send the next one without waiting for the response,
+	 * up to the number of requests the BMC says it can handle.
+	 * Timeouts and retries happen in bt_expire_old_msg() called
+	 * from bt_poll()
+	 */
+	if (bt.nr_inflight >= bt_max_inflight())
+		goto out;
+
+	/*
+	 * A response raises the interrupt, the BMC emptying the FIFO
+	 * doesn't. Have the poller look on every opal_run_pollers()
+	 * until it does.
+	 */
+	bt.fifo_wait = !bt_idle();
+	if (bt.fifo_wait) {
+		if (bt.irq_ok)
+			schedule_timer(&bt.poller, TIMER_POLL);
+		goto out;
 	}
 
+	list_del(&bt_msg->link);
+	list_add_tail(&bt.inflight, &bt_msg->link);
+	bt_msg->inflight = true;
+	bt.nr_inflight++;
+	bt_msg->tb = mftb();
+	bt_send_msg(bt_msg);
+	bt.last_sent = bt_msg;
+	bt_restart_pending();
+
+out:
 	unlock(&bt.lock);
 }
 
@@ -462,6 +617,7 @@ static void bt_poll(struct timer *t __unused, void *data __unused,
 		    uint64_t now)
 {
 	uint8_t bt_ctrl;
+	int i;
 
 	/* Don't do anything if the LPC bus is offline */
 	if (!lpc_ok())
@@ -477,9 +633,14 @@ static void bt_poll(struct timer *t __unused, void *data __unused,
 
 	bt_ctrl = bt_inb(BT_CTRL);
 
-	/* Is there a response waiting for us? */
-	if (bt_ctrl & BT_CTRL_B2H_ATN)
+	/*
+	 * Is there a response waiting for us? With several requests out
+	 * the BMC may have the next one ready as soon as we read this one.
+	 */
+	for (i = 0; i <= BT_MAX_INFLIGHT && (bt_ctrl & BT_CTRL_B2H_ATN); i++) {
 		bt_get_resp();
+		bt_ctrl = bt_inb(BT_CTRL);
+	}
 
 	bt_expire_old_msg(now);
 
@@ -497,26 +658,91 @@ static void bt_poll(struct timer *t __unused, void *data __unused,
 	 * instead of unlocking, but testing shows the BMC isn't that
 	 * fast so we will wait for the IRQ or a call to the pollers instead.
 	 */
+	bt.fifo_wait = false;
 	bt_send_and_unlock();
 
-	schedule_timer(&bt.poller,
-		       bt.irq_ok ? TIMER_POLL : msecs_to_tb(BT_DEFAULT_POLL_MS));
+	/*
+	 * With a working interrupt we are only here otherwise for the
+	 * timeouts, which don't need looking at more often than without.
+	 */
+	schedule_timer(&bt.poller, bt.irq_ok && bt.fifo_wait ?
+		       TIMER_POLL : msecs_to_tb(BT_DEFAULT_POLL_MS));
+}
+
+static enum bt_prio bt_msg_prio(struct ipmi_msg *ipmi_msg)
+{
+	uint32_t code = IPMI_CODE(ipmi_msg->netfn >> 2, ipmi_msg->cmd);
+
+	switch (code) {
+	case IPMI_RESET_WDT:
+	case IPMI_SET_WDT:
+	case IPMI_CHASSIS_CONTROL:
+	case IPMI_SET_POWER_STATE:
+		return BT_PRIO_HIGH;
+	case IPMI_ADD_SEL_EVENT:
+	case IPMI_RESERVE_SEL:
+		return BT_PRIO_LOW;
+	}
+
+	if (bmc_platform->ipmi_oem_partial_add_esel &&
+	    code == bmc_platform->ipmi_oem_partial_add_esel)
+		return BT_PRIO_LOW;
+
+	return BT_PRIO_NORMAL;
+}
+
+static bool bt_seq_in_use(uint8_t seq)
+{
+	struct bt_msg *bt_msg;
+	int prio;
+
+	list_for_each(&bt.inflight, bt_msg, link)
+		if (bt_msg->seq == seq)
+			return true;
+	for (prio = 0; prio < BT_NR_PRIOS; prio++)
+		list_for_each(&bt.msgq[prio], bt_msg, link)
+			if (bt_msg->seq == seq)
+				return true;
+	return false;
 }
 
-static void bt_add_msg(struct bt_msg *bt_msg)
+static void bt_add_msg(struct bt_msg *bt_msg, bool head)
 {
+	struct bt_msg *victim = NULL;
+	int prio;
+
 	bt_msg->tb = 0;
-	bt_msg->seq = ipmi_seq++;
+	/* Responses are matched by sequence number, keep them unique */
+	do {
+		bt_msg->seq = ipmi_seq++;
+	} while (bt_seq_in_use(bt_msg->seq));
 	bt_msg->send_count = 0;
-	bt.queue_len++;
-	if (bt.queue_len > BT_MAX_QUEUE_LEN) {
-		/* Maximum queue length exceeded, remove oldest messages. */
+	bt_msg->inflight = false;
+	bt_msg->prio = bt_msg_prio(&bt_msg->ipmi_msg);
+	if (bt.queue_len >= BT_MAX_QUEUE_LEN) {
+		/*
+		 * Maximum queue length exceeded, drop the newest message of
+		 * the lowest priority that hasn't been sent yet. That's the
+		 * new one unless something of a lower priority is queued.
+		 */
 		BT_Q_ERR(bt_msg, "Maximum queue length exceeded");
-		bt_msg = list_tail(&bt.msgq, struct bt_msg, link);
-		assert(bt_msg);
-		BT_Q_ERR(bt_msg, "Removed from queue");
-		bt_msg_del(bt_msg);
+		for (prio = BT_NR_PRIOS - 1; prio > bt_msg->prio && !victim;
+		     prio--)
+			victim = list_tail(&bt.msgq[prio], struct bt_msg, link);
+		if (!victim) {
+			BT_Q_ERR(bt_msg, "Not queued");
+			bt_msg_fail(bt_msg);
+			return;
+		}
+		BT_Q_ERR(victim, "Removed from queue");
+		bt_msg_del(victim);
 	}
+
+	bt.queue_len++;
+	if (head)
+		list_add(&bt.msgq[bt_msg->prio], &bt_msg->link);
+	else
+		list_add_tail(&bt.msgq[bt_msg->prio], &bt_msg->link);
 }
 
 static int bt_add_ipmi_msg_head(struct ipmi_msg *ipmi_msg)
@@ -524,8 +750,7 @@ static int bt_add_ipmi_msg_head(struct ipmi_msg *ipmi_msg)
 	struct bt_msg *bt_msg = container_of(ipmi_msg, struct bt_msg, ipmi_msg);
 
 	lock(&bt.lock);
-	bt_add_msg(bt_msg);
-	list_add(&bt.msgq, &bt_msg->link);
+	bt_add_msg(bt_msg, true);
 	bt_send_and_unlock();
 
 	return 0;
@@ -536,8 +761,7 @@ static int bt_add_ipmi_msg(struct ipmi_msg *ipmi_msg)
 	struct bt_msg *bt_msg = container_of(ipmi_msg, struct bt_msg, ipmi_msg);
 
 	lock(&bt.lock);
-	bt_add_msg(bt_msg);
-	list_add_tail(&bt.msgq, &bt_msg->link);
+	bt_add_msg(bt_msg, false);
 	bt_send_and_unlock();
 
 	return 0;
@@ -596,8 +820,7 @@ static int bt_del_ipmi_msg(struct ipmi_msg *ipmi_msg)
 	struct bt_msg *bt_msg = container_of(ipmi_msg, struct bt_msg, ipmi_msg);
 
 	lock(&bt.lock);
-	list_del_from(&bt.msgq, &bt_msg->link);
-	bt.queue_len--;
+	bt_msg_unlink(bt_msg);
 	bt_send_and_unlock();
 	return 0;
 }
@@ -619,6 +842,7 @@ void bt_init(void)
 	struct dt_node *n;
 	const struct dt_property *prop;
 	uint32_t irq;
+	int i;
 
 	/* Set sane capability defaults */
 	bt.caps.num_requests = 1;
@@ -654,7 +878,11 @@ void bt_init(void)
 	 * The iBT interface comes up in the busy state until the daemon has
 	 * initialised it.
 	 */
-	list_head_init(&bt.msgq);
+	for (i = 0; i < BT_NR_PRIOS; i++)
+		list_head_init(&bt.msgq[i]);
+	list_head_init(&bt.inflight);
+	bt.nr_inflight = 0;
+	bt.last_sent = NULL;
 	bt.queue_len = 0;
 
 	prlog(PR_NOTICE, "Interface initialized, IO 0x%04x\n", bt.base_addr);
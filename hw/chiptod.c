@@ -876,16 +876,15 @@ static void chiptod_sync_master(void *data)
 	*result = false;
 }
 
-static void chiptod_sync_slave(void *data)
+static bool chiptod_sync_slave(void *data __unused)
 {
-	bool *result = data;
+	bool ok;
 
 	/* Only get primaries, not threads */
 	if (this_cpu()->is_secondary) {
 		/* On secondaries we just cleanup the TFMR */
 		chiptod_cleanup_thread_tfmr();
-		*result = true;
-		return;
+		return true;
 	}
 
 	prlog(PR_DEBUG, "Slave sync on CPU PIR 0x%04x...\n",
@@ -917,8 +916,14 @@ static void chiptod_sync_slave(void *data)
 		goto error;
 	prlog(PR_INSANE, "SYNC SLAVE Step 4 TFMR=0x%016lx\n", mfspr(SPR_TFMR));
 
-	/* Move chiptod value to core TB */
-	if (!chiptod_to_tb())
+	/* Move chiptod value to core TB. The other cores are syncing at
+	 * the same time and the PIB master register is per chip, so one
+	 * at a time
+	 */
+	lock(&chiptod_lock);
+	ok = chiptod_to_tb();
+	unlock(&chiptod_lock);
+	if (!ok)
 		goto error;
 	prlog(PR_INSANE, "SYNC SLAVE Step 5 TFMR=0x%016lx\n", mfspr(SPR_TFMR));
 
@@ -928,11 +933,22 @@ static void chiptod_sync_slave(void *data)
 
 	prlog(PR_INSANE, "Slave sync completed, TB=%lx\n", mfspr(SPR_TBRL));
 
-	*result = true;
-	return;
+	return true;
  error:
 	prerror("Slave sync failed ! TFMR=0x%016lx\n", mfspr(SPR_TFMR));
-	*result = false;
+	return false;
+}
+
+static void chiptod_slave_synced(struct cpu_thread *cpu, bool ok,
+				 void *data __unused)
+{
+	if (!ok) {
+		op_display(OP_WARN, OP_MOD_CHIPTOD, 3|(cpu->pir << 8));
+
+		/* Disable threads */
+		cpu_disable_all_threads(cpu);
+	}
+	op_display(OP_LOG, OP_MOD_CHIPTOD, 3|(cpu->pir << 8));
 }
 
 bool chiptod_wakeup_resync(void)
@@ -1610,10 +1626,11 @@ static int64_t opal_resync_timebase(void)
 }
 opal_call(OPAL_RESYNC_TIMEBASE, opal_resync_timebase, 0);
 
-static void chiptod_print_tb(void *data __unused)
+static bool chiptod_print_tb(void *data __unused)
 {
 	prlog(PR_DEBUG, "PIR 0x%04x TB=%lx\n", this_cpu()->pir,
 				mfspr(SPR_TBRL));
+	return true;
 }
 
 static bool chiptod_probe(void)
@@ -1741,7 +1758,7 @@ static void chiptod_init_topology_info(void)
 
 void chiptod_init(void)
 {
-	struct cpu_thread *cpu0, *cpu;
+	struct cpu_thread *cpu0;
 	bool sres;
 
 	/* Mambo and qemu doesn't simulate the chiptod */
@@ -1777,34 +1794,13 @@ void chiptod_init(void)
 
 	op_display(OP_LOG, OP_MOD_CHIPTOD, 2);
 
-	/* Schedule slave sync */
-	for_each_available_cpu(cpu) {
-		/* Skip master */
-		if (cpu == cpu0)
-			continue;
+	/* Sync all the slaves at once, skipping the master */
+	cpu_run_per_core("chiptod_sync_slave", chiptod_sync_slave, NULL,
+			 cpu0, false, chiptod_slave_synced);
 
-		/* Queue job */
-		sres = false;
-		cpu_wait_job(cpu_queue_job(cpu, "chiptod_sync_slave",
-					   chiptod_sync_slave, &sres),
-			     true);
-		if (!sres) {
-			op_display(OP_WARN, OP_MOD_CHIPTOD, 3|(cpu->pir << 8));
-
-			/* Disable threads */
-			cpu_disable_all_threads(cpu);
-		}
-		op_display(OP_LOG, OP_MOD_CHIPTOD, 3|(cpu->pir << 8));
-	}
-
-	/* Display TBs */
-	for_each_available_cpu(cpu) {
-		/* Only do primaries, not threads */
-		if (cpu->is_secondary)
-			continue;
-		cpu_wait_job(cpu_queue_job(cpu, "chiptod_print_tb",
-					   chiptod_print_tb, NULL), true);
-	}
+	/* Display TBs, only do primaries, not threads */
+	cpu_run_per_core("chiptod_print_tb", chiptod_print_tb, NULL,
+			 NULL, true, NULL);
 
 	chiptod_init_topology_info();
 	op_display(OP_LOG, OP_MOD_CHIPTOD, 4);
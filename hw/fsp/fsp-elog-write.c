@@ -452,5 +452,5 @@ void fsp_elog_write_init(void)
 	elog_init();
 
 	/* Add a poller */
-	opal_add_poller(elog_timeout_poll, NULL);
+	opal_add_poller_timed(elog_timeout_poll, NULL, "elog-timeout", 0, 100);
 }
@@ -37,6 +37,7 @@
 #include <errorlog.h>
 #include <opal.h>
 #include <opal-msg.h>
+#include <timer.h>
 #include <ccan/list/list.h>
 
 DEFINE_LOG_ENTRY(OPAL_RC_FSP_POLL_TIMEOUT, OPAL_PLATFORM_ERR_EVT, OPAL_FSP,
@@ -106,10 +107,26 @@ static void *fsp_inbound_buf = NULL;
 static u32 fsp_inbound_off;
 
 static struct lock fsp_lock = LOCK_UNLOCKED;
-static struct lock fsp_poll_lock = LOCK_UNLOCKED;
 
 static u64 fsp_cmdclass_resp_bitmask;
-static u64 timeout_timer;
+
+/*
+ * Fires at the earliest deadline of the messages waiting for a response,
+ * only armed once fsp_opl() enables the timeouts.
+ */
+static struct timer fsp_timeout_timer;
+static bool fsp_timeouts_enabled;
+
+/* How long fsp_sync_msg() sleeps between looks at its message */
+#define FSP_SYNC_WAKEUP_US	100
+
+/*
+ * How often the poller looks at an idle mailbox, for the messages the
+ * FSP sends us before the OS takes the PSI interrupt. It's kicked, and
+ * thus runs on every opal_run_pollers(), while we have anything queued
+ * or in flight.
+ */
+#define FSP_POLL_MS		10
 
 static u64 fsp_hir_timeout;
 
@@ -243,6 +260,38 @@ static struct fsp_cmdclass *fsp_get_cmdclass(struct fsp_msg *msg)
 	return __fsp_get_cmdclass(c);
 }
 
+/* When the response to the message a class has in flight is due */
+static u64 fsp_cmdclass_deadline(struct fsp_cmdclass *cmdclass)
+{
+	return cmdclass->timesent + secs_to_tb(cmdclass->timeout * 60);
+}
+
+/*
+ * Point the timeout timer at the earliest deadline of the classes
+ * waiting for a response. Responses arriving don't touch the timer, if
+ * it fires for one of those it finds nothing expired and comes back
+ * here. Called with fsp_lock held.
+ */
+static void fsp_arm_timeout(void)
+{
+	u64 bitmask = fsp_cmdclass_resp_bitmask;
+	u64 deadline, first = 0;
+	u32 index;
+
+	if (!fsp_timeouts_enabled)
+		return;
+
+	for (index = 0; bitmask; index++, bitmask >>= 1) {
+		if (!(bitmask & 1))
+			continue;
+		deadline = fsp_cmdclass_deadline(&fsp_cmdclass[index]);
+		if (!first || tb_compare(deadline, first) == TB_ABEFOREB)
+			first = deadline;
+	}
+	if (first)
+		schedule_timer_at(&fsp_timeout_timer, first);
+}
+
 static struct fsp_msg *__fsp_allocmsg(void)
 {
 	return zalloc(sizeof(struct fsp_msg));
@@ -1092,6 +1141,7 @@ int fsp_queue_msg(struct fsp_msg *msg, void (*comp)(struct fsp_msg *msg))
 	else {
 		list_add_tail(&cmdclass->msgq, &msg->link);
 		fsp_poke_queue(cmdclass);
+		opal_kick_pollers(OPAL_POLL_EVT_FSP);
 	}
 
  unlock:
@@ -1114,6 +1164,9 @@ static void fsp_complete_msg(struct fsp_msg *msg)
 	comp = msg->complete;
 	list_del_from(&cmdclass->msgq, &msg->link);
 	cmdclass->busy = false;
+
+	/* Make the response visible before a waiter sees us done */
+	lwsync();
 	msg->state = fsp_msg_done;
 
 	unlock(&fsp_lock);
@@ -1141,6 +1194,7 @@ static void fsp_complete_send(struct fsp *fsp)
 		msg->state = fsp_msg_wresp;
 		fsp_cmdclass_resp_bitmask |= setbit;
 		cmdclass->timesent = mftb();
+		fsp_arm_timeout();
 	} else
 		fsp_complete_msg(msg);
 }
@@ -1752,8 +1806,18 @@ int fsp_sync_msg(struct fsp_msg *msg, bool autofree)
 			rc = -1;
 			goto bail;
 		}
-		cpu_relax();
+
+		/*
+		 * fsp_complete_msg() moving the message out of the busy
+		 * states is our completion, whether the response came in
+		 * or the timeout timer gave up on it. Until the OS takes
+		 * the FSP interrupt the mailbox is only serviced from the
+		 * pollers, so run them once per wakeup rather than
+		 * spinning through them all.
+		 */
 		opal_run_pollers();
+		if (fsp_msg_busy(msg))
+			time_wait_us(FSP_SYNC_WAKEUP_US);
 	}
 
 	switch(msg->state) {
@@ -2023,12 +2087,33 @@ static void fsp_create_fsp(struct dt_node *fsp_node)
 		psi_enable_fsp_interrupt(fsp->iopath[fsp->active_iopath].psi);
 }
 
+/* Is there anything queued, in flight or an R&R to see through ? */
+static bool fsp_mbox_busy(struct fsp *fsp)
+{
+	int i;
+
+	if (fsp->state != fsp_mbx_idle)
+		return true;
+	for (i = 0; i <= (FSP_MCLASS_LAST - FSP_MCLASS_FIRST); i++)
+		if (!list_empty(&fsp_cmdclass[i].msgq))
+			return true;
+	return false;
+}
+
 static void fsp_opal_poll(void *data __unused)
 {
-	if (try_lock(&fsp_lock)) {
-		__fsp_poll(false);
-		unlock(&fsp_lock);
+	struct fsp *fsp;
+
+	/* Someone else is at it, look again next time */
+	if (!try_lock(&fsp_lock)) {
+		opal_kick_pollers(OPAL_POLL_EVT_FSP);
+		return;
 	}
+	__fsp_poll(false);
+	fsp = fsp_get_active();
+	if (fsp && fsp_mbox_busy(fsp))
+		opal_kick_pollers(OPAL_POLL_EVT_FSP);
+	unlock(&fsp_lock);
 }
 
 int fsp_fatal_msg(struct fsp_msg *msg)
@@ -2089,7 +2174,8 @@ static bool fsp_init_one(const char *compat)
 			list_head_init(&fsp_cmdclass_rr.rr_queue);
 
 			/* Register poller */
-			opal_add_poller(fsp_opal_poll, NULL);
+			opal_add_poller_timed(fsp_opal_poll, NULL, "fsp-mbox",
+					      OPAL_POLL_EVT_FSP, FSP_POLL_MS);
 
 			inited = true;
 		}
@@ -2118,45 +2204,26 @@ bool fsp_present(void)
 	return first_fsp != NULL;
 }
 
-static void fsp_timeout_poll(void *data __unused)
+static void fsp_timeout_expiry(struct timer *t __unused, void *data __unused,
+			       u64 now)
 {
-	u64 now = mftb();
-	u64 timeout_val = 0;
 	u64 cmdclass_resp_bitmask = fsp_cmdclass_resp_bitmask;
 	struct fsp_cmdclass *cmdclass = NULL;
 	struct fsp_msg *req = NULL;
 	u32 index = 0;
 
-	if (timeout_timer == 0)
-		timeout_timer = now + secs_to_tb(30);
-
-	/* The lowest granularity for a message timeout is 30 secs.
-	 * So every 30secs, check if there is any message
-	 * waiting for a response from the FSP
-	 */
-	if (tb_compare(now, timeout_timer) == TB_ABEFOREB)
-		return;
-	if (!try_lock(&fsp_poll_lock))
-		return;
-	if (tb_compare(now, timeout_timer) == TB_ABEFOREB) {
-		unlock(&fsp_poll_lock);
-		return;
-	}
-
 	while (cmdclass_resp_bitmask) {
 		u64 time_sent = 0;
-		u64 time_to_comp = 0;
 
 		if (!(cmdclass_resp_bitmask & 0x1))
 			goto next_bit;
 
 		cmdclass = &fsp_cmdclass[index];
-		timeout_val = secs_to_tb((cmdclass->timeout) * 60);
 		time_sent = cmdclass->timesent;
-		time_to_comp = now - cmdclass->timesent;
 
 		/* Now check if the response has timed out */
-		if (tb_compare(time_to_comp, timeout_val) == TB_AAFTERB) {
+		if (tb_compare(now, fsp_cmdclass_deadline(cmdclass)) !=
+		    TB_ABEFOREB) {
 			u32 w0, w1;
 			enum fsp_msg_state mstate;
 
@@ -2203,7 +2270,11 @@ static void fsp_timeout_poll(void *data __unused)
 		cmdclass_resp_bitmask = cmdclass_resp_bitmask >> 1;
 		index++;
 	}
-	unlock(&fsp_poll_lock);
+
+	/* Go again for whatever is still outstanding */
+	lock(&fsp_lock);
+	fsp_arm_timeout();
+	unlock(&fsp_lock);
 }
 
 void fsp_opl(void)
@@ -2236,8 +2307,12 @@ void fsp_opl(void)
 		opal_run_pollers();
 	}
 
-	/* Initiate the timeout poller */
-	opal_add_poller(fsp_timeout_poll, NULL);
+	/* Start timing out the messages waiting for a response */
+	init_timer(&fsp_timeout_timer, fsp_timeout_expiry, NULL);
+	lock(&fsp_lock);
+	fsp_timeouts_enabled = true;
+	fsp_arm_timeout();
+	unlock(&fsp_lock);
 
 	/* Tell FSP we are in standby */
 	prlog(PR_INFO, "INIT: Sending HV Functional: Standby...\n");
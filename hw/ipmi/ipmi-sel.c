@@ -127,16 +127,61 @@ struct oem_sel {
 
 #define ESEL_HDR_SIZE 7
 
+/*
+ * An error log on its way to the BMC. The transfer state is kept here
+ * rather than in ipmi_elog_poll() so that logs committed while another
+ * one is being sent don't corrupt it.
+ */
+struct esel_log {
+	struct list_node	link;
+	struct errorlog		*elog;
+	struct ipmi_msg		*msg;
+	/* Identical logs committed while this one was waiting */
+	unsigned int		repeat;
+
+	bool			first;
+	size_t			esel_size;
+	size_t			esel_index;
+	unsigned int		reservation_id;
+	unsigned int		record_id;
+	size_t			pel_size;
+	char			pel_buf[IPMI_MAX_PEL_SIZE];
+};
+
+/*
+ * Logs waiting to be sent. A SEL reservation is cancelled by the next
+ * one, so logs go to the BMC one at a time but they are picked so that
+ * a flood from one component doesn't hold up the others, see
+ * esel_pick(). Past ESEL_MAX_PENDING logs are dropped starting with
+ * the component that has the most waiting.
+ */
+#define ESEL_MAX_PENDING	32
+
+static struct lock esel_lock = LOCK_UNLOCKED;
+static LIST_HEAD(esel_pending);
+static unsigned int esel_nr_pending;
+static struct esel_log *esel_active;
+static uint16_t esel_last_component;
+
+static struct {
+	unsigned long	sent;
+	unsigned long	failed;
+	unsigned long	coalesced;
+	unsigned long	dropped;
+} esel_stats;
+
 /* Used for sending PANIC events like abort() path */
 struct ipmi_sel_panic_msg {
 	bool		busy;
 	struct ipmi_msg	*msg;
+	struct esel_log	log;
 	struct lock	lock;
 };
 static struct ipmi_sel_panic_msg ipmi_sel_panic_msg;
 
 /* Forward declaration */
 static void ipmi_elog_poll(struct ipmi_msg *msg);
+static void ipmi_elog_error(struct ipmi_msg *msg);
 
 void ipmi_sel_init(void)
 {
@@ -155,9 +200,10 @@ void ipmi_sel_init(void)
  * For normal event, allocate memory using ipmi_mkmsg and for PANIC
  * event, use pre-allocated buffer.
  */
-static struct ipmi_msg *ipmi_sel_alloc_msg(struct errorlog *elog_buf)
+static struct ipmi_msg *ipmi_sel_alloc_msg(struct esel_log *log)
 {
 	struct ipmi_msg *msg = NULL;
+	struct errorlog *elog_buf = log->elog;
 
 	if (elog_buf->event_severity == OPAL_ERROR_PANIC) {
 		/* Called before initialization completes */
@@ -176,10 +222,10 @@ static struct ipmi_msg *ipmi_sel_alloc_msg(struct errorlog *elog_buf)
 		unlock(&ipmi_sel_panic_msg.lock);
 
 		ipmi_init_msg(msg, IPMI_DEFAULT_INTERFACE, IPMI_RESERVE_SEL,
-				ipmi_elog_poll, elog_buf, IPMI_MAX_REQ_SIZE, 2);
+				ipmi_elog_poll, log, IPMI_MAX_REQ_SIZE, 2);
 	} else {
 		msg = ipmi_mkmsg(IPMI_DEFAULT_INTERFACE, IPMI_RESERVE_SEL,
-				ipmi_elog_poll, elog_buf, NULL,
+				ipmi_elog_poll, log, NULL,
 				IPMI_MAX_REQ_SIZE, 2);
 	}
 
@@ -256,17 +302,6 @@ static void ipmi_update_sel_record(uint8_t event_severity, uint16_t esel_record_
 	}
 }
 
-static void ipmi_elog_error(struct ipmi_msg *msg)
-{
-	if (msg->cc == IPMI_LOST_ARBITRATION_ERR)
-		/* Retry due to SEL erase */
-		ipmi_queue_msg(msg);
-	else {
-		opal_elog_complete(msg->user_data, false);
-		ipmi_sel_free_msg(msg);
-	}
-}
-
 static void ipmi_log_sel_event_error(struct ipmi_msg *msg)
 {
 	if (msg->cc != IPMI_CC_NO_ERROR)
@@ -302,6 +337,136 @@ static void ipmi_log_sel_event(struct ipmi_msg *msg, uint8_t event_severity,
 	ipmi_queue_msg_head(msg);
 }
 
+static void esel_free(struct esel_log *log)
+{
+	if (log != &ipmi_sel_panic_msg.log)
+		free(log);
+}
+
+static bool esel_same(struct errorlog *a, struct errorlog *b)
+{
+	return a->reason_code == b->reason_code &&
+		a->component_id == b->component_id &&
+		a->event_severity == b->event_severity &&
+		a->event_subtype == b->event_subtype &&
+		a->user_section_count == b->user_section_count &&
+		a->user_section_size == b->user_section_size &&
+		!memcmp(a->additional_info, b->additional_info,
+			sizeof(a->additional_info)) &&
+		!memcmp(a->user_data_dump, b->user_data_dump,
+			a->user_section_size);
+}
+
+/*
+ * The oldest log, unless the last one sent came from the same component
+ * and another one is waiting. Must hold esel_lock.
+ */
+static struct esel_log *esel_pick(void)
+{
+	struct esel_log *log;
+
+	list_for_each(&esel_pending, log, link)
+		if (log->elog->component_id != esel_last_component)
+			return log;
+
+	return list_top(&esel_pending, struct esel_log, link);
+}
+
+/* Starts sending the next log if none is on its way */
+static void esel_send_next(void)
+{
+	struct esel_log *log;
+
+	for (;;) {
+		lock(&esel_lock);
+		if (esel_active) {
+			unlock(&esel_lock);
+			return;
+		}
+		log = esel_pick();
+		if (!log) {
+			unlock(&esel_lock);
+			return;
+		}
+		list_del(&log->link);
+		esel_nr_pending--;
+		esel_active = log;
+		esel_last_component = log->elog->component_id;
+		unlock(&esel_lock);
+
+		log->msg->req_size = 0;
+		if (!ipmi_queue_msg(log->msg))
+			return;
+
+		lock(&esel_lock);
+		esel_active = NULL;
+		esel_stats.failed++;
+		unlock(&esel_lock);
+		opal_elog_complete(log->elog, false);
+		ipmi_sel_free_msg(log->msg);
+		esel_free(log);
+	}
+}
+
+/* The active log is finished with, successfully or not */
+static void esel_done(struct esel_log *log, bool success)
+{
+	lock(&esel_lock);
+	assert(esel_active == log);
+	esel_active = NULL;
+	if (success)
+		esel_stats.sent++;
+	else
+		esel_stats.failed++;
+	unlock(&esel_lock);
+
+	if (log->repeat)
+		prlog(PR_INFO, "SEL: %u duplicate(s) of 0x%08x coalesced\n",
+		      log->repeat, log->elog->reason_code);
+
+	opal_elog_complete(log->elog, success);
+	esel_free(log);
+	esel_send_next();
+}
+
+/*
+ * A panic log took over while this one was being sent, which cancelled
+ * our reservation. Start it again once the panic log is done.
+ */
+static bool esel_preempted(struct esel_log *log)
+{
+	lock(&esel_lock);
+	if (esel_active == log) {
+		unlock(&esel_lock);
+		return false;
+	}
+	ipmi_init_msg(log->msg, IPMI_DEFAULT_INTERFACE, IPMI_RESERVE_SEL,
+		      ipmi_elog_poll, log, IPMI_MAX_REQ_SIZE, 2);
+	log->msg->error = ipmi_elog_error;
+	list_add(&esel_pending, &log->link);
+	esel_nr_pending++;
+	unlock(&esel_lock);
+
+	esel_send_next();
+	return true;
+}
+
+static void ipmi_elog_error(struct ipmi_msg *msg)
+{
+	struct esel_log *log = msg->user_data;
+
+	if (esel_preempted(log))
+		return;
+
+	if (msg->cc == IPMI_LOST_ARBITRATION_ERR)
+		/* Retry due to SEL erase */
+		ipmi_queue_msg(msg);
+	else {
+		ipmi_sel_free_msg(msg);
+		esel_done(log, false);
+	}
+}
+
 /* Goes through the required steps to add a complete eSEL:
  *
  *  1. Get a reservation
@@ -310,9 +475,10 @@ static void ipmi_log_sel_event(struct ipmi_msg *msg, uint8_t event_severity,
  *
  * Because a reservation is needed we need to ensure eSEL's are added
  * as a single transaction as concurrent/interleaved adds would cancel
- * the reservation. We guarantee this by always adding our messages to
- * the head of the transmission queue, blocking any other messages
- * being sent until we have completed sending this message.
+ * the reservation. We guarantee this by sending one log at a time, see
+ * esel_send_next(), and by always adding our messages to the head of
+ * the transmission queue, blocking any other messages being sent until
+ * we have completed sending this message.
  *
  * There is still a very small chance that we will accidentally
  * interleave a message if there is another one waiting at the head of
@@ -323,69 +489,71 @@ static void ipmi_log_sel_event(struct ipmi_msg *msg, uint8_t event_severity,
  */
 static void ipmi_elog_poll(struct ipmi_msg *msg)
 {
-	static bool first = false;
-	static char pel_buf[IPMI_MAX_PEL_SIZE];
-	static size_t pel_size;
-	static size_t esel_size;
-	static int esel_index = 0;
-	int pel_index;
-	static unsigned int reservation_id = 0;
-	static unsigned int record_id = 0;
-	struct errorlog *elog_buf = (struct errorlog *) msg->user_data;
+	struct esel_log *log = msg->user_data;
+	struct errorlog *elog_buf = log->elog;
 	size_t req_size;
+	int pel_index;
+
+	if (esel_preempted(log))
+		return;
 
 	if (bmc_platform->ipmi_oem_partial_add_esel == 0) {
 		prlog(PR_WARNING, "Dropped eSEL: BMC code is buggy/missing\n");
+		ipmi_sel_free_msg(msg);
+		esel_done(log, false);
 		return;
 	}
 
 	ipmi_init_esel_record();
 	if (msg->cmd == IPMI_CMD(IPMI_RESERVE_SEL)) {
-		first = true;
-		reservation_id = msg->data[0];
-		reservation_id |= msg->data[1] << 8;
-		if (!reservation_id) {
+		log->first = true;
+		log->reservation_id = msg->data[0];
+		log->reservation_id |= msg->data[1] << 8;
+		if (!log->reservation_id) {
 			/*
 			 * According to specification we should never
 			 * get here, but just in case we do we cancel
 			 * sending the message.
 			 */
 			prerror("Invalid reservation id");
-			opal_elog_complete(elog_buf, false);
 			ipmi_sel_free_msg(msg);
+			esel_done(log, false);
 			return;
 		}
 
-		pel_size = create_pel_log(elog_buf, pel_buf, IPMI_MAX_PEL_SIZE);
-		esel_size = pel_size + sizeof(struct sel_record);
-		esel_index = 0;
-		record_id = 0;
+		log->pel_size = create_pel_log(elog_buf, log->pel_buf,
+					       IPMI_MAX_PEL_SIZE);
+		log->esel_size = log->pel_size + sizeof(struct sel_record);
+		log->esel_index = 0;
+		log->record_id = 0;
 	} else {
-		record_id = msg->data[0];
-		record_id |= msg->data[1] << 8;
+		log->record_id = msg->data[0];
+		log->record_id |= msg->data[1] << 8;
 	}
 
 	/* Start or continue the IPMI_PARTIAL_ADD_SEL */
-	if (esel_index >= esel_size) {
+	if (log->esel_index >= log->esel_size) {
 		/*
 		 * We're all done. Invalidate the resevation id to
 		 * ensure we get an error if we cut in on another eSEL
 		 * message.
 		 */
-		reservation_id = 0;
-		esel_index = 0;
+		log->reservation_id = 0;
+		log->esel_index = 0;
 
 		/* Log SEL event and free ipmi message */
-		ipmi_log_sel_event(msg, elog_buf->event_severity, record_id);
+		ipmi_log_sel_event(msg, elog_buf->event_severity,
+				   log->record_id);
 
-		opal_elog_complete(elog_buf, true);
+		esel_done(log, true);
 		return;
 	}
 
-	if ((esel_size - esel_index) <= (IPMI_MAX_REQ_SIZE - ESEL_HDR_SIZE)) {
+	if ((log->esel_size - log->esel_index) <=
+	    (IPMI_MAX_REQ_SIZE - ESEL_HDR_SIZE)) {
 		/* Last data to send */
 		msg->data[6] = 1;
-		req_size = esel_size - esel_index + ESEL_HDR_SIZE;
+		req_size = log->esel_size - log->esel_index + ESEL_HDR_SIZE;
 	} else {
 		msg->data[6] = 0;
 		req_size = IPMI_MAX_REQ_SIZE;
@@ -393,35 +561,108 @@ static void ipmi_elog_poll(struct ipmi_msg *msg)
 
 	ipmi_init_msg(msg, IPMI_DEFAULT_INTERFACE,
 		      bmc_platform->ipmi_oem_partial_add_esel,
-		      ipmi_elog_poll, elog_buf, req_size, 2);
+		      ipmi_elog_poll, log, req_size, 2);
 
-	msg->data[0] = reservation_id & 0xff;
-	msg->data[1] = (reservation_id >> 8) & 0xff;
-	msg->data[2] = record_id & 0xff;
-	msg->data[3] = (record_id >> 8) & 0xff;
-	msg->data[4] = esel_index & 0xff;
-	msg->data[5] = (esel_index >> 8) & 0xff;
+	msg->data[0] = log->reservation_id & 0xff;
+	msg->data[1] = (log->reservation_id >> 8) & 0xff;
+	msg->data[2] = log->record_id & 0xff;
+	msg->data[3] = (log->record_id >> 8) & 0xff;
+	msg->data[4] = log->esel_index & 0xff;
+	msg->data[5] = (log->esel_index >> 8) & 0xff;
 
-	if (first) {
-		first = false;
+	if (log->first) {
+		log->first = false;
 		memcpy(&msg->data[ESEL_HDR_SIZE], &sel_record,
 			sizeof(struct sel_record));
-		esel_index = sizeof(struct sel_record);
-		msg->req_size = esel_index + ESEL_HDR_SIZE;
+		log->esel_index = sizeof(struct sel_record);
+		msg->req_size = log->esel_index + ESEL_HDR_SIZE;
 	} else {
-		pel_index = esel_index - sizeof(struct sel_record);
-		memcpy(&msg->data[ESEL_HDR_SIZE], &pel_buf[pel_index],
+		pel_index = log->esel_index - sizeof(struct sel_record);
+		memcpy(&msg->data[ESEL_HDR_SIZE], &log->pel_buf[pel_index],
 			msg->req_size - ESEL_HDR_SIZE);
-		esel_index += msg->req_size - ESEL_HDR_SIZE;
+		log->esel_index += msg->req_size - ESEL_HDR_SIZE;
 	}
 
 	ipmi_queue_msg_head(msg);
 	return;
 }
 
+static unsigned int esel_count(uint16_t component_id)
+{
+	struct esel_log *log;
+	unsigned int count = 0;
+
+	list_for_each(&esel_pending, log, link)
+		if (log->elog->component_id == component_id)
+			count++;
+	return count;
+}
+
+enum esel_admit {
+	ESEL_QUEUED,
+	ESEL_COALESCED,
+	ESEL_DROPPED,
+};
+
+/*
+ * Adds the log to the pending ones, unless an identical one is already
+ * waiting. If the queue is full, *victim is set to a log dropped to
+ * make room. Must hold esel_lock.
+ */
+static enum esel_admit esel_admit(struct esel_log *new,
+				  struct esel_log **victim)
+{
+	struct esel_log *log, *worst = NULL;
+	unsigned int count, max = 0;
+
+	*victim = NULL;
+	list_for_each(&esel_pending, log, link) {
+		if (esel_same(log->elog, new->elog)) {
+			log->repeat++;
+			esel_stats.coalesced++;
+			return ESEL_COALESCED;
+		}
+	}
+
+	if (esel_nr_pending >= ESEL_MAX_PENDING) {
+		esel_stats.dropped++;
+
+		/* The newest log of the component with the most waiting */
+		list_for_each(&esel_pending, log, link) {
+			count = esel_count(log->elog->component_id);
+			if (count >= max) {
+				max = count;
+				worst = log;
+			}
+		}
+		if (esel_count(new->elog->component_id) + 1 >= max)
+			return ESEL_DROPPED;
+
+		list_del(&worst->link);
+		esel_nr_pending--;
+		*victim = worst;
+	}
+
+	list_add_tail(&esel_pending, &new->link);
+	esel_nr_pending++;
+	return ESEL_QUEUED;
+}
+
+static void esel_drop(struct esel_log *log)
+{
+	prlog(PR_INFO, "SEL: Too many logs waiting, dropped 0x%08x (%lu)\n",
+	      log->elog->reason_code, esel_stats.dropped);
+	opal_elog_complete(log->elog, false);
+	ipmi_sel_free_msg(log->msg);
+	esel_free(log);
+}
+
 int ipmi_elog_commit(struct errorlog *elog_buf)
 {
+	struct esel_log *log, *victim;
 	struct ipmi_msg *msg;
+	enum esel_admit admit;
+	bool panic;
 
 	/* Only log events that needs attention */
 	if (elog_buf->event_severity <
@@ -432,23 +673,64 @@ int ipmi_elog_commit(struct errorlog *elog_buf)
 		return 0;
 	}
 
+	panic = elog_buf->event_severity == OPAL_ERROR_PANIC;
+	if (panic)
+		log = &ipmi_sel_panic_msg.log;
+	else
+		log = zalloc(sizeof(*log));
+	if (!log) {
+		opal_elog_complete(elog_buf, false);
+		return OPAL_RESOURCE;
+	}
+	log->elog = elog_buf;
+	log->repeat = 0;
+
 	/*
 	 * We pass a large request size in to mkmsg so that we have a
 	 * large enough allocation to reuse the message to pass the
 	 * PEL data via a series of partial add commands.
 	 */
-	msg = ipmi_sel_alloc_msg(elog_buf);
+	msg = ipmi_sel_alloc_msg(log);
 	if (!msg) {
 		opal_elog_complete(elog_buf, false);
+		if (!panic)
+			free(log);
 		return OPAL_RESOURCE;
 	}
 
 	msg->error = ipmi_elog_error;
 	msg->req_size = 0;
-	if (elog_buf->event_severity == OPAL_ERROR_PANIC)
+	log->msg = msg;
+
+	if (panic) {
+		/* Straight to the BMC, whatever else is being sent */
+		lock(&esel_lock);
+		esel_active = log;
+		unlock(&esel_lock);
 		ipmi_queue_msg_sync(msg);
-	else
-		ipmi_queue_msg(msg);
+		return 0;
+	}
+
+	lock(&esel_lock);
+	admit = esel_admit(log, &victim);
+	unlock(&esel_lock);
+
+	switch (admit) {
+	case ESEL_QUEUED:
+		if (victim)
+			esel_drop(victim);
+		esel_send_next();
+		break;
+	case ESEL_COALESCED:
+		/* Goes to the BMC as the one it's identical to */
+		opal_elog_complete(elog_buf, true);
+		ipmi_sel_free_msg(msg);
+		free(log);
+		break;
+	case ESEL_DROPPED:
+		esel_drop(log);
+		break;
+	}
 
 	return 0;
 }
@@ -0,0 +1,648 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the BT driver against a model of the BT registers and of a BMC
+ * that takes several requests at once and answers them in whatever
+ * order the test asks for.
+ */
+
+#define __TEST__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+#include "../../bt.c"
+#include "../../../ccan/list/list.c"
+
+#define BT_BASE		0xe4
+
+/* The BMC side of the interface */
+struct bmc_req {
+	uint8_t netfn, seq, cmd;
+	uint8_t data[BT_FIFO_LEN];
+	uint8_t len;
+	bool answered;
+};
+
+static struct {
+	uint8_t ctrl;
+	uint8_t intmask;
+	uint8_t h2b[BT_FIFO_LEN];
+	unsigned int h2b_pos;
+	uint8_t b2h[BT_FIFO_LEN];
+	unsigned int b2h_pos;
+
+	/* Requests taken from the FIFO and not answered yet */
+	struct bmc_req reqs[64];
+	unsigned int nr_reqs;
+	/* Clear H2B_ATN without reading the FIFO */
+	bool drop_next;
+} bmc;
+
+/* What the IPMI layer saw completing, in order */
+static struct {
+	uint8_t cmd, cc;
+	uint8_t data0;
+} done[64];
+static unsigned int nr_done;
+
+static const struct bmc_platform test_platform = {
+	.ipmi_oem_partial_add_esel = IPMI_CODE(0x3a, 0xf0),
+};
+const struct bmc_platform *bmc_platform = &test_platform;
+
+unsigned long tb_hz = 512000000;
+enum proc_chip_quirks proc_chip_quirks;
+struct dt_node *dt_root;
+
+int64_t lpc_write(enum OpalLPCAddressType addr_type, uint32_t addr,
+		  uint32_t data, uint32_t sz)
+{
+	assert(addr_type == OPAL_LPC_IO && sz == 1);
+
+	switch (addr - BT_BASE) {
+	case BT_CTRL:
+		if (data & BT_CTRL_CLR_WR_PTR)
+			bmc.h2b_pos = 0;
+		if (data & BT_CTRL_CLR_RD_PTR)
+			bmc.b2h_pos = 0;
+		if (data & BT_CTRL_H2B_ATN)
+			bmc.ctrl |= BT_CTRL_H2B_ATN;
+		/* These are write one to clear */
+		bmc.ctrl &= ~(data & (BT_CTRL_B2H_ATN | BT_CTRL_SMS_ATN));
+		/* And this one toggles */
+		bmc.ctrl ^= data & BT_CTRL_H_BUSY;
+		break;
+	case BT_HOST2BMC:
+		assert(bmc.h2b_pos < BT_FIFO_LEN);
+		bmc.h2b[bmc.h2b_pos++] = data;
+		break;
+	case BT_INTMASK:
+		bmc.intmask = data & BT_INTMASK_B2H_IRQEN;
+		break;
+	default:
+		assert(0);
+	}
+	return OPAL_SUCCESS;
+}
+
+int64_t lpc_read(enum OpalLPCAddressType addr_type, uint32_t addr,
+		 uint32_t *data, uint32_t sz)
+{
+	assert(addr_type == OPAL_LPC_IO && sz == 1);
+
+	switch (addr - BT_BASE) {
+	case BT_CTRL:
+		*data = bmc.ctrl;
+		break;
+	case BT_HOST2BMC:
+		assert(bmc.b2h_pos < BT_FIFO_LEN);
+		*data = bmc.b2h[bmc.b2h_pos++];
+		break;
+	case BT_INTMASK:
+		*data = bmc.intmask;
+		break;
+	default:
+		assert(0);
+	}
+	return OPAL_SUCCESS;
+}
+
+/* The BMC takes the request out of the FIFO and is ready for another */
+static void bmc_take(void)
+{
+	struct bmc_req *req;
+
+	if (!(bmc.ctrl & BT_CTRL_H2B_ATN))
+		return;
+	bmc.ctrl &= ~BT_CTRL_H2B_ATN;
+	if (bmc.drop_next) {
+		bmc.drop_next = false;
+		return;
+	}
+
+	assert(bmc.nr_reqs < ARRAY_SIZE(bmc.reqs));
+	req = &bmc.reqs[bmc.nr_reqs++];
+	assert(bmc.h2b[0] == bmc.h2b_pos - 1);
+	req->len = bmc.h2b[0] - BT_MIN_REQ_LEN;
+	req->netfn = bmc.h2b[1];
+	req->seq = bmc.h2b[2];
+	req->cmd = bmc.h2b[3];
+	memcpy(req->data, &bmc.h2b[4], req->len);
+	req->answered = false;
+}
+
+static struct bmc_req *bmc_find(uint8_t cmd)
+{
+	unsigned int i;
+
+	for (i = 0; i < bmc.nr_reqs; i++)
+		if (!bmc.reqs[i].answered && bmc.reqs[i].cmd == cmd)
+			return &bmc.reqs[i];
+	return NULL;
+}
+
+/* Answers the request for cmd, echoing its first data byte back */
+static void bmc_answer(uint8_t cmd)
+{
+	struct bmc_req *req = bmc_find(cmd);
+
+	assert(req);
+	assert(!(bmc.ctrl & (BT_CTRL_B2H_ATN | BT_CTRL_H_BUSY)));
+	req->answered = true;
+	bmc.b2h[0] = BT_MIN_RESP_LEN + 1;
+	bmc.b2h[1] = req->netfn | 0x4;
+	bmc.b2h[2] = req->seq;
+	bmc.b2h[3] = req->cmd;
+	bmc.b2h[4] = IPMI_CC_NO_ERROR;
+	bmc.b2h[5] = req->data[0];
+	bmc.ctrl |= BT_CTRL_B2H_ATN;
+}
+
+static unsigned int bmc_outstanding(void)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < bmc.nr_reqs; i++)
+		if (!bmc.reqs[i].answered)
+			n++;
+	return n;
+}
+
+bool lpc_ok(void)
+{
+	return true;
+}
+
+void lpc_register_client(uint32_t chip_id __unused,
+			 const struct lpc_client *clt __unused,
+			 uint32_t policy __unused)
+{
+}
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+void init_timer(struct timer *t __unused, timer_func_t expiry __unused,
+		void *data __unused)
+{
+}
+
+/* When the poller was last asked to come back */
+static uint64_t poll_delay;
+
+uint64_t schedule_timer(struct timer *t, uint64_t how_long)
+{
+	assert(t == &bt.poller);
+	poll_delay = how_long;
+	return stamp;
+}
+
+void ipmi_cmd_done(uint8_t cmd, uint8_t netfn __unused, uint8_t cc,
+		   struct ipmi_msg *msg)
+{
+	assert(!bt.lock.lock_val);
+	assert(nr_done < ARRAY_SIZE(done));
+	done[nr_done].cmd = cmd;
+	done[nr_done].cc = cc;
+	done[nr_done].data0 = cc == IPMI_CC_NO_ERROR ? msg->data[0] : 0;
+	nr_done++;
+	bt_free_ipmi_msg(msg);
+}
+
+void ipmi_sms_attention(void)
+{
+}
+
+void ipmi_register_backend(struct ipmi_backend *backend)
+{
+	assert(backend == &bt_backend);
+}
+
+void ipmi_free_msg(struct ipmi_msg *msg)
+{
+	bt_free_ipmi_msg(msg);
+}
+
+struct ipmi_msg *ipmi_mkmsg(int interface __unused, uint32_t code __unused,
+			    void (*complete)(struct ipmi_msg *) __unused,
+			    void *user_data __unused, void *req_data __unused,
+			    size_t req_size __unused, size_t resp_size __unused)
+{
+	/* Keep the default capabilities, the tests set their own */
+	return NULL;
+}
+
+int ipmi_queue_msg(struct ipmi_msg *msg __unused)
+{
+	return 0;
+}
+
+static struct dt_node *bt_node = (struct dt_node *)1;
+static struct dt_property bt_reg;
+
+struct dt_node *dt_find_compatible_node(struct dt_node *root __unused,
+					struct dt_node *prev __unused,
+					const char *compat)
+{
+	assert(!strcmp(compat, "ipmi-bt"));
+	return bt_node;
+}
+
+const struct dt_property *dt_find_property(const struct dt_node *node,
+					   const char *name)
+{
+	assert(node == bt_node && !strcmp(name, "reg"));
+	return &bt_reg;
+}
+
+u32 dt_property_get_cell(const struct dt_property *prop __unused, u32 index)
+{
+	return index ? BT_BASE : OPAL_LPC_IO;
+}
+
+u32 dt_prop_get_u32(const struct dt_node *node __unused,
+		    const char *prop __unused)
+{
+	return 10;
+}
+
+u32 dt_get_chip_id(const struct dt_node *node __unused)
+{
+	return 0;
+}
+
+void _prlog(int log_level __unused, const char *fmt __unused, ...)
+{
+}
+
+static void poll(void)
+{
+	bt_poll(NULL, NULL, stamp);
+}
+
+static struct ipmi_msg *queue(uint32_t code, uint8_t tag)
+{
+	struct ipmi_msg *msg = bt_alloc_ipmi_msg(1, 1);
+
+	assert(msg);
+	msg->backend = &bt_backend;
+	msg->netfn = IPMI_NETFN(code) << 2;
+	msg->cmd = IPMI_CMD(code);
+	msg->data[0] = tag;
+	assert(bt_add_ipmi_msg(msg) == 0);
+	return msg;
+}
+
+static void reset(int num_requests)
+{
+	assert(!bt.queue_len && !bt.nr_inflight);
+	memset(&bmc, 0, sizeof(bmc));
+	nr_done = 0;
+	bt.caps.num_requests = num_requests;
+}
+
+#define CMD_A	IPMI_CODE(IPMI_NETFN_APP, 0x10)
+#define CMD_B	IPMI_CODE(IPMI_NETFN_APP, 0x11)
+#define CMD_C	IPMI_CODE(IPMI_NETFN_APP, 0x12)
+#define CMD_D	IPMI_CODE(IPMI_NETFN_APP, 0x13)
+
+/* Only one request at a time, the way it has always worked */
+static void test_single(void)
+{
+	reset(1);
+
+	queue(CMD_A, 1);
+	queue(CMD_B, 2);
+	bmc_take();
+	poll();
+	/* The BMC is idle but B waits for the response to A */
+	assert(!(bmc.ctrl & BT_CTRL_H2B_ATN));
+	assert(bt.nr_inflight == 1);
+
+	bmc_answer(IPMI_CMD(CMD_A));
+	poll();
+	bmc_take();
+	bmc_answer(IPMI_CMD(CMD_B));
+	poll();
+
+	assert(nr_done == 2);
+	assert(done[0].cmd == IPMI_CMD(CMD_A) && done[0].data0 == 1);
+	assert(done[1].cmd == IPMI_CMD(CMD_B) && done[1].data0 == 2);
+
+	/*
+	 * The BMC clears H2B_ATN without doing anything. The request is
+	 * still in the FIFO, so the retry only has to raise H2B_ATN again.
+	 */
+	bmc.drop_next = true;
+	queue(CMD_C, 3);
+	bmc_take();
+	bmc.h2b_pos = 0;
+	stamp += secs_to_tb(bt.caps.msg_timeout) + 1;
+	poll();
+	assert(bmc.ctrl & BT_CTRL_H2B_ATN);
+	bmc.h2b_pos = bmc.h2b[0] + 1;
+	bmc_take();
+	bmc_answer(IPMI_CMD(CMD_C));
+	poll();
+	assert(nr_done == 3);
+	assert(done[2].cmd == IPMI_CMD(CMD_C) && done[2].data0 == 3);
+}
+
+/* Several requests out at once, answered in the reverse order */
+static void test_reorder(void)
+{
+	unsigned int i;
+
+	reset(4);
+
+	queue(CMD_A, 1);
+	queue(CMD_B, 2);
+	queue(CMD_C, 3);
+	queue(CMD_D, 4);
+	queue(CMD_A, 5);
+	for (i = 0; i < 8; i++) {
+		bmc_take();
+		poll();
+	}
+	/* Up to what the BMC said it takes, and not more */
+	assert(bmc_outstanding() == 4);
+	assert(bt.nr_inflight == 4);
+	assert(bt.queue_len == 5);
+
+	/* Each one is matched to its request by sequence number */
+	bmc_answer(IPMI_CMD(CMD_D));
+	poll();
+	bmc_answer(IPMI_CMD(CMD_B));
+	poll();
+	assert(nr_done == 2);
+	assert(done[0].cmd == IPMI_CMD(CMD_D) && done[0].data0 == 4);
+	assert(done[1].cmd == IPMI_CMD(CMD_B) && done[1].data0 == 2);
+
+	/* Which made room for the last one */
+	bmc_take();
+	assert(bmc_outstanding() == 3);
+
+	bmc_answer(IPMI_CMD(CMD_C));
+	poll();
+	bmc_answer(IPMI_CMD(CMD_A));
+	poll();
+	bmc_answer(IPMI_CMD(CMD_A));
+	poll();
+	assert(nr_done == 5);
+	assert(done[2].data0 == 3);
+	assert(done[3].data0 == 1);
+	assert(done[4].data0 == 5);
+	assert(!bt.queue_len && !bt.nr_inflight);
+
+	/* All the sequence numbers were different */
+	for (i = 1; i < bmc.nr_reqs; i++)
+		assert(bmc.reqs[i].seq != bmc.reqs[i - 1].seq);
+
+	/* A response nobody waits for any more is dropped */
+	bmc.nr_reqs = 1;
+	bmc.reqs[0].answered = false;
+	bmc_answer(IPMI_CMD(CMD_A));
+	poll();
+	assert(nr_done == 5);
+	assert(!(bmc.ctrl & (BT_CTRL_B2H_ATN | BT_CTRL_H_BUSY)));
+}
+
+/* Watchdog and power control go ahead, SEL and eSEL go last */
+static void test_priority(void)
+{
+	unsigned int i;
+
+	reset(1);
+
+	/* Keep the interface busy while everything is queued */
+	bmc.ctrl |= BT_CTRL_B_BUSY;
+	queue(IPMI_ADD_SEL_EVENT, 1);
+	queue(bmc_platform->ipmi_oem_partial_add_esel, 2);
+	queue(CMD_A, 3);
+	queue(IPMI_RESET_WDT, 4);
+	queue(CMD_B, 5);
+	queue(IPMI_CHASSIS_CONTROL, 6);
+	bmc.ctrl &= ~BT_CTRL_B_BUSY;
+
+	for (i = 0; i < 6; i++) {
+		poll();
+		bmc_take();
+		assert(bmc_outstanding() == 1);
+		bmc_answer(bmc.reqs[bmc.nr_reqs - 1].cmd);
+		poll();
+	}
+
+	assert(nr_done == 6);
+	assert(done[0].data0 == 4);
+	assert(done[1].data0 == 6);
+	assert(done[2].data0 == 3);
+	assert(done[3].data0 == 5);
+	assert(done[4].data0 == 1);
+	assert(done[5].data0 == 2);
+
+	/* A full queue drops the newest of the lowest priority */
+	bmc.ctrl |= BT_CTRL_B_BUSY;
+	for (i = 0; i < BT_MAX_QUEUE_LEN; i++)
+		queue(i % 2 ? IPMI_ADD_SEL_EVENT : CMD_A, i);
+	assert(nr_done == 6);
+	queue(IPMI_SET_WDT, 100);
+	assert(nr_done == 7);
+	assert(done[6].cmd == IPMI_CMD(IPMI_ADD_SEL_EVENT));
+	assert(done[6].cc == IPMI_TIMEOUT_ERR);
+	assert(bt.queue_len == BT_MAX_QUEUE_LEN);
+	assert(list_tail(&bt.msgq[BT_PRIO_LOW], struct bt_msg,
+			 link)->ipmi_msg.data[0] == BT_MAX_QUEUE_LEN - 3);
+	bmc.ctrl &= ~BT_CTRL_B_BUSY;
+
+	for (i = 0; i < BT_MAX_QUEUE_LEN; i++) {
+		poll();
+		bmc_take();
+		bmc_answer(bmc.reqs[bmc.nr_reqs - 1].cmd);
+		poll();
+	}
+	assert(nr_done == 7 + BT_MAX_QUEUE_LEN);
+	assert(done[7].data0 == 100);
+
+	/* A new message of the lowest priority is the one dropped */
+	nr_done = 0;
+	bmc.ctrl |= BT_CTRL_B_BUSY;
+	for (i = 0; i < BT_MAX_QUEUE_LEN; i++)
+		queue(IPMI_RESET_WDT, i);
+	queue(IPMI_ADD_SEL_EVENT, 100);
+	assert(nr_done == 1);
+	assert(done[0].cmd == IPMI_CMD(IPMI_ADD_SEL_EVENT));
+	assert(done[0].cc == IPMI_TIMEOUT_ERR);
+	assert(bt.queue_len == BT_MAX_QUEUE_LEN);
+	assert(list_empty(&bt.msgq[BT_PRIO_LOW]));
+	bmc.ctrl &= ~BT_CTRL_B_BUSY;
+
+	/* None of the watchdog messages went */
+	for (i = 0; i < BT_MAX_QUEUE_LEN; i++) {
+		poll();
+		bmc_take();
+		bmc_answer(bmc.reqs[bmc.nr_reqs - 1].cmd);
+		poll();
+	}
+	assert(nr_done == 1 + BT_MAX_QUEUE_LEN);
+	for (i = 0; i < BT_MAX_QUEUE_LEN; i++) {
+		assert(done[1 + i].cmd == IPMI_CMD(IPMI_RESET_WDT));
+		assert(done[1 + i].cc == IPMI_CC_NO_ERROR);
+		assert(done[1 + i].data0 == i);
+	}
+}
+
+/* Each request has its own timeout */
+static void test_timeout(void)
+{
+	uint64_t timeout = secs_to_tb(bt.caps.msg_timeout);
+
+	reset(3);
+
+	/* A is lost by the BMC after clearing H2B_ATN */
+	bmc.drop_next = true;
+	queue(CMD_A, 1);
+	bmc_take();
+	assert(bmc_outstanding() == 0);
+
+	stamp += timeout / 2;
+	queue(CMD_B, 2);
+	bmc_take();
+	queue(CMD_C, 3);
+	bmc_take();
+	assert(bmc_outstanding() == 2);
+	assert(bt.nr_inflight == 3);
+
+	/* Only A times out, and C is in the FIFO so A has to be resent */
+	stamp += timeout / 2 + 1;
+	poll();
+	assert(nr_done == 0);
+	assert(bt.nr_inflight == 3);
+	bmc_take();
+	assert(bmc_outstanding() == 3);
+	assert(bmc.reqs[2].cmd == IPMI_CMD(CMD_A));
+	assert(bmc.reqs[2].seq != bmc.reqs[0].seq);
+	assert(bmc.reqs[2].seq != bmc.reqs[1].seq);
+
+	/* C and A are answered, B is lost for good */
+	bmc_answer(IPMI_CMD(CMD_C));
+	poll();
+	bmc_answer(IPMI_CMD(CMD_A));
+	poll();
+	assert(nr_done == 2);
+	assert(done[0].data0 == 3 && done[1].data0 == 1);
+
+	/* B gets resent, and lost again */
+	stamp += timeout + 1;
+	poll();
+	assert(nr_done == 2);
+	assert(bmc.ctrl & BT_CTRL_H2B_ATN);
+	bmc.drop_next = true;
+	bmc_take();
+
+	/* Out of retries */
+	stamp += timeout + 1;
+	poll();
+	assert(nr_done == 3);
+	assert(done[2].cmd == IPMI_CMD(CMD_B));
+	assert(done[2].cc == IPMI_TIMEOUT_ERR);
+	assert(!bt.queue_len && !bt.nr_inflight);
+
+	/* A BMC that stays busy times out messages that were never sent */
+	bmc.ctrl |= BT_CTRL_B_BUSY;
+	queue(CMD_D, 4);
+	stamp += timeout + 1;
+	poll();
+	assert(nr_done == 4);
+	assert(done[3].cmd == IPMI_CMD(CMD_D));
+	assert(done[3].cc == IPMI_TIMEOUT_ERR);
+	bmc.ctrl &= ~BT_CTRL_B_BUSY;
+}
+
+/*
+ * With the interrupt working, the poller only runs on every
+ * opal_run_pollers() while a request waits for the BMC to empty the
+ * FIFO, nothing else tells us it did.
+ */
+static void test_poll_interval(void)
+{
+	reset(2);
+
+	poll();
+	assert(poll_delay == msecs_to_tb(BT_DEFAULT_POLL_MS));
+
+	bt.irq_ok = true;
+	poll();
+	assert(poll_delay == msecs_to_tb(BT_DEFAULT_POLL_MS));
+
+	/* The BMC hasn't taken A yet when B is queued */
+	queue(CMD_A, 1);
+	assert(poll_delay == msecs_to_tb(BT_DEFAULT_POLL_MS));
+	queue(CMD_B, 2);
+	assert(poll_delay == TIMER_POLL);
+	poll();
+	assert(poll_delay == TIMER_POLL);
+
+	/* It takes it, B goes out, the responses raise the interrupt */
+	bmc_take();
+	poll();
+	assert(bt.nr_inflight == 2);
+	assert(poll_delay == msecs_to_tb(BT_DEFAULT_POLL_MS));
+
+	bmc_take();
+	bmc_answer(IPMI_CMD(CMD_A));
+	poll();
+	bmc_answer(IPMI_CMD(CMD_B));
+	poll();
+	assert(nr_done == 2);
+	assert(poll_delay == msecs_to_tb(BT_DEFAULT_POLL_MS));
+
+	bt.irq_ok = false;
+}
+
+int main(void)
+{
+	/* A zero timebase means the message timeout hasn't started */
+	stamp = 1000;
+
+	bt_init();
+	assert(bt.base_addr == BT_BASE);
+
+	test_single();
+	test_reorder();
+	test_priority();
+	test_timeout();
+	test_poll_interval();
+
+	return 0;
+}
@@ -0,0 +1,508 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Sends bursts of error logs to a mock BMC implementing the SEL
+ * reservation and the AMI partial add eSEL command, and checks what
+ * gets there and in which order.
+ */
+
+#define __TEST__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+#include "../ipmi-sel.c"
+#include "../../../ccan/list/list.c"
+
+#define ESEL_CODE	IPMI_CODE(SEL_NETFN_IBM, 0xf0)
+#define CC_RESERVATION_CANCELLED	0xc5
+
+static const struct bmc_platform test_platform = {
+	.ipmi_oem_partial_add_esel = ESEL_CODE,
+};
+const struct bmc_platform *bmc_platform = &test_platform;
+
+/* Messages waiting for the BMC, in the order it takes them */
+static struct ipmi_msg *queue[256];
+static unsigned int queue_len, nr_msgs;
+
+/* The BMC */
+static struct {
+	unsigned int reservation;
+	unsigned int next_record;
+	uint8_t buf[IPMI_MAX_PEL_SIZE + 64];
+	size_t len;
+	/* Stop taking messages */
+	bool stalled;
+} bmc;
+
+/* What made it into the SEL, in order */
+static struct {
+	uint16_t component_id;
+	uint32_t reason_code;
+} sel[256];
+static unsigned int nr_sel, nr_sel_events;
+
+/* What the elog layer was told */
+static unsigned int nr_complete, nr_failed;
+
+static struct errorlog elogs[256];
+static unsigned int nr_elogs;
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+void _prlog(int log_level __unused, const char *fmt __unused, ...)
+{
+}
+
+void ipmi_init_msg(struct ipmi_msg *msg, int interface __unused,
+		   uint32_t code, void (*complete)(struct ipmi_msg *),
+		   void *user_data, size_t req_size, size_t resp_size)
+{
+	msg->cmd = IPMI_CMD(code);
+	msg->netfn = IPMI_NETFN(code) << 2;
+	msg->req_size = req_size;
+	msg->resp_size = resp_size;
+	msg->complete = complete;
+	msg->user_data = user_data;
+}
+
+struct ipmi_msg *ipmi_mkmsg(int interface, uint32_t code,
+			    void (*complete)(struct ipmi_msg *),
+			    void *user_data, void *req_data, size_t req_size,
+			    size_t resp_size)
+{
+	struct ipmi_msg *msg = calloc(1, sizeof(*msg) + IPMI_MAX_REQ_SIZE);
+
+	msg->data = (uint8_t *)(msg + 1);
+	ipmi_init_msg(msg, interface, code, complete, user_data, req_size,
+		      resp_size);
+	msg->error = ipmi_free_msg;
+	if (req_data)
+		memcpy(msg->data, req_data, req_size);
+	nr_msgs++;
+	return msg;
+}
+
+struct ipmi_msg *ipmi_mkmsg_simple(uint32_t code, void *req_data,
+				   size_t req_size)
+{
+	return ipmi_mkmsg(IPMI_DEFAULT_INTERFACE, code, ipmi_free_msg, NULL,
+			  req_data, req_size, 0);
+}
+
+void ipmi_free_msg(struct ipmi_msg *msg)
+{
+	assert(msg != ipmi_sel_panic_msg.msg);
+	assert(nr_msgs);
+	nr_msgs--;
+	free(msg);
+}
+
+int ipmi_queue_msg(struct ipmi_msg *msg)
+{
+	assert(queue_len < ARRAY_SIZE(queue));
+	queue[queue_len++] = msg;
+	return 0;
+}
+
+int ipmi_queue_msg_head(struct ipmi_msg *msg)
+{
+	assert(queue_len < ARRAY_SIZE(queue));
+	memmove(&queue[1], &queue[0], queue_len * sizeof(queue[0]));
+	queue[0] = msg;
+	queue_len++;
+	return 0;
+}
+
+static bool bmc_step(void);
+
+void ipmi_queue_msg_sync(struct ipmi_msg *msg)
+{
+	bool stalled = bmc.stalled;
+
+	/* Returns once this one is answered, the rest follows later */
+	ipmi_queue_msg_head(msg);
+	bmc.stalled = false;
+	bmc_step();
+	bmc.stalled = stalled;
+}
+
+uint8_t ipmi_get_sensor_number(uint8_t sensor_type __unused)
+{
+	return 0x42;
+}
+
+/* Made up, but enough to check it arrives in one piece */
+int create_pel_log(struct errorlog *elog_data, char *pel_buffer,
+		   size_t pel_buffer_size)
+{
+	size_t i, size = 64 + elog_data->reason_code % 1500;
+
+	assert(size <= pel_buffer_size);
+	memcpy(pel_buffer, &elog_data->reason_code, 4);
+	memcpy(pel_buffer + 4, &elog_data->component_id, 2);
+	for (i = 6; i < size; i++)
+		pel_buffer[i] = i ^ elog_data->reason_code;
+	return size;
+}
+
+void opal_elog_complete(struct errorlog *elog __unused, bool success)
+{
+	nr_complete++;
+	if (!success)
+		nr_failed++;
+}
+
+int _opal_queue_msg(enum opal_msg_type msg_type __unused, void *data __unused,
+		    void (*consumed)(void *data) __unused,
+		    size_t num_params __unused, const u64 *params __unused)
+{
+	return 0;
+}
+
+void occ_pnor_set_owner(enum pnor_owner owner __unused)
+{
+}
+
+void prd_occ_reset(uint32_t proc __unused)
+{
+}
+
+/* Only used by the SEL commands from the BMC, not tested here */
+struct dt_node *dt_root;
+struct debug_descriptor debug_descriptor;
+struct platform platform;
+
+bool flash_reserve(void)
+{
+	return false;
+}
+
+void flash_release(void)
+{
+}
+
+struct dt_node *dt_find_by_name(struct dt_node *root __unused,
+				const char *name __unused)
+{
+	return NULL;
+}
+
+struct dt_node *dt_find_by_name_addr(struct dt_node *parent __unused,
+				     const char *name __unused,
+				     uint64_t addr __unused)
+{
+	return NULL;
+}
+
+bool dt_has_node_property(const struct dt_node *node __unused,
+			  const char *name __unused, const char *val __unused)
+{
+	return false;
+}
+
+u32 dt_get_chip_id(const struct dt_node *node __unused)
+{
+	return 0;
+}
+
+static void bmc_reply(struct ipmi_msg *msg, uint8_t cc, uint16_t val)
+{
+	msg->cc = cc;
+	msg->data[0] = val & 0xff;
+	msg->data[1] = val >> 8;
+	if (cc)
+		msg->error(msg);
+	else
+		msg->complete(msg);
+}
+
+static void bmc_check_esel(void)
+{
+	uint32_t reason;
+	uint16_t component;
+	size_t i, pel = sizeof(struct sel_record);
+
+	assert(bmc.len > pel + 6);
+	memcpy(&reason, &bmc.buf[pel], 4);
+	memcpy(&component, &bmc.buf[pel + 4], 2);
+	assert(bmc.len - pel == 64 + reason % 1500);
+	for (i = 6; i < bmc.len - pel; i++)
+		assert(bmc.buf[pel + i] == (uint8_t)(i ^ reason));
+
+	assert(nr_sel < ARRAY_SIZE(sel));
+	sel[nr_sel].reason_code = reason;
+	sel[nr_sel].component_id = component;
+	nr_sel++;
+}
+
+/* Takes the next message, returns false if there was none */
+static bool bmc_step(void)
+{
+	struct ipmi_msg *msg;
+	unsigned int offset;
+
+	if (!queue_len || bmc.stalled)
+		return false;
+	msg = queue[0];
+	memmove(&queue[0], &queue[1], --queue_len * sizeof(queue[0]));
+
+	if (msg->cmd == IPMI_CMD(IPMI_RESERVE_SEL)) {
+		/* Cancels any other reservation */
+		bmc.reservation = (bmc.reservation + 1) & 0xffff;
+		if (!bmc.reservation)
+			bmc.reservation = 1;
+		bmc.len = 0;
+		bmc_reply(msg, IPMI_CC_NO_ERROR, bmc.reservation);
+	} else if (msg->cmd == IPMI_CMD(ESEL_CODE)) {
+		if ((msg->data[0] | msg->data[1] << 8) != bmc.reservation) {
+			bmc_reply(msg, CC_RESERVATION_CANCELLED, 0);
+			return true;
+		}
+		offset = msg->data[4] | msg->data[5] << 8;
+		assert(offset == bmc.len);
+		assert(msg->req_size > ESEL_HDR_SIZE);
+		memcpy(&bmc.buf[bmc.len], &msg->data[ESEL_HDR_SIZE],
+		       msg->req_size - ESEL_HDR_SIZE);
+		bmc.len += msg->req_size - ESEL_HDR_SIZE;
+		if (msg->data[6]) {
+			bmc_check_esel();
+			bmc.next_record++;
+		}
+		bmc_reply(msg, IPMI_CC_NO_ERROR, bmc.next_record);
+	} else {
+		assert(msg->cmd == IPMI_CMD(IPMI_ADD_SEL_EVENT));
+		nr_sel_events++;
+		bmc_reply(msg, IPMI_CC_NO_ERROR, 0);
+	}
+	return true;
+}
+
+static void bmc_run(void)
+{
+	while (bmc_step())
+		;
+}
+
+static struct errorlog *new_elog(uint16_t component, uint32_t reason,
+				 uint8_t severity)
+{
+	struct errorlog *elog;
+
+	assert(nr_elogs < ARRAY_SIZE(elogs));
+	elog = &elogs[nr_elogs++];
+	memset(elog, 0, sizeof(*elog));
+	elog->component_id = component;
+	elog->reason_code = reason;
+	elog->event_severity = severity;
+	elog->elog_origin = ORG_SAPPHIRE;
+	elog->user_section_size = 16;
+	memcpy(elog->user_data_dump, &reason, 4);
+	return elog;
+}
+
+static void commit(uint16_t component, uint32_t reason)
+{
+	assert(ipmi_elog_commit(new_elog(component, reason,
+				OPAL_UNRECOVERABLE_ERR_GENERAL)) == 0);
+}
+
+static void reset(void)
+{
+	bmc_run();
+	assert(!esel_active && list_empty(&esel_pending));
+	assert(!esel_nr_pending);
+	assert(nr_msgs == 0);
+	memset(&esel_stats, 0, sizeof(esel_stats));
+	nr_sel = nr_sel_events = nr_complete = nr_failed = nr_elogs = 0;
+}
+
+#define COMP_A	0x4141
+#define COMP_B	0x4242
+#define COMP_C	0x4343
+
+/* Logs committed while one is on its way don't get mixed up with it */
+static void test_burst(void)
+{
+	reset();
+
+	bmc.stalled = true;
+	commit(COMP_A, 1000);
+	commit(COMP_A, 1001);
+	commit(COMP_A, 1002);
+	commit(COMP_B, 2000);
+	commit(COMP_A, 1003);
+	commit(COMP_C, 3000);
+	assert(esel_nr_pending == 5);
+	bmc.stalled = false;
+	bmc_run();
+
+	/* Other components go between those of the busy one */
+	assert(nr_sel == 6);
+	assert(sel[0].reason_code == 1000);
+	assert(sel[1].reason_code == 2000);
+	assert(sel[2].reason_code == 1001);
+	assert(sel[3].reason_code == 3000);
+	assert(sel[4].reason_code == 1002);
+	assert(sel[5].reason_code == 1003);
+	assert(nr_sel_events == 6);
+	assert(nr_complete == 6 && nr_failed == 0);
+	assert(esel_stats.sent == 6);
+
+	/* One at a time as they come */
+	reset();
+	commit(COMP_A, 1);
+	bmc_run();
+	commit(COMP_B, 1499);
+	bmc_run();
+	assert(nr_sel == 2 && nr_complete == 2 && nr_failed == 0);
+}
+
+static void test_coalesce(void)
+{
+	unsigned int i;
+
+	reset();
+
+	bmc.stalled = true;
+	for (i = 0; i < 5; i++)
+		commit(COMP_A, 1234);
+	/* Same log from another component isn't a duplicate */
+	commit(COMP_B, 1234);
+	assert(esel_nr_pending == 2);
+	/* The first one is already on its way */
+	assert(esel_stats.coalesced == 3);
+	assert(nr_complete == 3);
+	bmc.stalled = false;
+	bmc_run();
+
+	fprintf(stderr, "%d %d %d %d\n", nr_sel, sel[0].reason_code, sel[1].reason_code, sel[2].reason_code);
+	assert(nr_sel == 3);
+	assert(nr_complete == 6 && nr_failed == 0);
+
+	/* Different user data isn't either */
+	reset();
+	bmc.stalled = true;
+	commit(COMP_A, 1);
+	commit(COMP_A, 2);
+	elogs[nr_elogs - 1].user_data_dump[8] = 1;
+	commit(COMP_A, 2);
+	elogs[nr_elogs - 1].user_data_dump[8] = 2;
+	commit(COMP_A, 2);
+	assert(esel_nr_pending == 3);
+	bmc.stalled = false;
+	bmc_run();
+	assert(nr_sel == 4);
+}
+
+/* A flood from one component can't push out the others */
+static void test_storm(void)
+{
+	unsigned int i, nr_b = 0, nr_a = 0;
+
+	reset();
+
+	bmc.stalled = true;
+	for (i = 0; i < 120; i++) {
+		commit(COMP_A, 10000 + i);
+		if (i % 20 == 0)
+			commit(COMP_B, 20000 + i);
+		assert(esel_nr_pending <= ESEL_MAX_PENDING);
+	}
+	assert(esel_nr_pending == ESEL_MAX_PENDING);
+	bmc.stalled = false;
+	bmc_run();
+
+	/* One on its way, then a full queue */
+	assert(nr_sel == ESEL_MAX_PENDING + 1);
+	assert(esel_stats.dropped == 120 + 6 - nr_sel);
+	assert(nr_complete == 126);
+	assert(nr_failed == esel_stats.dropped);
+	for (i = 0; i < nr_sel; i++) {
+		if (sel[i].component_id == COMP_B)
+			nr_b++;
+		else
+			nr_a++;
+	}
+	assert(nr_b == 6);
+
+	/* In order, the oldest of A first */
+	for (i = 1; i < nr_sel; i++)
+		if (sel[i].component_id == COMP_A &&
+		    sel[i - 1].component_id == COMP_A)
+			assert(sel[i].reason_code > sel[i - 1].reason_code);
+	assert(sel[0].reason_code == 10000);
+}
+
+/* A panic log goes first, cancelling what was being sent */
+static void test_panic(void)
+{
+	reset();
+
+	commit(COMP_A, 1400);
+	commit(COMP_B, 1401);
+	/* Part of the way through the first one */
+	bmc_step();
+	bmc_step();
+	bmc_step();
+	assert(bmc.len);
+
+	assert(ipmi_elog_commit(new_elog(COMP_C, 999, OPAL_ERROR_PANIC)) == 0);
+	/* Only the reservation is waited for */
+	assert(nr_sel == 0);
+	bmc_run();
+
+	assert(nr_sel == 3);
+	assert(sel[0].reason_code == 999);
+	/*
+	 * The interrupted log goes back in the queue when its message in
+	 * flight comes back, the other one may have been started by then.
+	 */
+	assert(sel[1].reason_code + sel[2].reason_code == 1400 + 1401);
+	assert(sel[1].reason_code != sel[2].reason_code);
+	assert(nr_complete == 3 && nr_failed == 0);
+	assert(!ipmi_sel_panic_msg.busy);
+}
+
+int main(void)
+{
+	ipmi_sel_init();
+	nr_msgs = 0;
+
+	test_burst();
+	test_coalesce();
+	test_storm();
+	test_panic();
+	reset();
+
+	return 0;
+}
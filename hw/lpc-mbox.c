@@ -51,6 +51,12 @@
 
 #define MBOX_MAX_QUEUE_LEN 5
 
+/*
+ * Responses and attentions raise the interrupt, once it's seen working
+ * the poller only looks in case one got lost
+ */
+#define MBOX_IRQ_POLL_MS 1000
+
 struct mbox {
 	uint32_t base;
 	int queue_len;
@@ -139,8 +145,8 @@ int bmc_mbox_enqueue(struct bmc_mbox_msg *msg, unsigned int timeout_sec)
 	bmc_mbox_send_message(msg);
 	unlock(&mbox.lock);
 
-	schedule_timer(&mbox.poller, mbox.irq_ok ?
-			TIMER_POLL : msecs_to_tb(MBOX_DEFAULT_POLL_MS));
+	schedule_timer(&mbox.poller, msecs_to_tb(mbox.irq_ok ?
+			MBOX_IRQ_POLL_MS : MBOX_DEFAULT_POLL_MS));
 
 	return 0;
 }
@@ -222,8 +228,8 @@ out_response:
 
 	unlock(&mbox.lock);
 
-	schedule_timer(&mbox.poller,
-		       mbox.irq_ok ? TIMER_POLL : msecs_to_tb(MBOX_DEFAULT_POLL_MS));
+	schedule_timer(&mbox.poller, msecs_to_tb(mbox.irq_ok ?
+			MBOX_IRQ_POLL_MS : MBOX_DEFAULT_POLL_MS));
 }
 
 static void mbox_irq(uint32_t chip_id __unused, uint32_t irq_mask __unused)
@@ -159,7 +159,71 @@ bool uart_enabled(void)
 
 /*
  * Internal console driver (output only)
+ *
+ * Output is copied to a ring which is pushed into the FIFO as far as
+ * it goes, then drained ahead of the OPAL console out_buf by the
+ * poller and the THRE interrupt. A printf() thus costs its caller at
+ * most a FIFO's worth of LPC writes instead of waiting for the whole
+ * line to go out at 115200. We only wait for the UART when the ring is
+ * full, and in uart_con_drain() for emergency output.
+ *
+ * Until uart_init() has registered the poller nothing would drain the
+ * ring behind the last write, so writes are synchronous, which also
+ * covers the early MMIO UART.
+ *
+ * The poller otherwise only looks at the UART every UART_POLL_MS, for
+ * input without a working interrupt. Whoever leaves output behind
+ * kicks it, see uart_kick_tx(), so it keeps pushing on every
+ * opal_run_pollers() until everything went out.
+ */
+#define UART_POLL_MS	1
+
+#define CON_TX_BUF_SIZE	0x4000
+static uint8_t con_tx_buf[CON_TX_BUF_SIZE];
+static uint32_t con_tx_prod;
+static uint32_t con_tx_cons;
+static bool con_tx_async;
+
+/* OPAL console input and output buffers, see below */
+static uint8_t *in_buf;
+static uint8_t *out_buf;
+
+/* Output is left behind, unless THRE comes back for it the poller must */
+static void uart_kick_tx(void)
+{
+	if (!in_buf || !irq_ok)
+		opal_kick_pollers(OPAL_POLL_EVT_UART);
+}
+
+static uint32_t uart_con_tx_space(void)
+{
+	return CON_TX_BUF_SIZE - 1 -
+		(con_tx_prod + CON_TX_BUF_SIZE - con_tx_cons) % CON_TX_BUF_SIZE;
+}
+
+/*
+ * Push the internal console ring into the FIFO, waiting for room if
+ * asked to. Returns true once the ring is empty. uart_lock must be
+ * held.
  */
+static bool uart_con_tx(bool wait)
+{
+	while (con_tx_prod != con_tx_cons) {
+		if (tx_room == 0) {
+			if (wait)
+				uart_wait_tx_room();
+			else
+				uart_check_tx_room();
+		}
+		if (tx_room == 0)
+			return false;
+		uart_write(REG_THR, con_tx_buf[con_tx_cons++]);
+		con_tx_cons %= CON_TX_BUF_SIZE;
+		tx_room--;
+	}
+	return true;
+}
+
 static size_t uart_con_write(const char *buf, size_t len)
 {
 	size_t written = 0;
@@ -170,22 +234,45 @@ static size_t uart_con_write(const char *buf, size_t len)
 
 	lock(&uart_lock);
 	while(written < len) {
-		if (tx_room == 0) {
+		/* Ring full, wait for the FIFO to make some room */
+		if (!uart_con_tx_space()) {
 			uart_wait_tx_room();
-			if (tx_room == 0)
-				goto bail;
-		} else {
-			uart_write(REG_THR, buf[written++]);
-			tx_room--;
+			uart_con_tx(false);
 		}
+		con_tx_buf[con_tx_prod++] = buf[written++];
+		con_tx_prod %= CON_TX_BUF_SIZE;
+	}
+
+	/* Have the THRE interrupt come back for what doesn't fit */
+	if (!uart_con_tx(!con_tx_async)) {
+		if (in_buf && !tx_full) {
+			tx_full = true;
+			uart_update_ier();
+		}
+		uart_kick_tx();
 	}
- bail:
 	unlock(&uart_lock);
 	return written;
 }
 
+/* Synchronously push out everything the internal console buffered */
+static void uart_con_drain(void)
+{
+	if (!lpc_ok() && !mmio_uart_base)
+		return;
+
+	/* We may be going down with it held */
+	if (lock_held_by_me(&uart_lock))
+		return;
+
+	lock(&uart_lock);
+	uart_con_tx(true);
+	unlock(&uart_lock);
+}
+
 static struct con_ops uart_con_driver = {
 	.write = uart_con_write,
+	.flush = uart_con_drain,
 };
 
 /*
@@ -204,17 +291,15 @@ static struct con_ops uart_con_driver = {
  * it's tty flip buffers so I don't bother with a ring buffer.
  */
 #define IN_BUF_SIZE	0x1000
-static uint8_t	*in_buf;
 static uint32_t	in_count;
 
 /*
  * We implement a ring buffer for output data as well to speed things
  * up a bit. This allows us to have interrupt driven sends. This is only
- * for the output data coming from the OPAL API, not the internal one
- * which is already bufferred.
+ * for the output data coming from the OPAL API, the internal one has
+ * its own ring above.
  */
 #define OUT_BUF_SIZE	0x1000
-static uint8_t *out_buf;
 static uint32_t out_buf_prod;
 static uint32_t out_buf_cons;
 
@@ -224,6 +309,16 @@ static int64_t uart_con_flush(void)
 	bool tx_was_full = tx_full;
 	uint32_t out_buf_cons_initial = out_buf_cons;
 
+	/*
+	 * Whatever the internal console buffered goes out first. That
+	 * one is never flushed synchronously from here, it can be much
+	 * bigger than out_buf.
+	 */
+	if (!uart_con_tx(false)) {
+		tx_full = true;
+		goto out;
+	}
+
 	while(out_buf_prod != out_buf_cons) {
 		if (tx_room == 0) {
 			/*
@@ -245,6 +340,7 @@ static int64_t uart_con_flush(void)
 		out_buf_cons %= OUT_BUF_SIZE;
 		tx_room--;
 	}
+ out:
 	if (tx_full != tx_was_full)
 		uart_update_ier();
 	if (out_buf_prod != out_buf_cons) {
@@ -281,8 +377,9 @@ static int64_t uart_opal_write(int64_t term_number, int64_t *length,
 		written++;
 	}
 
-	/* Flush out buffer again */
-	uart_con_flush();
+	/* Flush out buffer again, the poller pushes what's left */
+	if (uart_con_flush() != OPAL_SUCCESS)
+		uart_kick_tx();
 
 	unlock(&uart_lock);
 
@@ -402,12 +499,19 @@ static int64_t uart_opal_flush(int64_t term_number)
 
 static void __uart_do_poll(u8 trace_ctx)
 {
-	if (!in_buf)
+	/* Before the OPAL console is up, only drain the internal one */
+	if (!in_buf) {
+		lock(&uart_lock);
+		if (!uart_con_tx(false))
+			uart_kick_tx();
+		unlock(&uart_lock);
 		return;
+	}
 
 	lock(&uart_lock);
 	uart_read_to_buffer();
-	uart_con_flush();
+	if (uart_con_flush() != OPAL_SUCCESS)
+		uart_kick_tx();
 	uart_trace(trace_ctx, 0, tx_full, in_count);
 	unlock(&uart_lock);
 
@@ -494,9 +598,6 @@ static void uart_setup_opal_console(void)
 	 */
 	tx_full = rx_full = false;
 	uart_update_ier();
-
-	/* Start console poller */
-	opal_add_poller(uart_console_poll, NULL);
 }
 
 static void uart_init_opal_console(void)
@@ -690,6 +791,14 @@ void uart_init(void)
 	 */
 	lpc_used_by_console();
 
+	/*
+	 * Start console poller, it drains the internal console from now
+	 * on so printf() no longer needs to wait for the UART
+	 */
+	opal_add_poller_timed(uart_console_poll, NULL, "lpc-uart",
+			      OPAL_POLL_EVT_UART, UART_POLL_MS);
+	con_tx_async = true;
+
 	/* Install console backend for printf() */
 	set_console(&uart_con_driver);
 }
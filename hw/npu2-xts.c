@@ -0,0 +1,283 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The NVLink XTS tables, mapping GPU BDFs to an LPARSHORT and the
+ * wildcard PID entry of each LPARSHORT, and the OPAL calls setting up
+ * contexts in them.
+ *
+ * Each table access is an indirect SCOM, so instead of searching the
+ * BDF map entry by entry under p->lock on every call, we keep a cache
+ * of both tables, indexed by LPARSHORT. Only we write the tables, so
+ * the cache is read from the hardware once at init and after that
+ * every update goes through npu2_xts_write_bdf()/npu2_xts_write_pid(),
+ * which write both.
+ */
+
+#include <skiboot.h>
+#include <pci.h>
+#include <opal.h>
+#include <opal-api.h>
+#include <processor.h>
+#include <lock.h>
+#include <bitutils.h>
+#include <ccan/array_size/array_size.h>
+#include <npu2-regs.h>
+#include <npu2.h>
+
+#define NPU2_XTS_BDF_MAP_REG(id)	(NPU2_XTS_BDF_MAP + (id) * 8)
+#define NPU2_XTS_PID_MAP_REG(id)	(NPU2_XTS_PID_MAP + (id) * 0x20)
+
+void npu2_xts_init(struct npu2 *p)
+{
+	int i;
+
+	BUILD_ASSERT(ARRAY_SIZE(p->xts_bdf_cache) == NPU2_XTS_BDF_MAP_SIZE);
+	BUILD_ASSERT(ARRAY_SIZE(p->xts_pid_cache) == NPU2_XTS_BDF_MAP_SIZE);
+
+	for (i = 0; i < NPU2_XTS_BDF_MAP_SIZE; i++) {
+		p->xts_bdf_cache[i] = npu2_read(p, NPU2_XTS_BDF_MAP_REG(i));
+		p->xts_pid_cache[i] = npu2_read(p, NPU2_XTS_PID_MAP_REG(i));
+	}
+}
+
+static void npu2_xts_write_bdf(struct npu2 *p, int id, uint64_t val)
+{
+	NPU2DBG(p, "XTS_BDF_MAP[%03d] = 0x%08llx\n", id, val);
+	p->xts_bdf_cache[id] = val;
+	npu2_write(p, NPU2_XTS_BDF_MAP_REG(id), val);
+}
+
+static void npu2_xts_write_pid(struct npu2 *p, int id, uint64_t val)
+{
+	NPU2DBG(p, "XTS_PID_MAP[%03d] = 0x%08llx\n", id, val);
+	p->xts_pid_cache[id] = val;
+	npu2_write(p, NPU2_XTS_PID_MAP_REG(id), val);
+}
+
+/*
+ * Search the cached BDF map for an entry with matching value under
+ * mask. Returns the index, which is also the LPARSHORT of the entry,
+ * and the current value in *value.
+ */
+static int npu_table_search(struct npu2 *p, uint64_t *value, uint64_t mask)
+{
+	int i;
+
+	assert(value);
+
+	for (i = 0; i < NPU2_XTS_BDF_MAP_SIZE; i++) {
+		if ((p->xts_bdf_cache[i] & mask) == *value) {
+			*value = p->xts_bdf_cache[i];
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Allocate a context ID and initialise the tables with the relevant
+ * information. Returns the ID on or error if one couldn't be
+ * allocated.
+ */
+#define NPU2_VALID_ATS_MSR_BITS (MSR_DR | MSR_HV | MSR_PR | MSR_SF)
+static int64_t opal_npu_init_context(uint64_t phb_id, int pasid __unused,
+				     uint64_t msr, uint64_t bdf)
+{
+	struct phb *phb = pci_get_phb(phb_id);
+	struct npu2 *p;
+	uint64_t xts_bdf, old_xts_bdf_pid, xts_bdf_pid;
+	int id;
+
+	if (!phb || phb->phb_type != phb_type_npu_v2)
+		return OPAL_PARAMETER;
+
+	/*
+	 * MSR bits should be masked by the caller to allow for future
+	 * expansion if required.
+	 */
+	if (msr & ~NPU2_VALID_ATS_MSR_BITS)
+		return OPAL_UNSUPPORTED;
+
+	/*
+	 * Need to get LPARSHORT.
+	 */
+	p = phb_to_npu2_nvlink(phb);
+	lock(&p->lock);
+	xts_bdf = SETFIELD(NPU2_XTS_BDF_MAP_BDF, 0ul, bdf);
+	if (npu_table_search(p, &xts_bdf, NPU2_XTS_BDF_MAP_BDF) < 0) {
+		NPU2ERR(p, "LPARID not associated with any GPU\n");
+		id = OPAL_PARAMETER;
+		goto out;
+	}
+
+	id = GETFIELD(NPU2_XTS_BDF_MAP_LPARSHORT, xts_bdf);
+	NPU2DBG(p, "Found LPARSHORT = 0x%x for BDF = 0x%03llx\n", id, bdf);
+
+	/* Enable this mapping for both real and virtual addresses */
+	xts_bdf_pid = SETFIELD(NPU2_XTS_PID_MAP_VALID_ATRGPA0, 0UL, 1);
+	xts_bdf_pid = SETFIELD(NPU2_XTS_PID_MAP_VALID_ATRGPA1, xts_bdf_pid, 1);
+
+	/* Enables TLBIE/MMIOSD forwarding for this entry */
+	xts_bdf_pid = SETFIELD(NPU2_XTS_PID_MAP_VALID_ATSD, xts_bdf_pid, 1);
+	xts_bdf_pid = SETFIELD(NPU2_XTS_PID_MAP_LPARSHORT, xts_bdf_pid, id);
+
+	/* Set the relevant MSR bits */
+	xts_bdf_pid = SETFIELD(NPU2_XTS_PID_MAP_MSR_DR, xts_bdf_pid,
+			       !!(msr & MSR_DR));
+	xts_bdf_pid = SETFIELD(NPU2_XTS_PID_MAP_MSR_HV, xts_bdf_pid,
+			       !!(msr & MSR_HV));
+	xts_bdf_pid = SETFIELD(NPU2_XTS_PID_MAP_MSR_PR, xts_bdf_pid,
+			       !!(msr & MSR_PR));
+
+	/* We don't support anything other than 64-bit so we can safely hardcode
+	 * it here */
+	xts_bdf_pid = SETFIELD(NPU2_XTS_PID_MAP_MSR_SF, xts_bdf_pid, 1);
+
+	/*
+	 * Throw an error if the wildcard entry for this bdf is already set
+	 * with different msr bits.
+	 */
+	old_xts_bdf_pid = p->xts_pid_cache[id];
+	if (old_xts_bdf_pid) {
+		if (GETFIELD(NPU2_XTS_PID_MAP_MSR, old_xts_bdf_pid) !=
+		    GETFIELD(NPU2_XTS_PID_MAP_MSR, xts_bdf_pid)) {
+			NPU2ERR(p, "%s: Unexpected MSR value\n", __func__);
+			id = OPAL_PARAMETER;
+		}
+
+		goto out;
+	}
+
+	/* Write the entry */
+	npu2_xts_write_pid(p, id, xts_bdf_pid);
+
+	if (!GETFIELD(NPU2_XTS_BDF_MAP_VALID, xts_bdf)) {
+		xts_bdf = SETFIELD(NPU2_XTS_BDF_MAP_VALID, xts_bdf, 1);
+		npu2_xts_write_bdf(p, id, xts_bdf);
+	}
+
+out:
+	unlock(&p->lock);
+	return id;
+}
+opal_call(OPAL_NPU_INIT_CONTEXT, opal_npu_init_context, 4);
+
+static int opal_npu_destroy_context(uint64_t phb_id, uint64_t pid __unused,
+				    uint64_t bdf)
+{
+	struct phb *phb = pci_get_phb(phb_id);
+	struct npu2 *p;
+	uint64_t xts_bdf;
+	int rc = 0;
+
+	if (!phb || phb->phb_type != phb_type_npu_v2)
+		return OPAL_PARAMETER;
+
+	p = phb_to_npu2_nvlink(phb);
+	lock(&p->lock);
+
+	/* Need to find lparshort for this bdf */
+	xts_bdf = SETFIELD(NPU2_XTS_BDF_MAP_BDF, 0ul, bdf);
+	if (npu_table_search(p, &xts_bdf, NPU2_XTS_BDF_MAP_BDF) < 0) {
+		NPU2ERR(p, "LPARID not associated with any GPU\n");
+		rc = OPAL_PARAMETER;
+	}
+
+	/*
+	 * The bdf/pid table only contains wildcard entries, so we don't
+	 * need to remove anything here.
+	 */
+
+	unlock(&p->lock);
+	return rc;
+}
+opal_call(OPAL_NPU_DESTROY_CONTEXT, opal_npu_destroy_context, 3);
+
+/*
+ * Map the given virtual bdf to lparid with given lpcr.
+ */
+static int opal_npu_map_lpar(uint64_t phb_id, uint64_t bdf, uint64_t lparid,
+			     uint64_t lpcr)
+{
+	struct phb *phb = pci_get_phb(phb_id);
+	struct npu2 *p;
+	struct npu2_dev *ndev = NULL;
+	uint64_t xts_bdf_lpar, rc = OPAL_SUCCESS;
+	int i;
+	int id;
+
+	if (!phb || phb->phb_type != phb_type_npu_v2)
+		return OPAL_PARAMETER;
+
+	if (lpcr)
+		/* The LPCR bits are only required for hash based ATS,
+		 * which we don't currently support but may need to in
+		 * future. */
+		return OPAL_UNSUPPORTED;
+
+	p = phb_to_npu2_nvlink(phb);
+	lock(&p->lock);
+
+	/* Find any existing entries and update them */
+	xts_bdf_lpar = SETFIELD(NPU2_XTS_BDF_MAP_BDF, 0L, bdf);
+	id = npu_table_search(p, &xts_bdf_lpar, NPU2_XTS_BDF_MAP_BDF);
+	if (id < 0) {
+		/* No existing mapping found, find space for a new one */
+		xts_bdf_lpar = 0;
+		id = npu_table_search(p, &xts_bdf_lpar, -1UL);
+	}
+
+	if (id < 0) {
+		/* Unable to find a free mapping */
+		NPU2ERR(p, "No free XTS_BDF[] entry\n");
+		rc = OPAL_RESOURCE;
+		goto out;
+	}
+
+	xts_bdf_lpar = SETFIELD(NPU2_XTS_BDF_MAP_UNFILT, 0UL, 1);
+	xts_bdf_lpar = SETFIELD(NPU2_XTS_BDF_MAP_BDF, xts_bdf_lpar, bdf);
+
+	/* We only support radix for the moment */
+	xts_bdf_lpar = SETFIELD(NPU2_XTS_BDF_MAP_XLAT, xts_bdf_lpar, 0x3);
+	xts_bdf_lpar = SETFIELD(NPU2_XTS_BDF_MAP_LPARID, xts_bdf_lpar, lparid);
+	xts_bdf_lpar = SETFIELD(NPU2_XTS_BDF_MAP_LPARSHORT, xts_bdf_lpar, id);
+
+	/* Need to find an NVLink to send the ATSDs for this device over */
+	for (i = 0; i < p->total_devices; i++) {
+		if (p->devices[i].nvlink.gpu_bdfn == bdf) {
+			ndev = &p->devices[i];
+			break;
+		}
+	}
+
+	if (!ndev) {
+		NPU2ERR(p, "Unable to find nvlink for bdf %llx\n", bdf);
+		rc = OPAL_PARAMETER;
+		goto out;
+	}
+
+	xts_bdf_lpar = SETFIELD(NPU2_XTS_BDF_MAP_STACK, xts_bdf_lpar, 0x4 >> (ndev->index / 2));
+	xts_bdf_lpar = SETFIELD(NPU2_XTS_BDF_MAP_BRICK, xts_bdf_lpar, (ndev->index % 2));
+
+	npu2_xts_write_bdf(p, id, xts_bdf_lpar);
+
+out:
+	unlock(&p->lock);
+	return rc;
+}
+opal_call(OPAL_NPU_MAP_LPAR, opal_npu_map_lpar, 4);
@@ -849,12 +849,16 @@ static bool cpu_pstates_prepare_core(struct proc_chip *chip,
 	return true;
 }
 
+/* Throttle changes are polled, resets and consumed messages kick it */
+#define OCC_THROTTLE_POLL_MS	10
+
 static bool occ_opal_msg_outstanding = false;
 static void occ_msg_consumed(void *data __unused)
 {
 	lock(&occ_lock);
 	occ_opal_msg_outstanding = false;
 	unlock(&occ_lock);
+	opal_kick_pollers(OPAL_POLL_EVT_OCC);
 }
 
 static inline u8 get_cpu_throttle(struct proc_chip *chip)
@@ -1765,7 +1769,8 @@ void occ_pstates_init(void)
 	/* Add opal_poller to poll OCC throttle status of each chip */
 	for_each_chip(chip)
 		chip->throttle = 0;
-	opal_add_poller(occ_throttle_poll, NULL);
+	opal_add_poller_timed(occ_throttle_poll, NULL, "occ-throttle",
+			      OPAL_POLL_EVT_OCC, OCC_THROTTLE_POLL_MS);
 	occ_pstates_initialized = true;
 
 	/* Init OPAL-OCC command-response interface */
@@ -2007,6 +2012,7 @@ int occ_msg_queue_occ_reset(void)
 		chip->throttle = 0;
 	}
 	occ_reset = true;
+	opal_kick_pollers(OPAL_POLL_EVT_OCC);
 out:
 	unlock(&occ_lock);
 	return rc;
@@ -72,6 +72,10 @@ DEFINE_LOG_ENTRY(OPAL_RC_I2C_RESET, OPAL_INPUT_OUTPUT_ERR_EVT, OPAL_I2C,
 #define I2C_FIFO_REG			0x4
 #define I2C_FIFO			PPC_BITMASK(0, 7)
 
+/* I2C FIFO register moving 4 bytes per access, first one in bits 0-7 (P9) */
+#define I2C_FIFO4_REG			0x12
+#define I2C_FIFO4			PPC_BITMASK(0, 31)
+
 /* I2C command register */
 #define I2C_CMD_REG			0x5
 #define I2C_CMD_WITH_START		PPC_BIT(0)
@@ -194,6 +198,7 @@ struct p8_i2c_master {
 	uint64_t		poll_interval;	/* Polling interval  */
 	uint64_t		xscom_base;	/* xscom base of i2cm */
 	uint32_t		fifo_size;	/* Maximum size of FIFO  */
+	bool			fifo4;		/* Has I2C_FIFO4_REG */
 	uint32_t		chip_id;	/* Chip the i2cm sits on */
 	uint32_t		engine_id;	/* Engine# on chip */
 	uint8_t			obuf[4];	/* Offset buffer */
@@ -620,17 +625,28 @@ static int p8_i2c_fifo_read(struct p8_i2c_master *master,
 	uint32_t i;
 	int rc = 0;
 
-	for (i = 0; i < count; i++, buf++) {
-		rc = xscom_read(master->chip_id, master->xscom_base +
-				I2C_FIFO_REG, &fifo);
-		if (rc) {
-			log_simple_error(&e_info(OPAL_RC_I2C_TRANSFER),
-					 "I2C: Failed to read the fifo\n");
-			break;
+	while (count) {
+		/* Whole words through the wide FIFO, the rest bytewise */
+		if (master->fifo4 && count >= 4) {
+			rc = i2cm_read_reg(master, I2C_FIFO4_REG, &fifo);
+			if (rc)
+				break;
+			fifo = GETFIELD(I2C_FIFO4, fifo);
+			for (i = 0; i < 4; i++)
+				*buf++ = fifo >> (24 - 8 * i);
+			count -= 4;
+			continue;
 		}
 
-		*buf = GETFIELD(I2C_FIFO, fifo);
+		rc = i2cm_read_reg(master, I2C_FIFO_REG, &fifo);
+		if (rc)
+			break;
+		*buf++ = GETFIELD(I2C_FIFO, fifo);
+		count--;
 	}
+	if (rc)
+		log_simple_error(&e_info(OPAL_RC_I2C_TRANSFER),
+				 "I2C: Failed to read the fifo\n");
 	return rc;
 }
 
@@ -641,16 +657,28 @@ static int p8_i2c_fifo_write(struct p8_i2c_master *master,
 	uint32_t i;
 	int rc = 0;
 
-	for (i = 0; i < count; i++, buf++) {
-		fifo = SETFIELD(I2C_FIFO, 0ull, *buf);
-		rc = xscom_write(master->chip_id, master->xscom_base +
-				 I2C_FIFO_REG, fifo);
-		if (rc) {
-			log_simple_error(&e_info(OPAL_RC_I2C_TRANSFER),
-					 "I2C: Failed to write the fifo\n");
-			break;
+	while (count) {
+		if (master->fifo4 && count >= 4) {
+			fifo = 0;
+			for (i = 0; i < 4; i++)
+				fifo = fifo << 8 | *buf++;
+			rc = i2cm_write_reg(master, I2C_FIFO4_REG,
+					    SETFIELD(I2C_FIFO4, 0ull, fifo));
+			if (rc)
+				break;
+			count -= 4;
+			continue;
 		}
+
+		rc = i2cm_write_reg(master, I2C_FIFO_REG,
+				    SETFIELD(I2C_FIFO, 0ull, *buf++));
+		if (rc)
+			break;
+		count--;
 	}
+	if (rc)
+		log_simple_error(&e_info(OPAL_RC_I2C_TRANSFER),
+				 "I2C: Failed to write the fifo\n");
 	return rc;
 }
 
@@ -1042,13 +1070,29 @@ static int occ_i2c_unlock(struct p8_i2c_master *master)
 	return rc;
 }
 
+static bool p8_i2c_irq_driven(struct p8_i2c_master *master)
+{
+	return !opal_booting() && master->irq_ok;
+}
+
+/*
+ * Once the interrupt works, polling is only a backup in case one got
+ * lost, there's no point looking more often than a byte may take.
+ */
+static uint64_t p8_i2c_poll_period(struct p8_i2c_master *master)
+{
+	if (p8_i2c_irq_driven(master))
+		return msecs_to_tb(I2C_TIMEOUT_IRQ_MS);
+	return master->poll_interval;
+}
+
 static int p8_i2c_start_request(struct p8_i2c_master *master,
 				struct i2c_request *req)
 {
 	struct p8_i2c_master_port *port;
 	struct p8_i2c_request *request =
 		container_of(req, struct p8_i2c_request, req);
-	uint64_t cmd, poll_interval;
+	uint64_t cmd;
 	int64_t rc;
 
 	DBG("Starting req %d len=%d addr=%02x (offset=%x)\n",
@@ -1182,11 +1226,7 @@ static int p8_i2c_start_request(struct p8_i2c_master *master,
 	/* Run a poll timer for boot cases or non-working interrupts
 	 * cases
 	 */
-	if (!opal_booting() && master->irq_ok)
-		poll_interval = TIMER_POLL;
-	else
-		poll_interval = master->poll_interval;
-	schedule_timer(&master->poller, poll_interval);
+	schedule_timer(&master->poller, p8_i2c_poll_period(master));
 
 	/* If we don't have a user-set timeout then use the master's default */
 	if (!request->timeout)
@@ -1316,12 +1356,21 @@ static uint64_t p8_i2c_run_request(struct i2c_request *req)
 	struct p8_i2c_master_port *port =
 		container_of(bus, struct p8_i2c_master_port, bus);
 	struct p8_i2c_master *master = port->master;
+	struct p8_i2c_request *request =
+		container_of(req, struct p8_i2c_request, req);
 	uint64_t poll_interval = 0;
 
 	lock(&master->lock);
 	p8_i2c_check_status(master);
 	p8_i2c_check_work(master);
-	poll_interval = master->poll_interval;
+	/*
+	 * Once the interrupt works it completes the request, the caller
+	 * only needs to come back if that got lost.
+	 */
+	if (p8_i2c_irq_driven(master) && request->timeout)
+		poll_interval = request->timeout;
+	else
+		poll_interval = master->poll_interval;
 	unlock(&master->lock);
 
 	return poll_interval;
@@ -1419,7 +1468,8 @@ static void p8_i2c_enable_scache(struct timer *t __unused, void *data,
 	unlock(&master->lock);
 }
 
-static void p8_i2c_poll(struct timer *t __unused, void *data, uint64_t now)
+static void p8_i2c_poll(struct timer *t __unused, void *data,
+			uint64_t now __unused)
 {
 	struct p8_i2c_master *master = data;
 
@@ -1436,7 +1486,7 @@ static void p8_i2c_poll(struct timer *t __unused, void *data, uint64_t now)
 	lock(&master->lock);
 	p8_i2c_check_status(master);
 	if (master->state != state_idle)
-		schedule_timer_at(&master->poller, now + master->poll_interval);
+		schedule_timer(&master->poller, p8_i2c_poll_period(master));
 	p8_i2c_check_work(master);
 	unlock(&master->lock);
 }
@@ -1588,6 +1638,8 @@ static void p8_i2c_init_one(struct dt_node *i2cm, enum p8_i2c_master_type type)
 	}
 
 	master->fifo_size = GETFIELD(I2C_EXTD_STAT_FIFO_SIZE, ex_stat);
+	/* Only the processor engines of P9 have it, not P8's nor Centaur's */
+	master->fifo4 = master->type == I2C_POWER8 && proc_gen == proc_gen_p9;
 	list_head_init(&master->req_list);
 	list_head_init(&master->ports);
 
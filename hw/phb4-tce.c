@@ -0,0 +1,182 @@
+/* Copyright 2013-2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * PHB4 TCE cache invalidation
+ *
+ * This is kept apart from the rest of phb4.c so that the exact
+ * sequence of register accesses can be checked against a mock
+ * register file (see hw/test/run-phb4-tce-kill.c).
+ */
+#include <skiboot.h>
+#include <io.h>
+#include <opal.h>
+#include <pci.h>
+#include <chip.h>
+#include <phb4.h>
+#include <phb4-regs.h>
+
+/*
+ * Past this many pages a single PE kill is cheaper than killing the
+ * pages one at a time. It drops the PE's other cached TCEs as well,
+ * which only costs a refetch.
+ */
+#define PHB4_TCE_KILL_PE_THRESHOLD	256
+
+/* Bits of a DMA address that can't be part of a TCE kill */
+#define PHB4_TCE_KILL_ADDR_INVALID	0xf000000000000000ull
+
+static int64_t phb4_wait_bit(struct phb4 *p, uint32_t reg,
+			     uint64_t mask, uint64_t want_val)
+{
+	uint64_t val;
+
+	/* Wait for all pending TCE kills to complete
+	 *
+	 * XXX Add timeout...
+	 */
+	/* XXX SIMICS is nasty... */
+	if ((reg == PHB_TCE_KILL || reg == PHB_DMARD_SYNC) &&
+	    chip_quirk(QUIRK_SIMICS))
+		return OPAL_SUCCESS;
+
+	for (;;) {
+		val = in_be64(p->regs + reg);
+		if (val == 0xffffffffffffffffull) {
+			/* XXX Fenced ? */
+			return OPAL_HARDWARE;
+		}
+		if ((val & mask) == want_val)
+			break;
+
+	}
+	return OPAL_SUCCESS;
+}
+
+/* Wait for the HW to take the previous kill */
+static int64_t phb4_tce_kill_wait_slot(struct phb4 *p)
+{
+	return phb4_wait_bit(p, PHB_TCE_KILL,
+			     PHB_TCE_KILL_ALL |
+			     PHB_TCE_KILL_PE |
+			     PHB_TCE_KILL_ONE, 0);
+}
+
+static int64_t phb4_tce_kill_pe(struct phb4 *p, uint64_t pe_number)
+{
+	int64_t rc;
+
+	rc = phb4_tce_kill_wait_slot(p);
+	if (rc)
+		return rc;
+	out_be64(p->regs + PHB_TCE_KILL, PHB_TCE_KILL_PE |
+		 SETFIELD(PHB_TCE_KILL_PENUM, 0ull, pe_number));
+	return OPAL_SUCCESS;
+}
+
+static int64_t phb4_tce_kill_pages(struct phb4 *p, uint64_t pe_number,
+				   uint32_t tce_size, uint64_t dma_addr,
+				   uint32_t npages)
+{
+	uint64_t psel, last;
+	int64_t rc;
+
+	/* Set appropriate page size */
+	switch(tce_size) {
+	case 0x1000:
+		psel = 0;
+		break;
+	case 0x10000:
+		psel = PHB_TCE_KILL_PSEL | PHB_TCE_KILL_64K;
+		break;
+	case 0x200000:
+		psel = PHB_TCE_KILL_PSEL | PHB_TCE_KILL_2M;
+		break;
+	case 0x40000000:
+		psel = PHB_TCE_KILL_PSEL | PHB_TCE_KILL_1G;
+		break;
+	default:
+		return OPAL_PARAMETER;
+	}
+
+	/*
+	 * Check the whole range up front rather than page by page: if
+	 * the first page is aligned all of them are, so only the last
+	 * one can still run into the invalid address bits.
+	 */
+	if (dma_addr & (PHB4_TCE_KILL_ADDR_INVALID | (tce_size - 1)))
+		return OPAL_PARAMETER;
+	if (!npages)
+		return OPAL_SUCCESS;
+	last = dma_addr + (uint64_t)(npages - 1) * tce_size;
+	if (last < dma_addr || (last & PHB4_TCE_KILL_ADDR_INVALID))
+		return OPAL_PARAMETER;
+
+	if (npages > PHB4_TCE_KILL_PE_THRESHOLD)
+		return phb4_tce_kill_pe(p, pe_number);
+
+	while (npages--) {
+		rc = phb4_tce_kill_wait_slot(p);
+		if (rc)
+			return rc;
+		out_be64(p->regs + PHB_TCE_KILL, PHB_TCE_KILL_ONE | psel |
+			 SETFIELD(PHB_TCE_KILL_PENUM, dma_addr, pe_number));
+		dma_addr += tce_size;
+	}
+
+	return OPAL_SUCCESS;
+}
+
+int64_t phb4_tce_kill(struct phb *phb, uint32_t kill_type,
+		      uint64_t pe_number, uint32_t tce_size,
+		      uint64_t dma_addr, uint32_t npages)
+{
+	struct phb4 *p = phb_to_phb4(phb);
+	int64_t rc;
+
+	sync();
+	switch(kill_type) {
+	case OPAL_PCI_TCE_KILL_PAGES:
+		rc = phb4_tce_kill_pages(p, pe_number, tce_size,
+					 dma_addr, npages);
+		break;
+	case OPAL_PCI_TCE_KILL_PE:
+		rc = phb4_tce_kill_pe(p, pe_number);
+		break;
+	case OPAL_PCI_TCE_KILL_ALL:
+		rc = phb4_tce_kill_wait_slot(p);
+		if (rc)
+			return rc;
+		out_be64(p->regs + PHB_TCE_KILL, PHB_TCE_KILL_ALL);
+		break;
+	default:
+		return OPAL_PARAMETER;
+	}
+	if (rc)
+		return rc;
+
+	/* Start DMA sync process */
+	out_be64(p->regs + PHB_DMARD_SYNC, PHB_DMARD_SYNC_START);
+
+	/* Wait for kill to complete */
+	rc = phb4_wait_bit(p, PHB_Q_DMA_R, PHB_Q_DMA_R_TCE_KILL_STATUS, 0);
+	if (rc)
+		return rc;
+
+	/* Wait for DMA sync to complete */
+	return phb4_wait_bit(p, PHB_DMARD_SYNC,
+			     PHB_DMARD_SYNC_COMPLETE,
+			     PHB_DMARD_SYNC_COMPLETE);
+}
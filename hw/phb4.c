@@ -429,6 +429,73 @@ static int64_t phb4_rc_write(struct phb4 *p, uint32_t offset, uint8_t sz,
 	return OPAL_SUCCESS;
 }
 
+/*
+ * The config space access itself, once the PHB state, the device's
+ * filters and the parameters have all been checked
+ */
+static int64_t phb4_pcicfg_raw_read(struct phb4 *p, uint32_t bdfn,
+				    uint16_t pe, uint32_t offset,
+				    uint32_t size, void *data)
+{
+	uint64_t addr;
+
+	addr = PHB_CA_ENABLE;
+	addr = SETFIELD(PHB_CA_BDFN, addr, bdfn);
+	addr = SETFIELD(PHB_CA_REG, addr, offset & ~3u);
+	addr = SETFIELD(PHB_CA_PE, addr, pe);
+	out_be64(p->regs + PHB_CONFIG_ADDRESS, addr);
+	switch(size) {
+	case 1:
+		*((uint8_t *)data) =
+			in_8(p->regs + PHB_CONFIG_DATA + (offset & 3));
+		PHBLOGCFG(p, "%03x CFG08 Rd %02x=%02x\n",
+			  bdfn, offset, *((uint8_t *)data));
+		break;
+	case 2:
+		*((uint16_t *)data) =
+			in_le16(p->regs + PHB_CONFIG_DATA + (offset & 2));
+		PHBLOGCFG(p, "%03x CFG16 Rd %02x=%04x\n",
+			  bdfn, offset, *((uint16_t *)data));
+		break;
+	case 4:
+		*((uint32_t *)data) = in_le32(p->regs + PHB_CONFIG_DATA);
+		PHBLOGCFG(p, "%03x CFG32 Rd %02x=%08x\n",
+			  bdfn, offset, *((uint32_t *)data));
+		break;
+	default:
+		return OPAL_PARAMETER;
+	}
+	return OPAL_SUCCESS;
+}
+
+static int64_t phb4_pcicfg_raw_write(struct phb4 *p, uint32_t bdfn,
+				     uint16_t pe, uint32_t offset,
+				     uint32_t size, uint32_t data)
+{
+	uint64_t addr;
+
+	addr = PHB_CA_ENABLE;
+	addr = SETFIELD(PHB_CA_BDFN, addr, bdfn);
+	addr = SETFIELD(PHB_CA_REG, addr, offset & ~3u);
+	addr = SETFIELD(PHB_CA_PE, addr, pe);
+	out_be64(p->regs + PHB_CONFIG_ADDRESS, addr);
+	switch(size) {
+	case 1:
+		out_8(p->regs + PHB_CONFIG_DATA + (offset & 3), data);
+		break;
+	case 2:
+		out_le16(p->regs + PHB_CONFIG_DATA + (offset & 2), data);
+		break;
+	case 4:
+		out_le32(p->regs + PHB_CONFIG_DATA, data);
+		break;
+	default:
+		return OPAL_PARAMETER;
+	}
+	PHBLOGCFG(p, "%03x CFG%d Wr %02x=%08x\n", bdfn, 8 * size, offset, data);
+	return OPAL_SUCCESS;
+}
+
 static int64_t phb4_pcicfg_read(struct phb4 *p, uint32_t bdfn,
 				uint32_t offset, uint32_t size,
 				void *data)
@@ -462,11 +529,11 @@ static int64_t phb4_pcicfg_read(struct phb4 *p, uint32_t bdfn,
 	if (bdfn == 0)
 		return phb4_rc_read(p, offset, size, data, use_asb);
 
-	addr = PHB_CA_ENABLE;
-	addr = SETFIELD(PHB_CA_BDFN, addr, bdfn);
-	addr = SETFIELD(PHB_CA_REG, addr, offset & ~3u);
-	addr = SETFIELD(PHB_CA_PE, addr, pe);
 	if (use_asb) {
+		addr = PHB_CA_ENABLE;
+		addr = SETFIELD(PHB_CA_BDFN, addr, bdfn);
+		addr = SETFIELD(PHB_CA_REG, addr, offset & ~3u);
+		addr = SETFIELD(PHB_CA_PE, addr, pe);
 		phb4_write_reg_asb(p, PHB_CONFIG_ADDRESS, addr);
 		sync();
 		val64 = bswap_64(phb4_read_reg_asb(p, PHB_CONFIG_DATA));
@@ -483,31 +550,10 @@ static int64_t phb4_pcicfg_read(struct phb4 *p, uint32_t bdfn,
 		default:
 			return OPAL_PARAMETER;
 		}
-	} else {
-		out_be64(p->regs + PHB_CONFIG_ADDRESS, addr);
-		switch(size) {
-		case 1:
-			*((uint8_t *)data) =
-				in_8(p->regs + PHB_CONFIG_DATA + (offset & 3));
-			PHBLOGCFG(p, "%03x CFG08 Rd %02x=%02x\n",
-				  bdfn, offset, *((uint8_t *)data));
-			break;
-		case 2:
-			*((uint16_t *)data) =
-				in_le16(p->regs + PHB_CONFIG_DATA + (offset & 2));
-			PHBLOGCFG(p, "%03x CFG16 Rd %02x=%04x\n",
-				  bdfn, offset, *((uint16_t *)data));
-			break;
-		case 4:
-			*((uint32_t *)data) = in_le32(p->regs + PHB_CONFIG_DATA);
-			PHBLOGCFG(p, "%03x CFG32 Rd %02x=%08x\n",
-				  bdfn, offset, *((uint32_t *)data));
-			break;
-		default:
-			return OPAL_PARAMETER;
-		}
+		return OPAL_SUCCESS;
 	}
-	return OPAL_SUCCESS;
+
+	return phb4_pcicfg_raw_read(p, bdfn, pe, offset, size, data);
 }
 
 
@@ -526,7 +572,6 @@ static int64_t phb4_pcicfg_write(struct phb4 *p, uint32_t bdfn,
 				 uint32_t offset, uint32_t size,
 				 uint32_t data)
 {
-	uint64_t addr;
 	int64_t rc;
 	uint16_t pe;
 	bool use_asb = false;
@@ -555,31 +600,11 @@ static int64_t phb4_pcicfg_write(struct phb4 *p, uint32_t bdfn,
 	if (bdfn == 0)
 		return phb4_rc_write(p, offset, size, data, use_asb);
 
-	addr = PHB_CA_ENABLE;
-	addr = SETFIELD(PHB_CA_BDFN, addr, bdfn);
-	addr = SETFIELD(PHB_CA_REG, addr, offset & ~3u);
-	addr = SETFIELD(PHB_CA_PE, addr, pe);
-	if (use_asb) {
-		/* We don't support ASB config space writes */
+	/* We don't support ASB config space writes */
+	if (use_asb)
 		return OPAL_UNSUPPORTED;
-	} else {
-		out_be64(p->regs + PHB_CONFIG_ADDRESS, addr);
-		switch(size) {
-		case 1:
-			out_8(p->regs + PHB_CONFIG_DATA + (offset & 3), data);
-			break;
-		case 2:
-			out_le16(p->regs + PHB_CONFIG_DATA + (offset & 2), data);
-			break;
-		case 4:
-			out_le32(p->regs + PHB_CONFIG_DATA, data);
-			break;
-		default:
-			return OPAL_PARAMETER;
-		}
-	}
-	PHBLOGCFG(p, "%03x CFG%d Wr %02x=%08x\n", bdfn, 8 * size, offset, data);
-	return OPAL_SUCCESS;
+
+	return phb4_pcicfg_raw_write(p, bdfn, pe, offset, size, data);
 }
 
 #define PHB4_PCI_CFG_WRITE(size, type)					\
@@ -598,6 +623,112 @@ PHB4_PCI_CFG_WRITE(8, u8)
 PHB4_PCI_CFG_WRITE(16, u16)
 PHB4_PCI_CFG_WRITE(32, u32)
 
+/*
+ * What every access to @bdfn in a vectored batch would find when going
+ * through phb4_pcicfg_read/write(), bar the per access parameters.
+ * OPAL_PARTIAL means the accesses have to go through those one at a
+ * time: the root complex, fenced ASB access and devices with filters.
+ */
+static int64_t phb4_pcicfg_check_run(struct phb4 *p, uint32_t bdfn,
+				     uint16_t *pe)
+{
+	/* See phb4_pcicfg_check() */
+	if ((bdfn >> 8) == 0 && (bdfn & 0xff))
+		return OPAL_HARDWARE;
+	if (p->broken)
+		return OPAL_HARDWARE;
+	if (bdfn == 0)
+		return OPAL_PARTIAL;
+	if (p->flags & (PHB4_AIB_FENCED | PHB4_CFG_BLOCKED))
+		return OPAL_HARDWARE;
+	if (pci_device_has_cfg_reg_filters(&p->phb, bdfn))
+		return OPAL_PARTIAL;
+
+	*pe = p->rte_cache[bdfn];
+	return OPAL_SUCCESS;
+}
+
+static int64_t phb4_pcicfg_access_raw(struct phb4 *p, uint16_t pe,
+				      struct opal_pci_cfg_access *acc,
+				      int64_t run_rc)
+{
+	uint32_t bdfn = be16_to_cpu(acc->bdfn);
+	uint32_t offset = be16_to_cpu(acc->offset);
+	uint32_t size = acc->size;
+	uint32_t val;
+	int64_t rc;
+
+	/* Same order of checks as the single accesses */
+	if (acc->op != OPAL_PCI_CFG_ACCESS_READ &&
+	    acc->op != OPAL_PCI_CFG_ACCESS_WRITE)
+		return OPAL_PARAMETER;
+	if (size != 1 && size != 2 && size != 4)
+		return OPAL_PARAMETER;
+	if (offset > 0xfff || (offset & (size - 1)))
+		return OPAL_PARAMETER;
+	if (run_rc)
+		return run_rc;
+
+	if (acc->op == OPAL_PCI_CFG_ACCESS_WRITE)
+		return phb4_pcicfg_raw_write(p, bdfn, pe, offset, size,
+					     be32_to_cpu(acc->value));
+
+	switch (size) {
+	case 1: {
+		uint8_t v8;
+
+		rc = phb4_pcicfg_raw_read(p, bdfn, pe, offset, 1, &v8);
+		val = v8;
+		break;
+	}
+	case 2: {
+		uint16_t v16;
+
+		rc = phb4_pcicfg_raw_read(p, bdfn, pe, offset, 2, &v16);
+		val = v16;
+		break;
+	}
+	default:
+		rc = phb4_pcicfg_raw_read(p, bdfn, pe, offset, 4, &val);
+	}
+	if (rc == OPAL_SUCCESS)
+		acc->value = cpu_to_be32(val);
+
+	return rc;
+}
+
+/*
+ * Check the PHB state, fences and filters once for each run of
+ * accesses to the same device, then go straight to CONFIG_ADDRESS and
+ * CONFIG_DATA for all of them.
+ */
+static void phb4_pcicfg_access_vector(struct phb *phb,
+				      struct opal_pci_cfg_access *accs,
+				      uint64_t count)
+{
+	struct phb4 *p = phb_to_phb4(phb);
+	uint64_t i, j, end;
+	uint16_t pe = 0;
+	int64_t run_rc, rc;
+
+	for (i = 0; i < count; i = end) {
+		for (end = i + 1; end < count; end++)
+			if (accs[end].bdfn != accs[i].bdfn)
+				break;
+
+		run_rc = phb4_pcicfg_check_run(p, be16_to_cpu(accs[i].bdfn),
+					       &pe);
+		for (j = i; j < end; j++) {
+			if (run_rc == OPAL_PARTIAL)
+				rc = pci_cfg_access_one(phb, &accs[j]);
+			else
+				rc = phb4_pcicfg_access_raw(p, pe, &accs[j],
+							    run_rc);
+			accs[j].rc = cpu_to_be32(rc);
+		}
+	}
+}
+
 static uint8_t phb4_choose_bus(struct phb *phb __unused,
 			       struct pci_device *bridge __unused,
 			       uint8_t candidate, uint8_t *max_bus __unused,
@@ -985,125 +1116,6 @@ static void phb4_init_ioda_cache(struct phb4 *p)
 	p->mbt_cache[0][1] = IODA3_MBT1_ENABLE | ((~(M32_PCI_SIZE - 1)) & IODA3_MBT1_MASK);
 }
 
-static int64_t phb4_wait_bit(struct phb4 *p, uint32_t reg,
-			     uint64_t mask, uint64_t want_val)
-{
-	uint64_t val;
-
-	/* Wait for all pending TCE kills to complete
-	 *
-	 * XXX Add timeout...
-	 */
-	/* XXX SIMICS is nasty... */
-	if ((reg == PHB_TCE_KILL || reg == PHB_DMARD_SYNC) &&
-	    chip_quirk(QUIRK_SIMICS))
-		return OPAL_SUCCESS;
-
-	for (;;) {
-		val = in_be64(p->regs + reg);
-		if (val == 0xffffffffffffffffull) {
-			/* XXX Fenced ? */
-			return OPAL_HARDWARE;
-		}
-		if ((val & mask) == want_val)
-			break;
-
-	}
-	return OPAL_SUCCESS;
-}
-
-static int64_t phb4_tce_kill(struct phb *phb, uint32_t kill_type,
-			     uint64_t pe_number, uint32_t tce_size,
-			     uint64_t dma_addr, uint32_t npages)
-{
-	struct phb4 *p = phb_to_phb4(phb);
-	uint64_t val;
-	int64_t rc;
-
-	sync();
-	switch(kill_type) {
-	case OPAL_PCI_TCE_KILL_PAGES:
-		while (npages--) {
-			/* Wait for a slot in the HW kill queue */
-			rc = phb4_wait_bit(p, PHB_TCE_KILL,
-					   PHB_TCE_KILL_ALL |
-					   PHB_TCE_KILL_PE |
-					   PHB_TCE_KILL_ONE, 0);
-			if (rc)
-				return rc;
-			val = SETFIELD(PHB_TCE_KILL_PENUM, dma_addr, pe_number);
-
-			/* Set appropriate page size */
-			switch(tce_size) {
-			case 0x1000:
-				if (dma_addr & 0xf000000000000fffull)
-					return OPAL_PARAMETER;
-				break;
-			case 0x10000:
-				if (dma_addr & 0xf00000000000ffffull)
-					return OPAL_PARAMETER;
-				val |= PHB_TCE_KILL_PSEL | PHB_TCE_KILL_64K;
-				break;
-			case 0x200000:
-				if (dma_addr & 0xf0000000001fffffull)
-					return OPAL_PARAMETER;
-				val |= PHB_TCE_KILL_PSEL | PHB_TCE_KILL_2M;
-				break;
-			case 0x40000000:
-				if (dma_addr & 0xf00000003fffffffull)
-					return OPAL_PARAMETER;
-				val |= PHB_TCE_KILL_PSEL | PHB_TCE_KILL_1G;
-				break;
-			default:
-				return OPAL_PARAMETER;
-			}
-			/* Perform kill */
-			out_be64(p->regs + PHB_TCE_KILL, PHB_TCE_KILL_ONE | val);
-			/* Next page */
-			dma_addr += tce_size;
-		}
-		break;
-	case OPAL_PCI_TCE_KILL_PE:
-		/* Wait for a slot in the HW kill queue */
-		rc = phb4_wait_bit(p, PHB_TCE_KILL,
-				   PHB_TCE_KILL_ALL |
-				   PHB_TCE_KILL_PE |
-				   PHB_TCE_KILL_ONE, 0);
-		if (rc)
-			return rc;
-		/* Perform kill */
-		out_be64(p->regs + PHB_TCE_KILL, PHB_TCE_KILL_PE |
-			 SETFIELD(PHB_TCE_KILL_PENUM, 0ull, pe_number));
-		break;
-	case OPAL_PCI_TCE_KILL_ALL:
-		/* Wait for a slot in the HW kill queue */
-		rc = phb4_wait_bit(p, PHB_TCE_KILL,
-				   PHB_TCE_KILL_ALL |
-				   PHB_TCE_KILL_PE |
-				   PHB_TCE_KILL_ONE, 0);
-		if (rc)
-			return rc;
-		/* Perform kill */
-		out_be64(p->regs + PHB_TCE_KILL, PHB_TCE_KILL_ALL);
-		break;
-	default:
-		return OPAL_PARAMETER;
-	}
-
-	/* Start DMA sync process */
-	out_be64(p->regs + PHB_DMARD_SYNC, PHB_DMARD_SYNC_START);
-
-	/* Wait for kill to complete */
-	rc = phb4_wait_bit(p, PHB_Q_DMA_R, PHB_Q_DMA_R_TCE_KILL_STATUS, 0);
-	if (rc)
-		return rc;
-
-	/* Wait for DMA sync to complete */
-	return phb4_wait_bit(p, PHB_DMARD_SYNC,
-			     PHB_DMARD_SYNC_COMPLETE,
-			     PHB_DMARD_SYNC_COMPLETE);
-}
-
 /* phb4_ioda_reset - Reset the IODA tables
  *
  * @purge: If true, the cache is cleared and the cleared values
@@ -4263,6 +4275,7 @@ static const struct phb_ops phb4_ops = {
 	.cfg_write8		= phb4_pcicfg_write8,
 	.cfg_write16		= phb4_pcicfg_write16,
 	.cfg_write32		= phb4_pcicfg_write32,
+	.cfg_access_vector	= phb4_pcicfg_access_vector,
 	.choose_bus		= phb4_choose_bus,
 	.get_reserved_pe_number	= phb4_get_reserved_pe_number,
 	.device_init		= phb4_device_init,
@@ -55,6 +55,8 @@ void psi_set_link_polling(bool active)
 	printf("PSI: %sing link polling\n",
 	       active ? "start" : "stopp");
 	psi_link_poll_active = active;
+	if (active)
+		opal_kick_pollers(OPAL_POLL_EVT_PSI);
 }
 
 void psi_disable_link(struct psi *psi)
@@ -161,6 +163,7 @@ struct psi *psi_find_link(uint32_t chip_id)
 }
 
 #define PSI_LINK_CHECK_INTERVAL		10	/* Interval in secs */
+#define PSI_LINK_POLL_MS		100
 #define PSI_LINK_RECOVERY_TIMEOUT	1800	/* 30 minutes */
 
 static void psi_link_poll(void *data __unused)
@@ -1120,7 +1123,8 @@ void psi_fsp_link_in_use(struct psi *psi __unused)
 	/* Do this once only */
 	if (!poller_created) {
 		poller_created = true;
-		opal_add_poller(psi_link_poll, NULL);
+		opal_add_poller_timed(psi_link_poll, NULL, "psi-link",
+				      OPAL_POLL_EVT_PSI, PSI_LINK_POLL_MS);
 	}
 }
 
@@ -0,0 +1,350 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Sending every CPU through an rvwinkle cycle so the SLW engine
+ * reapplies the image on the way out, see slw_reinit().
+ *
+ * All the other cores go down at once. A core is down when all its
+ * threads have said so and its idle state history, cleared from then
+ * on, has logged a transition: nothing runs on it anymore, so that can
+ * only be the winkle. If the history is missed we wait as long as we
+ * always used to. Then they are all woken up together. Our own core
+ * goes last, woken by a thread 0 elsewhere (the "waker").
+ */
+
+#include <skiboot.h>
+#include <xscom.h>
+#include <cpu.h>
+#include <chip.h>
+#include <chiptod.h>
+#include <interrupts.h>
+#include <timebase.h>
+#include <opal-api.h>
+
+/* Threads going down or coming back only take a little while */
+#define SLW_RVWINKLE_STATE_TIMEOUT_MS	100
+/* How long we used to wait, unconditionally, for the cores */
+#define SLW_RVWINKLE_CORE_TIMEOUT_MS	1000
+#define SLW_RVWINKLE_POLL_US		10
+
+/* Set when giving up, so the waker doesn't wait for us forever */
+static bool slw_rvwinkle_aborted;
+
+/* Reading the history clears it */
+static bool slw_read_history(struct cpu_thread *c, uint64_t *val)
+{
+	uint32_t core_id = pir_to_core_id(c->pir);
+
+	if (xscom_read(c->chip_id,
+		       XSCOM_ADDR_P8_EX_SLAVE(core_id,
+					      EX_PM_IDLE_STATE_HISTORY_PHYP),
+		       val)) {
+		prerror("SLW: Failed to read PM_IDLE_STATE_HISTORY"
+			" of core %x:%x\n", c->chip_id, core_id);
+		return false;
+	}
+
+	prlog(PR_TRACE, "SLW: core %x:%x history: 0x%016llx\n",
+	      c->chip_id, core_id, *val);
+	return true;
+}
+
+static bool slw_core_in_state(struct cpu_thread *core,
+			      enum cpu_thread_state state)
+{
+	struct cpu_thread *t;
+	unsigned int i;
+
+	for (i = 0; i < cpu_thread_count; i++) {
+		t = find_cpu_by_pir(core->pir + i);
+		if (t && cpu_is_available(t) && t->state != state)
+			return false;
+	}
+	return true;
+}
+
+enum slw_core_state {
+	SLW_CORE_SKIP,		/* Not going down, ours */
+	SLW_CORE_GOING,		/* Some threads are still running */
+	SLW_CORE_DOWN,		/* History cleared, waiting for it */
+	SLW_CORE_BLIND,		/* Can't read the history, waiting */
+	SLW_CORE_WINKLED,
+};
+
+/* The primaries of the cores going down, indexed by PIR */
+static enum slw_core_state *slw_cores;
+
+static bool slw_wait_threads(struct cpu_thread *me,
+			     enum cpu_thread_state state, bool my_core)
+{
+	unsigned long end = mftb() + msecs_to_tb(SLW_RVWINKLE_STATE_TIMEOUT_MS);
+	struct cpu_thread *cpu;
+	uint64_t val;
+	bool done;
+
+	for (;;) {
+		/* Clear the history of cores as soon as they're down */
+		if (state == cpu_state_rvwinkle) {
+			for_each_available_cpu(cpu) {
+				if (slw_cores[cpu->pir] != SLW_CORE_GOING ||
+				    !slw_core_in_state(cpu, state))
+					continue;
+				if (slw_read_history(cpu, &val))
+					slw_cores[cpu->pir] = SLW_CORE_DOWN;
+				else
+					slw_cores[cpu->pir] = SLW_CORE_BLIND;
+			}
+		}
+
+		done = true;
+		for_each_available_cpu(cpu) {
+			if (cpu == me ||
+			    (!my_core && cpu_is_sibling(cpu, me)) ||
+			    cpu->state == state)
+				continue;
+			done = false;
+			if (tb_compare(mftb(), end) == TB_AAFTERB)
+				prerror("SLW: CPU PIR 0x%04x stuck %s rvwinkle\n",
+					cpu->pir,
+					state == cpu_state_rvwinkle ?
+					"before" : "in");
+		}
+		if (done || tb_compare(mftb(), end) == TB_AAFTERB)
+			return done;
+
+		sync();
+	}
+}
+
+static void slw_wait_cores(void)
+{
+	unsigned long end = mftb() + msecs_to_tb(SLW_RVWINKLE_CORE_TIMEOUT_MS);
+	struct cpu_thread *cpu;
+	unsigned int pending;
+	uint64_t val;
+
+	for (;;) {
+		pending = 0;
+		for_each_available_cpu(cpu) {
+			switch (slw_cores[cpu->pir]) {
+			case SLW_CORE_DOWN:
+				if (!slw_read_history(cpu, &val))
+					slw_cores[cpu->pir] = SLW_CORE_BLIND;
+				else if (val)
+					slw_cores[cpu->pir] = SLW_CORE_WINKLED;
+				break;
+			case SLW_CORE_GOING:
+				/* Only if it was down too late to notice */
+				slw_cores[cpu->pir] = SLW_CORE_BLIND;
+				break;
+			default:
+				break;
+			}
+			if (slw_cores[cpu->pir] == SLW_CORE_DOWN ||
+			    slw_cores[cpu->pir] == SLW_CORE_BLIND)
+				pending++;
+		}
+		if (!pending)
+			return;
+		if (tb_compare(mftb(), end) == TB_AAFTERB) {
+			prlog(PR_DEBUG, "SLW: %u cores didn't log their winkle,"
+			      " going on\n", pending);
+			return;
+		}
+		time_wait_us(SLW_RVWINKLE_POLL_US);
+	}
+}
+
+/* Wake up the CPUs in rvwinkle, ours too if asked, and wait for them */
+static bool slw_wake_threads(struct cpu_thread *me, bool my_core)
+{
+	struct cpu_thread *cpu;
+
+	for_each_available_cpu(cpu) {
+		if (cpu->state != cpu_state_rvwinkle ||
+		    (!my_core && cpu_is_sibling(cpu, me)))
+			continue;
+		icp_kick_cpu(cpu);
+	}
+
+	return slw_wait_threads(me, cpu_state_active, my_core);
+}
+
+/* Runs on the master's waker, once the other cores are back */
+static void slw_wake_master(struct cpu_thread *master)
+{
+	unsigned long end;
+	struct cpu_thread *cpu;
+	uint64_t val = 0;
+
+	/* Allriiiight... now wait for master to go down */
+	while (master->state != cpu_state_rvwinkle) {
+		if (slw_rvwinkle_aborted)
+			return;
+		sync();
+	}
+
+	/* Its siblings are already down, it's the last one */
+	end = mftb() + msecs_to_tb(SLW_RVWINKLE_CORE_TIMEOUT_MS);
+	if (slw_read_history(master, &val)) {
+		do {
+			time_wait_us(SLW_RVWINKLE_POLL_US);
+			if (!slw_read_history(master, &val))
+				break;
+		} while (!val && tb_compare(mftb(), end) != TB_AAFTERB);
+	}
+
+	prlog(PR_DEBUG, "SLW: Waking master (PIR 0x%04x)...\n", master->pir);
+
+	/* Now poke all the secondary threads on the master's core */
+	for_each_cpu(cpu) {
+		if (!cpu_is_sibling(cpu, master) || (cpu == master))
+			continue;
+		icp_kick_cpu(cpu);
+	}
+	end = mftb() + msecs_to_tb(SLW_RVWINKLE_STATE_TIMEOUT_MS);
+	for_each_cpu(cpu) {
+		if (!cpu_is_sibling(cpu, master) || (cpu == master))
+			continue;
+		while (cpu->state != cpu_state_active &&
+		       tb_compare(mftb(), end) != TB_AAFTERB)
+			sync();
+		if (cpu->state != cpu_state_active)
+			prerror("SLW: CPU PIR 0x%04x stuck in rvwinkle\n",
+				cpu->pir);
+	}
+
+	/* Now poke the master and be gone */
+	icp_kick_cpu(master);
+}
+
+void slw_do_rvwinkle(void *data)
+{
+	struct cpu_thread *cpu = this_cpu();
+	struct cpu_thread *master = data;
+	uint64_t lpcr = mfspr(SPR_LPCR);
+
+	/* Setup our ICP to receive IPIs */
+	icp_prep_for_pm();
+
+	/* Setup LPCR to wakeup on external interrupts only */
+	mtspr(SPR_LPCR, ((lpcr & ~SPR_LPCR_P8_PECE) | SPR_LPCR_P8_PECE2));
+
+	prlog(PR_DEBUG, "SLW: CPU PIR 0x%04x goint to rvwinkle...\n",
+	      cpu->pir);
+
+	/* Tell that we got it */
+	cpu->state = cpu_state_rvwinkle;
+
+	enter_p8_pm_state(1);
+
+	/* Restore SPRs */
+	init_shared_sprs();
+	init_replicated_sprs();
+
+	/* Ok, it's ours again */
+	cpu->state = cpu_state_active;
+
+	prlog(PR_DEBUG, "SLW: CPU PIR 0x%04x woken up !\n", cpu->pir);
+
+	/* Cleanup our ICP */
+	reset_cpu_icp();
+
+	/* Resync timebase */
+	chiptod_wakeup_resync();
+
+	/* Restore LPCR */
+	mtspr(SPR_LPCR, lpcr);
+
+	/* If we are passed a master pointer we are the designated
+	 * waker, let's proceed. If not, return, we are finished.
+	 */
+	if (!master)
+		return;
+
+	prlog(PR_DEBUG, "SLW: CPU PIR 0x%04x waiting for master...\n",
+	      cpu->pir);
+
+	slw_wake_master(master);
+}
+
+/* OPAL_TIMEOUT once jobs are queued: some cores may have been through
+ * rvwinkle. Any other error means nobody was asked to go down.
+ */
+int64_t slw_rvwinkle_others(void)
+{
+	struct cpu_thread *me = this_cpu(), *waker = NULL, *cpu;
+	int64_t rc = OPAL_SUCCESS;
+
+	/* Pick up a waker for myself: it must not be a sibling of
+	 * the current CPU and must be a thread 0 (so it gets to
+	 * sync its timebase before waiting). Without one, that means
+	 * we have no other core in the system, we can't do it.
+	 */
+	for_each_available_cpu(cpu) {
+		if (!cpu_is_sibling(cpu, me) && cpu_is_thread0(cpu)) {
+			waker = cpu;
+			break;
+		}
+	}
+	if (!waker) {
+		prlog(PR_TRACE, "SLW: No candidate waker, giving up !\n");
+		return OPAL_HARDWARE;
+	}
+
+	slw_cores = zalloc((cpu_max_pir + 1) * sizeof(*slw_cores));
+	if (!slw_cores)
+		return OPAL_NO_MEM;
+	for_each_available_cpu(cpu)
+		if (cpu_is_thread0(cpu) && !cpu_is_sibling(cpu, me))
+			slw_cores[cpu->pir] = SLW_CORE_GOING;
+	slw_rvwinkle_aborted = false;
+
+	/* rvwinkle everybody at once, the waker waits for me */
+	for_each_available_cpu(cpu) {
+		if (cpu == me)
+			continue;
+		__cpu_queue_job(cpu, "slw_do_rvwinkle", slw_do_rvwinkle,
+				cpu == waker ? me : NULL, true);
+	}
+
+	/* Wait for them to claim to be down, then for the cores to be */
+	if (!slw_wait_threads(me, cpu_state_rvwinkle, true)) {
+		rc = OPAL_TIMEOUT;
+		goto abort;
+	}
+	slw_wait_cores();
+
+	/* Wake everybody except on my core */
+	if (!slw_wake_threads(me, false)) {
+		rc = OPAL_TIMEOUT;
+		goto abort;
+	}
+
+	free(slw_cores);
+	slw_cores = NULL;
+	return OPAL_SUCCESS;
+
+ abort:
+	prerror("SLW: Giving up rvwinkle, waking everybody\n");
+	slw_rvwinkle_aborted = true;
+	lwsync();
+	slw_wake_threads(me, true);
+	free(slw_cores);
+	slw_cores = NULL;
+	return rc;
+}
@@ -31,6 +31,7 @@
 #include <opal-api.h>
 #include <nvram.h>
 #include <sbe-p8.h>
+#include <chip-init.h>
 
 #include <p9_stop_api.H>
 #include <p8_pore_table_gen_api.H>
@@ -61,93 +62,6 @@ DEFINE_LOG_ENTRY(OPAL_RC_SLW_REG, OPAL_PLATFORM_ERR_EVT, OPAL_SLW,
 		 OPAL_PLATFORM_FIRMWARE, OPAL_INFO,
 		 OPAL_NA);
 
-static void slw_do_rvwinkle(void *data)
-{
-	struct cpu_thread *cpu = this_cpu();
-	struct cpu_thread *master = data;
-	uint64_t lpcr = mfspr(SPR_LPCR);
-	struct proc_chip *chip;
-
-	/* Setup our ICP to receive IPIs */
-	icp_prep_for_pm();
-
-	/* Setup LPCR to wakeup on external interrupts only */
-	mtspr(SPR_LPCR, ((lpcr & ~SPR_LPCR_P8_PECE) | SPR_LPCR_P8_PECE2));
-
-	prlog(PR_DEBUG, "SLW: CPU PIR 0x%04x goint to rvwinkle...\n",
-	      cpu->pir);
-
-	/* Tell that we got it */
-	cpu->state = cpu_state_rvwinkle;
-
-	enter_p8_pm_state(1);
-
-	/* Restore SPRs */
-	init_shared_sprs();
-	init_replicated_sprs();
-
-	/* Ok, it's ours again */
-	cpu->state = cpu_state_active;
-
-	prlog(PR_DEBUG, "SLW: CPU PIR 0x%04x woken up !\n", cpu->pir);
-
-	/* Cleanup our ICP */
-	reset_cpu_icp();
-
-	/* Resync timebase */
-	chiptod_wakeup_resync();
-
-	/* Restore LPCR */
-	mtspr(SPR_LPCR, lpcr);
-
-	/* If we are passed a master pointer we are the designated
-	 * waker, let's proceed. If not, return, we are finished.
-	 */
-	if (!master)
-		return;
-
-	prlog(PR_DEBUG, "SLW: CPU PIR 0x%04x waiting for master...\n",
-	      cpu->pir);
-
-	/* Allriiiight... now wait for master to go down */
-	while(master->state != cpu_state_rvwinkle)
-		sync();
-
-	/* XXX Wait one second ! (should check xscom state ? ) */
-	time_wait_ms(1000);
-
-	for_each_chip(chip) {
-		struct cpu_thread *c;
-		uint64_t tmp;
-		for_each_available_core_in_chip(c, chip->id) {
-			xscom_read(chip->id,
-				 XSCOM_ADDR_P8_EX_SLAVE(pir_to_core_id(c->pir),
-							EX_PM_IDLE_STATE_HISTORY_PHYP),
-				   &tmp);	
-			prlog(PR_TRACE, "SLW: core %x:%x"
-			      " history: 0x%016llx (mid2)\n",
-			      chip->id, pir_to_core_id(c->pir),
-			      tmp);
-		}
-	}
-
-	prlog(PR_DEBUG, "SLW: Waking master (PIR 0x%04x)...\n", master->pir);
-
-	/* Now poke all the secondary threads on the master's core */
-	for_each_cpu(cpu) {
-		if (!cpu_is_sibling(cpu, master) || (cpu == master))
-			continue;
-		icp_kick_cpu(cpu);
-
-		/* Wait for it to claim to be back (XXX ADD TIMEOUT) */
-		while(cpu->state != cpu_state_active)
-			sync();
-	}
-
-	/* Now poke the master and be gone */
-	icp_kick_cpu(master);
-}
-
 static void slw_patch_reset(void)
 {
 	uint32_t *src, *dst, *sav;
@@ -1152,11 +1066,15 @@ static void slw_cleanup_chip(struct proc_chip *chip)
 		slw_cleanup_core(chip, c);
 }
 
+/* Nothing to put back, we couldn't read what was there */
+#define SLW_SCANS_UNKNOWN	(~0ull)
+
 static void slw_patch_scans(struct proc_chip *chip, bool le_mode)
 {
 	int64_t rc;
 	uint64_t old_val, new_val;
 
+	chip->slw_saved_scans = SLW_SCANS_UNKNOWN;
 	rc = sbe_xip_get_scalar((void *)chip->slw_base,
 				"skip_ex_override_ring_scans", &old_val);
 	if (rc) {
@@ -1165,6 +1083,7 @@ static void slw_patch_scans(struct proc_chip *chip, bool le_mode)
 			chip->id);
 		return;
 	}
+	chip->slw_saved_scans = old_val;
 
 	new_val = le_mode ? 0 : 1;
 
@@ -1180,12 +1099,29 @@ static void slw_patch_scans(struct proc_chip *chip, bool le_mode)
 	}
 }
 
+/* Back to what slw_patch_scans() found */
+static void slw_unpatch_scans(struct proc_chip *chip)
+{
+	int64_t rc;
+
+	if (chip->slw_saved_scans == SLW_SCANS_UNKNOWN)
+		return;
+
+	rc = sbe_xip_set_scalar((void *)chip->slw_base,
+				"skip_ex_override_ring_scans",
+				chip->slw_saved_scans);
+	if (rc)
+		log_simple_error(&e_info(OPAL_RC_SLW_REG),
+			"SLW: Failed to restore LE mode on chip %d\n",
+			chip->id);
+}
+
 int64_t slw_reinit(uint64_t flags)
 {
 	struct proc_chip *chip;
-	struct cpu_thread *cpu;
-	bool has_waker = false;
 	bool target_le = slw_current_le;
+	bool prev_le = slw_current_le;
+	int64_t rc;
 
 	if (proc_gen < proc_gen_p8)
 		return OPAL_UNSUPPORTED;
@@ -1200,96 +1136,53 @@ int64_t slw_reinit(uint64_t flags)
 	      this_cpu()->pir,
 	      target_le ? "little" : "big");
 
-	/* Prepare chips/cores for rvwinkle */
+	/* Check them all before we change any */
 	for_each_chip(chip) {
 		if (!chip->slw_base) {
 			log_simple_error(&e_info(OPAL_RC_SLW_INIT),
 				"SLW: Not found on chip %d\n", chip->id);
 			return OPAL_HARDWARE;
 		}
+	}
 
+	/* Prepare chips/cores for rvwinkle */
+	for_each_chip(chip)
 		slw_patch_scans(chip, target_le);
-	}
 	slw_current_le = target_le;
 
 	/* XXX Save HIDs ? Or do that in head.S ... */
 
 	slw_patch_reset();
 
-	/* rvwinkle everybody and pick one to wake me once I rvwinkle myself */
-	for_each_available_cpu(cpu) {
-		struct cpu_thread *master = NULL;
-
-		if (cpu == this_cpu())
-			continue;
-
-		/* Pick up a waker for myself: it must not be a sibling of
-		 * the current CPU and must be a thread 0 (so it gets to
-		 * sync its timebase before doing time_wait_ms()
-		 */
-		if (!has_waker && !cpu_is_sibling(cpu, this_cpu()) &&
-		    cpu_is_thread0(cpu)) {
-			has_waker = true;
-			master = this_cpu();
-		}
-		__cpu_queue_job(cpu, "slw_do_rvwinkle",
-				slw_do_rvwinkle, master, true);
-
-		/* Wait for it to claim to be down */
-		while(cpu->state != cpu_state_rvwinkle)
-			sync();		
-	}
-
-	/* XXX Wait one second ! (should check xscom state ? ) */
-	prlog(PR_TRACE, "SLW: Waiting one second...\n");
-	time_wait_ms(1000);
-	prlog(PR_TRACE, "SLW: Done.\n");
-
-	for_each_chip(chip) {
-		struct cpu_thread *c;
-		uint64_t tmp;
-		for_each_available_core_in_chip(c, chip->id) {
-			xscom_read(chip->id,
-				 XSCOM_ADDR_P8_EX_SLAVE(pir_to_core_id(c->pir),
-							EX_PM_IDLE_STATE_HISTORY_PHYP),
-				   &tmp);
-			prlog(PR_DEBUG, "SLW: core %x:%x"
-			      " history: 0x%016llx (mid)\n",
-			      chip->id, pir_to_core_id(c->pir), tmp);
-		}
-	}
-
-
-	/* Wake everybody except on my core */
-	for_each_cpu(cpu) {
-		if (cpu->state != cpu_state_rvwinkle ||
-		    cpu_is_sibling(cpu, this_cpu()))
-			continue;
-		icp_kick_cpu(cpu);
-
-		/* Wait for it to claim to be back (XXX ADD TIMEOUT) */
-		while(cpu->state != cpu_state_active)
-			sync();
-	}
-
-	/* Did we find a waker ? If we didn't, that means we had no
-	 * other core in the system, we can't do it
+	/* rvwinkle everybody else, with one to wake me once I rvwinkle
+	 * myself
 	 */
-	if (!has_waker) {
-		prlog(PR_TRACE, "SLW: No candidate waker, giving up !\n");
-		return OPAL_HARDWARE;
+	rc = slw_rvwinkle_others();
+	if (rc && rc != OPAL_TIMEOUT) {
+		/* Nobody went down, leave things as we found them */
+		slw_unpatch_reset();
+		for_each_chip(chip)
+			slw_unpatch_scans(chip);
+		slw_current_le = prev_le;
+		return rc;
 	}
 
 	/* Our siblings are rvwinkling, and our waker is waiting for us
-	 * so let's just go down now
+	 * so let's just go down now. If they timed out, some cores may
+	 * have come back with the new state already: keep it, and clean
+	 * up after them all the same.
 	 */
-	slw_do_rvwinkle(NULL);
+	if (!rc)
+		slw_do_rvwinkle(NULL);
 
 	slw_unpatch_reset();
 
 	for_each_chip(chip)
 		slw_cleanup_chip(chip);
 
+	if (rc)
+		return rc;
+
 	prlog(PR_TRACE, "SLW Reinit complete !\n");
 
 	return OPAL_SUCCESS;
@@ -1497,25 +1390,32 @@ static int64_t opal_config_cpu_idle_state(uint64_t state, uint64_t enter)
 
 opal_call(OPAL_CONFIG_CPU_IDLE_STATE, opal_config_cpu_idle_state, 2);
 
-int64_t opal_slw_set_reg(uint64_t cpu_pir, uint64_t sprn, uint64_t val)
+static struct cpu_thread *slw_reg_cpu(uint64_t cpu_pir,
+				      struct proc_chip **chip)
 {
-
 	struct cpu_thread *c = find_cpu_by_pir(cpu_pir);
-	struct proc_chip *chip;
-	int rc;
 
 	if (!c) {
 		prerror("SLW: Unknown thread with pir %x\n", (u32) cpu_pir);
-		return OPAL_PARAMETER;
+		return NULL;
 	}
 
-	chip = get_chip(c->chip_id);
-	if (!chip) {
+	if (!*chip || (*chip)->id != c->chip_id)
+		*chip = get_chip(c->chip_id);
+	if (!*chip) {
 		prerror("SLW: Unknown chip for thread with pir %x\n",
 			(u32) cpu_pir);
-		return OPAL_PARAMETER;
+		return NULL;
 	}
 
+	return c;
+}
+
+static int64_t slw_set_reg_on(struct cpu_thread *c, struct proc_chip *chip,
+			      uint64_t sprn, uint64_t val)
+{
+	int rc;
+
 	if (proc_gen == proc_gen_p9) {
 		if (!has_deep_states) {
 			prlog(PR_INFO, "SLW: Deep states not enabled\n");
@@ -1529,7 +1429,7 @@ int64_t opal_slw_set_reg(uint64_t cpu_pir, uint64_t sprn, uint64_t val)
 			return OPAL_INTERNAL_ERROR;
 		}
 		rc = p9_stop_save_cpureg((void *)chip->homer_base,
-					 sprn, val, cpu_pir);
+					 sprn, val, c->pir);
 
 	} else if (proc_gen == proc_gen_p8) {
 		int spr_is_supported = 0;
@@ -1570,37 +1470,107 @@ int64_t opal_slw_set_reg(uint64_t cpu_pir, uint64_t sprn, uint64_t val)
 	prlog(PR_DEBUG, "SLW: restore spr:0x%llx on c:0x%x with 0x%llx\n",
 	      sprn, c->pir, val);
 	return OPAL_SUCCESS;
+}
+
+int64_t opal_slw_set_reg(uint64_t cpu_pir, uint64_t sprn, uint64_t val)
+{
+	struct proc_chip *chip = NULL;
+	struct cpu_thread *c;
+
+	c = slw_reg_cpu(cpu_pir, &chip);
+	if (!c)
+		return OPAL_PARAMETER;
 
+	return slw_set_reg_on(c, chip, sprn, val);
 }
 
 opal_call(OPAL_SLW_SET_REG, opal_slw_set_reg, 3);
 
-void slw_init(void)
+/*
+ * The SPRs of all the threads in one call, each entry getting its own
+ * return code like OPAL_SLW_SET_REG would have, a failed one doesn't
+ * stop the ones after it. Sorted by core, consecutive entries reuse
+ * the thread and chip already looked up.
+ */
+static int64_t opal_slw_set_reg_vector(struct opal_slw_reg *regs,
+				       uint64_t count)
 {
-	struct proc_chip *chip;
+	struct proc_chip *chip = NULL;
+	struct cpu_thread *c = NULL;
+	bool failed = false, no_deep;
+	uint32_t pir;
+	int64_t rc;
+	uint64_t i;
 
-	if (proc_chip_quirks & QUIRK_MAMBO_CALLOUTS) {
-		wakeup_engine_state = WAKEUP_ENGINE_NOT_PRESENT;
-		add_cpu_idle_state_properties();
-		return;
+	if (!count || count > OPAL_SLW_SET_REG_MAX)
+		return OPAL_PARAMETER;
+	if (!opal_addr_valid(regs) || !opal_addr_valid(&regs[count - 1] + 1))
+		return OPAL_PARAMETER;
+
+	/*
+	 * Nothing to set without deep states, say so once rather than for
+	 * every entry. A bad PIR still fails like the single call.
+	 */
+	no_deep = proc_gen == proc_gen_p9 && !has_deep_states;
+	if (no_deep)
+		prlog(PR_INFO, "SLW: Deep states not enabled\n");
+
+	for (i = 0; i < count; i++) {
+		pir = be32_to_cpu(regs[i].pir);
+		if (!c || c->pir != pir)
+			c = slw_reg_cpu(pir, &chip);
+		if (!c)
+			rc = OPAL_PARAMETER;
+		else if (no_deep)
+			rc = OPAL_SUCCESS;
+		else
+			rc = slw_set_reg_on(c, chip, be32_to_cpu(regs[i].sprn),
+					    be64_to_cpu(regs[i].value));
+		regs[i].rc = cpu_to_be32(rc);
+		if (rc)
+			failed = true;
 	}
+
+	return failed ? OPAL_PARTIAL : OPAL_SUCCESS;
+}
+opal_call(OPAL_SLW_SET_REG_VECTOR, opal_slw_set_reg_vector, 2);
+
+/*
+ * Runs for all the chips at once, so every chip with a good image sets
+ * the engine present and is the only one patched from here, whatever
+ * the other chips found.
+ */
+static void slw_init_chip(struct proc_chip *chip)
+{
+	if (proc_chip_quirks & QUIRK_MAMBO_CALLOUTS)
+		return;
+
 	if (proc_gen == proc_gen_p8) {
-		for_each_chip(chip) {
-			slw_init_chip_p8(chip);
-			if(slw_image_check_p8(chip))
-				wakeup_engine_state = WAKEUP_ENGINE_PRESENT;
-			if (wakeup_engine_state == WAKEUP_ENGINE_PRESENT)
-				slw_late_init_p8(chip);
+		slw_init_chip_p8(chip);
+		if (slw_image_check_p8(chip)) {
+			wakeup_engine_state = WAKEUP_ENGINE_PRESENT;
+			slw_late_init_p8(chip);
 		}
-		p8_sbe_init_timer();
 	} else if (proc_gen == proc_gen_p9) {
-		for_each_chip(chip) {
-			slw_init_chip_p9(chip);
-			if(slw_image_check_p9(chip))
-				wakeup_engine_state = WAKEUP_ENGINE_PRESENT;
-			if (wakeup_engine_state == WAKEUP_ENGINE_PRESENT)
-				slw_late_init_p9(chip);
+		slw_init_chip_p9(chip);
+		if (slw_image_check_p9(chip)) {
+			wakeup_engine_state = WAKEUP_ENGINE_PRESENT;
+			slw_late_init_p9(chip);
 		}
 	}
+}
+
+static void slw_init_finish(void)
+{
+	if (proc_chip_quirks & QUIRK_MAMBO_CALLOUTS)
+		wakeup_engine_state = WAKEUP_ENGINE_NOT_PRESENT;
+	else if (proc_gen == proc_gen_p8)
+		p8_sbe_init_timer();
 	add_cpu_idle_state_properties();
 }
+
+const struct chip_init_unit slw_chip_unit = {
+	.name		= "slw",
+	.init_chip	= slw_init_chip,
+	.finish		= slw_init_finish,
+};
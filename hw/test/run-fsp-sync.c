@@ -0,0 +1,465 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * fsp_sync_msg() against a model of the FSP mailbox, acking what we
+ * send after ACK_US and answering after a per test latency, or never.
+ * Time only moves in time_wait() and a little per poller run. Checks
+ * how long after the response lands the sender returns, how often it
+ * runs the pollers while waiting, and that a response which never
+ * comes times the message out right at its class deadline.
+ */
+
+#define __TEST__
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+#define sync()
+#define lwsync()
+#define smt_lowest()
+#define smt_medium()
+
+/* Replace the MMIO accessors with the mock mailbox */
+#define __IO_H
+#include <skiboot.h>
+#include <errorlog.h>
+#include <mem_region-malloc.h>
+
+static uint32_t in_be32(volatile void *addr);
+static void out_be32(volatile void *addr, uint32_t val);
+static uint64_t in_be64(volatile void *addr);
+
+#undef zalloc
+#undef free
+#define zalloc(bytes) calloc((bytes), 1)
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+static unsigned int nr_errors;
+
+#undef prlog
+#define prlog(l, ...) do {			\
+	if ((l) <= PR_ERR)			\
+		nr_errors++;			\
+	mock_printf(__VA_ARGS__);		\
+} while (0)
+#undef printf
+#define printf(...) mock_printf(__VA_ARGS__)
+#undef log_simple_error
+#define log_simple_error(e_info, ...) ({	\
+	(void)(e_info);				\
+	nr_errors++;				\
+	mock_printf(__VA_ARGS__);		\
+	0;					\
+})
+
+#include "../fsp/fsp.c"
+#include "../../ccan/list/list.c"
+
+#define ACK_US		20
+#define POLL_US		1
+#define NR_MSGS		200
+
+unsigned long tb_hz = 512000000;
+struct dt_node *dt_root;
+
+static struct fsp fsp;
+static struct psi psi;
+static uint8_t mbox_regs[0x1000];
+
+static struct {
+	uint32_t hdata[16];
+	uint32_t w0, w1;	/* The message sent */
+	bool xup, hpend;
+	unsigned long ack_due, resp_due;
+	unsigned long resp_lat;
+	bool answer;
+	unsigned int nr_sent;
+} mbox;
+
+static struct timer *armed_timer;
+static unsigned long nr_polls, nr_sleeps;
+
+/* When the response hit the mailbox, for the wake latency */
+static unsigned long resp_landed;
+
+static void mbox_update(void)
+{
+	if (mbox.ack_due && stamp >= mbox.ack_due) {
+		mbox.xup = true;
+		mbox.ack_due = 0;
+	}
+	if (mbox.resp_due && stamp >= mbox.resp_due && !mbox.hpend) {
+		mbox.hpend = true;
+		resp_landed = mbox.resp_due;
+		mbox.resp_due = 0;
+	}
+}
+
+static uint32_t in_be32(volatile void *addr)
+{
+	uint32_t reg = (uint8_t *)addr - mbox_regs;
+
+	mbox_update();
+
+	switch (reg) {
+	case FSP_MBX1_HCTL_REG:
+		return (mbox.xup ? FSP_MBX_CTL_XUP : 0) |
+			(mbox.hpend ? FSP_MBX_CTL_HPEND : 0);
+	case FSP_MBX1_FHDR0_REG:
+		assert(mbox.hpend);
+		return 8 << 16;
+	case FSP_MBX1_FDATA_AREA:
+		assert(mbox.hpend);
+		return mbox.w0;
+	case FSP_MBX1_FDATA_AREA + 4:
+		assert(mbox.hpend);
+		return (mbox.w1 & 0xff) | 0x80;
+	}
+	return 0;
+}
+
+static void out_be32(volatile void *addr, uint32_t val)
+{
+	uint32_t reg = (uint8_t *)addr - mbox_regs;
+
+	if (reg >= FSP_MBX1_HDATA_AREA &&
+	    reg < FSP_MBX1_HDATA_AREA + sizeof(mbox.hdata)) {
+		mbox.hdata[(reg - FSP_MBX1_HDATA_AREA) / 4] = val;
+		return;
+	}
+	if (reg != FSP_MBX1_HCTL_REG)
+		return;
+
+	if (val & FSP_MBX_CTL_SPPEND) {
+		assert(!mbox.ack_due && !mbox.resp_due && !mbox.xup);
+		mbox.w0 = mbox.hdata[0];
+		mbox.w1 = mbox.hdata[1];
+		mbox.ack_due = stamp + usecs_to_tb(ACK_US);
+		if (mbox.answer)
+			mbox.resp_due = mbox.ack_due + mbox.resp_lat;
+		mbox.nr_sent++;
+	}
+	if (val & FSP_MBX_CTL_XUP)
+		mbox.xup = false;
+	if (val & FSP_MBX_CTL_HPEND)
+		mbox.hpend = false;
+}
+
+void init_timer(struct timer *t, timer_func_t expiry, void *data)
+{
+	t->link.next = t->link.prev = NULL;
+	t->target = 0;
+	t->expiry = expiry;
+	t->user_data = data;
+	t->running = NULL;
+}
+
+void schedule_timer_at(struct timer *t, uint64_t when)
+{
+	assert(!armed_timer || armed_timer == t);
+	t->target = when;
+	armed_timer = t;
+}
+
+void opal_run_pollers(void)
+{
+	struct timer *t = armed_timer;
+
+	nr_polls++;
+	stamp += usecs_to_tb(POLL_US);
+	fsp_opal_poll(NULL);
+
+	if (t && stamp >= t->target) {
+		armed_timer = NULL;
+		t->expiry(t, t->user_data, stamp);
+	}
+}
+
+void time_wait_us(unsigned long us)
+{
+	nr_sleeps++;
+	stamp += usecs_to_tb(us);
+}
+
+void time_wait_nopoll(unsigned long duration)
+{
+	stamp += duration;
+}
+
+void opal_add_poller_timed(void (*poller)(void *data) __unused,
+			   void *data __unused, const char *name __unused,
+			   uint64_t events __unused,
+			   unsigned long interval_ms __unused)
+{
+}
+
+void opal_kick_pollers(uint64_t events __unused)
+{
+}
+
+bool psi_check_link_active(struct psi *p __unused)
+{
+	return true;
+}
+
+bool psi_poll_fsp_interrupt(struct psi *p __unused)
+{
+	return false;
+}
+
+void psi_enable_fsp_interrupt(struct psi *p __unused)
+{
+}
+
+void psi_disable_link(struct psi *p __unused)
+{
+}
+
+void psi_reset_fsp(struct psi *p __unused)
+{
+}
+
+void psi_init_for_fsp(struct psi *p __unused)
+{
+}
+
+void psi_fsp_link_in_use(struct psi *p __unused)
+{
+}
+
+struct psi *psi_find_link(uint32_t xscom_base __unused)
+{
+	return NULL;
+}
+
+void fsp_fips_dump_notify(uint32_t dump_id __unused,
+			  uint32_t dump_size __unused)
+{
+}
+
+void trace_add(union trace *trace __unused, u8 type __unused,
+	       u16 len __unused)
+{
+}
+
+void *__memalign(size_t blocksize __unused, size_t bytes __unused,
+		 const char *location __unused)
+{
+	return NULL;
+}
+
+void *__malloc(size_t bytes __unused, const char *location __unused)
+{
+	return NULL;
+}
+
+static uint64_t in_be64(volatile void *addr __unused)
+{
+	return 0;
+}
+
+struct dt_node *dt_find_by_path(struct dt_node *root __unused,
+				const char *path __unused)
+{
+	return NULL;
+}
+
+struct dt_node *dt_find_compatible_node(struct dt_node *root __unused,
+					struct dt_node *prev __unused,
+					const char *compat __unused)
+{
+	return NULL;
+}
+
+const struct dt_property *dt_find_property(const struct dt_node *node __unused,
+					   const char *name __unused)
+{
+	return NULL;
+}
+
+u32 dt_prop_get_u32(const struct dt_node *node __unused,
+		    const char *prop __unused)
+{
+	return 0;
+}
+
+const void *dt_prop_get_def(const struct dt_node *node __unused,
+			    const char *prop __unused, void *def)
+{
+	return def;
+}
+
+bool lock_recursive_caller(struct lock *l, const char *caller)
+{
+	if (l->lock_val)
+		return false;
+	lock_caller(l, caller);
+	return true;
+}
+
+bool try_lock_caller(struct lock *l, const char *caller __unused)
+{
+	if (l->lock_val)
+		return false;
+	l->lock_val = 1;
+	return true;
+}
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+bool lock_held_by_me(struct lock *l)
+{
+	return l->lock_val;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+static void setup(bool answer, unsigned long resp_lat)
+{
+	memset(&mbox, 0, sizeof(mbox));
+	mbox.answer = answer;
+	mbox.resp_lat = resp_lat;
+	fsp.state = fsp_mbx_idle;
+	nr_polls = nr_sleeps = nr_errors = 0;
+}
+
+static void init(void)
+{
+	int i;
+
+	for (i = 0; i <= (FSP_MCLASS_LAST - FSP_MCLASS_FIRST); i++) {
+		list_head_init(&fsp_cmdclass[i].msgq);
+		list_head_init(&fsp_cmdclass[i].clientq);
+		list_head_init(&fsp_cmdclass[i].rr_queue);
+	}
+	list_head_init(&fsp_cmdclass_rr.msgq);
+	list_head_init(&fsp_cmdclass_rr.clientq);
+	list_head_init(&fsp_cmdclass_rr.rr_queue);
+
+	fsp.iopath_count = 1;
+	fsp.active_iopath = 0;
+	fsp.iopath[0].state = fsp_path_active;
+	fsp.iopath[0].fsp_regs = mbox_regs;
+	fsp.iopath[0].psi = &psi;
+	first_fsp = active_fsp = &fsp;
+
+	/* What fsp_opl() does once the FSP is up */
+	init_timer(&fsp_timeout_timer, fsp_timeout_expiry, NULL);
+	fsp_timeouts_enabled = true;
+}
+
+/*
+ * Answered messages: the sender is back within a wakeup of the
+ * response landing, and runs the pollers about once per wakeup
+ */
+static void test_latency(void)
+{
+	unsigned long lat, start;
+	unsigned long waited, slices;
+	int i, rc;
+
+	srandom(1);
+	for (i = 0; i < NR_MSGS; i++) {
+		setup(true, usecs_to_tb(random() % 50000));
+		start = stamp;
+
+		rc = fsp_sync_msg(fsp_mkmsg(FSP_CMD_HV_FUNCTNAL, 1, i), true);
+		assert(rc == 0);
+		assert(mbox.nr_sent == 1);
+		assert((mbox.w0 & 0xff) == FSP_MCLASS_SERVICE);
+		assert(!fsp_cmdclass_resp_bitmask);
+		assert(!nr_errors);
+
+		lat = stamp - resp_landed;
+		assert(lat <= usecs_to_tb(FSP_SYNC_WAKEUP_US + 2 * POLL_US));
+
+		waited = stamp - start;
+		slices = waited / usecs_to_tb(FSP_SYNC_WAKEUP_US);
+		assert(nr_polls <= slices + 2);
+		assert(nr_sleeps <= slices + 1);
+	}
+
+	/* Nothing timed out, the timer is still pointing at a deadline
+	 * that went away with the responses */
+	assert(armed_timer == &fsp_timeout_timer);
+}
+
+/* A response just inside the deadline isn't timed out by a stale timer */
+static void test_late_response(void)
+{
+	unsigned long deadline;
+	int rc;
+
+	setup(true, secs_to_tb(2 * 60) - usecs_to_tb(500));
+	deadline = stamp + usecs_to_tb(ACK_US) + secs_to_tb(2 * 60);
+
+	rc = fsp_sync_msg(fsp_mkmsg(FSP_CMD_SURV_HBEAT, 1, 120), true);
+	assert(rc == 0);
+	assert(stamp < deadline);
+	assert(!nr_errors);
+	assert(fsp.state == fsp_mbx_idle);
+}
+
+/*
+ * No response: the timer completes the message right at its class
+ * deadline, with FSP_STATUS_BUSY, and kicks off a reset of the FSP
+ */
+static void test_timeout(void)
+{
+	unsigned long deadline, start;
+	int rc;
+
+	setup(false, 0);
+	start = stamp;
+	deadline = stamp + usecs_to_tb(ACK_US) + secs_to_tb(2 * 60);
+
+	rc = fsp_sync_msg(fsp_mkmsg(FSP_CMD_SURV_HBEAT, 1, 120), true);
+	assert(rc == FSP_STATUS_BUSY);
+	assert(stamp >= deadline);
+	assert(stamp - deadline <=
+	       usecs_to_tb(FSP_SYNC_WAKEUP_US + 2 * POLL_US));
+	assert(nr_polls <= (stamp - start) / usecs_to_tb(FSP_SYNC_WAKEUP_US) + 2);
+	assert(!fsp_cmdclass_resp_bitmask);
+	assert(!armed_timer);
+	assert(nr_errors);
+}
+
+int main(void)
+{
+	init();
+	test_latency();
+	test_late_response();
+	test_timeout();
+
+	return 0;
+}
@@ -0,0 +1,536 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The internal console output of the LPC UART against a model of a
+ * 16550 at 115200: a 16 byte FIFO sending a byte every BYTE_US, with
+ * each LPC access taking LPC_US. Checks that what goes in comes out on
+ * the wire in order and without overrunning the FIFO, how long a
+ * printf() keeps its caller, and that the poller, the THRE interrupt
+ * or an emergency drain each get everything out.
+ */
+
+#define __TEST__
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+#define lwsync()
+#define smt_lowest()
+#define smt_medium()
+
+/* Only the LPC path is modelled */
+#define __IO_H
+#include <skiboot.h>
+#include <errorlog.h>
+
+static uint8_t in_8(const volatile uint8_t *addr);
+static void out_8(volatile uint8_t *addr, uint8_t val);
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+static unsigned int nr_errors;
+
+#undef prlog
+#define prlog(l, ...) do {			\
+	if ((l) <= PR_ERR)			\
+		nr_errors++;			\
+	mock_printf(__VA_ARGS__);		\
+} while (0)
+#undef printf
+#define printf(...) mock_printf(__VA_ARGS__)
+#undef log_simple_error
+#define log_simple_error(e_info, ...) ({	\
+	(void)(e_info);				\
+	nr_errors++;				\
+	mock_printf(__VA_ARGS__);		\
+	0;					\
+})
+
+#include "../lpc-uart.c"
+
+#define UART_BASE	0x3f8
+#define FIFO_SIZE	16
+#define BYTE_US		87
+#define LPC_US		2
+#define POLL_US		100
+#define WIRE_SIZE	0x100000
+
+unsigned long tb_hz = 512000000;
+struct dt_node *dt_root;
+struct dt_node *dt_chosen;
+
+static struct {
+	uint8_t fifo[FIFO_SIZE];
+	unsigned int count;
+	unsigned long next_out;
+	uint8_t ier;
+	unsigned int nr_overruns;
+} sim;
+
+/* What made it out, and what was written to the console */
+static char wire[WIRE_SIZE];
+static unsigned int wire_len;
+static char sent[WIRE_SIZE];
+static unsigned int sent_len;
+static char opal_sent[WIRE_SIZE];
+static unsigned int opal_sent_len;
+
+static unsigned long nr_polls, nr_irqs;
+
+static void sim_advance(void)
+{
+	while (sim.count && stamp >= sim.next_out) {
+		assert(wire_len < WIRE_SIZE);
+		wire[wire_len++] = sim.fifo[0];
+		memmove(sim.fifo, sim.fifo + 1, --sim.count);
+		sim.next_out += usecs_to_tb(BYTE_US);
+	}
+}
+
+int64_t lpc_write(enum OpalLPCAddressType addr_type, uint32_t addr,
+		  uint32_t data, uint32_t sz)
+{
+	assert(addr_type == OPAL_LPC_IO && sz == 1);
+	stamp += usecs_to_tb(LPC_US);
+	sim_advance();
+
+	switch (addr - UART_BASE) {
+	case REG_THR:
+		if (sim.count == FIFO_SIZE) {
+			sim.nr_overruns++;
+			break;
+		}
+		if (!sim.count)
+			sim.next_out = stamp + usecs_to_tb(BYTE_US);
+		sim.fifo[sim.count++] = data;
+		break;
+	case REG_IER:
+		sim.ier = data;
+		break;
+	}
+	return OPAL_SUCCESS;
+}
+
+int64_t lpc_read(enum OpalLPCAddressType addr_type, uint32_t addr,
+		 uint32_t *data, uint32_t sz)
+{
+	assert(addr_type == OPAL_LPC_IO && sz == 1);
+	stamp += usecs_to_tb(LPC_US);
+	sim_advance();
+
+	*data = 0;
+	if (addr - UART_BASE == REG_LSR && !sim.count)
+		*data = LSR_THRE | LSR_TEMT;
+	return OPAL_SUCCESS;
+}
+
+static uint8_t in_8(const volatile uint8_t *addr __unused)
+{
+	return 0xff;
+}
+
+static void out_8(volatile uint8_t *addr __unused, uint8_t val __unused)
+{
+}
+
+bool lpc_ok(void)
+{
+	return true;
+}
+
+void trace_add(union trace *trace __unused, u8 type __unused,
+	       u16 len __unused)
+{
+}
+
+void opal_update_pending_evt(uint64_t evt_mask __unused,
+			     uint64_t evt_values __unused)
+{
+}
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+bool lock_held_by_me(struct lock *l)
+{
+	return l->lock_val;
+}
+
+/* Only the init paths, which the test sets up by hand, use these */
+bool lpc_present(void)
+{
+	return true;
+}
+
+void lpc_used_by_console(void)
+{
+}
+
+void lpc_register_client(uint32_t chip_id __unused,
+			 const struct lpc_client *clt __unused,
+			 uint32_t policy __unused)
+{
+}
+
+void opal_add_poller_timed(void (*poller)(void *data) __unused,
+			   void *data __unused, const char *name __unused,
+			   uint64_t events __unused,
+			   unsigned long interval_ms __unused)
+{
+}
+
+static bool uart_kicked;
+
+void opal_kick_pollers(uint64_t events)
+{
+	if (events & OPAL_POLL_EVT_UART)
+		uart_kicked = true;
+}
+
+void set_console(struct con_ops *driver __unused)
+{
+}
+
+struct dt_node *add_opal_console_node(int index __unused,
+				      const char *type __unused,
+				      uint32_t write_buffer_size __unused)
+{
+	return NULL;
+}
+
+const char *nvram_query(const char *name __unused)
+{
+	return NULL;
+}
+
+struct dt_node *dt_find_compatible_node(struct dt_node *root __unused,
+					struct dt_node *prev __unused,
+					const char *compat __unused)
+{
+	return NULL;
+}
+
+const struct dt_property *dt_find_property(const struct dt_node *node __unused,
+					   const char *name __unused)
+{
+	return NULL;
+}
+
+u32 dt_property_get_cell(const struct dt_property *prop __unused,
+			 u32 index __unused)
+{
+	return 0;
+}
+
+u32 dt_prop_get_u32(const struct dt_node *node __unused,
+		    const char *prop __unused)
+{
+	return 0;
+}
+
+const void *dt_prop_get_def(const struct dt_node *node __unused,
+			    const char *prop __unused, void *def)
+{
+	return def;
+}
+
+u64 dt_translate_address(const struct dt_node *node __unused,
+			 unsigned int index __unused, u64 *out_size __unused)
+{
+	return 0;
+}
+
+u32 dt_get_chip_id(const struct dt_node *node __unused)
+{
+	return 0;
+}
+
+char *dt_get_path(const struct dt_node *node __unused)
+{
+	return NULL;
+}
+
+struct dt_property *dt_add_property_string(struct dt_node *node __unused,
+					   const char *name __unused,
+					   const char *value __unused)
+{
+	return NULL;
+}
+
+struct dt_property *__dt_add_property_strings(struct dt_node *node __unused,
+					      const char *name __unused,
+					      int count __unused, ...)
+{
+	return NULL;
+}
+
+/*
+ * Time passes, with opal_run_pollers() every POLL_US. Like it, only
+ * call the poller when kicked or every UART_POLL_MS.
+ */
+static void idle(unsigned long us)
+{
+	unsigned long end = stamp + usecs_to_tb(us);
+	static unsigned long next_poll;
+
+	while (stamp < end) {
+		stamp += usecs_to_tb(POLL_US);
+		sim_advance();
+		if (!uart_kicked && stamp < next_poll)
+			continue;
+		uart_kicked = false;
+		next_poll = stamp + msecs_to_tb(UART_POLL_MS);
+		nr_polls++;
+		uart_console_poll(NULL);
+	}
+}
+
+/* Time passes, the THRE interrupt fires whenever it's asked for */
+static void idle_irq(unsigned long us)
+{
+	unsigned long end = stamp + usecs_to_tb(us);
+
+	while (stamp < end) {
+		stamp += usecs_to_tb(1);
+		sim_advance();
+		if ((sim.ier & IER_THRE) && !sim.count) {
+			nr_irqs++;
+			uart_irq(0, 0);
+		}
+	}
+}
+
+static bool all_out(void)
+{
+	return con_tx_prod == con_tx_cons && !sim.count;
+}
+
+/* A line of the internal console, returns how long the write took */
+static unsigned long con_line(unsigned int len)
+{
+	char buf[256];
+	unsigned long start = stamp;
+	unsigned int i;
+
+	assert(len < sizeof(buf));
+	for (i = 0; i < len - 1; i++)
+		buf[i] = 'a' + random() % 26;
+	buf[i] = '\n';
+
+	assert(sent_len + len <= WIRE_SIZE);
+	memcpy(sent + sent_len, buf, len);
+	sent_len += len;
+
+	assert(uart_con_write(buf, len) == len);
+	return stamp - start;
+}
+
+static void opal_line(unsigned int len)
+{
+	uint8_t buf[256];
+	int64_t written;
+	unsigned int i;
+
+	assert(len < sizeof(buf));
+	for (i = 0; i < len; i++)
+		buf[i] = 'A' + random() % 26;
+
+	written = len;
+	assert(uart_opal_write(0, &written, buf) == OPAL_SUCCESS);
+	assert(opal_sent_len + written <= WIRE_SIZE);
+	memcpy(opal_sent + opal_sent_len, buf, written);
+	opal_sent_len += written;
+}
+
+/* Both streams made it out whole and in order, whatever the mix */
+static void check_wire(void)
+{
+	unsigned int i, ncon = 0, nopal = 0;
+
+	assert(!sim.nr_overruns);
+	for (i = 0; i < wire_len; i++) {
+		if (wire[i] >= 'A' && wire[i] <= 'Z') {
+			assert(nopal < opal_sent_len);
+			assert(wire[i] == opal_sent[nopal++]);
+		} else {
+			assert(ncon < sent_len);
+			assert(wire[i] == sent[ncon++]);
+		}
+	}
+	assert(ncon == sent_len);
+	assert(nopal == opal_sent_len);
+}
+
+static void setup(bool async)
+{
+	memset(&sim, 0, sizeof(sim));
+	wire_len = sent_len = opal_sent_len = 0;
+	nr_polls = nr_irqs = 0;
+	uart_kicked = false;
+	con_tx_prod = con_tx_cons = 0;
+	con_tx_async = async;
+	tx_room = 0;
+	tx_full = false;
+	uart_base = UART_BASE;
+}
+
+/* Before the poller is up, a write only returns once it's all queued */
+static void test_sync(void)
+{
+	int i;
+
+	setup(false);
+	for (i = 0; i < 50; i++) {
+		con_line(1 + random() % 120);
+		assert(con_tx_prod == con_tx_cons);
+		assert(wire_len + sim.count == sent_len);
+	}
+	idle(10000);
+	assert(all_out());
+	check_wire();
+}
+
+/*
+ * The poller drains the ring. Unless the ring is full, a caller is
+ * only held for the LPC writes topping up the FIFO. When it is, the
+ * caller waits, but nothing is lost.
+ */
+static void test_poller(void)
+{
+	unsigned long lat;
+	unsigned int len;
+	int i;
+
+	setup(true);
+	for (i = 0; i < 2000; i++) {
+		len = 1 + random() % 120;
+		assert(len <= uart_con_tx_space());
+		lat = con_line(len);
+		/* A look at LSR either side of filling the FIFO */
+		assert(lat <= usecs_to_tb((FIFO_SIZE + 2) * LPC_US));
+		idle(random() % 20000);
+	}
+
+	/* Flat out, way past the size of the ring */
+	for (i = 0; i < 1000; i++)
+		con_line(1 + random() % 120);
+	assert(sent_len > 4 * CON_TX_BUF_SIZE);
+
+	assert(uart_kicked);
+	idle(sent_len * BYTE_US);
+	assert(all_out());
+	assert(nr_polls);
+	check_wire();
+
+	/* Nothing left to send, the poller is back to its interval */
+	assert(!uart_kicked);
+	nr_polls = 0;
+	idle(100000);
+	assert(nr_polls <= 100 / UART_POLL_MS + 1);
+}
+
+/* Emergency output is on the wire or in the FIFO when we return */
+static void test_drain(void)
+{
+	int i;
+
+	setup(true);
+	for (i = 0; i < 100; i++)
+		con_line(1 + random() % 120);
+	assert(con_tx_prod != con_tx_cons);
+
+	uart_con_drain();
+	assert(con_tx_prod == con_tx_cons);
+	assert(wire_len + sim.count == sent_len);
+
+	/* Not when we are going down holding the lock though */
+	con_line(100);
+	lock(&uart_lock);
+	uart_con_drain();
+	unlock(&uart_lock);
+	assert(con_tx_prod != con_tx_cons);
+
+	idle(20000);
+	assert(all_out());
+	check_wire();
+}
+
+/*
+ * With the OPAL console up and a working interrupt, THRE drains both
+ * the internal console and out_buf, without any poller
+ */
+static void test_irq(void)
+{
+	int i;
+
+	setup(true);
+	in_buf = calloc(1, IN_BUF_SIZE);
+	out_buf = calloc(1, OUT_BUF_SIZE);
+	has_irq = irq_ok = true;
+	out_buf_prod = out_buf_cons = 0;
+	uart_update_ier();
+
+	for (i = 0; i < 1000; i++) {
+		if (random() % 2)
+			con_line(1 + random() % 120);
+		else
+			opal_line(1 + random() % 120);
+		idle_irq(random() % 15000);
+	}
+	idle_irq(WIRE_SIZE);
+
+	assert(all_out());
+	assert(out_buf_prod == out_buf_cons);
+	assert(!nr_polls && nr_irqs);
+	assert(!(sim.ier & IER_THRE));
+	check_wire();
+
+	free(in_buf);
+	free(out_buf);
+	in_buf = out_buf = NULL;
+	has_irq = irq_ok = false;
+}
+
+int main(void)
+{
+	srandom(1);
+
+	test_sync();
+	test_poller();
+	test_drain();
+	test_irq();
+	assert(!nr_errors);
+
+	return 0;
+}
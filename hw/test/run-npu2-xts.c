@@ -0,0 +1,267 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The NPU2 context OPAL calls against a mock of the XTS tables. Checks
+ * what they return, that the tables are only read at init and that
+ * the cache in struct npu2 always matches what's in the hardware.
+ */
+
+#define __TEST__
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <skiboot.h>
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+static unsigned int nr_errors;
+
+#undef prlog
+#define prlog(l, ...) do {			\
+	if ((l) <= PR_ERR)			\
+		nr_errors++;			\
+	mock_printf(__VA_ARGS__);		\
+} while (0)
+
+#include "../npu2-xts.c"
+
+#define PHB_ID		0x42
+#define NR_DEVICES	20
+#define NR_OPS		20000
+
+static struct npu2 npu;
+static struct npu2_dev devices[NR_DEVICES];
+static uint64_t bdf_map[NPU2_XTS_BDF_MAP_SIZE];
+static uint64_t pid_map[NPU2_XTS_BDF_MAP_SIZE];
+static unsigned int nr_reads, nr_writes;
+
+static uint64_t *xts_reg(uint64_t reg)
+{
+	if (reg >= NPU2_XTS_BDF_MAP &&
+	    reg < NPU2_XTS_BDF_MAP_REG(NPU2_XTS_BDF_MAP_SIZE)) {
+		assert(!((reg - NPU2_XTS_BDF_MAP) % 8));
+		return &bdf_map[(reg - NPU2_XTS_BDF_MAP) / 8];
+	}
+	if (reg >= NPU2_XTS_PID_MAP &&
+	    reg < NPU2_XTS_PID_MAP_REG(NPU2_XTS_BDF_MAP_SIZE)) {
+		/* Only the wildcard entries are ever used */
+		assert(!((reg - NPU2_XTS_PID_MAP) % 0x20));
+		return &pid_map[(reg - NPU2_XTS_PID_MAP) / 0x20];
+	}
+	assert(false);
+}
+
+uint64_t npu2_read(struct npu2 *p, uint64_t reg)
+{
+	assert(p == &npu);
+	nr_reads++;
+	return *xts_reg(reg);
+}
+
+void npu2_write(struct npu2 *p, uint64_t reg, uint64_t val)
+{
+	assert(p == &npu);
+	nr_writes++;
+	*xts_reg(reg) = val;
+}
+
+struct phb *pci_get_phb(uint64_t phb_id)
+{
+	return phb_id == PHB_ID ? &npu.phb_nvlink : NULL;
+}
+
+void lock_caller(struct lock *l, const char *caller __unused)
+{
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+static void check_cache(void)
+{
+	assert(!npu.lock.lock_val);
+	assert(!memcmp(npu.xts_bdf_cache, bdf_map, sizeof(bdf_map)));
+	assert(!memcmp(npu.xts_pid_cache, pid_map, sizeof(pid_map)));
+}
+
+static uint64_t gpu_bdf(int i)
+{
+	return 0x100 + (i << 3);
+}
+
+static int bdf_lparshort(uint64_t bdf)
+{
+	int i;
+
+	for (i = 0; i < NPU2_XTS_BDF_MAP_SIZE; i++)
+		if (bdf_map[i] && GETFIELD(NPU2_XTS_BDF_MAP_BDF, bdf_map[i]) == bdf)
+			return i;
+	return -1;
+}
+
+static void setup(void)
+{
+	int i;
+
+	memset(&npu, 0, sizeof(npu));
+	memset(bdf_map, 0, sizeof(bdf_map));
+	memset(pid_map, 0, sizeof(pid_map));
+	for (i = 0; i < NR_DEVICES; i++) {
+		devices[i].index = i % NPU2_LINKS_PER_CHIP;
+		devices[i].nvlink.gpu_bdfn = gpu_bdf(i);
+	}
+	npu.devices = devices;
+	npu.total_devices = NR_DEVICES;
+	npu.phb_nvlink.phb_type = phb_type_npu_v2;
+	npu.phb_nvlink.opal_id = PHB_ID;
+	nr_errors = 0;
+}
+
+/* Whatever a previous boot left in the tables is picked up */
+static void test_init(void)
+{
+	uint64_t msr = MSR_DR | MSR_PR | MSR_SF;
+
+	setup();
+	bdf_map[3] = SETFIELD(NPU2_XTS_BDF_MAP_BDF, 0ul, gpu_bdf(5)) |
+		SETFIELD(NPU2_XTS_BDF_MAP_LPARSHORT, 0ul, 3) |
+		NPU2_XTS_BDF_MAP_VALID;
+	pid_map[3] = SETFIELD(NPU2_XTS_PID_MAP_LPARSHORT, 0ul, 3) |
+		SETFIELD(NPU2_XTS_PID_MAP_MSR, 0ul, 0x8);
+
+	npu2_xts_init(&npu);
+	check_cache();
+
+	nr_reads = 0;
+	assert(opal_npu_init_context(PHB_ID, 0, msr, gpu_bdf(5)) ==
+	       OPAL_PARAMETER);
+	assert(opal_npu_destroy_context(PHB_ID, 0, gpu_bdf(5)) == 0);
+	assert(opal_npu_map_lpar(PHB_ID, gpu_bdf(5), 7, 0) == OPAL_SUCCESS);
+	assert(bdf_lparshort(gpu_bdf(5)) == 3);
+	assert(!nr_reads);
+	check_cache();
+}
+
+static void test_errors(void)
+{
+	uint64_t msr = MSR_DR | MSR_HV | MSR_SF;
+	int i;
+
+	setup();
+	npu2_xts_init(&npu);
+	nr_reads = nr_writes = 0;
+
+	/* Not an NPU, or nothing mapped yet */
+	assert(opal_npu_map_lpar(PHB_ID + 1, gpu_bdf(0), 1, 0) ==
+	       OPAL_PARAMETER);
+	assert(opal_npu_map_lpar(PHB_ID, gpu_bdf(0), 1, 1) == OPAL_UNSUPPORTED);
+	assert(opal_npu_init_context(PHB_ID, 0, MSR_LE, gpu_bdf(0)) ==
+	       OPAL_UNSUPPORTED);
+	assert(opal_npu_init_context(PHB_ID, 0, msr, gpu_bdf(0)) ==
+	       OPAL_PARAMETER);
+	assert(opal_npu_destroy_context(PHB_ID, 0, gpu_bdf(0)) ==
+	       OPAL_PARAMETER);
+	assert(!nr_writes);
+
+	/* Not a GPU behind any link */
+	assert(opal_npu_map_lpar(PHB_ID, 0xff, 1, 0) == OPAL_PARAMETER);
+	assert(!nr_writes);
+
+	/* Fill the table up, then remap one */
+	for (i = 0; i < NPU2_XTS_BDF_MAP_SIZE; i++)
+		assert(opal_npu_map_lpar(PHB_ID, gpu_bdf(i), i, 0) ==
+		       OPAL_SUCCESS);
+	assert(opal_npu_map_lpar(PHB_ID, gpu_bdf(i), i, 0) == OPAL_RESOURCE);
+	assert(opal_npu_map_lpar(PHB_ID, gpu_bdf(4), 0x123, 0) ==
+	       OPAL_SUCCESS);
+	assert(GETFIELD(NPU2_XTS_BDF_MAP_LPARID, bdf_map[4]) == 0x123);
+
+	/* The context is the LPARSHORT, set up only once per MSR */
+	assert(opal_npu_init_context(PHB_ID, 0, msr, gpu_bdf(4)) == 4);
+	assert(GETFIELD(NPU2_XTS_BDF_MAP_VALID, bdf_map[4]));
+	assert(opal_npu_init_context(PHB_ID, 1, msr, gpu_bdf(4)) == 4);
+	assert(opal_npu_init_context(PHB_ID, 2, MSR_SF, gpu_bdf(4)) ==
+	       OPAL_PARAMETER);
+	assert(opal_npu_destroy_context(PHB_ID, 0, gpu_bdf(4)) == 0);
+
+	assert(!nr_reads);
+	check_cache();
+}
+
+/* Random calls, the cache and the hardware never diverge */
+static void test_random(void)
+{
+	static const uint64_t msrs[] = {
+		MSR_SF, MSR_DR | MSR_SF, MSR_DR | MSR_PR | MSR_SF,
+		MSR_DR | MSR_HV | MSR_SF,
+	};
+	uint64_t bdf;
+	int i, rc, id;
+
+	setup();
+	npu2_xts_init(&npu);
+	nr_reads = 0;
+	srandom(1);
+
+	for (i = 0; i < NR_OPS; i++) {
+		bdf = gpu_bdf(random() % NR_DEVICES);
+		id = bdf_lparshort(bdf);
+
+		switch (random() % 3) {
+		case 0:
+			rc = opal_npu_map_lpar(PHB_ID, bdf, random() % 0x1000, 0);
+			if (id >= 0)
+				assert(rc == OPAL_SUCCESS);
+			assert(rc == OPAL_SUCCESS || rc == OPAL_RESOURCE);
+			if (rc == OPAL_SUCCESS)
+				assert(bdf_lparshort(bdf) >= 0);
+			break;
+		case 1:
+			rc = opal_npu_init_context(PHB_ID, 0,
+						   msrs[random() % ARRAY_SIZE(msrs)],
+						   bdf);
+			assert(id < 0 ? rc == OPAL_PARAMETER :
+			       rc == id || rc == OPAL_PARAMETER);
+			break;
+		case 2:
+			rc = opal_npu_destroy_context(PHB_ID, 0, bdf);
+			assert(rc == (id < 0 ? OPAL_PARAMETER : 0));
+			break;
+		}
+		check_cache();
+	}
+	assert(!nr_reads);
+}
+
+int main(void)
+{
+	test_init();
+	test_errors();
+	test_random();
+
+	return 0;
+}
@@ -0,0 +1,711 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * i2c_request_send() through the P8/P9 I2C master driver against a
+ * model of the engine's registers and of an EEPROM behind it. The bus
+ * moves a byte every BYTE_US, stalling on a full or empty FIFO, and the
+ * engine raises its interrupt when enabled. Checks the bytes that made
+ * it to the device and back, NACK retries, timeouts, how many FIFO
+ * accesses it took and that a synchronous request is completed by the
+ * interrupt rather than by polling.
+ */
+
+#define __TEST__
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+#define sync()
+#define lwsync()
+#define smt_lowest()
+#define smt_medium()
+
+#include <skiboot.h>
+#include <errorlog.h>
+#include <mem_region-malloc.h>
+
+#undef zalloc
+#undef free
+#define zalloc(bytes) calloc((bytes), 1)
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+static unsigned int nr_errors;
+
+#undef prlog
+#define prlog(l, ...) do {			\
+	if ((l) <= PR_ERR)			\
+		nr_errors++;			\
+	mock_printf(__VA_ARGS__);		\
+} while (0)
+#undef log_simple_error
+#define log_simple_error(e_info, ...) ({	\
+	(void)(e_info);				\
+	nr_errors++;				\
+	mock_printf(__VA_ARGS__);		\
+	0;					\
+})
+
+#include "../p8-i2c.c"
+#include "../../core/i2c.c"
+#include "../../ccan/list/list.c"
+
+#define FIFO_SIZE	8
+#define BYTE_US		25
+#define XSCOM_BASE	0xa0000
+#define EEPROM_ADDR	0x50
+#define EEPROM_SIZE	256
+
+unsigned long tb_hz = 512000000;
+enum proc_gen proc_gen = proc_gen_p9;
+unsigned long top_of_ram = ~0UL;
+struct debug_descriptor debug_descriptor;
+
+static struct proc_chip chip;
+static struct p8_i2c_master master;
+static struct p8_i2c_master_port port;
+static unsigned int nr_stub_calls;
+
+/* A 256 byte EEPROM, the first byte written sets the address */
+static struct {
+	uint8_t mem[EEPROM_SIZE];
+	uint8_t ptr;
+	bool ptr_set;
+	unsigned int nacks;	/* The next transfers to NACK */
+	bool stuck;		/* Holds the clock forever */
+} eeprom;
+
+static struct {
+	uint64_t mode, watermark, intr_en;
+	uint64_t err;
+	bool busy, addressed, stalled, cmd_comp, rnw;
+	uint32_t dev, len, done;
+	uint8_t fifo[FIFO_SIZE];
+	uint32_t fifo_count;
+	uint64_t next_tb;
+} eng;
+
+static unsigned int nr_fifo, nr_fifo4, nr_stat_polls, nr_irqs;
+static bool in_irq;
+
+static void fifo_push(uint8_t b)
+{
+	assert(eng.fifo_count < FIFO_SIZE);
+	eng.fifo[eng.fifo_count++] = b;
+}
+
+static uint8_t fifo_pop(void)
+{
+	uint8_t b = eng.fifo[0];
+
+	assert(eng.fifo_count);
+	memmove(eng.fifo, eng.fifo + 1, --eng.fifo_count);
+	return b;
+}
+
+/* A stalled bus goes on a byte time after the FIFO was serviced */
+static void fifo_serviced(void)
+{
+	if (eng.stalled) {
+		eng.stalled = false;
+		eng.next_tb = stamp + usecs_to_tb(BYTE_US);
+	}
+}
+
+static void eng_address(void)
+{
+	if (eng.dev != EEPROM_ADDR || eeprom.nacks) {
+		if (eng.dev == EEPROM_ADDR)
+			eeprom.nacks--;
+		eng.err = I2C_STAT_NACK_RCVD_ERR;
+		eng.busy = false;
+		return;
+	}
+	eng.addressed = true;
+	if (!eng.rnw)
+		eeprom.ptr_set = false;
+}
+
+static void eng_step(void)
+{
+	while (eng.busy && !eng.stalled && eeprom.stuck == false &&
+	       tb_compare(eng.next_tb, stamp) != TB_AAFTERB) {
+		if (!eng.addressed) {
+			eng_address();
+		} else if (eng.done == eng.len) {
+			eng.busy = false;
+			eng.cmd_comp = true;
+			break;
+		} else if (eng.rnw) {
+			if (eng.fifo_count == FIFO_SIZE) {
+				eng.stalled = true;
+				break;
+			}
+			fifo_push(eeprom.mem[eeprom.ptr++]);
+			eng.done++;
+		} else {
+			if (!eng.fifo_count) {
+				eng.stalled = true;
+				break;
+			}
+			if (eeprom.ptr_set)
+				eeprom.mem[eeprom.ptr++] = fifo_pop();
+			else
+				eeprom.ptr = fifo_pop();
+			eeprom.ptr_set = true;
+			eng.done++;
+		}
+		eng.next_tb += usecs_to_tb(BYTE_US);
+	}
+}
+
+static uint64_t eng_status(void)
+{
+	uint64_t stat = eng.err;
+	uint32_t to_fill;
+
+	eng_step();
+	if (eng.cmd_comp)
+		stat |= I2C_STAT_CMD_COMP;
+	if (eng.rnw && eng.fifo_count &&
+	    (eng.fifo_count >= I2C_FIFO_HI_LVL || !eng.busy))
+		stat |= I2C_STAT_DATA_REQ;
+	to_fill = eng.len - eng.done - eng.fifo_count;
+	if (!eng.rnw && eng.busy && !eng.err && to_fill &&
+	    eng.fifo_count <= I2C_FIFO_LO_LVL)
+		stat |= I2C_STAT_DATA_REQ;
+	return SETFIELD(I2C_STAT_FIFO_ENTRY_COUNT, stat, eng.fifo_count);
+}
+
+static void eng_cmd(uint64_t cmd)
+{
+	/* The STOP that recovers the port */
+	if (!(cmd & I2C_CMD_WITH_START)) {
+		assert(cmd == I2C_CMD_WITH_STOP);
+		eng.busy = false;
+		eng.cmd_comp = true;
+		return;
+	}
+
+	assert(!eng.busy && !eng.err);
+	assert(GETFIELD(I2C_CMD_INTR_STEERING, cmd) == I2C_CMD_INTR_STEER_HOST);
+	eng.dev = GETFIELD(I2C_CMD_DEV_ADDR, cmd);
+	eng.rnw = !!(cmd & I2C_CMD_READ_NOT_WRITE);
+	eng.len = GETFIELD(I2C_CMD_LEN_BYTES, cmd);
+	eng.done = 0;
+	eng.fifo_count = 0;
+	eng.busy = true;
+	eng.addressed = eng.stalled = eng.cmd_comp = false;
+	eng.next_tb = stamp + usecs_to_tb(BYTE_US);
+}
+
+int _xscom_read(uint32_t partid, uint64_t pcb_addr, uint64_t *val,
+		bool take_lock __unused)
+{
+	unsigned int i;
+
+	assert(partid == chip.id);
+	switch (pcb_addr - XSCOM_BASE) {
+	case I2C_FIFO_REG:
+		nr_fifo++;
+		*val = SETFIELD(I2C_FIFO, 0ull, fifo_pop());
+		fifo_serviced();
+		break;
+	case I2C_FIFO4_REG:
+		nr_fifo4++;
+		assert(eng.fifo_count >= 4);
+		*val = 0;
+		for (i = 0; i < 4; i++)
+			*val = *val << 8 | fifo_pop();
+		*val = SETFIELD(I2C_FIFO4, 0ull, *val);
+		fifo_serviced();
+		break;
+	case I2C_CMD_REG:
+		*val = 0;
+		break;
+	case I2C_MODE_REG:
+		*val = eng.mode;
+		break;
+	case I2C_WATERMARK_REG:
+		*val = eng.watermark;
+		break;
+	case I2C_INTR_MASK_REG:
+	case I2C_INTR_COND_REG:
+		*val = eng.intr_en;
+		break;
+	case I2C_STAT_REG:
+		if (!in_irq)
+			nr_stat_polls++;
+		*val = eng_status();
+		break;
+	case I2C_EXTD_STAT_REG:
+		*val = SETFIELD(I2C_EXTD_STAT_FIFO_SIZE, 0ull, FIFO_SIZE);
+		break;
+	default:
+		assert(0);
+	}
+	return 0;
+}
+
+int _xscom_write(uint32_t partid, uint64_t pcb_addr, uint64_t val,
+		 bool take_lock __unused)
+{
+	uint64_t data;
+	unsigned int i;
+
+	assert(partid == chip.id);
+	switch (pcb_addr - XSCOM_BASE) {
+	case I2C_FIFO_REG:
+		nr_fifo++;
+		fifo_push(GETFIELD(I2C_FIFO, val));
+		fifo_serviced();
+		break;
+	case I2C_FIFO4_REG:
+		nr_fifo4++;
+		data = GETFIELD(I2C_FIFO4, val);
+		for (i = 0; i < 4; i++)
+			fifo_push(data >> (24 - 8 * i));
+		fifo_serviced();
+		break;
+	case I2C_CMD_REG:
+		eng_cmd(val);
+		break;
+	case I2C_MODE_REG:
+		eng.mode = val;
+		break;
+	case I2C_WATERMARK_REG:
+		eng.watermark = val;
+		break;
+	case I2C_INTR_COND_REG:
+		eng.intr_en = val;
+		break;
+	case I2C_INTR_REG:
+		eng.intr_en &= val;
+		break;
+	case I2C_RESET_I2C_REG:
+		eng.busy = eng.cmd_comp = false;
+		eng.err = 0;
+		eng.fifo_count = 0;
+		break;
+	default:
+		assert(0);
+	}
+	return 0;
+}
+
+/* Timers, run as time goes by; TIMER_POLL ones every millisecond */
+#define MAX_TIMERS	8
+static struct timer *timers[MAX_TIMERS];
+
+void init_timer(struct timer *t, timer_func_t expiry, void *data)
+{
+	t->expiry = expiry;
+	t->user_data = data;
+	t->target = 0;
+}
+
+void cancel_timer_async(struct timer *t)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAX_TIMERS; i++)
+		if (timers[i] == t)
+			timers[i] = NULL;
+}
+
+void schedule_timer_at(struct timer *t, uint64_t when)
+{
+	unsigned int i, free = MAX_TIMERS;
+
+	t->target = when;
+	for (i = 0; i < MAX_TIMERS; i++) {
+		if (timers[i] == t)
+			return;
+		if (!timers[i])
+			free = i;
+	}
+	assert(free < MAX_TIMERS);
+	timers[free] = t;
+}
+
+uint64_t schedule_timer(struct timer *t, uint64_t how_long)
+{
+	if (how_long == TIMER_POLL)
+		schedule_timer_at(t, TIMER_POLL);
+	else
+		schedule_timer_at(t, stamp + how_long);
+	return stamp;
+}
+
+static void run_timers(bool poll)
+{
+	struct timer *t;
+	unsigned int i;
+
+	for (i = 0; i < MAX_TIMERS; i++) {
+		t = timers[i];
+		if (!t)
+			continue;
+		if (t->target == TIMER_POLL ? !poll :
+		    tb_compare(t->target, stamp) == TB_AAFTERB)
+			continue;
+		timers[i] = NULL;
+		t->expiry(t, t->user_data, stamp);
+	}
+}
+
+/* The engine interrupt, taken by the OS and passed to OPAL */
+static void take_irq(void)
+{
+	uint64_t cond = eng_status() >> 16;
+
+	if (!master.irq_ok || opal_booting() || !(cond & eng.intr_en))
+		return;
+	nr_irqs++;
+	in_irq = true;
+	p8_i2c_interrupt(chip.id);
+	in_irq = false;
+}
+
+void time_wait(unsigned long duration)
+{
+	unsigned long end = stamp + duration;
+
+	while (tb_compare(stamp, end) == TB_ABEFOREB) {
+		stamp += usecs_to_tb(1);
+		take_irq();
+		run_timers(stamp % msecs_to_tb(1) < usecs_to_tb(1));
+	}
+}
+
+void time_wait_ms(unsigned long ms)
+{
+	time_wait(msecs_to_tb(ms));
+}
+
+struct proc_chip *get_chip(uint32_t chip_id)
+{
+	assert(chip_id == chip.id);
+	return &chip;
+}
+
+void lock_caller(struct lock *l __unused, const char *caller __unused)
+{
+}
+
+void unlock(struct lock *l __unused)
+{
+}
+
+struct dt_property *__dt_add_property_cells(struct dt_node *node __unused,
+					    const char *name __unused,
+					    int count __unused, ...)
+{
+	return NULL;
+}
+
+/* Not used by the requests under test, the master is set up by hand */
+struct dt_node *dt_root;
+
+struct dt_node *dt_find_compatible_node(struct dt_node *root __unused,
+					struct dt_node *prev __unused,
+					const char *compat __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+const struct dt_property *dt_find_property(const struct dt_node *node __unused,
+					   const char *name __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+struct dt_property *__dt_add_property_strings(struct dt_node *node __unused,
+					      const char *name __unused,
+					      int count __unused, ...)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+struct dt_property *dt_add_property_string(struct dt_node *node __unused,
+					   const char *name __unused,
+					   const char *value __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+u32 dt_prop_get_u32(const struct dt_node *node __unused,
+		    const char *prop __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+u32 dt_prop_get_u32_def(const struct dt_node *node __unused,
+			const char *prop __unused, u32 def)
+{
+	nr_stub_calls++;
+	return def;
+}
+
+const void *dt_prop_get(const struct dt_node *node __unused,
+			const char *prop __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+u32 dt_get_chip_id(const struct dt_node *node __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+u64 dt_get_address(const struct dt_node *node __unused,
+		   unsigned int index __unused, u64 *out_size __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+int _opal_queue_msg(enum opal_msg_type msg_type __unused, void *data __unused,
+		    void (*consumed)(void *data) __unused,
+		    size_t num_params __unused, const u64 *params __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+int64_t centaur_disable_sensor_cache(uint32_t part_id __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+int64_t centaur_enable_sensor_cache(uint32_t part_id __unused)
+{
+	nr_stub_calls++;
+	return 0;
+}
+
+struct centaur_chip *get_centaur(uint32_t part_id __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+static void setup(bool fifo4, bool irq)
+{
+	memset(&master, 0, sizeof(master));
+	memset(&eng, 0, sizeof(eng));
+	eng.cmd_comp = true;
+
+	master.type = I2C_POWER8;
+	master.state = state_idle;
+	master.chip_id = chip.id;
+	master.xscom_base = XSCOM_BASE;
+	master.fifo_size = FIFO_SIZE;
+	master.fifo4 = fifo4;
+	master.irq_ok = irq;
+	master.poll_interval = p8_i2c_get_poll_interval(400000);
+	list_head_init(&master.req_list);
+	list_head_init(&master.ports);
+	init_timer(&master.timeout, p8_i2c_timeout, &master);
+	init_timer(&master.poller, p8_i2c_poll, &master);
+	init_timer(&master.recovery, p8_i2c_recover, &master);
+	init_timer(&master.sensor_cache, p8_i2c_enable_scache, &master);
+	list_head_init(&chip.i2cms);
+	list_add_tail(&chip.i2cms, &master.link);
+	list_add_tail(&master.ports, &port.link);
+	port.master = &master;
+	port.byte_timeout = msecs_to_tb(I2C_TIMEOUT_IRQ_MS);
+
+	memset(timers, 0, sizeof(timers));
+	nr_fifo = nr_fifo4 = nr_stat_polls = nr_irqs = 0;
+}
+
+static int eeprom_write(uint8_t offset, const void *buf, size_t len)
+{
+	return i2c_request_send(port.bus.opal_id, EEPROM_ADDR, SMBUS_WRITE,
+				offset, 1, (void *)buf, len, 100);
+}
+
+static int eeprom_read(uint8_t offset, void *buf, size_t len)
+{
+	return i2c_request_send(port.bus.opal_id, EEPROM_ADDR, SMBUS_READ,
+				offset, 1, buf, len, 100);
+}
+
+static void check_idle(void)
+{
+	assert(master.state == state_idle);
+	assert(list_empty(&master.req_list));
+	assert(!eng.busy && !eng.fifo_count);
+}
+
+/* Byte streams, both ways, at odd offsets and lengths */
+static void test_streams(bool fifo4)
+{
+	uint8_t in[EEPROM_SIZE], out[EEPROM_SIZE];
+	static const unsigned int lens[] = { 1, 3, 4, 7, 8, 9, 31, 64, 100 };
+	unsigned int i, j, off = 0, fifo_bytes = 0;
+
+	setup(fifo4, false);
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		for (j = 0; j < lens[i]; j++)
+			out[j] = rand();
+		assert(eeprom_write(off, out, lens[i]) == OPAL_SUCCESS);
+		assert(!memcmp(eeprom.mem + off, out, lens[i]));
+		check_idle();
+
+		memset(in, 0, sizeof(in));
+		assert(eeprom_read(off, in, lens[i]) == OPAL_SUCCESS);
+		assert(!memcmp(in, out, lens[i]));
+		check_idle();
+
+		/* Offset byte of both, then the data both ways */
+		fifo_bytes += 2 + 2 * lens[i];
+		off += lens[i] + 1;
+	}
+	assert(nr_fifo + 4 * nr_fifo4 == fifo_bytes);
+	printf("%s: %u bytes through the FIFO in %u accesses\n",
+	       fifo4 ? "FIFO4" : "FIFO ", fifo_bytes, nr_fifo + nr_fifo4);
+	if (fifo4)
+		assert((nr_fifo + nr_fifo4) * 2 < fifo_bytes);
+	else
+		assert(!nr_fifo4);
+	assert(!nr_errors);
+}
+
+/* A device that's not there for the first transfers */
+static void test_nack(void)
+{
+	uint8_t buf[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 }, in[16];
+
+	setup(true, false);
+
+	eeprom.nacks = MAX_NACK_RETRIES;
+	assert(eeprom_write(0x80, buf, sizeof(buf)) == OPAL_SUCCESS);
+	assert(!eeprom.nacks);
+	assert(!memcmp(eeprom.mem + 0x80, buf, sizeof(buf)));
+	check_idle();
+
+	eeprom.nacks = MAX_NACK_RETRIES;
+	assert(eeprom_read(0x80, in, sizeof(in)) == OPAL_SUCCESS);
+	assert(!memcmp(in, buf, sizeof(buf)));
+	check_idle();
+
+	/* One too many */
+	eeprom.nacks = MAX_NACK_RETRIES + 1;
+	buf[0] = 0xff;
+	assert(eeprom_write(0x80, buf, sizeof(buf)) == OPAL_HARDWARE);
+	assert(!eeprom.nacks);
+	assert(eeprom.mem[0x80] == 1);
+	check_idle();
+
+	/* Expected, not worth logging */
+	assert(!nr_errors);
+}
+
+/* A device holding the clock: the request times out and the bus recovers */
+static void test_timeout(void)
+{
+	uint8_t buf[16];
+	unsigned long start = stamp;
+
+	setup(true, false);
+	eeprom.stuck = true;
+	assert(eeprom_read(0, buf, sizeof(buf)) == OPAL_HARDWARE);
+	assert(stamp - start >= msecs_to_tb(100));
+	assert(stamp - start < msecs_to_tb(200));
+	assert(nr_errors);
+	eeprom.stuck = false;
+	check_idle();
+
+	/* And works again */
+	assert(eeprom_read(0, buf, sizeof(buf)) == OPAL_SUCCESS);
+	assert(!memcmp(buf, eeprom.mem, sizeof(buf)));
+	check_idle();
+	nr_errors = 0;
+}
+
+/* At runtime the interrupt completes the request, nobody polls */
+static void test_irq(void)
+{
+	uint8_t buf[64], in[64];
+	unsigned long start, bus;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7;
+
+	setup(true, true);
+	debug_descriptor.state_flags |= OPAL_BOOT_COMPLETE;
+
+	assert(eeprom_write(0x40, buf, sizeof(buf)) == OPAL_SUCCESS);
+	assert(!memcmp(eeprom.mem + 0x40, buf, sizeof(buf)));
+	check_idle();
+
+	start = stamp;
+	nr_stat_polls = nr_irqs = 0;
+	assert(eeprom_read(0x40, in, sizeof(in)) == OPAL_SUCCESS);
+	assert(!memcmp(in, buf, sizeof(buf)));
+	check_idle();
+
+	/* Address and offset, address again, the data, each a byte time */
+	bus = usecs_to_tb(BYTE_US) * (2 + 1 + sizeof(in) + 2);
+	printf("IRQ: %lu us for %lu us on the bus, %u irqs, %u polls\n",
+	       tb_to_usecs(stamp - start), tb_to_usecs(bus), nr_irqs,
+	       nr_stat_polls);
+	assert(nr_irqs > sizeof(in) / I2C_FIFO_HI_LVL);
+	/* Starting it, once when first run and the backup poll */
+	assert(nr_stat_polls <= 4);
+	assert(stamp - start < bus + usecs_to_tb(4 * REQ_COMPLETE_WAKEUP_US));
+
+	debug_descriptor.state_flags &= ~OPAL_BOOT_COMPLETE;
+	assert(!nr_errors);
+}
+
+int main(void)
+{
+	chip.id = 1;
+	port.bus.queue_req = p8_i2c_queue_request;
+	port.bus.alloc_req = p8_i2c_alloc_request;
+	port.bus.free_req = p8_i2c_free_request;
+	port.bus.set_req_timeout = p8_i2c_set_request_timeout;
+	port.bus.run_req = p8_i2c_run_request;
+	i2c_add_bus(&port.bus);
+
+	test_streams(false);
+	test_streams(true);
+	test_nack();
+	test_timeout();
+	test_irq();
+
+	assert(!nr_stub_calls);
+	return 0;
+}
@@ -0,0 +1,277 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define __TEST__
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+
+/* Replace the MMIO accessors with a mock PHB register file */
+#define __IO_H
+#include <skiboot.h>
+
+static uint64_t in_be64(volatile void *addr);
+static void out_be64(volatile void *addr, uint64_t val);
+
+#define sync()
+
+#include "../phb4-tce.c"
+
+enum proc_chip_quirks proc_chip_quirks;
+
+#define MAX_ACCESSES	8192
+
+struct access {
+	bool write;
+	uint32_t reg;
+	uint64_t val;
+};
+
+static struct access accesses[MAX_ACCESSES];
+static unsigned int nr_accesses;
+
+static uint8_t regs[0x1000];
+static struct phb4 phb4 = { .regs = regs };
+
+/* How many reads a kill or a sync stays busy for */
+static unsigned int busy_reads = 2;
+static unsigned int kill_busy, dma_busy, sync_busy;
+static bool fenced;
+
+static void log_access(bool write, uint32_t reg, uint64_t val)
+{
+	assert(nr_accesses < MAX_ACCESSES);
+	accesses[nr_accesses].write = write;
+	accesses[nr_accesses].reg = reg;
+	accesses[nr_accesses].val = val;
+	nr_accesses++;
+}
+
+static uint64_t in_be64(volatile void *addr)
+{
+	uint32_t reg = (uint8_t *)addr - regs;
+	uint64_t val = 0;
+
+	if (fenced)
+		return 0xffffffffffffffffull;
+
+	switch (reg) {
+	case PHB_TCE_KILL:
+		if (kill_busy) {
+			kill_busy--;
+			val = PHB_TCE_KILL_ONE;
+		}
+		break;
+	case PHB_Q_DMA_R:
+		if (dma_busy) {
+			dma_busy--;
+			val = PHB_Q_DMA_R_TCE_KILL_STATUS;
+		}
+		break;
+	case PHB_DMARD_SYNC:
+		if (sync_busy)
+			sync_busy--;
+		else
+			val = PHB_DMARD_SYNC_COMPLETE;
+		break;
+	default:
+		assert(0);
+	}
+	log_access(false, reg, val);
+	return val;
+}
+
+static void out_be64(volatile void *addr, uint64_t val)
+{
+	uint32_t reg = (uint8_t *)addr - regs;
+
+	switch (reg) {
+	case PHB_TCE_KILL:
+		/* The HW can't take a kill while the previous one is busy */
+		assert(!kill_busy);
+		kill_busy = busy_reads;
+		break;
+	case PHB_DMARD_SYNC:
+		assert(val == PHB_DMARD_SYNC_START);
+		dma_busy = busy_reads;
+		sync_busy = busy_reads;
+		break;
+	default:
+		assert(0);
+	}
+	log_access(true, reg, val);
+}
+
+static void reset(void)
+{
+	nr_accesses = 0;
+	kill_busy = dma_busy = sync_busy = 0;
+	fenced = false;
+}
+
+static unsigned int count(bool write, uint32_t reg)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < nr_accesses; i++)
+		if (accesses[i].write == write && accesses[i].reg == reg)
+			n++;
+	return n;
+}
+
+/* Returns the index of the nth write to reg */
+static unsigned int nth_write(uint32_t reg, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_accesses; i++) {
+		if (accesses[i].write && accesses[i].reg == reg && !n--)
+			return i;
+	}
+	assert(0);
+}
+
+/* Every kill must be preceded by a read showing the kill slot free */
+static void check_kill_slots(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_accesses; i++) {
+		if (!accesses[i].write || accesses[i].reg != PHB_TCE_KILL)
+			continue;
+		assert(i > 0);
+		assert(!accesses[i - 1].write && accesses[i - 1].reg == PHB_TCE_KILL);
+		assert(accesses[i - 1].val == 0);
+	}
+}
+
+/* The kills are followed by exactly one DMA read sync */
+static void check_sync(void)
+{
+	unsigned int i = nth_write(PHB_DMARD_SYNC, 0);
+
+	assert(count(true, PHB_DMARD_SYNC) == 1);
+	for (i++; i < nr_accesses; i++)
+		assert(!accesses[i].write);
+	assert(accesses[nr_accesses - 1].reg == PHB_DMARD_SYNC);
+	assert(accesses[nr_accesses - 1].val == PHB_DMARD_SYNC_COMPLETE);
+}
+
+static void test_pages(uint32_t tce_size, uint64_t psel, uint32_t npages)
+{
+	uint64_t addr = 0x80000000ull, pe = 0x1f;
+	unsigned int i;
+	int64_t rc;
+
+	reset();
+	rc = phb4_tce_kill(&phb4.phb, OPAL_PCI_TCE_KILL_PAGES, pe, tce_size,
+			   addr, npages);
+	assert(rc == OPAL_SUCCESS);
+	check_kill_slots();
+	check_sync();
+
+	assert(count(true, PHB_TCE_KILL) == npages);
+	for (i = 0; i < npages; i++) {
+		uint64_t val = accesses[nth_write(PHB_TCE_KILL, i)].val;
+
+		assert(val == (PHB_TCE_KILL_ONE | psel |
+			       SETFIELD(PHB_TCE_KILL_PENUM,
+					addr + (uint64_t)i * tce_size, pe)));
+	}
+}
+
+static void test_bad_pages(uint32_t tce_size, uint64_t addr, uint32_t npages)
+{
+	int64_t rc;
+
+	reset();
+	rc = phb4_tce_kill(&phb4.phb, OPAL_PCI_TCE_KILL_PAGES, 1, tce_size,
+			   addr, npages);
+	assert(rc == OPAL_PARAMETER);
+	/* Nothing may have been killed */
+	assert(nr_accesses == 0);
+}
+
+int main(void)
+{
+	int64_t rc;
+
+	/* One kill per page for each page size */
+	test_pages(0x1000, 0, 1);
+	test_pages(0x1000, 0, 16);
+	test_pages(0x10000, PHB_TCE_KILL_PSEL | PHB_TCE_KILL_64K, 8);
+	test_pages(0x200000, PHB_TCE_KILL_PSEL | PHB_TCE_KILL_2M, 4);
+	test_pages(0x40000000, PHB_TCE_KILL_PSEL | PHB_TCE_KILL_1G, 2);
+	test_pages(0x1000, 0, PHB4_TCE_KILL_PE_THRESHOLD);
+
+	/* Slow hardware doesn't change the sequence */
+	busy_reads = 10;
+	test_pages(0x10000, PHB_TCE_KILL_PSEL | PHB_TCE_KILL_64K, 32);
+	busy_reads = 0;
+	test_pages(0x1000, 0, 32);
+	busy_reads = 2;
+
+	/* Zero pages only syncs */
+	test_pages(0x1000, 0, 0);
+
+	/* Bad parameters are caught before anything is killed */
+	test_bad_pages(0x2000, 0, 1);
+	test_bad_pages(0x1000, 0x800, 1);
+	test_bad_pages(0x10000, 0x1000, 4);
+	test_bad_pages(0x1000, 0xf000000000000000ull, 1);
+	test_bad_pages(0x40000000, 0x0fffffffc0000000ull, 2);
+
+	/* Large ranges become a single PE kill */
+	reset();
+	rc = phb4_tce_kill(&phb4.phb, OPAL_PCI_TCE_KILL_PAGES, 7, 0x1000,
+			   0, PHB4_TCE_KILL_PE_THRESHOLD + 1);
+	assert(rc == OPAL_SUCCESS);
+	check_kill_slots();
+	check_sync();
+	assert(count(true, PHB_TCE_KILL) == 1);
+	assert(accesses[nth_write(PHB_TCE_KILL, 0)].val ==
+	       (PHB_TCE_KILL_PE | SETFIELD(PHB_TCE_KILL_PENUM, 0ull, 7)));
+
+	reset();
+	rc = phb4_tce_kill(&phb4.phb, OPAL_PCI_TCE_KILL_PE, 3, 0, 0, 0);
+	assert(rc == OPAL_SUCCESS);
+	check_kill_slots();
+	check_sync();
+	assert(accesses[nth_write(PHB_TCE_KILL, 0)].val ==
+	       (PHB_TCE_KILL_PE | SETFIELD(PHB_TCE_KILL_PENUM, 0ull, 3)));
+
+	reset();
+	rc = phb4_tce_kill(&phb4.phb, OPAL_PCI_TCE_KILL_ALL, 0, 0, 0, 0);
+	assert(rc == OPAL_SUCCESS);
+	check_kill_slots();
+	check_sync();
+	assert(accesses[nth_write(PHB_TCE_KILL, 0)].val == PHB_TCE_KILL_ALL);
+
+	reset();
+	rc = phb4_tce_kill(&phb4.phb, 42, 0, 0, 0, 0);
+	assert(rc == OPAL_PARAMETER);
+	assert(nr_accesses == 0);
+
+	/* A fenced PHB gives up rather than writing */
+	reset();
+	fenced = true;
+	rc = phb4_tce_kill(&phb4.phb, OPAL_PCI_TCE_KILL_PAGES, 0, 0x1000,
+			   0, 4);
+	assert(rc == OPAL_HARDWARE);
+	assert(count(true, PHB_TCE_KILL) == 0);
+
+	return 0;
+}
@@ -0,0 +1,416 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The rvwinkle cycle of slw_reinit() against a model of the threads
+ * and cores: threads claim rvwinkle some time after their job is
+ * queued, a core logs its winkle in the idle state history a while
+ * after its last thread went down, and kicked threads come back a
+ * while later. Checks nobody is woken before its core winkled, the
+ * timeouts, and how long it all takes.
+ */
+
+#define __TEST__
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+static unsigned long stamp;
+#define mftb()	(stamp)
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+#include <skiboot.h>
+
+enum cpu_thread_state {
+	cpu_state_no_cpu	= 0,
+	cpu_state_unknown,
+	cpu_state_unavailable,
+	cpu_state_present,
+	cpu_state_active,
+	cpu_state_os,
+	cpu_state_disabled,
+	cpu_state_rvwinkle,
+};
+
+struct cpu_thread {
+	uint32_t		pir;
+	uint32_t		chip_id;
+	bool			is_secondary;
+	struct cpu_thread	*primary;
+	enum cpu_thread_state	state;
+};
+
+#define NR_CORES	6
+#define THREADS		8
+#define NR_CPUS		(NR_CORES * THREADS)
+
+static struct cpu_thread cpus[NR_CPUS];
+static struct cpu_thread *cur_cpu;
+static unsigned int cpu_thread_count = THREADS;
+static unsigned int cpu_max_pir = NR_CPUS - 1;
+
+static struct cpu_thread *this_cpu(void)
+{
+	return cur_cpu;
+}
+
+static inline bool cpu_is_available(struct cpu_thread *cpu)
+{
+	return cpu->state == cpu_state_active ||
+		cpu->state == cpu_state_rvwinkle;
+}
+
+static inline bool cpu_is_thread0(struct cpu_thread *cpu)
+{
+	return cpu->primary == cpu;
+}
+
+static inline bool cpu_is_sibling(struct cpu_thread *cpu1,
+				  struct cpu_thread *cpu2)
+{
+	return cpu1->primary == cpu2->primary;
+}
+
+static struct cpu_thread *find_cpu_by_pir(uint32_t pir)
+{
+	return pir < NR_CPUS ? &cpus[pir] : NULL;
+}
+
+static struct cpu_thread *next_cpu(struct cpu_thread *cpu)
+{
+	cpu = cpu ? cpu + 1 : &cpus[0];
+	return cpu < &cpus[NR_CPUS] ? cpu : NULL;
+}
+
+static struct cpu_thread *next_available_cpu(struct cpu_thread *cpu)
+{
+	do {
+		cpu = next_cpu(cpu);
+	} while (cpu && !cpu_is_available(cpu));
+	return cpu;
+}
+
+#define for_each_cpu(cpu)	\
+	for (cpu = next_cpu(NULL); cpu; cpu = next_cpu(cpu))
+#define for_each_available_cpu(cpu)	\
+	for (cpu = next_available_cpu(NULL); cpu; cpu = next_available_cpu(cpu))
+
+struct cpu_job;
+static struct cpu_job *__cpu_queue_job(struct cpu_thread *cpu,
+				       const char *name,
+				       void (*func)(void *data), void *data,
+				       bool no_return);
+
+static void sim_step(unsigned long tb);
+#define sync()		sim_step(50)
+#define lwsync()
+
+#define mfspr(spr)		(0UL)
+#define mtspr(spr, val)		do { (void)(val); } while (0)
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+static unsigned int nr_errors;
+
+#undef prlog
+#define prlog(l, ...) do {			\
+	if ((l) <= PR_ERR)			\
+		nr_errors++;			\
+	mock_printf(__VA_ARGS__);		\
+} while (0)
+#undef prerror
+#define prerror(...) prlog(PR_ERR, __VA_ARGS__)
+
+#include "../slw-rvwinkle.c"
+
+unsigned long tb_hz = 512000000;
+
+/* How long each step takes, in us */
+#define CLAIM_US	20
+#define ENTRY_US	300
+#define WAKE_US		150
+
+static struct thread_sim {
+	unsigned long	claim_tb;	/* Job queued, going down then */
+	unsigned long	wake_tb;	/* Kicked, back then */
+	void		*job_data;
+	bool		stuck;
+} threads[NR_CPUS];
+
+static struct core_sim {
+	unsigned long	down_tb;	/* All threads down since */
+	unsigned long	entry_us;
+	bool		winkled;
+	bool		kicked;
+	uint64_t	history;
+	unsigned int	reads;
+} cores[NR_CORES];
+
+static unsigned int nr_early_kicks, nr_kicks;
+static struct cpu_thread *last_kicked;
+
+static void sim_step(unsigned long tb)
+{
+	unsigned int i, c;
+	bool down;
+
+	stamp += tb;
+	for (i = 0; i < NR_CPUS; i++) {
+		if (threads[i].claim_tb && stamp >= threads[i].claim_tb) {
+			threads[i].claim_tb = 0;
+			cpus[i].state = cpu_state_rvwinkle;
+		}
+		if (threads[i].wake_tb && stamp >= threads[i].wake_tb) {
+			threads[i].wake_tb = 0;
+			cpus[i].state = cpu_state_active;
+		}
+	}
+	for (c = 0; c < NR_CORES; c++) {
+		down = true;
+		for (i = c * THREADS; i < (c + 1) * THREADS; i++)
+			down &= cpus[i].state == cpu_state_rvwinkle;
+		if (!down) {
+			cores[c].down_tb = 0;
+			cores[c].winkled = false;
+			continue;
+		}
+		if (!cores[c].down_tb) {
+			cores[c].down_tb = stamp;
+			cores[c].kicked = false;
+		}
+		if (!cores[c].winkled && stamp >= cores[c].down_tb +
+		    usecs_to_tb(cores[c].entry_us)) {
+			cores[c].winkled = true;
+			cores[c].history = 0x8000000000000000ull;
+		}
+	}
+}
+
+void time_wait_us(unsigned long us)
+{
+	sim_step(usecs_to_tb(us));
+}
+
+uint32_t pir_to_core_id(uint32_t pir)
+{
+	return (pir / THREADS) % 2;
+}
+
+int _xscom_read(uint32_t partid, uint64_t pcb_addr, uint64_t *val,
+		bool take_lock __unused)
+{
+	unsigned int c;
+
+	for (c = 0; c < 2; c++)
+		if (pcb_addr == XSCOM_ADDR_P8_EX_SLAVE(c,
+					EX_PM_IDLE_STATE_HISTORY_PHYP))
+			break;
+	assert(c < 2);
+	c += partid * 2;
+	assert(c < NR_CORES);
+
+	sim_step(usecs_to_tb(1));
+	cores[c].reads++;
+	*val = cores[c].history;
+	cores[c].history = 0;
+	return 0;
+}
+
+static unsigned int nr_writes;
+
+int _xscom_write(uint32_t partid __unused, uint64_t pcb_addr __unused,
+		 uint64_t val __unused, bool take_lock __unused)
+{
+	nr_writes++;
+	return 0;
+}
+
+static struct cpu_job *__cpu_queue_job(struct cpu_thread *cpu,
+				       const char *name __unused,
+				       void (*func)(void *data), void *data,
+				       bool no_return)
+{
+	struct thread_sim *t = &threads[cpu->pir];
+
+	assert(func == slw_do_rvwinkle && no_return);
+	assert(cpu != this_cpu());
+	t->job_data = data;
+	if (!t->stuck)
+		t->claim_tb = stamp + usecs_to_tb(CLAIM_US + cpu->pir);
+	return NULL;
+}
+
+void icp_kick_cpu(struct cpu_thread *cpu)
+{
+	struct core_sim *c = &cores[cpu->pir / THREADS];
+
+	/* The first one wakes the core up */
+	assert(cpu->state == cpu_state_rvwinkle);
+	if (!c->kicked && !c->winkled)
+		nr_early_kicks++;
+	c->kicked = true;
+	nr_kicks++;
+	last_kicked = cpu;
+	threads[cpu->pir].wake_tb = stamp + usecs_to_tb(WAKE_US);
+}
+
+/* What runs on the waker */
+void icp_prep_for_pm(void)
+{
+}
+
+void enter_p8_pm_state(bool winkle)
+{
+	assert(winkle);
+}
+
+void init_shared_sprs(void)
+{
+}
+
+void init_replicated_sprs(void)
+{
+}
+
+void reset_cpu_icp(void)
+{
+}
+
+bool chiptod_wakeup_resync(void)
+{
+	return true;
+}
+
+static void reset(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		memset(&threads[i], 0, sizeof(threads[i]));
+		cpus[i].state = cpu_state_active;
+	}
+	for (i = 0; i < NR_CORES; i++) {
+		memset(&cores[i], 0, sizeof(cores[i]));
+		cores[i].entry_us = ENTRY_US + 50 * i;
+	}
+	nr_early_kicks = nr_kicks = nr_errors = 0;
+	stamp += usecs_to_tb(1000);
+}
+
+/* Returns the elapsed time */
+static unsigned long run(int64_t expect)
+{
+	unsigned long start = stamp;
+
+	assert(slw_rvwinkle_others() == expect);
+	assert(!slw_cores);
+
+	return stamp - start;
+}
+
+int main(void)
+{
+	struct cpu_thread *me, *waker = &cpus[THREADS];
+	unsigned long elapsed;
+	unsigned int i;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		cpus[i].pir = i;
+		cpus[i].chip_id = i / (2 * THREADS);
+		cpus[i].is_secondary = i % THREADS;
+		cpus[i].primary = &cpus[i - i % THREADS];
+	}
+	/* Not a thread 0, the waker must still be elsewhere */
+	me = cur_cpu = &cpus[1];
+
+	/* Everybody else down, all the other cores back up */
+	reset();
+	elapsed = run(OPAL_SUCCESS);
+	printf("%u cores: %lu us, was over 1000000 us\n", NR_CORES,
+	       tb_to_usecs(elapsed));
+	assert(elapsed < msecs_to_tb(2));
+	assert(!nr_early_kicks && !nr_errors);
+	assert(nr_kicks == NR_CPUS - THREADS);
+	for (i = 0; i < NR_CPUS; i++) {
+		assert(threads[i].job_data == (&cpus[i] == waker ? me : NULL));
+		if (&cpus[i] == me)
+			assert(cpus[i].state == cpu_state_active);
+		else if (cpu_is_sibling(&cpus[i], me))
+			assert(cpus[i].state == cpu_state_rvwinkle);
+		else
+			assert(cpus[i].state == cpu_state_active);
+	}
+	/* Our core is left for the waker */
+	assert(!cores[0].reads);
+
+	/* A core logging its winkle before we looked: the old delay */
+	reset();
+	cores[3].entry_us = 0;
+	elapsed = run(OPAL_SUCCESS);
+	assert(elapsed >= msecs_to_tb(SLW_RVWINKLE_CORE_TIMEOUT_MS));
+	assert(elapsed < msecs_to_tb(SLW_RVWINKLE_CORE_TIMEOUT_MS + 2));
+	assert(!nr_early_kicks && !nr_errors);
+
+	/* A thread that never goes down, everybody comes back */
+	reset();
+	threads[4 * THREADS + 5].stuck = true;
+	elapsed = run(OPAL_TIMEOUT);
+	assert(elapsed >= msecs_to_tb(SLW_RVWINKLE_STATE_TIMEOUT_MS));
+	assert(elapsed < msecs_to_tb(SLW_RVWINKLE_STATE_TIMEOUT_MS + 2));
+	assert(slw_rvwinkle_aborted && nr_errors);
+	for (i = 0; i < NR_CPUS; i++)
+		assert(cpus[i].state == cpu_state_active);
+
+	/* Nobody on another core to wake us, nobody goes down */
+	reset();
+	for (i = THREADS; i < NR_CPUS; i++)
+		cpus[i].state = cpu_state_disabled;
+	run(OPAL_HARDWARE);
+	assert(!threads[2].job_data && !threads[2].claim_tb);
+
+	/* The waker: our siblings down, then us, then the core winkles */
+	reset();
+	for (i = 0; i < THREADS; i++)
+		cpus[i].state = cpu_state_rvwinkle;
+	slw_rvwinkle_aborted = false;
+	cur_cpu = waker;
+	elapsed = stamp;
+	slw_do_rvwinkle(me);
+	elapsed = stamp - elapsed;
+	assert(!nr_early_kicks && !nr_errors);
+	assert(nr_kicks == THREADS && last_kicked == me);
+	assert(elapsed >= usecs_to_tb(ENTRY_US));
+	assert(elapsed < usecs_to_tb(ENTRY_US + WAKE_US + 100));
+	for (i = 0; i < THREADS; i++)
+		assert(cpus[i].state == (&cpus[i] == me ? cpu_state_rvwinkle :
+					 cpu_state_active));
+
+	/* We gave up, the waker goes */
+	reset();
+	slw_rvwinkle_aborted = true;
+	slw_do_rvwinkle(me);
+	assert(!nr_kicks);
+	assert(!nr_writes);
+
+	return 0;
+}
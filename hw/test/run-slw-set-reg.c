@@ -0,0 +1,588 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * OPAL_SLW_SET_REG_VECTOR against OPAL_SLW_SET_REG: the P9 stop api
+ * runs on in-memory HOMER images, the vector has to leave them exactly
+ * as the same registers set one call at a time do, and fail the same
+ * entries. On P8 the calls to libpore are compared instead.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static unsigned int nr_errors;
+
+#include <skiboot.h>
+#include <processor.h>
+#include <errorlog.h>
+
+#undef sync_icache
+#define sync_icache()	do { } while (0)
+
+/* Built for the host, the stop api trips over its own byte swapping */
+#pragma GCC diagnostic ignored "-Wundef"
+#pragma GCC diagnostic ignored "-Wshift-overflow"
+#include "../../libpore/p9_stop_util.C"
+#include "../../libpore/p9_stop_api.C"
+#include "../../libpore/p8_pore_table_static_data.c"
+
+static inline void mock_printf(const char *fmt __unused, ...)
+{
+}
+
+#undef prlog
+#define prlog(l, ...) do {			\
+	if ((l) <= PR_ERR)			\
+		nr_errors++;			\
+	mock_printf(__VA_ARGS__);		\
+} while (0)
+#undef log_simple_error
+#define log_simple_error(e_info, ...) ({		\
+	(void)(e_info);				\
+	nr_errors++;				\
+	mock_printf(__VA_ARGS__);		\
+	0;					\
+})
+
+/* An empty reset patch, slw_reinit() leaves 0x100 alone */
+#define reset_patch_end reset_patch_start
+
+#include "../slw.c"
+
+#define NR_CHIPS	2
+#define NR_CORES	3
+#define THREADS		4
+#define NR_CPUS		(NR_CHIPS * NR_CORES * THREADS)
+#define MAX_REGS	(NR_CPUS * 8 + 2)
+
+enum proc_gen proc_gen;
+enum proc_chip_quirks proc_chip_quirks;
+unsigned long top_of_ram = ~0UL;
+struct dt_node *dt_root;
+struct dt_node *opal_node;
+uint32_t reset_patch_start;
+
+static struct proc_chip chips[NR_CHIPS];
+static struct cpu_thread cpus[NR_CPUS];
+static unsigned int nr_stub_calls;
+
+static uint32_t cpu_pir(unsigned int chip, unsigned int core,
+			unsigned int thread)
+{
+	return chip << 8 | core << 2 | thread;
+}
+
+struct cpu_thread *find_cpu_by_pir(u32 pir)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_CPUS; i++)
+		if (cpus[i].pir == pir)
+			return &cpus[i];
+	return NULL;
+}
+
+struct proc_chip *get_chip(uint32_t chip_id)
+{
+	return chip_id < NR_CHIPS ? &chips[chip_id] : NULL;
+}
+
+uint32_t cpu_get_core_index(struct cpu_thread *cpu)
+{
+	return (cpu->pir >> 2) & 0x3f;
+}
+
+/* What a P8 image would have been asked to do */
+static struct p8_call {
+	void *image;
+	uint32_t sprn, core, thread;
+	uint64_t val;
+} p8_calls[2][MAX_REGS];
+static unsigned int nr_p8_calls[2], p8_run;
+
+uint32_t p8_pore_gen_cpureg_fixed(void *io_image, uint8_t i_modeBuild,
+				  uint32_t i_regName, uint64_t i_regData,
+				  uint32_t i_coreId, uint32_t i_threadId)
+{
+	struct p8_call *c = &p8_calls[p8_run][nr_p8_calls[p8_run]++];
+
+	assert(nr_p8_calls[p8_run] <= MAX_REGS);
+	assert(i_modeBuild == P8_SLW_MODEBUILD_SRAM);
+	c->image = io_image;
+	c->sprn = i_regName;
+	c->val = i_regData;
+	c->core = i_coreId;
+	c->thread = i_threadId;
+	return 0;
+}
+
+/* Not used by the calls under test */
+struct dt_property *dt_add_property(struct dt_node *node __unused,
+				    const char *name __unused,
+				    const void *val __unused,
+				    size_t size __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+const struct dt_property *dt_find_property(const struct dt_node *node __unused,
+					   const char *name __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+struct dt_node *dt_new_check(struct dt_node *parent __unused,
+			     const char *name __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+bool dt_prop_find_string(const struct dt_property *p __unused,
+			 const char *s __unused)
+{
+	nr_stub_calls++;
+	return false;
+}
+
+u32 dt_prop_get_u32_def(const struct dt_node *node __unused,
+			const char *prop __unused, u32 def)
+{
+	nr_stub_calls++;
+	return def;
+}
+
+struct cpu_thread *first_available_cpu(void)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+struct cpu_thread *next_available_cpu(struct cpu_thread *cpu __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+/* Walked by slw_cleanup_chip() only, with no cores */
+static unsigned int nr_core_walks;
+
+struct cpu_thread *first_available_core_in_chip(u32 chip_id __unused)
+{
+	nr_core_walks++;
+	return NULL;
+}
+
+struct cpu_thread *next_available_core_in_chip(struct cpu_thread *cpu __unused,
+					       u32 chip_id __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+struct proc_chip *next_chip(struct proc_chip *chip)
+{
+	if (!chip)
+		return &chips[0];
+	if (++chip < &chips[NR_CHIPS])
+		return chip;
+	return NULL;
+}
+
+uint32_t pir_to_core_id(uint32_t pir)
+{
+	nr_stub_calls++;
+	return pir;
+}
+
+const char *nvram_query(const char *name __unused)
+{
+	nr_stub_calls++;
+	return NULL;
+}
+
+void nx_p9_rng_late_init(void)
+{
+	nr_stub_calls++;
+}
+
+void xive_late_init(void)
+{
+	nr_stub_calls++;
+}
+
+void p8_sbe_init_timer(void)
+{
+	nr_stub_calls++;
+}
+
+/* The scan override in each chip's SLW image */
+static uint64_t scans[NR_CHIPS];
+
+static uint64_t *image_scans(void *image, const char *id)
+{
+	unsigned int c;
+
+	assert(!strcmp(id, "skip_ex_override_ring_scans"));
+	for (c = 0; c < NR_CHIPS; c++)
+		if (chips[c].slw_base == (uint64_t)image)
+			return &scans[c];
+	assert(0);
+	return NULL;
+}
+
+int sbe_xip_get_scalar(void *i_image, const char *i_id, uint64_t *o_data)
+{
+	*o_data = *image_scans(i_image, i_id);
+	return 0;
+}
+
+int sbe_xip_set_scalar(void *io_image, const char *i_id,
+		       const uint64_t i_data)
+{
+	*image_scans(io_image, i_id) = i_data;
+	return 0;
+}
+
+int _xscom_read(uint32_t partid __unused, uint64_t pcb_addr __unused,
+		uint64_t *val __unused, bool take_lock __unused)
+{
+	nr_stub_calls++;
+	return -1;
+}
+
+int _xscom_write(uint32_t partid __unused, uint64_t pcb_addr __unused,
+		 uint64_t val __unused, bool take_lock __unused)
+{
+	nr_stub_calls++;
+	return -1;
+}
+
+void _prlog(int log_level __unused, const char *fmt __unused, ...)
+{
+}
+
+void slw_do_rvwinkle(void *data __unused)
+{
+	nr_stub_calls++;
+}
+
+static unsigned int nr_rvwinkles;
+static int64_t rvwinkle_rc;
+
+int64_t slw_rvwinkle_others(void)
+{
+	nr_rvwinkles++;
+	return rvwinkle_rc;
+}
+
+/* A HOMER as the hcode leaves it: empty restore areas, non fused */
+static void *new_homer(void)
+{
+	HomerSection_t *homer = calloc(1, sizeof(*homer));
+	HomerImgDesc_t *desc = (HomerImgDesc_t *)homer->interrruptHandler;
+	unsigned int c, t;
+
+	assert(homer);
+	desc->cpmrMagicWord = SWIZZLE_8_BYTE(CPMR_MAGIC_NUMBER);
+	desc->fusedModeStatus = NONFUSED_CORE_MODE;
+	for (c = 0; c < MAX_CORES_PER_CHIP; c++) {
+		for (t = 0; t < MAX_THREADS_PER_CORE; t++) {
+			SprRestoreArea_t *a = &homer->coreThreadRestore[c][t];
+
+			*(uint32_t *)a->threadArea = SWIZZLE_4_BYTE(BLR_INST);
+			*(uint32_t *)a->coreArea = SWIZZLE_4_BYTE(BLR_INST);
+		}
+	}
+	return homer;
+}
+
+static const uint32_t p9_thread_sprs[] = {
+	P9_STOP_SPR_HSPRG0, P9_STOP_SPR_LPCR, P9_STOP_SPR_PSSCR,
+	P9_STOP_SPR_MSR,
+};
+static const uint32_t p9_core_sprs[] = {
+	P9_STOP_SPR_HRMOR, P9_STOP_SPR_HMEER, P9_STOP_SPR_HID,
+	P9_STOP_SPR_PMCR,
+};
+
+static struct opal_slw_reg regs[MAX_REGS];
+static int64_t single_rc[MAX_REGS];
+
+static void add_reg(unsigned int *n, uint32_t pir, uint32_t sprn, uint64_t val)
+{
+	assert(*n < MAX_REGS);
+	regs[*n].pir = cpu_to_be32(pir);
+	regs[*n].sprn = cpu_to_be32(sprn);
+	regs[*n].value = cpu_to_be64(val);
+	regs[*n].rc = cpu_to_be32(0xdead);
+	(*n)++;
+}
+
+/* Everything the kernel sets at boot, sorted by core, plus bad ones */
+static unsigned int build_regs(const uint32_t *thread_sprs, unsigned int nt,
+			       const uint32_t *core_sprs, unsigned int nc,
+			       uint32_t bad_sprn)
+{
+	unsigned int n = 0, i, j;
+	uint32_t pir;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		pir = cpus[i].pir;
+		for (j = 0; j < nt; j++)
+			add_reg(&n, pir, thread_sprs[j], (uint64_t)pir << 32 | j);
+		if (cpus[i].primary != &cpus[i])
+			continue;
+		for (j = 0; j < nc; j++)
+			add_reg(&n, pir, core_sprs[j], 0xc0de0000ull | pir << 4 | j);
+		/* Same core, now with one the image doesn't take */
+		if (i == NR_CPUS / 2)
+			add_reg(&n, pir, bad_sprn, 1);
+	}
+	/* And a thread that doesn't exist */
+	add_reg(&n, cpu_pir(NR_CHIPS, 0, 0), thread_sprs[0], 2);
+
+	return n;
+}
+
+static void run_single(unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		single_rc[i] = opal_slw_set_reg(be32_to_cpu(regs[i].pir),
+						be32_to_cpu(regs[i].sprn),
+						be64_to_cpu(regs[i].value));
+}
+
+static void check_vector_rcs(unsigned int n, int64_t rc)
+{
+	unsigned int i, failed = 0;
+
+	for (i = 0; i < n; i++) {
+		assert((int32_t)be32_to_cpu(regs[i].rc) == single_rc[i]);
+		if (single_rc[i])
+			failed++;
+	}
+	assert(failed == 2);
+	assert(single_rc[n - 1] == OPAL_PARAMETER);
+	assert(rc == OPAL_PARTIAL);
+}
+
+static void test_p9(void)
+{
+	void *single[NR_CHIPS], *vector[NR_CHIPS];
+	unsigned int n, c, i;
+	int64_t rc;
+
+	proc_gen = proc_gen_p9;
+	has_deep_states = true;
+	wakeup_engine_state = WAKEUP_ENGINE_PRESENT;
+
+	n = build_regs(p9_thread_sprs, ARRAY_SIZE(p9_thread_sprs),
+		       p9_core_sprs, ARRAY_SIZE(p9_core_sprs), 9999);
+
+	for (c = 0; c < NR_CHIPS; c++) {
+		single[c] = new_homer();
+		vector[c] = new_homer();
+		chips[c].homer_base = (uint64_t)single[c];
+	}
+	nr_errors = 0;
+	run_single(n);
+	assert(nr_errors == 2);
+
+	for (c = 0; c < NR_CHIPS; c++)
+		chips[c].homer_base = (uint64_t)vector[c];
+	nr_errors = 0;
+	rc = opal_slw_set_reg_vector(regs, n);
+	assert(nr_errors == 2);
+	check_vector_rcs(n, rc);
+
+	for (c = 0; c < NR_CHIPS; c++) {
+		HomerSection_t *h = vector[c];
+
+		assert(!memcmp(single[c], vector[c], sizeof(HomerSection_t)));
+		/* And they really did get something */
+		for (i = 0; i < NR_CORES * THREADS; i++)
+			assert(*(uint32_t *)h->coreThreadRestore[i / THREADS]
+			       [i % THREADS].threadArea !=
+			       SWIZZLE_4_BYTE(BLR_INST));
+	}
+
+	/* Setting them again only rewrites the values */
+	rc = opal_slw_set_reg_vector(regs, n);
+	assert(rc == OPAL_PARTIAL);
+	for (c = 0; c < NR_CHIPS; c++)
+		assert(!memcmp(single[c], vector[c], sizeof(HomerSection_t)));
+
+	/*
+	 * No deep states, nothing to do but not a failure either, except
+	 * for the thread that doesn't exist
+	 */
+	has_deep_states = false;
+	memset(vector[0], 0xa5, sizeof(HomerSection_t));
+	assert(opal_slw_set_reg_vector(regs, n) == OPAL_PARTIAL);
+	for (i = 0; i < n; i++)
+		assert((int32_t)be32_to_cpu(regs[i].rc) ==
+		       opal_slw_set_reg(be32_to_cpu(regs[i].pir),
+					be32_to_cpu(regs[i].sprn), 0));
+	assert((int32_t)be32_to_cpu(regs[n - 1].rc) == OPAL_PARAMETER);
+	assert(opal_slw_set_reg_vector(regs, n - 1) == OPAL_SUCCESS);
+	assert(((uint8_t *)vector[0])[CPMR_HOMER_OFFSET] == 0xa5);
+	has_deep_states = true;
+
+	/* Nor without the engine, per entry like the single call */
+	wakeup_engine_state = WAKEUP_ENGINE_FAILED;
+	assert(opal_slw_set_reg_vector(regs, 2) == OPAL_PARTIAL);
+	assert(be32_to_cpu(regs[0].rc) == (uint32_t)OPAL_INTERNAL_ERROR);
+	assert(opal_slw_set_reg(be32_to_cpu(regs[0].pir),
+				be32_to_cpu(regs[0].sprn), 0) ==
+	       OPAL_INTERNAL_ERROR);
+	wakeup_engine_state = WAKEUP_ENGINE_PRESENT;
+
+	for (c = 0; c < NR_CHIPS; c++) {
+		free(single[c]);
+		free(vector[c]);
+	}
+}
+
+static void test_p8(void)
+{
+	static const uint32_t p8_thread_sprs[] = {
+		P8_SPR_HSPRG0, P8_SPR_LPCR, P8_MSR_MSR,
+	};
+	static const uint32_t p8_core_sprs[] = {
+		P8_SPR_HRMOR, P8_SPR_HID0, P8_SPR_HID1, P8_SPR_HID4,
+		P8_SPR_HID5,
+	};
+	unsigned int n, i, nr_chip1 = 0;
+	int64_t rc;
+
+	proc_gen = proc_gen_p8;
+	chips[0].slw_base = 0x1000;
+	chips[1].slw_base = 0x2000;
+
+	n = build_regs(p8_thread_sprs, ARRAY_SIZE(p8_thread_sprs),
+		       p8_core_sprs, ARRAY_SIZE(p8_core_sprs), 9999);
+
+	p8_run = 0;
+	run_single(n);
+	p8_run = 1;
+	rc = opal_slw_set_reg_vector(regs, n);
+	check_vector_rcs(n, rc);
+
+	assert(nr_p8_calls[0] == n - 2);
+	assert(nr_p8_calls[1] == nr_p8_calls[0]);
+	assert(!memcmp(p8_calls[0], p8_calls[1],
+		       nr_p8_calls[0] * sizeof(p8_calls[0][0])));
+	for (i = 0; i < n; i++)
+		if (!single_rc[i] && be32_to_cpu(regs[i].pir) >> 8)
+			nr_chip1++;
+	for (i = 0; i < nr_p8_calls[1]; i++)
+		if (p8_calls[1][i].image == (void *)0x2000ul)
+			nr_chip1--;
+	assert(!nr_chip1);
+}
+
+static void test_args(void)
+{
+	proc_gen = proc_gen_p9;
+	assert(opal_slw_set_reg_vector(regs, 0) == OPAL_PARAMETER);
+	assert(opal_slw_set_reg_vector(regs, OPAL_SLW_SET_REG_MAX + 1) ==
+	       OPAL_PARAMETER);
+	assert(opal_slw_set_reg_vector((void *)0x8000000000000000ul, 1) ==
+	       OPAL_PARAMETER);
+}
+
+/* When the others can't go down, nothing is left switched to LE */
+static void test_reinit_fail(void)
+{
+	proc_gen = proc_gen_p8;
+	chips[0].slw_base = 0x1000;
+	chips[1].slw_base = 0x2000;
+	scans[0] = 1;
+	scans[1] = 0x5a;
+	slw_current_le = false;
+	nr_errors = 0;
+	rvwinkle_rc = OPAL_HARDWARE;
+
+	assert(slw_reinit(OPAL_REINIT_CPUS_HILE_LE) == OPAL_HARDWARE);
+	assert(nr_rvwinkles == 1);
+	assert(scans[0] == 1 && scans[1] == 0x5a);
+	assert(!slw_current_le);
+	assert(!nr_core_walks);
+
+	/* Nor when a chip has no SLW image, which is checked first */
+	chips[1].slw_base = 0;
+	assert(slw_reinit(OPAL_REINIT_CPUS_HILE_LE) == OPAL_HARDWARE);
+	assert(nr_rvwinkles == 1);
+	assert(scans[0] == 1);
+	assert(!slw_current_le);
+	assert(nr_errors == 1);
+	chips[1].slw_base = 0x2000;
+}
+
+/* After a timeout cores may have gone through with LE: keep it */
+static void test_reinit_timeout(void)
+{
+	proc_gen = proc_gen_p8;
+	scans[0] = 1;
+	scans[1] = 1;
+	slw_current_le = false;
+	nr_rvwinkles = 0;
+	nr_core_walks = 0;
+	rvwinkle_rc = OPAL_TIMEOUT;
+
+	assert(slw_reinit(OPAL_REINIT_CPUS_HILE_LE) == OPAL_TIMEOUT);
+	assert(nr_rvwinkles == 1);
+	assert(scans[0] == 0 && scans[1] == 0);
+	assert(slw_current_le);
+	/* And every chip is cleaned up */
+	assert(nr_core_walks == NR_CHIPS);
+}
+
+int main(void)
+{
+	unsigned int chip, core, t, i = 0;
+
+	for (chip = 0; chip < NR_CHIPS; chip++) {
+		chips[chip].id = chip;
+		for (core = 0; core < NR_CORES; core++) {
+			struct cpu_thread *primary = &cpus[i];
+
+			for (t = 0; t < THREADS; t++, i++) {
+				cpus[i].pir = cpu_pir(chip, core, t);
+				cpus[i].chip_id = chip;
+				cpus[i].primary = primary;
+			}
+		}
+	}
+
+	test_p9();
+	test_p8();
+	test_args();
+	test_reinit_fail();
+	test_reinit_timeout();
+
+	assert(!nr_stub_calls);
+	return 0;
+}
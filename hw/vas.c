@@ -19,6 +19,7 @@
 #include <xscom.h>
 #include <io.h>
 #include <vas.h>
+#include <chip-init.h>
 
 #define vas_err(__fmt,...)	prlog(PR_ERR,"VAS: " __fmt, ##__VA_ARGS__)
 
@@ -436,7 +437,8 @@ static void disable_vas_inst(struct dt_node *np)
 }
 
 /*
- * Initialize one VAS instance and enable it if @enable is true.
+ * Initialize one VAS instance and enable it if @enable is true. Runs
+ * for all the chips at once, the device-tree is left to vas_init_finish().
  */
 static int init_vas_inst(struct dt_node *np, bool enable)
 {
@@ -464,35 +466,56 @@ static int init_vas_inst(struct dt_node *np, bool enable)
 	    			init_rma(chip))
 		return -1;
 
-	create_mm_dt_node(chip);
-
 	prlog(PR_NOTICE, "VAS: Initialized chip %d\n", chip->id);
 	return 0;
 
 }
 
-void vas_init()
+/* Set by any chip that failed, only ever from false to true */
+static bool vas_failed;
+
+static void vas_init_chip(struct proc_chip *chip)
 {
-	bool enabled;
 	struct dt_node *np;
 
 	if (proc_gen != proc_gen_p9)
 		return;
 
-	enabled = vas_nx_enabled();
-
 	dt_for_each_compatible(dt_root, np, "ibm,power9-vas-x") {
-		if (init_vas_inst(np, enabled))
-			goto out;
+		if (dt_get_chip_id(np) != chip->id)
+			continue;
+		if (init_vas_inst(np, vas_nx_enabled()))
+			vas_failed = true;
 	}
+}
 
-	vas_initialized = enabled;
-	return;
+static void vas_init_finish(void)
+{
+	struct proc_chip *chip;
+	struct dt_node *np;
 
-out:
-	dt_for_each_compatible(dt_root, np, "ibm,power9-vas-x")
-		disable_vas_inst(np);
+	if (proc_gen != proc_gen_p9)
+		return;
 
-	vas_err("Disabled (failed initialization)\n");
-	return;
+	if (vas_failed) {
+		dt_for_each_compatible(dt_root, np, "ibm,power9-vas-x")
+			disable_vas_inst(np);
+
+		vas_err("Disabled (failed initialization)\n");
+		return;
+	}
+
+	vas_initialized = vas_nx_enabled();
+	if (!vas_initialized)
+		return;
+
+	for_each_chip(chip)
+		if (chip->vas)
+			create_mm_dt_node(chip);
 }
+
+const struct chip_init_unit vas_chip_unit = {
+	.name		= "vas",
+	.init_chip	= vas_init_chip,
+	.finish		= vas_init_finish,
+};
@@ -0,0 +1,62 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/* Layout of the ibm,opal/boot-profile property, shared with the decoder */
+#ifndef __BOOT_PROFILE_TYPES_H
+#define __BOOT_PROFILE_TYPES_H
+
+#include <types.h>
+
+#define BOOT_PROFILE_MAGIC	0x42505246	/* "BPRF" */
+#define BOOT_PROFILE_VERSION	1
+
+#define BOOT_PROFILE_PHASE	1	/* A step of main_cpu_entry() */
+#define BOOT_PROFILE_JOB	2	/* A cpu_job */
+
+#define BOOT_PROFILE_NAME_LEN	24
+
+struct boot_profile_hdr {
+	__be32 magic;
+	__be32 version;
+	__be64 tb_hz;
+	__be32 nr_entries;
+	/* Entries that didn't fit and were not recorded */
+	__be32 nr_dropped;
+	/* Bytes read from the system flash */
+	__be64 flash_bytes;
+	/* Timebase ticks spent spinning on contended locks, all CPUs */
+	__be64 lock_wait_tb;
+};
+
+/*
+ * Timestamps are raw timebase values. The timebase isn't synchronised
+ * until chiptod_init(), so stamps taken before then come from a free
+ * running timebase and may be after those taken later on.
+ *
+ * end_tb is zero if the phase or job hadn't finished when the profile
+ * was exported.
+ */
+struct boot_profile_entry {
+	__be64 start_tb;
+	__be64 end_tb;
+	/* Ticks this CPU spent waiting for locks during the entry */
+	__be64 lock_wait_tb;
+	__be32 pir;
+	u8 type;
+	u8 reserved[3];
+	char name[BOOT_PROFILE_NAME_LEN];
+};
+
+#endif /* __BOOT_PROFILE_TYPES_H */
@@ -0,0 +1,43 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __BOOT_PROFILE_H
+#define __BOOT_PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Boot profiling
+ *
+ * Records when each phase of the boot and each cpu_job ran, so that
+ * boot time can be tracked across releases. The result is exported to
+ * the OS as ibm,opal/boot-profile, see boot-profile-types.h for the
+ * layout. Recording stops once the profile has been exported.
+ */
+
+/* End the current boot phase and start a new one, NULL just ends it */
+extern void boot_phase(const char *name);
+
+/* Returns a handle to pass to boot_profile_job_end(), or -1 */
+extern int boot_profile_job_start(const char *name);
+extern void boot_profile_job_end(int slot);
+
+extern void boot_profile_flash_read(uint64_t bytes);
+
+/* Ends the current phase and adds ibm,opal/boot-profile */
+extern void boot_profile_add_dt(void);
+
+#endif /* __BOOT_PROFILE_H */
@@ -0,0 +1,48 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CHIP_INIT_H
+#define __CHIP_INIT_H
+
+struct proc_chip;
+
+#define CHIP_INIT_MAX_DEPS	4
+
+/*
+ * A unit of per chip initialisation, run at boot by chip_init_run().
+ *
+ * init_chip() is called once for each chip, from a CPU of that chip
+ * when there is one, concurrently with the other chips and with the
+ * other units. It mustn't touch the device-tree or state shared with
+ * other chips without locking, that belongs in finish() which runs on
+ * the boot CPU once all the chips are done.
+ *
+ * A unit starts on a chip once each of its dependencies is done on that
+ * same chip, or everywhere when the dependency has a finish() hook, in
+ * which case the hook has run too. Dependencies not part of the same
+ * chip_init_run() are assumed to have run already.
+ */
+struct chip_init_unit {
+	const char			*name;
+	void				(*init_chip)(struct proc_chip *chip);
+	void				(*finish)(void);
+	/* NULL terminated */
+	const struct chip_init_unit	*deps[CHIP_INIT_MAX_DEPS + 1];
+};
+
+extern void chip_init_run(const struct chip_init_unit * const *units,
+			  unsigned int nr_units);
+
+#endif /* __CHIP_INIT_H */
@@ -187,6 +187,7 @@ struct proc_chip {
 	uint64_t		slw_base;
 	uint64_t		slw_bar_size;
 	uint64_t		slw_image_size;
+	uint64_t		slw_saved_scans;
 
 	/* Used by hw/homer.c */
 	uint64_t		homer_base;
@@ -222,6 +223,9 @@ struct proc_chip {
 
 	/* Used by hw/sbe-p9.c */
 	struct p9_sbe		*sbe;
+
+	/* Malfunction alert and NX/CAPP/NPU FIR decode during HMIs */
+	struct lock		hmi_lock;
 };
 
 extern uint32_t pir_to_chip_id(uint32_t pir);
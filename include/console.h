@@ -51,6 +51,8 @@ struct con_ops {
 	size_t (*write)(const char *buf, size_t len);
 	size_t (*read)(char *buf, size_t len);
 	bool (*poll_read)(void);
+	/* Synchronously push out whatever write() left buffered */
+	void (*flush)(void);
 };
 
 struct opal_con_ops {
@@ -76,6 +78,7 @@ struct opal_con_ops {
 };
 
 extern bool flush_console(void);
+extern void flush_console_sync(void);
 
 extern void set_console(struct con_ops *driver);
 extern void set_opal_console(struct opal_con_ops *driver);
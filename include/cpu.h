@@ -43,6 +43,7 @@ enum cpu_thread_state {
 
 struct cpu_job;
 struct xive_cpu_state;
+struct lat_hist;
 
 struct cpu_thread {
 	/*
@@ -64,6 +65,7 @@ struct cpu_thread {
 	uint32_t			quiesce_opal_call;
 	uint32_t			con_suspend;
 	struct list_head		locks_held;
+	uint64_t			lock_wait_tb; /* spent on contended locks */
 	bool				con_need_flush;
 	bool				in_mcount;
 	bool				in_poller;
@@ -74,6 +76,8 @@ struct cpu_thread {
 	uint32_t			hbrt_spec_wakeup; /* primary only */
 	uint64_t			save_l2_fir_action1;
 	uint64_t			current_token;
+	uint64_t			opal_call_tb;	/* entry of the call */
+	struct lat_hist			*opal_call_lat;	/* per token, or NULL */
 #ifdef STACK_CHECK_ENABLED
 	int64_t				stack_bot_mark;
 	uint64_t			stack_bot_pc;
@@ -97,6 +101,8 @@ struct cpu_thread {
 	 */
 	uint32_t			core_hmi_state; /* primary only */
 	uint32_t			*core_hmi_state_ptr;
+	/* Core wide TFMR cleanup and SPRC/SPRD accesses during HMIs */
+	struct lock			hmi_lock; /* primary only */
 	bool				tb_invalid;
 	bool				tb_resynced;
 
@@ -280,6 +286,11 @@ static inline struct cpu_job *cpu_queue_job(struct cpu_thread *cpu,
 	return __cpu_queue_job(cpu, name, func, data, false);
 }
 
+/* Queue a job on the least busy CPU of a chip, NULL if there is none */
+extern struct cpu_job *cpu_queue_job_on_chip(uint32_t chip_id,
+					     const char *name,
+					     void (*func)(void *data),
+					     void *data);
 
 /* Poll job status, returns true if completed */
 extern bool cpu_poll_job(struct cpu_job *job);
@@ -297,6 +308,21 @@ extern void cpu_process_local_jobs(void);
 /* Check if there's any job pending */
 bool cpu_check_jobs(struct cpu_thread *cpu);
 
+/*
+ * Run func() on every available CPU but skip, or only on the primary
+ * threads, all the cores at once. A core's secondaries start once its
+ * primary is done, and not at all if func() failed there. Then done(),
+ * if any, is called here for each CPU func() ran on, in PIR order,
+ * with what it returned (false if it couldn't be queued). Returns the
+ * number of failures.
+ */
+extern unsigned int cpu_run_per_core(const char *name,
+				     bool (*func)(void *data), void *data,
+				     struct cpu_thread *skip,
+				     bool primaries_only,
+				     void (*done)(struct cpu_thread *cpu,
+						  bool ok, void *data));
+
 /* OPAL sreset vector in place at 0x100 */
 void cpu_set_sreset_enable(bool sreset_enabled);
 
@@ -320,6 +346,10 @@ extern void cpu_fast_reboot_complete(void);
 
 int dctl_set_special_wakeup(struct cpu_thread *t);
 int dctl_clear_special_wakeup(struct cpu_thread *t);
+/* Same for the primaries of a number of different cores, at once */
+int dctl_set_special_wakeup_cores(struct cpu_thread **cores, unsigned int nr);
+int dctl_clear_special_wakeup_cores(struct cpu_thread **cores,
+				    unsigned int nr);
 int dctl_core_is_gated(struct cpu_thread *t);
 
 #endif /* __CPU_H */
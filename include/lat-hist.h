@@ -0,0 +1,60 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LAT_HIST_H
+#define __LAT_HIST_H
+
+#include <stdint.h>
+#include <timebase.h>
+
+/*
+ * Latency histogram with power of two buckets in microseconds: bucket
+ * 0 counts anything under 2us, bucket n from 2^n to 2^(n+1) - 1us and
+ * the last one everything above. Histograms exported to the OS keep
+ * this layout, in the firmware's endianness.
+ */
+#define LAT_HIST_BUCKETS	24
+
+struct lat_hist {
+	uint64_t	count;
+	uint64_t	total_us;
+	uint64_t	max_us;
+	uint64_t	bucket[LAT_HIST_BUCKETS];
+};
+
+static inline unsigned int lat_hist_bucket(uint64_t us)
+{
+	unsigned int b = 0;
+
+	while (us > 1 && b < LAT_HIST_BUCKETS - 1) {
+		us >>= 1;
+		b++;
+	}
+	return b;
+}
+
+/* Not atomic, callers that can race provide their own locking */
+static inline void lat_hist_add(struct lat_hist *h, unsigned long tb)
+{
+	uint64_t us = tb_to_usecs(tb);
+
+	h->count++;
+	h->total_us += us;
+	if (us > h->max_us)
+		h->max_us = us;
+	h->bucket[lat_hist_bucket(us)]++;
+}
+
+#endif /* __LAT_HIST_H */
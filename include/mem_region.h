@@ -66,6 +66,11 @@ bool mem_check(const struct mem_region *region);
 bool mem_check_all(void);
 void mem_region_release_unused(void);
 void mem_region_clear_unused(void);
+
+/* Parallel zeroing of large ranges, see core/mem-clear.c */
+void mem_zero(void *addr, size_t len);
+void mem_clear_queue(uint64_t start, uint64_t end, uint32_t chip_id);
+void mem_clear_wait(void);
 int64_t mem_dump_free(void);
 void mem_dump_allocs(void);
 
@@ -157,6 +157,11 @@ struct npu2 {
 	uint64_t	tve_cache[16];
 	bool		tx_zcal_complete[2];
 
+	/* XTS BDF map and wildcard PID map entries, by LPARSHORT. See
+	 * npu2-xts.c */
+	uint64_t	xts_bdf_cache[16];
+	uint64_t	xts_pid_cache[16];
+
 	/* Used to protect global MMIO space, in particular the XTS
 	 * tables. */
 	struct lock	lock;
@@ -195,6 +200,7 @@ void npu2_write(struct npu2 *p, uint64_t reg, uint64_t val);
 uint64_t npu2_read(struct npu2 *p, uint64_t reg);
 void npu2_write_mask(struct npu2 *p, uint64_t reg, uint64_t val, uint64_t mask);
 void npu2_write_mask_4b(struct npu2 *p, uint64_t reg, uint32_t val, uint32_t mask);
+void npu2_xts_init(struct npu2 *p);
 int64_t npu2_dev_procedure(void *dev, struct pci_cfg_reg_filter *pcrf,
 			   uint32_t offset, uint32_t len, uint32_t *data,
 			   bool write);
@@ -223,7 +223,9 @@
 #define OPAL_PCI_GET_PBCQ_TUNNEL_BAR		164
 #define OPAL_PCI_SET_PBCQ_TUNNEL_BAR		165
 #define OPAL_HANDLE_HMI2			166
-#define OPAL_LAST				166
+#define OPAL_PCI_CONFIG_ACCESS_VECTOR		167
+#define OPAL_SLW_SET_REG_VECTOR			168
+#define OPAL_LAST				168
 
 #define QUIESCE_HOLD			1 /* Spin all calls at entry */
 #define QUIESCE_REJECT			2 /* Fail all calls with OPAL_BUSY */
@@ -486,6 +488,35 @@ enum OpalPciMaskAction {
 	OPAL_MASK_ERROR_TYPE = 1
 };
 
+/* OPAL_PCI_CONFIG_ACCESS_VECTOR */
+enum OpalPciCfgAccessOp {
+	OPAL_PCI_CFG_ACCESS_READ	= 0,
+	OPAL_PCI_CFG_ACCESS_WRITE	= 1
+};
+
+#define OPAL_PCI_CFG_ACCESS_MAX		256
+
+struct opal_pci_cfg_access {
+	__be16	bdfn;
+	__be16	offset;
+	uint8_t	size;		/* 1, 2 or 4 bytes */
+	uint8_t	op;		/* enum OpalPciCfgAccessOp */
+	__be16	reserved;
+	__be32	value;		/* Value to write, or value read */
+	__be32	rc;		/* OPAL return code for this access */
+};
+
+/* OPAL_SLW_SET_REG_VECTOR */
+#define OPAL_SLW_SET_REG_MAX		4096
+
+struct opal_slw_reg {
+	__be32	pir;
+	__be32	sprn;
+	__be64	value;
+	__be32	rc;		/* OPAL return code for this SPR */
+	__be32	reserved;
+};
+
 enum OpalPciSlotPresence {
 	OPAL_PCI_SLOT_EMPTY	= 0,
 	OPAL_PCI_SLOT_PRESENT	= 1
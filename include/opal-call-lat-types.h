@@ -0,0 +1,63 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/* Layout of the opal_call_latency export, shared with the decoder */
+#ifndef __OPAL_CALL_LAT_TYPES_H
+#define __OPAL_CALL_LAT_TYPES_H
+
+#include <types.h>
+
+#define OPAL_CALL_LAT_MAGIC	0x4f434c54	/* "OCLT" */
+#define OPAL_CALL_LAT_VERSION	1
+
+/* Same as LAT_HIST_BUCKETS, see lat-hist.h for what each one counts */
+#define OPAL_CALL_LAT_BUCKETS	24
+
+/*
+ * The header is followed by one block per CPU, the first one hdr_size
+ * bytes from the start and each cpu_size bytes after the previous one.
+ */
+struct opal_call_lat_hdr {
+	__be32 magic;
+	__be32 version;
+	__be32 hdr_size;
+	__be32 cpu_size;
+	__be32 nr_cpus;
+	/* Histograms per CPU, indexed by OPAL token */
+	__be32 nr_tokens;
+	__be32 nr_buckets;
+	__be32 reserved;
+	__be64 tb_hz;
+};
+
+/*
+ * Time from opal_entry_check() to opal_exit_check(), in microseconds.
+ * The firmware updates these in place, so unlike the header they're in
+ * its own endianness, big endian.
+ */
+struct opal_call_lat_hist {
+	__be64 count;
+	__be64 total_us;
+	__be64 max_us;
+	__be64 bucket[OPAL_CALL_LAT_BUCKETS];
+};
+
+struct opal_call_lat_cpu {
+	__be32 pir;
+	__be32 reserved;
+	struct opal_call_lat_hist hist[];
+};
+
+#endif /* __OPAL_CALL_LAT_TYPES_H */
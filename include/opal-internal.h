@@ -56,6 +56,13 @@ __be64 opal_dynamic_event_alloc(void);
 void opal_dynamic_event_free(__be64 event);
 extern void add_opal_node(void);
 
+/* Exports a firmware buffer to the OS as /sys/firmware/opal/exports/<name> */
+extern void opal_add_export(const char *name, void *base, uint64_t size);
+
+struct cpu_thread;
+extern void opal_call_lat_init(void);
+extern void opal_call_lat_record(struct cpu_thread *cpu, uint64_t token);
+
 #define opal_register(token, func, nargs)				\
 	__opal_register((token) + 0*sizeof(func(__test_args##nargs)),	\
 			(func), (nargs))
@@ -69,9 +76,36 @@ int64_t opal_quiesce(uint32_t shutdown_type, int32_t cpu);
  * which will also be used for other things such as runtime updates
  */
 extern void opal_add_poller(void (*poller)(void *data), void *data);
+extern void opal_add_poller_timed(void (*poller)(void *data), void *data,
+				  const char *name, uint64_t events,
+				  unsigned long interval_ms);
 extern void opal_del_poller(void (*poller)(void *data));
 extern void opal_run_pollers(void);
 
+/*
+ * Events for opal_add_poller_timed() pollers, kicking one runs the
+ * pollers interested in it on the next opal_run_pollers() even if their
+ * interval isn't up. A poller interested in events but without an
+ * interval only runs when kicked.
+ */
+#define OPAL_POLL_EVT_OCC	PPC_BIT(0)
+#define OPAL_POLL_EVT_PSI	PPC_BIT(1)
+#define OPAL_POLL_EVT_UART	PPC_BIT(2)
+#define OPAL_POLL_EVT_FSP	PPC_BIT(3)
+
+extern void opal_kick_pollers(uint64_t events);
+
+/* What opal_run_pollers() did with a named poller so far */
+struct opal_poller_stats {
+	uint64_t	runs;
+	uint64_t	skips;
+	unsigned long	total_tb;
+	unsigned long	max_tb;
+};
+
+extern bool opal_poller_stats(const char *name, struct opal_poller_stats *stats);
+extern void opal_dump_pollers(void);
+
 /*
  * Warning: no locking, only call that from the init processor
  */
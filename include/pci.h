@@ -43,6 +43,31 @@ struct pci_cfg_reg_filter {
 	struct list_node	link;
 };
 
+/*
+ * Capability chains recorded when the device is probed, so that finding
+ * a capability doesn't go through config space. Chains that didn't fit
+ * or couldn't be read aren't recorded and are walked in config space.
+ */
+#define PCI_CACHED_CAPS		16
+#define PCI_CACHED_ECAPS	32
+
+struct pci_cap_cache {
+	bool			stale;
+	bool			caps_valid;
+	bool			ecaps_valid;
+	uint8_t			nr_caps;
+	uint8_t			nr_ecaps;
+	struct {
+		uint8_t		id;
+		uint8_t		pos;
+	} caps[PCI_CACHED_CAPS];
+	struct {
+		uint16_t	id;
+		uint16_t	pos;
+		uint8_t		version;
+	} ecaps[PCI_CACHED_ECAPS];
+};
+
 /*
  * While this might not be necessary in the long run, the existing
  * Linux kernels expect us to provide a device-tree that contains
@@ -84,6 +109,7 @@ struct pci_device {
 		void		*data;
 		pci_cap_free_data_func free_func;
 	} cap[64];
+	struct pci_cap_cache	cap_cache;
 	uint32_t		mps;		/* Max payload size capability */
 
 	uint32_t		pcrf_start;
@@ -202,6 +228,17 @@ struct phb_ops {
 	int64_t (*cfg_write32)(struct phb *phb, uint32_t bdfn,
 			       uint32_t offset, uint32_t data);
 
+	/*
+	 * Optional, runs a batch of OPAL_PCI_CONFIG_ACCESS_VECTOR
+	 * descriptors and sets each one's rc. This lets the PHB check
+	 * its state and the device's filters once per run of accesses
+	 * to the same device. pci_cfg_access_one() does a single access
+	 * through the ops above.
+	 */
+	void (*cfg_access_vector)(struct phb *phb,
+				  struct opal_pci_cfg_access *accs,
+				  uint64_t count);
+
 	/*
 	 * Bus number selection. See pci_scan() for a description
 	 */
@@ -384,6 +421,12 @@ static inline void phb_unlock(struct phb *phb)
 	unlock(&phb->lock);
 }
 
+static inline bool pci_device_has_cfg_reg_filters(struct phb *phb,
+						  uint16_t bdfn)
+{
+	return bitmap_tst_bit(*phb->filter_map, bdfn);
+}
+
 /* Config space ops wrappers */
 static inline int64_t pci_cfg_read8(struct phb *phb, uint32_t bdfn,
 				    uint32_t offset, uint8_t *data)
@@ -434,6 +477,11 @@ extern void pci_add_device_nodes(struct phb *phb,
 extern int64_t pci_find_cap(struct phb *phb, uint16_t bdfn, uint8_t cap);
 extern int64_t pci_find_ecap(struct phb *phb, uint16_t bdfn, uint16_t cap,
 			     uint8_t *version);
+extern int64_t pci_dev_find_cap(struct phb *phb, struct pci_device *pd,
+				uint8_t want);
+extern int64_t pci_dev_find_ecap(struct phb *phb, struct pci_device *pd,
+				 uint16_t want, uint8_t *version);
+extern void pci_uncache_caps(struct phb *phb, struct pci_device *pd);
 extern void pci_init_capabilities(struct phb *phb, struct pci_device *pd);
 extern bool pci_wait_crs(struct phb *phb, uint16_t bdfn, uint32_t *out_vdid);
 extern void pci_restore_slot_bus_configs(struct pci_slot *slot);
@@ -483,6 +531,8 @@ extern void pci_std_swizzle_irq_map(struct dt_node *dt_node,
 extern void pci_init_slots(void);
 extern int64_t pci_reset(void);
 
+extern int64_t pci_cfg_access_one(struct phb *phb,
+				  struct opal_pci_cfg_access *acc);
 extern void opal_pci_eeh_set_evt(uint64_t phb_id);
 extern void opal_pci_eeh_clear_evt(uint64_t phb_id);
 
@@ -250,6 +250,11 @@ static inline void phb4_set_err_pending(struct phb4 *p, bool pending)
 	p->err_pending = pending;
 }
 
+/* TCE cache invalidation, hw/phb4-tce.c */
+extern int64_t phb4_tce_kill(struct phb *phb, uint32_t kill_type,
+			     uint64_t pe_number, uint32_t tce_size,
+			     uint64_t dma_addr, uint32_t npages);
+
 #define PHB4_PER_CHIP                        6 /* Max 6 PHBs per chip on p9 */
 
 static inline int phb4_get_opal_id(unsigned int chip_id, unsigned int index)
@@ -196,6 +196,7 @@ extern void start_kernel_secondary(uint64_t entry) __noreturn;
 extern int parse_hdat(bool is_opal);
 
 struct dt_node;
+struct chip_init_unit;
 
 /* Add /cpus/features node for boot environment that passes an fdt */
 extern void dt_add_cpufeatures(struct dt_node *root);
@@ -242,7 +243,7 @@ extern void mbox_init(void);
 extern void early_uart_init(void);
 extern void homer_init(void);
 extern void occ_pstates_init(void);
-extern void slw_init(void);
+extern const struct chip_init_unit slw_chip_unit;
 extern void add_cpu_idle_state_properties(void);
 extern void occ_fsp_init(void);
 extern void lpc_rtc_init(void);
@@ -323,6 +324,10 @@ extern void xive_late_init(void);
 /* SLW reinit function for switching core settings */
 extern int64_t slw_reinit(uint64_t flags);
 
+/* rvwinkle cycle of the CPUs for it, hw/slw-rvwinkle.c */
+extern void slw_do_rvwinkle(void *data);
+extern int64_t slw_rvwinkle_others(void);
+
 /* Patch SPR in SLW image */
 extern int64_t opal_slw_set_reg(uint64_t cpu_pir, uint64_t sprn, uint64_t val);
 
@@ -36,7 +36,9 @@
  *	CQ:	(Power Bus) Common Queue
  */
 
-extern void vas_init(void);
+struct chip_init_unit;
+extern const struct chip_init_unit vas_chip_unit;
+
 extern __attrconst bool vas_nx_enabled(void);
 extern __attrconst uint64_t vas_get_hvwc_mmio_bar(const int chipid);
 extern __attrconst uint64_t vas_get_wcbs_bar(int chipid);
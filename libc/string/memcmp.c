@@ -12,12 +12,39 @@
 
 #include "string.h"
 
+#define WORD_SIZE sizeof(unsigned long)
+#define WORD_MASK (WORD_SIZE - 1)
 
 int
 memcmp(const void *ptr1, const void *ptr2, size_t n)
 {
 	const unsigned char *p1 = ptr1;
 	const unsigned char *p2 = ptr2;
+	const unsigned long *l1, *l2;
+
+	if (n >= 2 * WORD_SIZE &&
+	    !(((unsigned long)p1 ^ (unsigned long)p2) & WORD_MASK)) {
+		while ((unsigned long)p1 & WORD_MASK) {
+			if (*p1 != *p2)
+				return (*p1 - *p2);
+			p1 += 1;
+			p2 += 1;
+			n--;
+		}
+		/*
+		 * Skip the words that match, the bytes of the first one
+		 * that doesn't are compared below to find the difference.
+		 */
+		l1 = (const unsigned long *)p1;
+		l2 = (const unsigned long *)p2;
+		while (n >= WORD_SIZE && *l1 == *l2) {
+			l1++;
+			l2++;
+			n -= WORD_SIZE;
+		}
+		p1 = (const unsigned char *)l1;
+		p2 = (const unsigned char *)l2;
+	}
 
 	while (n-- > 0) {
 		if (*p1 != *p2)
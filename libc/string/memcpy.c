@@ -12,13 +12,68 @@
 
 #include "string.h"
 
+#define CACHE_LINE_SIZE 128
+#define WORD_SIZE sizeof(unsigned long)
+#define WORD_MASK (WORD_SIZE - 1)
+
 void *
 memcpy(void *dest, const void *src, size_t n)
 {
-	char *cdest;
-	const char *csrc = src;
+	unsigned char *cdest = dest;
+	const unsigned char *csrc = src;
+	unsigned long *ldest;
+	const unsigned long *lsrc;
+	unsigned long a, b, c, d;
+	unsigned int i;
+#if defined(__powerpc__) || defined(__powerpc64__)
+	/* Struct assignment can end up here with dest == src */
+	int overlap = cdest < csrc + n && csrc < cdest + n;
+#endif
+
+	/*
+	 * Words are only accessed aligned as nothing handles alignment
+	 * interrupts, so this needs src and dest to be aligned alike.
+	 */
+	if (n >= 2 * WORD_SIZE &&
+	    !(((unsigned long)cdest ^ (unsigned long)csrc) & WORD_MASK)) {
+		while ((unsigned long)cdest & WORD_MASK) {
+			*cdest++ = *csrc++;
+			n--;
+		}
+		ldest = (unsigned long *)cdest;
+		lsrc = (const unsigned long *)csrc;
+
+		while (n >= CACHE_LINE_SIZE) {
+#if defined(__powerpc__) || defined(__powerpc64__)
+			/* The whole line gets overwritten, don't fetch it */
+			if (!overlap &&
+			    !((unsigned long)ldest % CACHE_LINE_SIZE))
+				asm volatile ("dcbz 0,%0\n" : : "r"(ldest)
+					      : "memory");
+#endif
+			for (i = 0; i < CACHE_LINE_SIZE / WORD_SIZE; i += 4) {
+				a = lsrc[i];
+				b = lsrc[i + 1];
+				c = lsrc[i + 2];
+				d = lsrc[i + 3];
+				ldest[i] = a;
+				ldest[i + 1] = b;
+				ldest[i + 2] = c;
+				ldest[i + 3] = d;
+			}
+			ldest += CACHE_LINE_SIZE / WORD_SIZE;
+			lsrc += CACHE_LINE_SIZE / WORD_SIZE;
+			n -= CACHE_LINE_SIZE;
+		}
+		while (n >= WORD_SIZE) {
+			*ldest++ = *lsrc++;
+			n -= WORD_SIZE;
+		}
+
+		cdest = (unsigned char *)ldest;
+		csrc = (const unsigned char *)lsrc;
+	}
 
-	cdest = dest;
 	while (n-- > 0) {
 		*cdest++ = *csrc++;
 	}
@@ -12,31 +12,95 @@
 
 #include "string.h"
 
+#define WORD_SIZE sizeof(unsigned long)
+#define WORD_MASK (WORD_SIZE - 1)
 
-void *
-memmove(void *dest, const void *src, size_t n)
+/*
+ * Each word is read before the overlapping one is written, so copying
+ * forwards is safe when dest is below src and backwards when it's
+ * above.
+ */
+static void
+copy_forward(unsigned char *cdest, const unsigned char *csrc, size_t n)
 {
-	char *cdest;
-	const char *csrc;
-	int i;
+	unsigned long *ldest;
+	const unsigned long *lsrc;
 
-	/* Do the buffers overlap in a bad way? */
-	if (src < dest && src + n >= dest) {
-		/* Copy from end to start */
-		cdest = dest + n - 1;
-		csrc = src + n - 1;
-		for (i = 0; i < n; i++) {
-			*cdest-- = *csrc--;
+	if (n >= 2 * WORD_SIZE &&
+	    !(((unsigned long)cdest ^ (unsigned long)csrc) & WORD_MASK)) {
+		while ((unsigned long)cdest & WORD_MASK) {
+			*cdest++ = *csrc++;
+			n--;
+		}
+		ldest = (unsigned long *)cdest;
+		lsrc = (const unsigned long *)csrc;
+		while (n >= 4 * WORD_SIZE) {
+			ldest[0] = lsrc[0];
+			ldest[1] = lsrc[1];
+			ldest[2] = lsrc[2];
+			ldest[3] = lsrc[3];
+			ldest += 4;
+			lsrc += 4;
+			n -= 4 * WORD_SIZE;
+		}
+		while (n >= WORD_SIZE) {
+			*ldest++ = *lsrc++;
+			n -= WORD_SIZE;
 		}
+		cdest = (unsigned char *)ldest;
+		csrc = (const unsigned char *)lsrc;
 	}
-	else {
-		/* Normal copy is possible */
-		cdest = dest;
-		csrc = src;
-		for (i = 0; i < n; i++) {
-			*cdest++ = *csrc++;
+
+	while (n-- > 0) {
+		*cdest++ = *csrc++;
+	}
+}
+
+/* cdest and csrc point just past the end of the buffers */
+static void
+copy_backward(unsigned char *cdest, const unsigned char *csrc, size_t n)
+{
+	unsigned long *ldest;
+	const unsigned long *lsrc;
+
+	if (n >= 2 * WORD_SIZE &&
+	    !(((unsigned long)cdest ^ (unsigned long)csrc) & WORD_MASK)) {
+		while ((unsigned long)cdest & WORD_MASK) {
+			*--cdest = *--csrc;
+			n--;
+		}
+		ldest = (unsigned long *)cdest;
+		lsrc = (const unsigned long *)csrc;
+		while (n >= 4 * WORD_SIZE) {
+			ldest -= 4;
+			lsrc -= 4;
+			ldest[3] = lsrc[3];
+			ldest[2] = lsrc[2];
+			ldest[1] = lsrc[1];
+			ldest[0] = lsrc[0];
+			n -= 4 * WORD_SIZE;
+		}
+		while (n >= WORD_SIZE) {
+			*--ldest = *--lsrc;
+			n -= WORD_SIZE;
 		}
+		cdest = (unsigned char *)ldest;
+		csrc = (const unsigned char *)lsrc;
 	}
 
+	while (n-- > 0) {
+		*--cdest = *--csrc;
+	}
+}
+
+void *
+memmove(void *dest, const void *src, size_t n)
+{
+	/* Do the buffers overlap in a bad way? */
+	if (src < dest && src + n > dest)
+		copy_backward(dest + n, src + n, n);
+	else
+		copy_forward(dest, src, n);
+
 	return dest;
 }
@@ -13,37 +13,57 @@
 #include "string.h"
 
 #define CACHE_LINE_SIZE 128
+#define WORD_SIZE sizeof(unsigned long)
+#define WORD_MASK (WORD_SIZE - 1)
 
 void *
 memset(void *dest, int c, size_t size)
 {
 	unsigned char *d = (unsigned char *)dest;
-	unsigned long big_c = 0;
+	unsigned long big_c = (unsigned char)c;
+	unsigned long *ld;
+	unsigned int i;
 
-#if defined(__powerpc__) || defined(__powerpc64__)
-	if (size > CACHE_LINE_SIZE && c==0) {
-		while ((unsigned long long)d % CACHE_LINE_SIZE) {
+	big_c |= big_c << 8;
+	big_c |= big_c << 16;
+	big_c |= big_c << 32;
+
+	if (size >= 2 * WORD_SIZE) {
+		while ((unsigned long)d & WORD_MASK) {
 			*d++ = (unsigned char)c;
 			size--;
 		}
-		while (size >= CACHE_LINE_SIZE) {
-			asm volatile ("dcbz 0,%0\n" : : "r"(d) : "memory");
-			d+= CACHE_LINE_SIZE;
-			size-= CACHE_LINE_SIZE;
+		ld = (unsigned long *)d;
+
+#if defined(__powerpc__) || defined(__powerpc64__)
+		if (size > CACHE_LINE_SIZE && big_c == 0) {
+			while ((unsigned long)ld % CACHE_LINE_SIZE) {
+				*ld++ = 0;
+				size -= WORD_SIZE;
+			}
+			while (size >= CACHE_LINE_SIZE) {
+				asm volatile ("dcbz 0,%0\n" : : "r"(ld) : "memory");
+				ld += CACHE_LINE_SIZE / WORD_SIZE;
+				size -= CACHE_LINE_SIZE;
+			}
 		}
-	}
 #endif
 
-	if (c) {
-		big_c = c;
-		big_c |= (big_c << 8) | big_c;
-		big_c |= (big_c << 16) | big_c;
-		big_c |= (big_c << 32) | big_c;
-	}
-	while (size >= 8 && c == 0) {
-		*((unsigned long *)d) = big_c;
-		d+=8;
-		size-=8;
+		while (size >= CACHE_LINE_SIZE) {
+			for (i = 0; i < CACHE_LINE_SIZE / WORD_SIZE; i += 4) {
+				ld[i] = big_c;
+				ld[i + 1] = big_c;
+				ld[i + 2] = big_c;
+				ld[i + 3] = big_c;
+			}
+			ld += CACHE_LINE_SIZE / WORD_SIZE;
+			size -= CACHE_LINE_SIZE;
+		}
+		while (size >= WORD_SIZE) {
+			*ld++ = big_c;
+			size -= WORD_SIZE;
+		}
+		d = (unsigned char *)ld;
 	}
 
 	while (size-- > 0) {
@@ -12,17 +12,38 @@
 
 #include <string.h>
 
+#define WORD_SIZE sizeof(unsigned long)
+#define WORD_MASK (WORD_SIZE - 1)
+#define ONES ((unsigned long)-1 / 0xff)
+#define HIGHS (ONES << 7)
+/* Non zero if any byte of x is zero */
+#define HAS_ZERO(x) (((x) - ONES) & ~(x) & HIGHS)
+
 size_t
 strlen(const char *s)
 {
-	size_t len = 0;
+	const char *p = s;
+	const unsigned long *w;
 
-	while (*s != 0) {
-		len += 1;
-		s += 1;
+	while ((unsigned long)p & WORD_MASK) {
+		if (*p == 0)
+			return p - s;
+		p += 1;
 	}
 
-	return len;
+	/*
+	 * An aligned word can't straddle a page boundary, so reading the
+	 * rest of the word past the terminator is harmless.
+	 */
+	w = (const unsigned long *)p;
+	while (!HAS_ZERO(*w))
+		w += 1;
+
+	p = (const char *)w;
+	while (*p != 0)
+		p += 1;
+
+	return p - s;
 }
 
 size_t
@@ -0,0 +1,36 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This file is built against the skiboot libc. The functions are
+ * renamed so that run-memops-fuzz.c can compare them against the
+ * system libc ones in the same binary.
+ */
+
+#include <config.h>
+
+#define memcpy skiboot_memcpy
+#define memmove skiboot_memmove
+#define memset skiboot_memset
+#define memcmp skiboot_memcmp
+#define strlen skiboot_strlen
+#define strnlen skiboot_strnlen
+
+#include "../string/memcpy.c"
+#include "../string/memmove.c"
+#include "../string/memset.c"
+#include "../string/memcmp.c"
+#include "../string/strlen.c"
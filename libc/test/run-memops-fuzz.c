@@ -0,0 +1,263 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the skiboot memory primitives against the system libc for
+ * every alignment and length up to a few KB, plus some large copies.
+ *
+ * Run with -b to also get a rough benchmark of both, only meaningful
+ * from an optimised build (make libc-bench).
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+void *skiboot_memcpy(void *dest, const void *src, size_t n);
+void *skiboot_memmove(void *dest, const void *src, size_t n);
+void *skiboot_memset(void *dest, int c, size_t size);
+int skiboot_memcmp(const void *ptr1, const void *ptr2, size_t n);
+size_t skiboot_strlen(const char *s);
+
+/* Lengths are tested one by one up to here, then sparsely */
+#define ALL_LEN		512
+#define MAX_LEN		4096
+#define MAX_ALIGN	16
+/* Room around the buffers to catch writes out of bounds */
+#define GUARD		64
+#define BUF_SIZE	(GUARD + MAX_ALIGN + MAX_LEN + GUARD)
+#define LARGE_LEN	(8 << 20)
+
+static unsigned char src[BUF_SIZE], dst[BUF_SIZE], ref[BUF_SIZE];
+
+static void fill_random(unsigned char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = random();
+}
+
+static size_t next_len(size_t len)
+{
+	return len < ALL_LEN ? len + 1 : len + 61;
+}
+
+static int sign(int v)
+{
+	return (v > 0) - (v < 0);
+}
+
+static void check_memcpy(size_t salign, size_t dalign, size_t len)
+{
+	unsigned char *s = src + GUARD + salign;
+
+	memcpy(ref, dst, BUF_SIZE);
+	memcpy(ref + GUARD + dalign, s, len);
+	assert(skiboot_memcpy(dst + GUARD + dalign, s, len) ==
+	       dst + GUARD + dalign);
+	assert(memcmp(dst, ref, BUF_SIZE) == 0);
+}
+
+static void check_memset(size_t dalign, size_t len, int c)
+{
+	memcpy(ref, dst, BUF_SIZE);
+	memset(ref + GUARD + dalign, c, len);
+	assert(skiboot_memset(dst + GUARD + dalign, c, len) ==
+	       dst + GUARD + dalign);
+	assert(memcmp(dst, ref, BUF_SIZE) == 0);
+}
+
+/* Moves within dst, the two ranges overlapping by any amount */
+static void check_memmove(size_t salign, size_t dalign, size_t len)
+{
+	unsigned char *s = dst + GUARD + salign;
+	unsigned char *d = dst + GUARD + dalign;
+
+	memcpy(ref, dst, BUF_SIZE);
+	memmove(ref + GUARD + dalign, ref + GUARD + salign, len);
+	assert(skiboot_memmove(d, s, len) == d);
+	assert(memcmp(dst, ref, BUF_SIZE) == 0);
+}
+
+static void check_memcmp(size_t salign, size_t dalign, size_t len)
+{
+	unsigned char *s = src + GUARD + salign;
+	unsigned char *d = dst + GUARD + dalign;
+	size_t pos[3];
+	unsigned int i;
+
+	memcpy(d, s, len);
+	assert(skiboot_memcmp(d, s, len) == 0);
+	if (!len)
+		return;
+
+	/* A difference at the start, the end and somewhere random */
+	pos[0] = 0;
+	pos[1] = len - 1;
+	pos[2] = random() % len;
+	for (i = 0; i < 3; i++) {
+		d[pos[i]]++;
+		assert(sign(skiboot_memcmp(d, s, len)) ==
+		       sign(memcmp(d, s, len)));
+		assert(skiboot_memcmp(d, s, len) == d[pos[i]] - s[pos[i]]);
+		d[pos[i]]--;
+	}
+}
+
+static void check_strlen(size_t salign, size_t len)
+{
+	unsigned char *s = src + GUARD + salign;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (!s[i])
+			s[i] = 1;
+	s[len] = 0;
+	assert(skiboot_strlen((char *)s) == len);
+	assert(skiboot_strlen((char *)s) == strlen((char *)s));
+}
+
+static void fuzz(void)
+{
+	size_t salign, dalign, len;
+
+	for (salign = 0; salign < MAX_ALIGN; salign++) {
+		for (dalign = 0; dalign < MAX_ALIGN; dalign++) {
+			fill_random(src, BUF_SIZE);
+			fill_random(dst, BUF_SIZE);
+			for (len = 0; len <= MAX_LEN; len = next_len(len)) {
+				check_memcpy(salign, dalign, len);
+				check_memmove(salign, dalign, len);
+				check_memcmp(salign, dalign, len);
+			}
+		}
+		for (len = 0; len <= MAX_LEN; len = next_len(len)) {
+			check_memset(salign, len, 0);
+			check_memset(salign, len, 0xa5);
+			check_memset(salign, len, random() & 0xff);
+			check_strlen(salign, len);
+		}
+	}
+}
+
+static void large(void)
+{
+	unsigned char *a = malloc(LARGE_LEN + 8), *b = malloc(LARGE_LEN + 8);
+	unsigned int i;
+
+	assert(a && b);
+	fill_random(a, LARGE_LEN + 8);
+
+	for (i = 0; i < 8; i++) {
+		skiboot_memcpy(b + i, a + 8 - i, LARGE_LEN);
+		assert(memcmp(b + i, a + 8 - i, LARGE_LEN) == 0);
+		assert(skiboot_memcmp(b + i, a + 8 - i, LARGE_LEN) == 0);
+	}
+
+	/* Overlapping moves in both directions */
+	memcpy(b, a, LARGE_LEN + 8);
+	skiboot_memmove(a + 8, a, LARGE_LEN);
+	assert(memcmp(a + 8, b, LARGE_LEN) == 0);
+	skiboot_memmove(a, a + 8, LARGE_LEN);
+	assert(memcmp(a, b, LARGE_LEN) == 0);
+
+	skiboot_memset(a + 3, 0, LARGE_LEN);
+	for (i = 0; i < LARGE_LEN; i++)
+		assert(a[i + 3] == 0);
+	assert(skiboot_memcmp(a, b, LARGE_LEN) != 0);
+
+	skiboot_memset(b, 'x', LARGE_LEN);
+	b[LARGE_LEN] = 0;
+	assert(skiboot_strlen((char *)b) == LARGE_LEN);
+
+	free(a);
+	free(b);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Keeps the compiler from dropping results that are never used */
+static volatile size_t sink;
+
+#define BENCH(what, len, loops, call) do {				\
+	double start = now();						\
+	unsigned long l;						\
+									\
+	for (l = 0; l < (loops); l++)					\
+		sink += (size_t)(call);					\
+	printf("%-8s %8zu bytes: %8.1f MB/s\n", what, (size_t)(len),	\
+	       (double)(len) * (loops) / (now() - start) / 1e6);	\
+} while (0)
+
+static void bench(void)
+{
+	static const size_t sizes[] = { 64, 256, 4096, LARGE_LEN };
+	unsigned char *a = malloc(LARGE_LEN + 1), *b = malloc(LARGE_LEN + 8);
+	unsigned long loops;
+	unsigned int i;
+
+	assert(a && b);
+	memset(a, 'a', LARGE_LEN + 1);
+	memset(b, 'a', LARGE_LEN + 8);
+	a[LARGE_LEN] = b[LARGE_LEN] = 0;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		size_t len = sizes[i];
+
+		/* About 1GB of data moved per line */
+		loops = (1ul << 30) / len;
+
+		BENCH("memcpy", len, loops, skiboot_memcpy(b, a, len));
+		BENCH("(libc)", len, loops, memcpy(b, a, len));
+		BENCH("memmove", len, loops, skiboot_memmove(b + 8, b, len));
+		BENCH("(libc)", len, loops, memmove(b + 8, b, len));
+		BENCH("memset", len, loops, skiboot_memset(b, 0x5a, len));
+		BENCH("(libc)", len, loops, memset(b, 0x5a, len));
+		memcpy(b, a, len);
+		BENCH("memcmp", len, loops, skiboot_memcmp(b, a, len));
+		BENCH("(libc)", len, loops, memcmp(b, a, len));
+		a[len] = 0;
+		BENCH("strlen", len, loops, skiboot_strlen((char *)a));
+		BENCH("(libc)", len, loops, strlen((char *)a));
+		a[len] = 'a';
+	}
+
+	free(a);
+	free(b);
+}
+
+int main(int argc, char *argv[])
+{
+	srandom(1);
+
+	fuzz();
+	large();
+
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+		bench();
+
+	return 0;
+}
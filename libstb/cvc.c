@@ -19,6 +19,7 @@
 #endif
 
 #include <skiboot.h>
+#include <cpu.h>
 #include <string.h>
 #include <opal-api.h>
 #include <chip.h>
@@ -326,6 +327,53 @@ int call_cvc_sha512(const uint8_t *data, size_t data_len, uint8_t *digest,
 	return OPAL_SUCCESS;
 }
 
+static void cvc_sha512_job(void *data)
+{
+	struct cvc_sha512_req *req = data;
+
+	req->rc = call_cvc_sha512(req->data, req->data_len, req->digest,
+				  SHA512_DIGEST_LENGTH);
+}
+
+void call_cvc_sha512_start(struct cvc_sha512_req *req)
+{
+	req->job = cpu_queue_job(NULL, "cvc_sha512", cvc_sha512_job, req);
+	if (!req->job)
+		cvc_sha512_job(req);
+}
+
+int call_cvc_sha512_wait(struct cvc_sha512_req *req)
+{
+	if (req->job)
+		cpu_wait_job(req->job, true);
+	req->job = NULL;
+
+	return req->rc;
+}
+
+int call_cvc_sha512_multi(struct cvc_sha512_req *reqs, unsigned int count)
+{
+	unsigned int i;
+	int rc = OPAL_SUCCESS;
+
+	if (!count)
+		return OPAL_SUCCESS;
+
+	/* Hashing is all CPU bound, so we take the last one ourselves */
+	for (i = 0; i < count - 1; i++)
+		call_cvc_sha512_start(&reqs[i]);
+	reqs[count - 1].job = NULL;
+	cvc_sha512_job(&reqs[count - 1]);
+
+	cpu_process_local_jobs();
+
+	for (i = 0; i < count; i++)
+		if (call_cvc_sha512_wait(&reqs[i]) && rc == OPAL_SUCCESS)
+			rc = reqs[i].rc;
+
+	return rc;
+}
+
 int call_cvc_verify(void *container, size_t len, const void *hw_key_hash,
 		    size_t hw_key_hash_size, uint64_t *log)
 {
@@ -58,4 +58,34 @@ int call_cvc_verify(void *buf, size_t size, const void *hw_key_hash,
 int call_cvc_sha512(const uint8_t *data, size_t data_len, uint8_t *digest,
 		    size_t digest_size);
 
+struct cvc_sha512_req {
+	const uint8_t *data;
+	size_t data_len;
+	uint8_t *digest;	/* SHA512_DIGEST_LENGTH bytes */
+	int rc;			/* as returned by call_cvc_sha512() */
+	struct cpu_job *job;
+};
+
+/*
+ * call_cvc_sha512_start - Start calculating the sha512 hash of @req on
+ * another CPU, or right away if there is none to take it.
+ *
+ * call_cvc_sha512_wait - Wait for a hash started by call_cvc_sha512_start()
+ * and return its @rc.
+ */
+void call_cvc_sha512_start(struct cvc_sha512_req *req);
+int call_cvc_sha512_wait(struct cvc_sha512_req *req);
+
+/*
+ * call_cvc_sha512_multi - Calculate the sha512 hash of several buffers at
+ * once, each one on a different CPU. The digests are the same as the ones
+ * call_cvc_sha512() gives for each buffer.
+ *
+ * @reqs - buffers to hash, the result of each is stored in its @rc
+ * @count - number of entries in @reqs
+ *
+ * returns: OPAL_SUCCESS or the first error of any of @reqs
+ */
+int call_cvc_sha512_multi(struct cvc_sha512_req *reqs, unsigned int count);
+
 #endif /* __CVC_H */
@@ -174,10 +174,23 @@ static const uint64_t K[80] =
     UL64(0x5FCB6FAB3AD6FAEC),  UL64(0x6C44198C4A475817)
 };
 
+static inline uint64_t sha512_load_be64( const unsigned char *b )
+{
+    uint64_t n;
+
+    GET_UINT64_BE( n, b, 0 );
+    return( n );
+}
+
+/*
+ * The rounds are fully unrolled and the message schedule is kept in a
+ * 16 entry window computed as the rounds need it rather than expanded
+ * to 80 words upfront, so that it can live in registers. This is what
+ * the CPU spends its time on when hashing a kernel and initramfs.
+ */
 void mbedtls_sha512_process( mbedtls_sha512_context *ctx, const unsigned char data[128] )
 {
-    int i;
-    uint64_t temp1, temp2, W[80];
+    uint64_t temp1, temp2, W[16];
     uint64_t A, B, C, D, E, F, G, H;
 
 #define  SHR(x,n) (x >> n)
@@ -199,16 +212,27 @@ void mbedtls_sha512_process( mbedtls_sha512_context *ctx, const unsigned char da
     d += temp1; h = temp1 + temp2;              \
 }
 
-    for( i = 0; i < 16; i++ )
-    {
-        GET_UINT64_BE( W[i], data, i << 3 );
-    }
-
-    for( ; i < 80; i++ )
-    {
-        W[i] = S1(W[i -  2]) + W[i -  7] +
-               S0(W[i - 15]) + W[i - 16];
-    }
+/* Message words for the first 16 rounds, then the rolling schedule */
+#define LOAD(i) ( W[i] = sha512_load_be64( data + ( (i) << 3 ) ) )
+
+#define R(i)                                    \
+(                                               \
+    W[(i) & 15] += S1(W[((i) - 2) & 15]) +      \
+                   W[((i) - 7) & 15] +          \
+                   S0(W[((i) - 15) & 15])       \
+)
+
+#define P8(i,X)                                                 \
+{                                                               \
+    P( A, B, C, D, E, F, G, H, X((i) + 0), K[(i) + 0] );        \
+    P( H, A, B, C, D, E, F, G, X((i) + 1), K[(i) + 1] );        \
+    P( G, H, A, B, C, D, E, F, X((i) + 2), K[(i) + 2] );        \
+    P( F, G, H, A, B, C, D, E, X((i) + 3), K[(i) + 3] );        \
+    P( E, F, G, H, A, B, C, D, X((i) + 4), K[(i) + 4] );        \
+    P( D, E, F, G, H, A, B, C, X((i) + 5), K[(i) + 5] );        \
+    P( C, D, E, F, G, H, A, B, X((i) + 6), K[(i) + 6] );        \
+    P( B, C, D, E, F, G, H, A, X((i) + 7), K[(i) + 7] );        \
+}
 
     A = ctx->state[0];
     B = ctx->state[1];
@@ -218,20 +242,17 @@ void mbedtls_sha512_process( mbedtls_sha512_context *ctx, const unsigned char da
     F = ctx->state[5];
     G = ctx->state[6];
     H = ctx->state[7];
-    i = 0;
 
-    do
-    {
-        P( A, B, C, D, E, F, G, H, W[i], K[i] ); i++;
-        P( H, A, B, C, D, E, F, G, W[i], K[i] ); i++;
-        P( G, H, A, B, C, D, E, F, W[i], K[i] ); i++;
-        P( F, G, H, A, B, C, D, E, W[i], K[i] ); i++;
-        P( E, F, G, H, A, B, C, D, W[i], K[i] ); i++;
-        P( D, E, F, G, H, A, B, C, W[i], K[i] ); i++;
-        P( C, D, E, F, G, H, A, B, W[i], K[i] ); i++;
-        P( B, C, D, E, F, G, H, A, W[i], K[i] ); i++;
-    }
-    while( i < 80 );
+    P8(  0, LOAD );
+    P8(  8, LOAD );
+    P8( 16, R );
+    P8( 24, R );
+    P8( 32, R );
+    P8( 40, R );
+    P8( 48, R );
+    P8( 56, R );
+    P8( 64, R );
+    P8( 72, R );
 
     ctx->state[0] += A;
     ctx->state[1] += B;
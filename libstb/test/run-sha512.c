@@ -0,0 +1,257 @@
+/* Copyright 2018 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the software SHA-512 against the NIST test vectors, and that
+ * hashing several buffers at once through cpu jobs (threads here) gives
+ * the same digests as hashing them one by one. Prints the throughput of
+ * both.
+ */
+
+#include <config.h>
+
+#define __TEST__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Don't include this, it's PPC-specific */
+#define __CPU_H
+
+struct cpu_thread;
+
+struct cpu_job {
+	pthread_t thread;
+	void (*func)(void *data);
+	void *data;
+};
+
+struct cpu_job *cpu_queue_job(struct cpu_thread *cpu, const char *name,
+			      void (*func)(void *data), void *data);
+void cpu_wait_job(struct cpu_job *job, bool free_it);
+void cpu_process_local_jobs(void);
+
+/* From the skiboot libc, only used with the real secure ROM */
+void *memcpy_from_ci(void *destpp, const void *srcpp, size_t len);
+
+#include "../mbedtls/sha512.c"
+#include "../cvc.c"
+
+struct dt_node *dt_root;
+enum proc_gen proc_gen;
+
+static unsigned int nr_queued;
+
+static void *job_thread(void *data)
+{
+	struct cpu_job *job = data;
+
+	job->func(job->data);
+	return NULL;
+}
+
+struct cpu_job *cpu_queue_job(struct cpu_thread *cpu,
+			      const char *name __unused,
+			      void (*func)(void *data), void *data)
+{
+	struct cpu_job *job = malloc(sizeof(*job));
+
+	assert(!cpu);
+	job->func = func;
+	job->data = data;
+	assert(pthread_create(&job->thread, NULL, job_thread, job) == 0);
+	nr_queued++;
+	return job;
+}
+
+void cpu_wait_job(struct cpu_job *job, bool free_it)
+{
+	assert(pthread_join(job->thread, NULL) == 0);
+	if (free_it)
+		free(job);
+}
+
+void cpu_process_local_jobs(void)
+{
+}
+
+/* FIPS 180-2 appendix C, plus the empty message */
+static const struct {
+	const char *msg;
+	unsigned int repeat;
+	const char *digest;
+} vectors[] = {
+	{ "", 1,
+	  "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+	  "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e" },
+	{ "abc", 1,
+	  "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+	  "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+	{ "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+	  "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+	  "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+	  "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909" },
+	{ "a", 1000000,
+	  "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973eb"
+	  "de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b" },
+};
+
+static void from_hex(const char *hex, uint8_t *out)
+{
+	unsigned int i, v;
+
+	for (i = 0; i < SHA512_DIGEST_LENGTH; i++) {
+		assert(sscanf(hex + 2 * i, "%2x", &v) == 1);
+		out[i] = v;
+	}
+}
+
+static void check_vectors(void)
+{
+	uint8_t expect[SHA512_DIGEST_LENGTH], digest[SHA512_DIGEST_LENGTH];
+	mbedtls_sha512_context ctx;
+	unsigned int i, j;
+	size_t len;
+	uint8_t *buf;
+
+	for (i = 0; i < ARRAY_SIZE(vectors); i++) {
+		from_hex(vectors[i].digest, expect);
+		len = strlen(vectors[i].msg);
+
+		/* Fed a piece at a time, to go through the partial blocks */
+		mbedtls_sha512_init(&ctx);
+		mbedtls_sha512_starts(&ctx, 0);
+		for (j = 0; j < vectors[i].repeat; j++)
+			mbedtls_sha512_update(&ctx,
+				(const unsigned char *)vectors[i].msg, len);
+		mbedtls_sha512_finish(&ctx, digest);
+		mbedtls_sha512_free(&ctx);
+		assert(memcmp(digest, expect, sizeof(digest)) == 0);
+
+		/* And in one go */
+		buf = malloc(len * vectors[i].repeat + 1);
+		for (j = 0; j < vectors[i].repeat; j++)
+			memcpy(buf + j * len, vectors[i].msg, len);
+		mbedtls_sha512(buf, len * vectors[i].repeat, digest, 0);
+		assert(memcmp(digest, expect, sizeof(digest)) == 0);
+		free(buf);
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define NR_BUFS		4
+#define BUF_SIZE	(4 << 20)
+
+static void check_multi(void)
+{
+	static uint8_t digests[NR_BUFS][SHA512_DIGEST_LENGTH];
+	static uint8_t single[NR_BUFS][SHA512_DIGEST_LENGTH];
+	struct cvc_sha512_req reqs[NR_BUFS];
+	uint8_t *bufs[NR_BUFS];
+	size_t total = 0;
+	unsigned int i, j;
+	double start;
+
+	softrom = true;
+
+	for (i = 0; i < NR_BUFS; i++) {
+		/* Different sizes, so that none is a whole number of blocks */
+		reqs[i].data_len = BUF_SIZE - i * 4099;
+		bufs[i] = malloc(reqs[i].data_len);
+		for (j = 0; j < reqs[i].data_len; j++)
+			bufs[i][j] = random();
+		reqs[i].data = bufs[i];
+		reqs[i].digest = digests[i];
+		total += reqs[i].data_len;
+	}
+
+	start = now();
+	for (i = 0; i < NR_BUFS; i++)
+		assert(call_cvc_sha512(bufs[i], reqs[i].data_len, single[i],
+				       SHA512_DIGEST_LENGTH) == OPAL_SUCCESS);
+	printf("single stream: %.1f MB/s\n", total / (now() - start) / 1e6);
+
+	start = now();
+	assert(call_cvc_sha512_multi(reqs, NR_BUFS) == OPAL_SUCCESS);
+	printf("%u streams:     %.1f MB/s\n", NR_BUFS,
+	       total / (now() - start) / 1e6);
+
+	/* The caller's CPU takes one of them */
+	assert(nr_queued == NR_BUFS - 1);
+	for (i = 0; i < NR_BUFS; i++) {
+		assert(reqs[i].rc == OPAL_SUCCESS);
+		assert(!reqs[i].job);
+		assert(memcmp(digests[i], single[i], SHA512_DIGEST_LENGTH) == 0);
+	}
+
+	/* One bad request fails the lot, the others are still hashed */
+	memset(digests, 0, sizeof(digests));
+	reqs[1].digest = NULL;
+	assert(call_cvc_sha512_multi(reqs, NR_BUFS) == OPAL_PARAMETER);
+	assert(reqs[1].rc == OPAL_PARAMETER);
+	for (i = 0; i < NR_BUFS; i++)
+		if (i != 1)
+			assert(memcmp(digests[i], single[i],
+				      SHA512_DIGEST_LENGTH) == 0);
+
+	/* A single one is done by the caller */
+	nr_queued = 0;
+	reqs[0].digest = digests[0];
+	assert(call_cvc_sha512_multi(reqs, 1) == OPAL_SUCCESS);
+	assert(nr_queued == 0);
+	assert(call_cvc_sha512_multi(reqs, 0) == OPAL_SUCCESS);
+
+	/*
+	 * Started one at a time and waited for later, the way the flash
+	 * preload measures one resource while reading the next
+	 */
+	nr_queued = 0;
+	memset(digests, 0, sizeof(digests));
+	reqs[1].digest = digests[1];
+	for (i = 0; i < NR_BUFS; i++)
+		call_cvc_sha512_start(&reqs[i]);
+	assert(nr_queued == NR_BUFS);
+	for (i = 0; i < NR_BUFS; i++) {
+		assert(call_cvc_sha512_wait(&reqs[i]) == OPAL_SUCCESS);
+		assert(!reqs[i].job);
+		assert(memcmp(digests[i], single[i],
+			      SHA512_DIGEST_LENGTH) == 0);
+	}
+
+	for (i = 0; i < NR_BUFS; i++)
+		free(bufs[i]);
+}
+
+int main(void)
+{
+	srandom(1);
+
+	check_vectors();
+	check_multi();
+
+	return 0;
+}
@@ -161,17 +161,12 @@ out_free:
 	return (failed) ? -1 : 0;
 }
 
-int trustedboot_measure(enum resource_id id, void *buf, size_t len)
+/* Checks that a resource can be measured and sets up what to hash */
+static int trustedboot_prepare(struct trustedboot_measurement *m,
+			       struct cvc_sha512_req *req,
+			       enum resource_id id, void *buf, size_t len)
 {
-	uint8_t digest[SHA512_DIGEST_LENGTH];
-	void *buf_aux;
-	size_t len_aux;
 	const char *name;
-	TPM_Pcr pcr;
-	int rc = -1;
-
-	if (!trusted_mode)
-		return 1;
 
 	name = flash_map_resource_name(id);
 	if (!name) {
@@ -195,8 +190,8 @@ int trustedboot_measure(enum resource_id id, void *buf, size_t len)
 		      "services\n", name);
 		return -1;
 	}
-	pcr = map_pcr(id);
-	if (pcr == -1) {
+	m->pcr = map_pcr(id);
+	if (m->pcr == -1) {
 		/**
 		 * @fwts-label ResourceNotMappedToPCR
 		 * @fwts-advice This is a bug. The resource cannot be measured
@@ -214,22 +209,32 @@ int trustedboot_measure(enum resource_id id, void *buf, size_t len)
 		prlog(PR_ERR, "%s NOT MEASURED, it's null\n", name);
 		return -1;
 	}
+	m->name = name;
 	if (stb_is_container(buf, len)) {
-		buf_aux = buf + SECURE_BOOT_HEADERS_SIZE;
-		len_aux = len - SECURE_BOOT_HEADERS_SIZE;
+		req->data = buf + SECURE_BOOT_HEADERS_SIZE;
+		req->data_len = len - SECURE_BOOT_HEADERS_SIZE;
 	} else {
-		buf_aux = buf;
-		len_aux = len;
+		req->data = buf;
+		req->data_len = len;
 	}
+	req->digest = m->digest;
+
+	return 0;
+}
 
-	rc = call_cvc_sha512(buf_aux, len_aux, digest, SHA512_DIGEST_LENGTH);
+/* Extends the PCR once the resource has been hashed */
+static int trustedboot_extend(struct trustedboot_measurement *m,
+			      struct cvc_sha512_req *req)
+{
+	const char *name = m->name;
+	int rc = req->rc;
 
 	if (rc == OPAL_SUCCESS) {
 		prlog(PR_NOTICE, "%s hash calculated\n", name);
 	} else if (rc == OPAL_PARAMETER) {
 		prlog(PR_ERR, "%s NOT MEASURED, invalid param. buf=%p, "
-		      "len=%zd, digest=%p\n", name, buf_aux,
-		      len_aux, digest);
+		      "len=%zd, digest=%p\n", name, req->data,
+		      req->data_len, req->digest);
 		return -1;
 	} else if (rc == OPAL_UNSUPPORTED) {
 		prlog(PR_ERR, "%s NOT MEASURED, CVC-sha512 service not "
@@ -242,15 +247,97 @@ int trustedboot_measure(enum resource_id id, void *buf, size_t len)
 	}
 
 #ifdef STB_DEBUG
-	stb_print_data(digest, TPM_ALG_SHA256_SIZE);
+	stb_print_data(m->digest, TPM_ALG_SHA256_SIZE);
 #endif
 	/*
 	 * Extend the given PCR number in both sha256 and sha1 banks with the
 	 * sha512 hash calculated. The hash is truncated accordingly to fit the
 	 * PCR.
 	 */
-	return tpm_extendl(pcr,
-			   TPM_ALG_SHA256, digest, TPM_ALG_SHA256_SIZE,
-			   TPM_ALG_SHA1,   digest, TPM_ALG_SHA1_SIZE,
+	return tpm_extendl(m->pcr,
+			   TPM_ALG_SHA256, m->digest, TPM_ALG_SHA256_SIZE,
+			   TPM_ALG_SHA1,   m->digest, TPM_ALG_SHA1_SIZE,
 			   EV_ACTION, name);
 }
+
+int trustedboot_measure(enum resource_id id, void *buf, size_t len)
+{
+	struct trustedboot_measurement m;
+	struct cvc_sha512_req req;
+
+	if (!trusted_mode)
+		return 1;
+
+	if (trustedboot_prepare(&m, &req, id, buf, len))
+		return -1;
+
+	req.rc = call_cvc_sha512(req.data, req.data_len, req.digest,
+				 SHA512_DIGEST_LENGTH);
+
+	return trustedboot_extend(&m, &req);
+}
+
+int trustedboot_measure_start(struct trustedboot_measurement *m,
+			      enum resource_id id, void *buf, size_t len)
+{
+	m->started = false;
+
+	if (!trusted_mode)
+		return 1;
+
+	if (trustedboot_prepare(m, &m->req, id, buf, len))
+		return -1;
+
+	call_cvc_sha512_start(&m->req);
+	m->started = true;
+
+	return 0;
+}
+
+int trustedboot_measure_finish(struct trustedboot_measurement *m)
+{
+	if (!m->started)
+		return 0;
+	m->started = false;
+
+	call_cvc_sha512_wait(&m->req);
+
+	return trustedboot_extend(m, &m->req);
+}
+
+int trustedboot_measure_multi(struct trustedboot_resource *res,
+			      unsigned int count)
+{
+	struct trustedboot_measurement *m;
+	unsigned int i;
+	int rc = 0;
+
+	if (!trusted_mode)
+		return 1;
+	if (!count)
+		return 0;
+
+	m = zalloc(count * sizeof(*m));
+	if (!m) {
+		/* Still measured, just one after the other */
+		for (i = 0; i < count; i++)
+			if (trustedboot_measure(res[i].id, res[i].buf,
+						res[i].len))
+				rc = -1;
+		return rc;
+	}
+
+	/* Only the ones that can be measured get hashed */
+	for (i = 0; i < count; i++)
+		if (trustedboot_measure_start(&m[i], res[i].id, res[i].buf,
+					      res[i].len))
+			rc = -1;
+
+	/* The event log has them in the order they were given */
+	for (i = 0; i < count; i++)
+		if (trustedboot_measure_finish(&m[i]))
+			rc = -1;
+
+	free(m);
+	return rc;
+}
@@ -18,6 +18,8 @@
 #define __TRUSTEDBOOT_H
 
 #include <platform.h>
+#include "container.h"
+#include "cvc.h"
 
 void trustedboot_init(void);
 
@@ -48,4 +50,61 @@ int trustedboot_exit_boot_services(void);
  */
 int trustedboot_measure(enum resource_id id, void *buf, size_t len);
 
+struct trustedboot_measurement {
+	const char *name;
+	int pcr;
+	uint8_t digest[SHA512_DIGEST_LENGTH];
+	struct cvc_sha512_req req;
+	bool started;
+};
+
+/**
+ * trustedboot_measure_start - start measuring a resource
+ * @m     : keeps track of the measurement until it's finished
+ * @id    : resource id
+ * @buf   : data to be measured
+ * @len   : buf length
+ *
+ * Hashes the resource on another CPU, so the caller can get on with
+ * something else, e.g. verifying it. @buf must not change until
+ * trustedboot_measure_finish() has extended the PCR. Together the two do
+ * the same as trustedboot_measure().
+ *
+ * returns: 0 if started, 1 if trusted mode is off, -1 otherwise
+ */
+int trustedboot_measure_start(struct trustedboot_measurement *m,
+			      enum resource_id id, void *buf, size_t len);
+
+/**
+ * trustedboot_measure_finish - finish a measurement
+ * @m     : as passed to trustedboot_measure_start()
+ *
+ * Waits for the hash and records the event, measurements finished in the
+ * same order as trustedboot_measure() calls give the same PCR values and
+ * event log.
+ *
+ * returns: as trustedboot_measure(), 0 if the measurement didn't start
+ */
+int trustedboot_measure_finish(struct trustedboot_measurement *m);
+
+struct trustedboot_resource {
+	enum resource_id id;
+	void *buf;
+	size_t len;
+};
+
+/**
+ * trustedboot_measure_multi - measure several resources at once
+ * @res   : resources to measure
+ * @count : number of entries in @res
+ *
+ * Same as calling trustedboot_measure() on each resource in turn, but the
+ * resources are hashed in parallel on different CPUs. The events are still
+ * recorded in the order of @res.
+ *
+ * returns: 0 if all were measured, -1 otherwise
+ */
+int trustedboot_measure_multi(struct trustedboot_resource *res,
+			      unsigned int count);
+
 #endif /* __TRUSTEDBOOT_H */
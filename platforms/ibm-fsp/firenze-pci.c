@@ -247,8 +247,8 @@ static void firenze_pci_add_inventory(struct phb *phb,
 	pci_cfg_read16(phb, pd->bdfn, PCI_CFG_VENDOR_ID, &entry->vendor_id);
 	pci_cfg_read16(phb, pd->bdfn, PCI_CFG_DEVICE_ID, &entry->device_id);
         if (pd->is_bridge) {
-                int64_t ssvc = pci_find_cap(phb, pd->bdfn,
-					    PCI_CFG_CAP_ID_SUBSYS_VID);
+                int64_t ssvc = pci_dev_find_cap(phb, pd,
+						PCI_CFG_CAP_ID_SUBSYS_VID);
 		if (ssvc <= 0) {
 			entry->subsys_vendor_id = 0xffff;
 			entry->subsys_device_id = 0xffff;